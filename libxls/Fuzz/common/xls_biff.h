@@ -0,0 +1,291 @@
+/*
+ * BIFF record list for the libxls fuzzing tools.
+ *
+ * xls_biff_parse() splits a Workbook stream into records.  Each record is a
+ * 16-bit type, a 16-bit length and a body.  Bytes after the last whole record
+ * are kept as a raw tail.
+ *
+ * A BOUNDSHEET record finds its sheet by the stream offset of the sheet's BOF
+ * record (lbPlyPos).  The parser resolves that offset to a record index, and
+ * xls_biff_serialize() writes back the new offset of the same BOF record.  So
+ * records can be inserted, removed and resized without cutting sheets loose.
+ * A BOUNDSHEET whose offset matched no record start keeps its raw value.
+ * Bodies longer than a record can hold are written as the record followed by
+ * CONTINUE records.
+ */
+
+#ifndef XLS_BIFF_H
+#define XLS_BIFF_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "xls_cfb.h"
+
+#define XLS_BIFF_MAX_DATA 8224          // BIFF8 record body limit
+#define XLS_BIFF_MAX_RECORDS (1 << 20)
+
+enum {
+    XLS_BIFF_FORMULA = 0x0006,
+    XLS_BIFF_EOF = 0x000A,
+    XLS_BIFF_1904 = 0x0022,
+    XLS_BIFF_FILEPASS = 0x002F,
+    XLS_BIFF_FONT = 0x0031,
+    XLS_BIFF_CONTINUE = 0x003C,
+    XLS_BIFF_WINDOW1 = 0x003D,
+    XLS_BIFF_CODEPAGE = 0x0042,
+    XLS_BIFF_DEFCOLWIDTH = 0x0055,
+    XLS_BIFF_COLINFO = 0x007D,
+    XLS_BIFF_BOUNDSHEET = 0x0085,
+    XLS_BIFF_MULRK = 0x00BD,
+    XLS_BIFF_MULBLANK = 0x00BE,
+    XLS_BIFF_XF = 0x00E0,
+    XLS_BIFF_MERGEDCELLS = 0x00E5,
+    XLS_BIFF_SST = 0x00FC,
+    XLS_BIFF_LABELSST = 0x00FD,
+    XLS_BIFF_EXTSST = 0x00FF,
+    XLS_BIFF_DIMENSIONS = 0x0200,
+    XLS_BIFF_BLANK = 0x0201,
+    XLS_BIFF_NUMBER = 0x0203,
+    XLS_BIFF_LABEL = 0x0204,
+    XLS_BIFF_BOOLERR = 0x0205,
+    XLS_BIFF_STRING = 0x0207,
+    XLS_BIFF_ROW = 0x0208,
+    XLS_BIFF_RK = 0x027E,
+    XLS_BIFF_FORMAT = 0x041E,
+    XLS_BIFF_SHRFMLA = 0x04BC,
+    XLS_BIFF_BOF = 0x0809,
+};
+
+// BOF substream types (dt)
+enum { XLS_BIFF_BOF_GLOBALS = 0x0005, XLS_BIFF_BOF_SHEET = 0x0010 };
+
+typedef struct {
+    uint16_t type;
+    uint8_t *data;
+    size_t len;
+    int target;     // BOUNDSHEET: index of the sheet's BOF record, or -1
+} xls_biff_record;
+
+typedef struct {
+    xls_biff_record *rec;
+    int count;
+    int cap;
+    uint8_t *tail;  // trailing bytes that do not form a whole record
+    size_t tail_len;
+} xls_biff_stream;
+
+static inline void xls_biff_free(xls_biff_stream *s) {
+    for (int i = 0; i < s->count; i++) {
+        free(s->rec[i].data);
+    }
+    free(s->rec);
+    free(s->tail);
+    memset(s, 0, sizeof(*s));
+}
+
+// Inserts a record with a copy of data before index idx.  Targets of the
+// other records are shifted; the new record's target is -1.
+static inline bool xls_biff_insert(xls_biff_stream *s, int idx, uint16_t type, const uint8_t *data, size_t len) {
+    if (s->count >= XLS_BIFF_MAX_RECORDS) {
+        return false;
+    }
+    if (s->count == s->cap) {
+        int cap = s->cap ? 2 * s->cap : 64;
+        xls_biff_record *grown = (xls_biff_record *)realloc(s->rec, (size_t)cap * sizeof(xls_biff_record));
+        if (!grown) {
+            return false;
+        }
+        s->rec = grown;
+        s->cap = cap;
+    }
+    uint8_t *copy = (uint8_t *)malloc(len ? len : 1);
+    if (!copy) {
+        return false;
+    }
+    if (len) {
+        memcpy(copy, data, len);
+    }
+    // Appending (the parse path) cannot move any target.
+    if (idx < s->count) {
+        for (int i = 0; i < s->count; i++) {
+            if (s->rec[i].target >= idx) {
+                s->rec[i].target++;
+            }
+        }
+    }
+    memmove(&s->rec[idx + 1], &s->rec[idx], (size_t)(s->count - idx) * sizeof(xls_biff_record));
+    s->rec[idx].type = type;
+    s->rec[idx].data = copy;
+    s->rec[idx].len = len;
+    s->rec[idx].target = -1;
+    s->count++;
+    return true;
+}
+
+static inline bool xls_biff_append(xls_biff_stream *s, uint16_t type, const uint8_t *data, size_t len) {
+    return xls_biff_insert(s, s->count, type, data, len);
+}
+
+// Removes record idx.  BOUNDSHEETs that pointed at it keep its old offset.
+static inline void xls_biff_remove(xls_biff_stream *s, int idx) {
+    free(s->rec[idx].data);
+    memmove(&s->rec[idx], &s->rec[idx + 1], (size_t)(s->count - idx - 1) * sizeof(xls_biff_record));
+    s->count--;
+    for (int i = 0; i < s->count; i++) {
+        if (s->rec[i].target == idx) {
+            s->rec[i].target = -1;
+        } else if (s->rec[i].target > idx) {
+            s->rec[i].target--;
+        }
+    }
+}
+
+// Swaps records a and b; BOUNDSHEETs keep pointing at the same BOF record.
+static inline void xls_biff_swap(xls_biff_stream *s, int a, int b) {
+    xls_biff_record t = s->rec[a];
+    s->rec[a] = s->rec[b];
+    s->rec[b] = t;
+    for (int i = 0; i < s->count; i++) {
+        if (s->rec[i].target == a) {
+            s->rec[i].target = b;
+        } else if (s->rec[i].target == b) {
+            s->rec[i].target = a;
+        }
+    }
+}
+
+// Sets the body length of a record, zero-filling any new bytes.
+static inline bool xls_biff_resize(xls_biff_record *r, size_t len) {
+    uint8_t *grown = (uint8_t *)realloc(r->data, len ? len : 1);
+    if (!grown) {
+        return false;
+    }
+    if (len > r->len) {
+        memset(grown + r->len, 0, len - r->len);
+    }
+    r->data = grown;
+    r->len = len;
+    return true;
+}
+
+// Index of the first record of the given type at or after from, or -1.
+static inline int xls_biff_find(const xls_biff_stream *s, uint16_t type, int from) {
+    for (int i = from < 0 ? 0 : from; i < s->count; i++) {
+        if (s->rec[i].type == type) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+static inline bool xls_biff_parse(const uint8_t *buf, size_t len, xls_biff_stream *s) {
+    memset(s, 0, sizeof(*s));
+    size_t pos = 0;
+    size_t *offset = NULL;
+    while (len - pos >= 4 && s->count < XLS_BIFF_MAX_RECORDS) {
+        size_t n = xls_fuzz_get16(buf + pos + 2);
+        if (n > len - pos - 4) {
+            break;
+        }
+        if (!xls_biff_append(s, xls_fuzz_get16(buf + pos), buf + pos + 4, n)) {
+            goto fail;
+        }
+        pos += 4 + n;
+    }
+    if (pos < len) {
+        s->tail = (uint8_t *)malloc(len - pos);
+        if (!s->tail) {
+            goto fail;
+        }
+        memcpy(s->tail, buf + pos, len - pos);
+        s->tail_len = len - pos;
+    }
+
+    // Resolve BOUNDSHEET offsets to record indexes.
+    offset = (size_t *)malloc((size_t)(s->count ? s->count : 1) * sizeof(size_t));
+    if (!offset) {
+        goto fail;
+    }
+    pos = 0;
+    for (int i = 0; i < s->count; i++) {
+        offset[i] = pos;
+        pos += 4 + s->rec[i].len;
+    }
+    for (int i = 0; i < s->count; i++) {
+        xls_biff_record *r = &s->rec[i];
+        if (r->type != XLS_BIFF_BOUNDSHEET || r->len < 4) {
+            continue;
+        }
+        size_t want = xls_fuzz_get32(r->data);
+        int lo = 0, hi = s->count - 1;
+        while (lo <= hi) {
+            int mid = lo + (hi - lo) / 2;
+            if (offset[mid] == want) {
+                r->target = mid;
+                break;
+            }
+            if (offset[mid] < want) {
+                lo = mid + 1;
+            } else {
+                hi = mid - 1;
+            }
+        }
+    }
+    free(offset);
+    return true;
+
+fail:
+    free(offset);
+    xls_biff_free(s);
+    return false;
+}
+
+// Number of records a body of len bytes is written as.
+static inline size_t xls_biff_pieces(size_t len) {
+    return len <= 0xFFFF ? 1 : (len + XLS_BIFF_MAX_DATA - 1) / XLS_BIFF_MAX_DATA;
+}
+
+// Writes the records to out (replacing its contents), with BOUNDSHEET
+// offsets pointing at their BOF records.
+static inline bool xls_biff_serialize(const xls_biff_stream *s, xls_fuzz_buf *out) {
+    out->len = 0;
+    size_t *offset = (size_t *)malloc((size_t)(s->count ? s->count : 1) * sizeof(size_t));
+    if (!offset) {
+        return false;
+    }
+    size_t total = 0;
+    for (int i = 0; i < s->count; i++) {
+        offset[i] = total;
+        total += 4 * xls_biff_pieces(s->rec[i].len) + s->rec[i].len;
+    }
+    bool ok = xls_fuzz_buf_reserve(out, total + s->tail_len);
+    for (int i = 0; ok && i < s->count; i++) {
+        const xls_biff_record *r = &s->rec[i];
+        size_t done = 0;
+        for (size_t piece = 0; piece < xls_biff_pieces(r->len); piece++) {
+            size_t n = r->len <= 0xFFFF ? r->len : r->len - done < XLS_BIFF_MAX_DATA ? r->len - done : XLS_BIFF_MAX_DATA;
+            uint8_t *p = out->data + out->len;
+            xls_fuzz_put16(p, piece ? (uint16_t)XLS_BIFF_CONTINUE : r->type);
+            xls_fuzz_put16(p + 2, (uint16_t)n);
+            if (n) {
+                memcpy(p + 4, r->data + done, n);
+            }
+            if (piece == 0 && r->type == XLS_BIFF_BOUNDSHEET && n >= 4 && r->target >= 0 && r->target < s->count) {
+                xls_fuzz_put32(p + 4, (uint32_t)offset[r->target]);
+            }
+            out->len += 4 + n;
+            done += n;
+        }
+    }
+    if (ok) {
+        ok = xls_fuzz_buf_append(out, s->tail, s->tail_len);
+    }
+    free(offset);
+    return ok;
+}
+
+#endif // XLS_BIFF_H
@@ -0,0 +1,617 @@
+/*
+ * OLE2 compound file (CFB) reader and writer for the libxls fuzzing tools.
+ *
+ * xls_cfb_read() loads every directory entry of a compound file.  Each
+ * stream's contents are gathered from its FAT or MiniFAT sector chain, so the
+ * stream can be edited as one flat buffer.  The reader is meant for fuzzer
+ * inputs.  Chains that loop, leave the file or hit a missing sector are cut
+ * short instead of failing.  Only a bad signature, a bad sector size or a
+ * missing root entry make it give up.
+ *
+ * xls_cfb_write() writes the entries out again as a fresh version 3 file with
+ * 512-byte sectors.  The header, FAT, DIFAT, MiniFAT, mini stream and
+ * directory all agree with each other.  Streams below the 4096-byte cutoff go
+ * to the mini stream, and every other stream gets one contiguous chain.  The
+ * directory tree (left/right/child links and colours) is written back as read.
+ */
+
+#ifndef XLS_CFB_H
+#define XLS_CFB_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define XLS_CFB_SIGNATURE "\xD0\xCF\x11\xE0\xA1\xB1\x1A\xE1"
+#define XLS_CFB_HEADER_SIZE 512
+#define XLS_CFB_HEADER_DIFAT 109     // FAT sector ids held in the header
+#define XLS_CFB_ENTRY_SIZE 128
+#define XLS_CFB_MINI_CUTOFF 4096
+#define XLS_CFB_MINI_SECTOR 64
+#define XLS_CFB_MAX_ENTRIES 4096
+
+#define XLS_CFB_DIFSECT 0xFFFFFFFCu
+#define XLS_CFB_FATSECT 0xFFFFFFFDu
+#define XLS_CFB_ENDOFCHAIN 0xFFFFFFFEu
+#define XLS_CFB_FREESECT 0xFFFFFFFFu
+#define XLS_CFB_NOSTREAM 0xFFFFFFFFu
+
+enum { XLS_CFB_EMPTY = 0, XLS_CFB_STORAGE = 1, XLS_CFB_STREAM = 2, XLS_CFB_ROOT = 5 };
+
+typedef struct {
+    uint8_t *data;
+    size_t len;
+    size_t cap;
+} xls_fuzz_buf;
+
+typedef struct {
+    uint16_t name[32];      // UTF-16LE name as stored
+    uint16_t name_len;      // in bytes, including the terminating NUL
+    uint8_t type;
+    uint8_t color;
+    uint32_t left, right, child;
+    uint8_t clsid[16];
+    uint32_t state;
+    uint8_t times[16];      // creation and modification FILETIMEs
+    uint8_t *data;          // stream contents (streams only)
+    size_t size;
+} xls_cfb_entry;
+
+typedef struct {
+    xls_cfb_entry *entry;   // entry[0] is the root entry
+    int count;
+} xls_cfb;
+
+static inline uint16_t xls_fuzz_get16(const uint8_t *p) {
+    return (uint16_t)(p[0] | p[1] << 8);
+}
+
+static inline uint32_t xls_fuzz_get32(const uint8_t *p) {
+    return (uint32_t)p[0] | (uint32_t)p[1] << 8 | (uint32_t)p[2] << 16 | (uint32_t)p[3] << 24;
+}
+
+static inline void xls_fuzz_put16(uint8_t *p, uint16_t v) {
+    p[0] = (uint8_t)v;
+    p[1] = (uint8_t)(v >> 8);
+}
+
+static inline void xls_fuzz_put32(uint8_t *p, uint32_t v) {
+    p[0] = (uint8_t)v;
+    p[1] = (uint8_t)(v >> 8);
+    p[2] = (uint8_t)(v >> 16);
+    p[3] = (uint8_t)(v >> 24);
+}
+
+static inline bool xls_fuzz_buf_reserve(xls_fuzz_buf *b, size_t n) {
+    if (n <= b->cap) {
+        return true;
+    }
+    size_t cap = b->cap ? b->cap : 256;
+    while (cap < n) {
+        cap *= 2;
+    }
+    uint8_t *grown = (uint8_t *)realloc(b->data, cap);
+    if (!grown) {
+        return false;
+    }
+    b->data = grown;
+    b->cap = cap;
+    return true;
+}
+
+static inline bool xls_fuzz_buf_append(xls_fuzz_buf *b, const void *p, size_t n) {
+    if (!xls_fuzz_buf_reserve(b, b->len + n)) {
+        return false;
+    }
+    if (n) {
+        memcpy(b->data + b->len, p, n);
+    }
+    b->len += n;
+    return true;
+}
+
+static inline void xls_fuzz_buf_free(xls_fuzz_buf *b) {
+    free(b->data);
+    memset(b, 0, sizeof(*b));
+}
+
+static inline void xls_cfb_free(xls_cfb *cfb) {
+    for (int i = 0; i < cfb->count; i++) {
+        free(cfb->entry[i].data);
+    }
+    free(cfb->entry);
+    memset(cfb, 0, sizeof(*cfb));
+}
+
+// Appends the chain starting at sect to out, at most max bytes.  Sector n
+// lives at base + n * unit.  A chain can visit at most nfat sectors, so loops
+// end.
+static inline bool xls_cfb_read_chain(const uint32_t *fat, uint32_t nfat, uint32_t sect, const uint8_t *base,
+                                      size_t base_len, size_t unit, size_t max, xls_fuzz_buf *out) {
+    for (uint32_t steps = 0; out->len < max && steps <= nfat; steps++) {
+        if (sect >= XLS_CFB_DIFSECT || (size_t)sect >= base_len / unit + (base_len % unit != 0)) {
+            break;
+        }
+        size_t off = (size_t)sect * unit;
+        size_t n = base_len - off < unit ? base_len - off : unit;
+        if (n > max - out->len) {
+            n = max - out->len;
+        }
+        if (!xls_fuzz_buf_append(out, base + off, n)) {
+            return false;
+        }
+        if (sect >= nfat) {
+            break;
+        }
+        sect = fat[sect];
+    }
+    return true;
+}
+
+// Reads a sector chain of little-endian 32-bit entries (MiniFAT) into a table.
+static inline uint32_t *xls_cfb_read_table(const xls_fuzz_buf *raw, uint32_t *count) {
+    *count = (uint32_t)(raw->len / 4);
+    uint32_t *table = (uint32_t *)malloc((*count ? *count : 1) * sizeof(uint32_t));
+    if (!table) {
+        return NULL;
+    }
+    for (uint32_t i = 0; i < *count; i++) {
+        table[i] = xls_fuzz_get32(raw->data + 4 * i);
+    }
+    return table;
+}
+
+// Parses a compound file.  On success cfb owns a copy of every stream.
+static inline bool xls_cfb_read(const uint8_t *buf, size_t len, xls_cfb *cfb) {
+    memset(cfb, 0, sizeof(*cfb));
+    if (len < XLS_CFB_HEADER_SIZE || memcmp(buf, XLS_CFB_SIGNATURE, 8) != 0) {
+        return false;
+    }
+    uint16_t shift = xls_fuzz_get16(buf + 0x1E);
+    uint16_t mini_shift = xls_fuzz_get16(buf + 0x20);
+    if (shift != 9 && shift != 12) {
+        return false;
+    }
+    size_t ssz = (size_t)1 << shift;
+    size_t mini_unit = mini_shift >= 2 && mini_shift <= shift ? (size_t)1 << mini_shift : XLS_CFB_MINI_SECTOR;
+    if (len <= ssz) {
+        return false;
+    }
+    const uint8_t *base = buf + ssz;
+    size_t base_len = len - ssz;
+    uint32_t nsect = (uint32_t)(base_len / ssz + (base_len % ssz != 0));
+    uint32_t per = (uint32_t)(ssz / 4);
+
+    // FAT sector ids: the header's DIFAT array, then the DIFAT sector chain.
+    uint32_t want = xls_fuzz_get32(buf + 0x2C);
+    if (want > nsect) {
+        want = nsect;
+    }
+    uint32_t *ids = (uint32_t *)malloc((want ? want : 1) * sizeof(uint32_t));
+    if (!ids) {
+        return false;
+    }
+    uint32_t nids = 0;
+    for (int i = 0; i < XLS_CFB_HEADER_DIFAT && nids < want; i++) {
+        ids[nids++] = xls_fuzz_get32(buf + 0x4C + 4 * i);
+    }
+    uint32_t difat = xls_fuzz_get32(buf + 0x44);
+    for (uint32_t steps = 0; nids < want && difat < nsect && steps < nsect; steps++) {
+        const uint8_t *p = base + (size_t)difat * ssz;
+        size_t avail = base_len - (size_t)difat * ssz;
+        for (uint32_t i = 0; i + 1 < per && nids < want && 4 * (i + 1) <= avail; i++) {
+            ids[nids++] = xls_fuzz_get32(p + 4 * i);
+        }
+        difat = 4 * per <= avail ? xls_fuzz_get32(p + 4 * (per - 1)) : XLS_CFB_ENDOFCHAIN;
+    }
+
+    uint32_t nfat = nids * per;
+    uint32_t *fat = (uint32_t *)malloc((nfat ? nfat : 1) * sizeof(uint32_t));
+    if (!fat) {
+        free(ids);
+        return false;
+    }
+    for (uint32_t i = 0; i < nfat; i++) {
+        uint32_t id = ids[i / per];
+        size_t off = (size_t)id * ssz + 4 * (i % per);
+        fat[i] = id < nsect && off + 4 <= base_len ? xls_fuzz_get32(base + off) : XLS_CFB_FREESECT;
+    }
+    free(ids);
+
+    bool ok = false;
+    xls_fuzz_buf dir = {0}, minifat_raw = {0}, ministream = {0};
+    uint32_t *minifat = NULL, nminifat = 0;
+
+    if (!xls_cfb_read_chain(fat, nfat, xls_fuzz_get32(buf + 0x30), base, base_len, ssz,
+                            (size_t)XLS_CFB_MAX_ENTRIES * XLS_CFB_ENTRY_SIZE, &dir)) {
+        goto out;
+    }
+    int count = (int)(dir.len / XLS_CFB_ENTRY_SIZE);
+    if (count == 0 || dir.data[0x42] != XLS_CFB_ROOT) {
+        goto out;
+    }
+    cfb->entry = (xls_cfb_entry *)calloc((size_t)count, sizeof(xls_cfb_entry));
+    if (!cfb->entry) {
+        goto out;
+    }
+    cfb->count = count;
+
+    size_t minifat_max = (size_t)xls_fuzz_get32(buf + 0x40) * ssz;
+    if (!xls_cfb_read_chain(fat, nfat, xls_fuzz_get32(buf + 0x3C), base, base_len, ssz,
+                            minifat_max < base_len ? minifat_max : base_len, &minifat_raw) ||
+        !(minifat = xls_cfb_read_table(&minifat_raw, &nminifat))) {
+        goto out;
+    }
+    uint32_t cutoff = xls_fuzz_get32(buf + 0x38);
+
+    for (int i = 0; i < cfb->count; i++) {
+        const uint8_t *p = dir.data + (size_t)i * XLS_CFB_ENTRY_SIZE;
+        xls_cfb_entry *e = &cfb->entry[i];
+        for (int c = 0; c < 32; c++) {
+            e->name[c] = xls_fuzz_get16(p + 2 * c);
+        }
+        e->name_len = xls_fuzz_get16(p + 0x40);
+        if (e->name_len > 64) {
+            e->name_len = 64;
+        }
+        e->type = p[0x42];
+        e->color = p[0x43];
+        e->left = xls_fuzz_get32(p + 0x44);
+        e->right = xls_fuzz_get32(p + 0x48);
+        e->child = xls_fuzz_get32(p + 0x4C);
+        memcpy(e->clsid, p + 0x50, 16);
+        e->state = xls_fuzz_get32(p + 0x60);
+        memcpy(e->times, p + 0x64, 16);
+        uint32_t start = xls_fuzz_get32(p + 0x74);
+        size_t size = xls_fuzz_get32(p + 0x78);
+
+        xls_fuzz_buf data = {0};
+        if (i == 0) {
+            // Root entry: its chain is the mini stream.
+            if (!xls_cfb_read_chain(fat, nfat, start, base, base_len, ssz,
+                                    size < base_len ? size : base_len, &ministream)) {
+                goto out;
+            }
+            continue;
+        }
+        if (e->type != XLS_CFB_STREAM || size == 0) {
+            continue;
+        }
+        bool read = size < cutoff
+            ? xls_cfb_read_chain(minifat, nminifat, start, ministream.data, ministream.len, mini_unit,
+                                 size < ministream.len ? size : ministream.len, &data)
+            : xls_cfb_read_chain(fat, nfat, start, base, base_len, ssz, size < base_len ? size : base_len, &data);
+        if (!read) {
+            xls_fuzz_buf_free(&data);
+            goto out;
+        }
+        e->data = data.data;
+        e->size = data.len;
+    }
+    ok = true;
+
+out:
+    free(fat);
+    free(minifat);
+    xls_fuzz_buf_free(&dir);
+    xls_fuzz_buf_free(&minifat_raw);
+    xls_fuzz_buf_free(&ministream);
+    if (!ok) {
+        xls_cfb_free(cfb);
+    }
+    return ok;
+}
+
+// Compares an entry name with an ASCII name, ignoring case like CFB does.
+static inline bool xls_cfb_entry_is(const xls_cfb_entry *e, const char *name) {
+    size_t n = strlen(name);
+    if (e->name_len != 2 * (n + 1)) {
+        return false;
+    }
+    for (size_t i = 0; i < n; i++) {
+        uint16_t c = e->name[i];
+        uint16_t a = (uint8_t)name[i];
+        if (c >= 'a' && c <= 'z') c -= 32;
+        if (a >= 'a' && a <= 'z') a -= 32;
+        if (c != a) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Index of the stream called name, or -1.
+static inline int xls_cfb_find(const xls_cfb *cfb, const char *name) {
+    for (int i = 1; i < cfb->count; i++) {
+        if (cfb->entry[i].type == XLS_CFB_STREAM && xls_cfb_entry_is(&cfb->entry[i], name)) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+// The BIFF stream libxls opens: "Workbook" (BIFF8) or "Book" (BIFF5).
+static inline int xls_cfb_workbook(const xls_cfb *cfb) {
+    int i = xls_cfb_find(cfb, "Workbook");
+    return i >= 0 ? i : xls_cfb_find(cfb, "Book");
+}
+
+static inline void xls_cfb_set_name(xls_cfb_entry *e, const char *name) {
+    size_t n = strlen(name);
+    if (n > 31) {
+        n = 31;
+    }
+    memset(e->name, 0, sizeof(e->name));
+    for (size_t i = 0; i < n; i++) {
+        e->name[i] = (uint8_t)name[i];
+    }
+    e->name_len = (uint16_t)(2 * (n + 1));
+}
+
+// Replaces the contents of a stream with a copy of data.
+static inline bool xls_cfb_set_data(xls_cfb_entry *e, const uint8_t *data, size_t size) {
+    uint8_t *copy = NULL;
+    if (size) {
+        copy = (uint8_t *)malloc(size);
+        if (!copy) {
+            return false;
+        }
+        memcpy(copy, data, size);
+    }
+    free(e->data);
+    e->data = copy;
+    e->size = size;
+    return true;
+}
+
+// Starts an empty compound file that holds only the root entry.
+static inline bool xls_cfb_init(xls_cfb *cfb) {
+    memset(cfb, 0, sizeof(*cfb));
+    cfb->entry = (xls_cfb_entry *)calloc(1, sizeof(xls_cfb_entry));
+    if (!cfb->entry) {
+        return false;
+    }
+    cfb->count = 1;
+    xls_cfb_set_name(&cfb->entry[0], "Root Entry");
+    cfb->entry[0].type = XLS_CFB_ROOT;
+    cfb->entry[0].color = 1;
+    cfb->entry[0].left = cfb->entry[0].right = cfb->entry[0].child = XLS_CFB_NOSTREAM;
+    return true;
+}
+
+// CFB sibling order: shorter names first, then by upper-cased code unit.
+static inline int xls_cfb_compare(const xls_cfb_entry *a, const xls_cfb_entry *b) {
+    if (a->name_len != b->name_len) {
+        return a->name_len < b->name_len ? -1 : 1;
+    }
+    for (int i = 0; i < a->name_len / 2 && i < 32; i++) {
+        uint16_t x = a->name[i], y = b->name[i];
+        if (x >= 'a' && x <= 'z') x -= 32;
+        if (y >= 'a' && y <= 'z') y -= 32;
+        if (x != y) {
+            return x < y ? -1 : 1;
+        }
+    }
+    return 0;
+}
+
+// Adds a stream under the root storage and returns its index, or -1.  The
+// new entry is linked into the root's sibling tree as a plain binary search
+// tree with every node black, which readers accept.
+static inline int xls_cfb_add_stream(xls_cfb *cfb, const char *name, const uint8_t *data, size_t size) {
+    if (cfb->count >= XLS_CFB_MAX_ENTRIES) {
+        return -1;
+    }
+    xls_cfb_entry *grown = (xls_cfb_entry *)realloc(cfb->entry, (size_t)(cfb->count + 1) * sizeof(xls_cfb_entry));
+    if (!grown) {
+        return -1;
+    }
+    cfb->entry = grown;
+    int idx = cfb->count;
+    xls_cfb_entry *e = &cfb->entry[idx];
+    memset(e, 0, sizeof(*e));
+    xls_cfb_set_name(e, name);
+    e->type = XLS_CFB_STREAM;
+    e->color = 1;
+    e->left = e->right = e->child = XLS_CFB_NOSTREAM;
+    if (!xls_cfb_set_data(e, data, size)) {
+        return -1;
+    }
+    cfb->count++;
+
+    uint32_t *link = &cfb->entry[0].child;
+    for (int steps = 0; *link < (uint32_t)idx && steps < idx; steps++) {
+        xls_cfb_entry *node = &cfb->entry[*link];
+        link = xls_cfb_compare(e, node) < 0 ? &node->left : &node->right;
+    }
+    *link = (uint32_t)idx;
+    return idx;
+}
+
+static inline void xls_cfb_chain(uint32_t *table, uint32_t start, uint32_t n) {
+    for (uint32_t i = 0; i < n; i++) {
+        table[start + i] = i + 1 < n ? start + i + 1 : XLS_CFB_ENDOFCHAIN;
+    }
+}
+
+static inline void xls_cfb_put_table(uint8_t *dst, const uint32_t *table, uint32_t n) {
+    for (uint32_t i = 0; i < n; i++) {
+        xls_fuzz_put32(dst + 4 * i, table[i]);
+    }
+}
+
+// Writes cfb to out (replacing its contents) as a consistent version 3 file.
+static inline bool xls_cfb_write(const xls_cfb *cfb, xls_fuzz_buf *out) {
+    const uint32_t ssz = 512, per = ssz / 4;
+    const uint32_t mini_per_sector = ssz / XLS_CFB_MINI_SECTOR;
+    out->len = 0;
+    if (cfb->count < 1 || cfb->count > XLS_CFB_MAX_ENTRIES) {
+        return false;
+    }
+
+    // Sector counts of each region.
+    uint64_t n_mini = 0, n_big = 0;
+    for (int i = 1; i < cfb->count; i++) {
+        const xls_cfb_entry *e = &cfb->entry[i];
+        if (e->type != XLS_CFB_STREAM || e->size == 0) {
+            continue;
+        }
+        if (e->size > 0x7FFFFFFF) {
+            return false;
+        }
+        if (e->size < XLS_CFB_MINI_CUTOFF) {
+            n_mini += (e->size + XLS_CFB_MINI_SECTOR - 1) / XLS_CFB_MINI_SECTOR;
+        } else {
+            n_big += (e->size + ssz - 1) / ssz;
+        }
+    }
+    uint64_t n_ms = (n_mini + mini_per_sector - 1) / mini_per_sector;
+    uint64_t n_dir = ((uint64_t)cfb->count + 3) / 4;
+    uint64_t n_minifat = (n_mini + per - 1) / per;
+    uint64_t body = n_big + n_ms + n_dir + n_minifat;
+    if (body > 0x00FFFFFF) {
+        return false;
+    }
+    // The FAT must also cover its own sectors and the DIFAT sectors.
+    uint32_t n_fat = 1, n_difat = 0;
+    for (;;) {
+        n_difat = n_fat > XLS_CFB_HEADER_DIFAT ? (n_fat - XLS_CFB_HEADER_DIFAT + per - 2) / (per - 1) : 0;
+        uint32_t need = (uint32_t)((body + n_fat + n_difat + per - 1) / per);
+        if (need <= n_fat) {
+            break;
+        }
+        n_fat = need;
+    }
+    uint32_t total = (uint32_t)body + n_fat + n_difat;
+
+    uint32_t *fat = (uint32_t *)malloc((size_t)n_fat * per * sizeof(uint32_t));
+    uint32_t *minifat = (uint32_t *)malloc((size_t)(n_minifat ? n_minifat : 1) * per * sizeof(uint32_t));
+    uint32_t *start = (uint32_t *)malloc((size_t)cfb->count * sizeof(uint32_t));
+    bool ok = fat && minifat && start && xls_fuzz_buf_reserve(out, (size_t)(total + 1) * ssz);
+    if (!ok) {
+        goto done;
+    }
+    memset(fat, 0xFF, (size_t)n_fat * per * sizeof(uint32_t));
+    memset(minifat, 0xFF, (size_t)(n_minifat ? n_minifat : 1) * per * sizeof(uint32_t));
+    memset(out->data, 0, (size_t)(total + 1) * ssz);
+    out->len = (size_t)(total + 1) * ssz;
+    uint8_t *sectors = out->data + ssz;
+
+    // Layout: large streams, mini stream, directory, MiniFAT, FAT, DIFAT.
+    uint32_t next = 0, mini_next = 0;
+    for (int i = 0; i < cfb->count; i++) {
+        const xls_cfb_entry *e = &cfb->entry[i];
+        start[i] = i == 0 || e->type == XLS_CFB_STREAM ? XLS_CFB_ENDOFCHAIN : 0;
+        if (i == 0 || e->type != XLS_CFB_STREAM || e->size < XLS_CFB_MINI_CUTOFF) {
+            continue;
+        }
+        uint32_t n = (uint32_t)((e->size + ssz - 1) / ssz);
+        start[i] = next;
+        xls_cfb_chain(fat, next, n);
+        memcpy(sectors + (size_t)next * ssz, e->data, e->size);
+        next += n;
+    }
+    uint32_t ms_start = next;
+    if (n_ms) {
+        start[0] = ms_start;
+        xls_cfb_chain(fat, ms_start, (uint32_t)n_ms);
+        next += (uint32_t)n_ms;
+    }
+    for (int i = 1; i < cfb->count; i++) {
+        const xls_cfb_entry *e = &cfb->entry[i];
+        if (e->type != XLS_CFB_STREAM || e->size == 0 || e->size >= XLS_CFB_MINI_CUTOFF) {
+            continue;
+        }
+        uint32_t n = (uint32_t)((e->size + XLS_CFB_MINI_SECTOR - 1) / XLS_CFB_MINI_SECTOR);
+        start[i] = mini_next;
+        xls_cfb_chain(minifat, mini_next, n);
+        memcpy(sectors + (size_t)ms_start * ssz + (size_t)mini_next * XLS_CFB_MINI_SECTOR, e->data, e->size);
+        mini_next += n;
+    }
+
+    uint32_t dir_start = next;
+    xls_cfb_chain(fat, dir_start, (uint32_t)n_dir);
+    next += (uint32_t)n_dir;
+    for (uint32_t i = 0; i < n_dir * 4; i++) {
+        uint8_t *p = sectors + (size_t)dir_start * ssz + (size_t)i * XLS_CFB_ENTRY_SIZE;
+        if (i >= (uint32_t)cfb->count) {
+            xls_fuzz_put32(p + 0x44, XLS_CFB_NOSTREAM);
+            xls_fuzz_put32(p + 0x48, XLS_CFB_NOSTREAM);
+            xls_fuzz_put32(p + 0x4C, XLS_CFB_NOSTREAM);
+            continue;
+        }
+        const xls_cfb_entry *e = &cfb->entry[i];
+        for (int c = 0; c < 32; c++) {
+            xls_fuzz_put16(p + 2 * c, e->name[c]);
+        }
+        xls_fuzz_put16(p + 0x40, e->name_len);
+        p[0x42] = e->type;
+        p[0x43] = e->color;
+        xls_fuzz_put32(p + 0x44, e->left);
+        xls_fuzz_put32(p + 0x48, e->right);
+        xls_fuzz_put32(p + 0x4C, e->child);
+        memcpy(p + 0x50, e->clsid, 16);
+        xls_fuzz_put32(p + 0x60, e->state);
+        memcpy(p + 0x64, e->times, 16);
+        xls_fuzz_put32(p + 0x74, start[i]);
+        uint32_t size = i == 0 ? mini_next * XLS_CFB_MINI_SECTOR : e->type == XLS_CFB_STREAM ? (uint32_t)e->size : 0;
+        xls_fuzz_put32(p + 0x78, size);
+    }
+
+    uint32_t minifat_start = next;
+    xls_cfb_chain(fat, minifat_start, (uint32_t)n_minifat);
+    xls_cfb_put_table(sectors + (size_t)minifat_start * ssz, minifat, (uint32_t)n_minifat * per);
+    next += (uint32_t)n_minifat;
+
+    uint32_t fat_start = next;
+    for (uint32_t i = 0; i < n_fat; i++) {
+        fat[fat_start + i] = XLS_CFB_FATSECT;
+    }
+    next += n_fat;
+    uint32_t difat_start = next;
+    for (uint32_t i = 0; i < n_difat; i++) {
+        fat[difat_start + i] = XLS_CFB_DIFSECT;
+    }
+    xls_cfb_put_table(sectors + (size_t)fat_start * ssz, fat, n_fat * per);
+
+    // DIFAT sectors: per - 1 FAT sector ids each, then the next DIFAT sector.
+    for (uint32_t d = 0; d < n_difat; d++) {
+        uint8_t *p = sectors + (size_t)(difat_start + d) * ssz;
+        for (uint32_t i = 0; i + 1 < per; i++) {
+            uint32_t k = XLS_CFB_HEADER_DIFAT + d * (per - 1) + i;
+            xls_fuzz_put32(p + 4 * i, k < n_fat ? fat_start + k : XLS_CFB_FREESECT);
+        }
+        xls_fuzz_put32(p + 4 * (per - 1), d + 1 < n_difat ? difat_start + d + 1 : XLS_CFB_ENDOFCHAIN);
+    }
+
+    uint8_t *h = out->data;
+    memcpy(h, XLS_CFB_SIGNATURE, 8);
+    xls_fuzz_put16(h + 0x18, 0x003E);   // minor version
+    xls_fuzz_put16(h + 0x1A, 0x0003);   // major version 3: 512-byte sectors
+    xls_fuzz_put16(h + 0x1C, 0xFFFE);   // byte order mark
+    xls_fuzz_put16(h + 0x1E, 9);
+    xls_fuzz_put16(h + 0x20, 6);
+    xls_fuzz_put32(h + 0x2C, n_fat);
+    xls_fuzz_put32(h + 0x30, dir_start);
+    xls_fuzz_put32(h + 0x38, XLS_CFB_MINI_CUTOFF);
+    xls_fuzz_put32(h + 0x3C, n_minifat ? minifat_start : XLS_CFB_ENDOFCHAIN);
+    xls_fuzz_put32(h + 0x40, (uint32_t)n_minifat);
+    xls_fuzz_put32(h + 0x44, n_difat ? difat_start : XLS_CFB_ENDOFCHAIN);
+    xls_fuzz_put32(h + 0x48, n_difat);
+    for (uint32_t i = 0; i < XLS_CFB_HEADER_DIFAT; i++) {
+        xls_fuzz_put32(h + 0x4C + 4 * i, i < n_fat ? fat_start + i : XLS_CFB_FREESECT);
+    }
+
+done:
+    free(fat);
+    free(minifat);
+    free(start);
+    if (!ok) {
+        out->len = 0;
+    }
+    return ok;
+}
+
+#endif // XLS_CFB_H
@@ -0,0 +1,91 @@
+/*
+ * Helpers shared by the libxls AFL drivers.
+ *
+ * xls_fuzz_read_file() reads a file argument (afl-fuzz @@, or a crash being
+ * reproduced).  xls_fuzz_check_leaks() runs LeakSanitizer between persistent
+ * iterations, where leaks would otherwise pile up in one process, and aborts
+ * on a leak so that afl-fuzz records a crash.  It checks every
+ * XLS_FUZZ_LEAK_CHECK_INTERVAL iterations (0: never); a check scans the whole
+ * heap, so the default is every 1000 iterations, and the driver checks once
+ * more when the loop ends.  The crash is then saved under the testcase that
+ * ran at the check, while the leak may come from any earlier iteration; use
+ * -DXLS_FUZZ_LEAK_CHECK_INTERVAL=1 when hunting a leak.
+ *
+ * afl-fuzz exports ASAN_OPTIONS=detect_leaks=0 unless it is set, which turns
+ * the check into a no-op; xls_fuzz_warn_leaks_disabled() says so at startup.
+ */
+
+#ifndef XLS_FUZZ_AFL_H
+#define XLS_FUZZ_AFL_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifndef XLS_FUZZ_LEAK_CHECK_INTERVAL
+#define XLS_FUZZ_LEAK_CHECK_INTERVAL 1000
+#endif
+
+// Only present when LeakSanitizer is linked in (-fsanitize=address or leak)
+int __lsan_do_recoverable_leak_check(void) __attribute__((weak));
+
+// Reads the whole file into a malloc'd buffer the caller frees
+static inline uint8_t *xls_fuzz_read_file(const char *path, size_t *size) {
+    FILE *file = fopen(path, "rb");
+    if (!file) {
+        perror("Failed to open input file");
+        return NULL;
+    }
+
+    if (fseeko(file, 0, SEEK_END) != 0) {
+        fprintf(stderr, "fseeko error!\n");
+        fclose(file);
+        return NULL;
+    }
+    *size = ftello(file);
+    if (fseeko(file, 0, SEEK_SET) != 0) {
+        fprintf(stderr, "fseeko error!\n");
+        fclose(file);
+        return NULL;
+    }
+
+    uint8_t *data = (uint8_t *)malloc(*size ? *size : 1);
+    if (!data) {
+        fclose(file);
+        return NULL;
+    }
+    if (fread(data, 1, *size, file) != *size) {
+        perror("Failed to read input file");
+        free(data);
+        fclose(file);
+        return NULL;
+    }
+    fclose(file);
+    return data;
+}
+
+// Leak check after iteration (1-based); 0 checks unconditionally, for the
+// single-file run and the end of the persistent loop
+static inline void xls_fuzz_check_leaks(unsigned long iteration) {
+#if XLS_FUZZ_LEAK_CHECK_INTERVAL > 0
+    if (__lsan_do_recoverable_leak_check && iteration % XLS_FUZZ_LEAK_CHECK_INTERVAL == 0 &&
+        __lsan_do_recoverable_leak_check()) {
+        abort();
+    }
+#else
+    (void)iteration;
+#endif
+}
+
+// With detect_leaks=0 the LeakSanitizer check does nothing; say so once
+static inline void xls_fuzz_warn_leaks_disabled(void) {
+#if XLS_FUZZ_LEAK_CHECK_INTERVAL > 0
+    const char *options = getenv("ASAN_OPTIONS");
+    if (__lsan_do_recoverable_leak_check && options && strstr(options, "detect_leaks=0")) {
+        fprintf(stderr, "ASAN_OPTIONS has detect_leaks=0, the leak check is off; set detect_leaks=1\n");
+    }
+#endif
+}
+
+#endif // XLS_FUZZ_AFL_H
@@ -0,0 +1,133 @@
+/*
+ * Option header for the xls_open_buffer drivers.
+ *
+ * The input is a fixed-size header followed by the .xls file:
+ *
+ *   offset  size  field
+ *   0       4     magic "XLSF"
+ *   4       1     layout version (XLS_FUZZ_OPTIONS_VERSION)
+ *   5       1     bits 0-3: output charset, index into xls_fuzz_charsets
+ *                 bits 4-7: reserved
+ *   6       1     bits 0-1: sheet selection (xls_fuzz_sheet_mode)
+ *                 bits 2-3: cell traversal (xls_fuzz_walk_mode)
+ *                 bit 4: resolve each visited cell's XF, font and number format
+ *                 bits 5-7: reserved
+ *   7       1     sheet argument: the sheet index for XLS_FUZZ_SHEETS_ONE,
+ *                 the sheet mask for XLS_FUZZ_SHEETS_MASK and the seed of
+ *                 XLS_FUZZ_WALK_RANDOM
+ *   8       ...   .xls file
+ *
+ * Every header value is accepted.  The charset is passed to xls_open_buffer
+ * as given, and index 0 passes NULL (libxls' default, UTF-8).  The sheet
+ * argument is not part of the option tuple: it picks from the sheets of one
+ * particular file, much like the file contents themselves.
+ */
+
+#ifndef XLS_FUZZ_OPTIONS_H
+#define XLS_FUZZ_OPTIONS_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#define XLS_FUZZ_OPTIONS_MAGIC   "XLSF"
+#define XLS_FUZZ_OPTIONS_VERSION 1
+#define XLS_FUZZ_OPTIONS_SIZE    8
+
+// Header charset index i selects xls_fuzz_charsets[i].  The list covers the
+// UTF-8 path, iconv to other Unicode encodings, single-byte and multi-byte
+// code pages, and the //TRANSLIT and //IGNORE suffixes.
+static const char *const xls_fuzz_charsets[16] = {
+    NULL,
+    "UTF-8",
+    "UTF-16LE",
+    "UTF-16BE",
+    "UTF-32",
+    "ASCII",
+    "ISO-8859-1",
+    "ISO-8859-15",
+    "WINDOWS-1252",
+    "CP1251",
+    "KOI8-R",
+    "SHIFT_JIS",
+    "GB18030",
+    "BIG5",
+    "ASCII//TRANSLIT",
+    "UTF-8//IGNORE",
+};
+
+typedef enum {
+    XLS_FUZZ_SHEETS_ALL,        // every sheet in order
+    XLS_FUZZ_SHEETS_ONE,        // sheet (argument % count) only
+    XLS_FUZZ_SHEETS_MASK,       // sheet i if bit (i % 8) of the argument is set
+    XLS_FUZZ_SHEETS_REVERSE,    // every sheet, last to first
+} xls_fuzz_sheet_mode;
+
+typedef enum {
+    XLS_FUZZ_WALK_SKIP,         // parse the sheets, do not touch the cells
+    XLS_FUZZ_WALK_ROWS,         // xls_row + xls_cell, row by row
+    XLS_FUZZ_WALK_COLUMNS,      // xls_cell, column by column
+    XLS_FUZZ_WALK_RANDOM,       // xls_cell at random coordinates, one past each edge included
+} xls_fuzz_walk_mode;
+
+typedef struct {
+    int charset_index;
+    const char *charset;        // NULL for libxls' default
+    xls_fuzz_sheet_mode sheets;
+    xls_fuzz_walk_mode walk;
+    bool formats;               // resolve XF, font and format per visited cell
+    uint8_t sheet_arg;
+} xls_fuzz_options;
+
+static inline bool xls_fuzz_has_options(const uint8_t *buf, size_t len) {
+    return len >= XLS_FUZZ_OPTIONS_SIZE &&
+           memcmp(buf, XLS_FUZZ_OPTIONS_MAGIC, 4) == 0 &&
+           buf[4] == XLS_FUZZ_OPTIONS_VERSION;
+}
+
+// Decodes the header.  Returns false if buf does not start with a header of
+// the supported version.
+static inline bool xls_fuzz_parse_options(const uint8_t *buf, size_t len, xls_fuzz_options *opts) {
+    if (!xls_fuzz_has_options(buf, len)) {
+        return false;
+    }
+    opts->charset_index = buf[5] & 0x0f;
+    opts->charset = xls_fuzz_charsets[opts->charset_index];
+    opts->sheets = (xls_fuzz_sheet_mode)(buf[6] & 0x3);
+    opts->walk = (xls_fuzz_walk_mode)((buf[6] >> 2) & 0x3);
+    opts->formats = (buf[6] & 0x10) != 0;
+    opts->sheet_arg = buf[7];
+    return true;
+}
+
+// Default header: libxls' default charset, every sheet, row-major walk.
+static inline void xls_fuzz_default_header(uint8_t *out) {
+    memset(out, 0, XLS_FUZZ_OPTIONS_SIZE);
+    memcpy(out, XLS_FUZZ_OPTIONS_MAGIC, 4);
+    out[4] = XLS_FUZZ_OPTIONS_VERSION;
+    out[6] = XLS_FUZZ_WALK_ROWS << 2;
+}
+
+// Writes the normalised form of a header that passes xls_fuzz_has_options()
+// to key (XLS_FUZZ_OPTIONS_SIZE bytes): reserved bits and the sheet argument
+// are cleared, so headers that decode to the same option tuple get the same
+// key, and the key itself is a valid header.
+static inline void xls_fuzz_options_key(const uint8_t *hdr, uint8_t *key) {
+    memcpy(key, hdr, 5);
+    key[5] = hdr[5] & 0x0f;
+    key[6] = hdr[6] & 0x1f;
+    key[7] = 0;
+}
+
+static inline const char *xls_fuzz_sheet_mode_name(xls_fuzz_sheet_mode mode) {
+    static const char *const names[] = {"all", "one", "mask", "reverse"};
+    return names[mode & 0x3];
+}
+
+static inline const char *xls_fuzz_walk_mode_name(xls_fuzz_walk_mode mode) {
+    static const char *const names[] = {"skip", "rows", "columns", "random"};
+    return names[mode & 0x3];
+}
+
+#endif // XLS_FUZZ_OPTIONS_H
@@ -0,0 +1,244 @@
+/*
+ * One exec of the xls_open_buffer drivers, with per-phase timing.
+ *
+ * xls_fuzz_run() opens the file with the header's charset, parses the
+ * workbook, and parses the selected sheets (common/xls_fuzz_options.h).  It
+ * walks each sheet's cells through the public xls_row / xls_cell accessors
+ * before closing the sheet.  For every visited cell it reads the value and
+ * the converted string.  With the formats option it also looks up the
+ * cell's XF record, font and number format string, which is what a caller
+ * formatting the cell does.
+ *
+ * The wall-clock time of the four phases is kept in xls_fuzz_phases:
+ *
+ *   open       xls_open_buffer (OLE2 container, summary strings)
+ *   workbook   xls_parseWorkBook (globals: SST strings are converted to the
+ *              output charset here)
+ *   sheets     xls_getWorkSheet + xls_parseWorkSheet + xls_close_WS of the
+ *              selected sheets (inline strings and formula results)
+ *   cells      the cell walk
+ *
+ * Set XLS_FUZZ_PHASE_LOG to print one line per exec to stderr with the
+ * option tuple and the phase times.  A number is taken as a threshold in
+ * milliseconds, so that only execs at least that slow are printed.  The line
+ * shows which phase a slow charset conversion path lands in.
+ */
+
+#ifndef XLS_FUZZ_WALK_H
+#define XLS_FUZZ_WALK_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "xls.h"
+#include "xls_fuzz_options.h"
+
+typedef struct {
+    uint64_t open_ns;
+    uint64_t workbook_ns;
+    uint64_t sheets_ns;
+    uint64_t cells_ns;
+    int sheets;                 // sheets parsed
+    uint64_t cells;             // cells visited
+} xls_fuzz_phases;
+
+// Folded into by every visited cell, so the walk is not optimised away.
+static volatile uint64_t xls_fuzz_sink;
+
+static bool xls_fuzz_phase_log_on = false;
+static uint64_t xls_fuzz_phase_log_ns = 0;
+
+// Reads XLS_FUZZ_PHASE_LOG.  Call once, before __AFL_INIT().
+static inline void xls_fuzz_phases_init(void) {
+    const char *env = getenv("XLS_FUZZ_PHASE_LOG");
+    xls_fuzz_phase_log_on = env != NULL;
+    xls_fuzz_phase_log_ns = env ? strtoull(env, NULL, 10) * 1000000 : 0;
+}
+
+static inline uint64_t xls_fuzz_now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000 + (uint64_t)ts.tv_nsec;
+}
+
+static inline uint32_t xls_fuzz_rand(uint32_t *state) {
+    *state ^= *state << 13;
+    *state ^= *state >> 17;
+    *state ^= *state << 5;
+    return *state;
+}
+
+// XF record, font name and number format string of a cell.
+static inline uint64_t xls_fuzz_cell_format(const xlsWorkBook *wb, const xlsCell *cell) {
+    if (cell->xf >= wb->xfs.count || !wb->xfs.xf) {
+        return 0;
+    }
+    const struct st_xf_data *xf = &wb->xfs.xf[cell->xf];
+    uint64_t h = xf->type ^ ((uint64_t)xf->align << 16);
+    // BIFF has no font record 4, so indices above it are one off.
+    DWORD font = xf->font < 4 ? xf->font : (DWORD)xf->font - 1;
+    if (font < wb->fonts.count && wb->fonts.font && wb->fonts.font[font].name) {
+        h += strlen(wb->fonts.font[font].name);
+    }
+    for (DWORD i = 0; i < wb->formats.count && wb->formats.format; i++) {
+        if (wb->formats.format[i].index == xf->format) {
+            if (wb->formats.format[i].value) {
+                h += strlen(wb->formats.format[i].value);
+            }
+            break;
+        }
+    }
+    return h;
+}
+
+static inline uint64_t xls_fuzz_visit(const xlsWorkBook *wb, const xlsCell *cell, bool formats) {
+    if (!cell) {
+        return 1;
+    }
+    uint64_t bits;
+    memcpy(&bits, &cell->d, sizeof(bits));
+    uint64_t h = bits ^ (uint32_t)cell->l ^ ((uint64_t)cell->id << 32);
+    if (cell->str) {
+        h += strlen(cell->str);
+    }
+    if (formats) {
+        h += xls_fuzz_cell_format(wb, cell);
+    }
+    return h;
+}
+
+// Walks the cells of a parsed sheet and returns the number visited.
+static inline uint64_t xls_fuzz_walk_sheet(xlsWorkSheet *ws, int num, const xls_fuzz_options *opts) {
+    if (!ws->rows.row) {
+        return 0;
+    }
+    const xlsWorkBook *wb = ws->workbook;
+    int rows = ws->rows.lastrow + 1;
+    int cols = ws->rows.lastcol + 1;
+    uint64_t h = 0, visited = 0;
+
+    switch (opts->walk) {
+    case XLS_FUZZ_WALK_SKIP:
+        break;
+    case XLS_FUZZ_WALK_ROWS:
+        for (int r = 0; r < rows; r++) {
+            const xlsRow *row = xls_row(ws, (WORD)r);
+            if (!row) {
+                continue;
+            }
+            h += row->height;
+            for (int c = 0; c < cols; c++, visited++) {
+                h += xls_fuzz_visit(wb, xls_cell(ws, (WORD)r, (WORD)c), opts->formats);
+            }
+        }
+        break;
+    case XLS_FUZZ_WALK_COLUMNS:
+        for (int c = 0; c < cols; c++) {
+            for (int r = 0; r < rows; r++, visited++) {
+                h += xls_fuzz_visit(wb, xls_cell(ws, (WORD)r, (WORD)c), opts->formats);
+            }
+        }
+        break;
+    case XLS_FUZZ_WALK_RANDOM: {
+        uint32_t state = ((uint32_t)opts->sheet_arg + 1) * 2654435761u ^ (uint32_t)num;
+        if (!state) {
+            state = 1;
+        }
+        // As many probes as cells; coordinates go one past the last row and
+        // column so the bounds checks in xls_row / xls_cell are reached too.
+        uint32_t rmax = rows < 0xffff ? (uint32_t)rows + 1 : 0x10000;
+        uint32_t cmax = cols < 0xffff ? (uint32_t)cols + 1 : 0x10000;
+        uint64_t probes = (uint64_t)rows * (uint64_t)cols;
+        for (; visited < probes; visited++) {
+            WORD r = (WORD)(xls_fuzz_rand(&state) % rmax);
+            WORD c = (WORD)(xls_fuzz_rand(&state) % cmax);
+            if (xls_fuzz_rand(&state) & 1) {
+                h += xls_row(ws, r) != NULL;
+            }
+            h += xls_fuzz_visit(wb, xls_cell(ws, r, c), opts->formats);
+        }
+        break;
+    }
+    }
+    xls_fuzz_sink += h;
+    return visited;
+}
+
+// Index of the sheet visited at position k of count, or -1 if the
+// selection skips it.
+static inline int xls_fuzz_sheet_at(const xls_fuzz_options *opts, int k, int count) {
+    int i = opts->sheets == XLS_FUZZ_SHEETS_REVERSE ? count - 1 - k : k;
+    switch (opts->sheets) {
+    case XLS_FUZZ_SHEETS_ONE:
+        return i == opts->sheet_arg % count ? i : -1;
+    case XLS_FUZZ_SHEETS_MASK:
+        return (opts->sheet_arg >> (i % 8)) & 1 ? i : -1;
+    default:
+        return i;
+    }
+}
+
+// One exec.  Every allocation is released before returning.
+static inline void xls_fuzz_run(const uint8_t *data, size_t size, const xls_fuzz_options *opts,
+                                xls_fuzz_phases *ph) {
+    memset(ph, 0, sizeof(*ph));
+    xls_error_t error = LIBXLS_OK;
+    uint64_t t0 = xls_fuzz_now_ns();
+    xlsWorkBook *work_book = xls_open_buffer(data, size, opts->charset, &error);
+    uint64_t t1 = xls_fuzz_now_ns();
+    ph->open_ns = t1 - t0;
+    if (!work_book) {
+        return;
+    }
+
+    xls_error_t parsed = xls_parseWorkBook(work_book);
+    uint64_t t2 = xls_fuzz_now_ns();
+    ph->workbook_ns = t2 - t1;
+
+    int count = parsed == LIBXLS_OK ? (int)work_book->sheets.count : 0;
+    for (int k = 0; k < count; k++) {
+        int i = xls_fuzz_sheet_at(opts, k, count);
+        if (i < 0) {
+            continue;
+        }
+        uint64_t s0 = xls_fuzz_now_ns();
+        xlsWorkSheet *work_sheet = xls_getWorkSheet(work_book, i);
+        if (!work_sheet) {
+            ph->sheets_ns += xls_fuzz_now_ns() - s0;
+            continue;
+        }
+        xls_error_t sheet_error = xls_parseWorkSheet(work_sheet);
+        uint64_t s1 = xls_fuzz_now_ns();
+        if (sheet_error == LIBXLS_OK) {
+            ph->cells += xls_fuzz_walk_sheet(work_sheet, i, opts);
+        }
+        uint64_t s2 = xls_fuzz_now_ns();
+        xls_close_WS(work_sheet);
+        ph->sheets_ns += (s1 - s0) + (xls_fuzz_now_ns() - s2);
+        ph->cells_ns += s2 - s1;
+        ph->sheets++;
+    }
+
+    xls_close_WB(work_book);
+}
+
+// Prints the phase line if XLS_FUZZ_PHASE_LOG asks for it.
+static inline void xls_fuzz_phases_log(const xls_fuzz_options *opts, const xls_fuzz_phases *ph) {
+    uint64_t total = ph->open_ns + ph->workbook_ns + ph->sheets_ns + ph->cells_ns;
+    if (!xls_fuzz_phase_log_on || total < xls_fuzz_phase_log_ns) {
+        return;
+    }
+    fprintf(stderr, "xls phases: charset=%s sheets=%s walk=%s formats=%d: open %llu us, workbook %llu us, "
+            "sheets %llu us (%d), cells %llu us (%llu)\n",
+            opts->charset ? opts->charset : "default", xls_fuzz_sheet_mode_name(opts->sheets),
+            xls_fuzz_walk_mode_name(opts->walk), (int)opts->formats,
+            (unsigned long long)(ph->open_ns / 1000), (unsigned long long)(ph->workbook_ns / 1000),
+            (unsigned long long)(ph->sheets_ns / 1000), ph->sheets,
+            (unsigned long long)(ph->cells_ns / 1000), (unsigned long long)ph->cells);
+}
+
+#endif // XLS_FUZZ_WALK_H
@@ -0,0 +1,407 @@
+/*
+ * Synthetic BIFF8 workbook generator for the libxls tools.
+ *
+ * xls_gen_workbook() writes a complete .xls file (an OLE2 container with one
+ * Workbook stream, common/xls_cfb.h) built from a handful of parameters:
+ *
+ *   sheets    worksheets, each with its own BOF..EOF substream
+ *   rows      rows per sheet (ROW records, cells in blocks of 32 rows)
+ *   cols      cells per row; columns cycle through LABELSST, NUMBER and RK
+ *   sst       unique strings in the shared string table (0: no SST, the
+ *             LABELSST columns become NUMBER cells)
+ *   strlen    characters per shared string
+ *   split     body limit of the SST record and its CONTINUE records, at
+ *             most 8224.  Strings are split across CONTINUE records the way
+ *             Excel does it: the string header never splits, and the
+ *             continuation starts with an option-flags byte.
+ *   formula   percentage of cells written as FORMULA records; one in four
+ *             has a string result followed by a STRING record
+ *   seed      seed of the values and string contents
+ *
+ * The globals substream has the BOF, CODEPAGE, 1904, FONT, FORMAT, XF,
+ * BOUNDSHEET, SST and EOF records that libxls reads.  BOUNDSHEET offsets
+ * point at the sheet BOF records, and DIMENSIONS matches the cells written.
+ * The stream is written directly rather than through a record list (common/
+ * xls_biff.h), so workbooks with millions of cells stay cheap to build.
+ */
+
+#ifndef XLS_GEN_H
+#define XLS_GEN_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "xls_cfb.h"
+#include "xls_biff.h"
+
+typedef struct {
+    int sheets;
+    int rows;
+    int cols;
+    int sst;
+    int str_len;
+    int split;
+    int formula_pct;
+    uint32_t seed;
+} xls_gen_params;
+
+static inline void xls_gen_defaults(xls_gen_params *p) {
+    p->sheets = 1;
+    p->rows = 1000;
+    p->cols = 10;
+    p->sst = 1000;
+    p->str_len = 16;
+    p->split = XLS_BIFF_MAX_DATA;
+    p->formula_pct = 10;
+    p->seed = 1;
+}
+
+static inline void xls_gen_clamp(xls_gen_params *p) {
+#define XLS_GEN_CLAMP(v, lo, hi) ((v) = (v) < (lo) ? (lo) : (v) > (hi) ? (hi) : (v))
+    XLS_GEN_CLAMP(p->sheets, 1, 1024);
+    XLS_GEN_CLAMP(p->rows, 0, 65536);
+    XLS_GEN_CLAMP(p->cols, 0, 256);
+    XLS_GEN_CLAMP(p->sst, 0, 1 << 24);
+    XLS_GEN_CLAMP(p->str_len, 1, 32767);
+    XLS_GEN_CLAMP(p->split, 16, XLS_BIFF_MAX_DATA);
+    XLS_GEN_CLAMP(p->formula_pct, 0, 100);
+#undef XLS_GEN_CLAMP
+}
+
+// Applies "key=N[,key=N...]" on top of p.  Returns false on an unknown key
+// or a malformed value.
+static inline bool xls_gen_parse(xls_gen_params *p, const char *spec) {
+    static const struct {
+        const char *key;
+        size_t offset;
+    } keys[] = {
+        {"sheets", offsetof(xls_gen_params, sheets)},
+        {"rows", offsetof(xls_gen_params, rows)},
+        {"cols", offsetof(xls_gen_params, cols)},
+        {"sst", offsetof(xls_gen_params, sst)},
+        {"strlen", offsetof(xls_gen_params, str_len)},
+        {"split", offsetof(xls_gen_params, split)},
+        {"formula", offsetof(xls_gen_params, formula_pct)},
+    };
+    while (*spec) {
+        const char *eq = strchr(spec, '=');
+        if (!eq) {
+            return false;
+        }
+        char *end;
+        long value = strtol(eq + 1, &end, 0);
+        if (end == eq + 1 || (*end && *end != ',')) {
+            return false;
+        }
+        size_t klen = (size_t)(eq - spec);
+        bool known = false;
+        if (klen == 4 && !strncmp(spec, "seed", 4)) {
+            p->seed = (uint32_t)value;
+            known = true;
+        }
+        for (size_t i = 0; !known && i < sizeof(keys) / sizeof(keys[0]); i++) {
+            if (strlen(keys[i].key) == klen && !strncmp(spec, keys[i].key, klen)) {
+                *(int *)((char *)p + keys[i].offset) = (int)value;
+                known = true;
+            }
+        }
+        if (!known) {
+            return false;
+        }
+        spec = *end ? end + 1 : end;
+    }
+    xls_gen_clamp(p);
+    return true;
+}
+
+typedef struct {
+    xls_fuzz_buf *out;
+    uint32_t rng;
+    bool ok;
+    size_t head;    // offset of the open record's header (chunked records)
+    size_t limit;
+} xls_gen;
+
+static inline uint32_t xls_gen_rand(xls_gen *g) {
+    g->rng ^= g->rng << 13;
+    g->rng ^= g->rng >> 17;
+    g->rng ^= g->rng << 5;
+    return g->rng;
+}
+
+static inline void xls_gen_bytes(xls_gen *g, const void *data, size_t len) {
+    g->ok = g->ok && xls_fuzz_buf_append(g->out, data, len);
+}
+
+static inline void xls_gen_record(xls_gen *g, uint16_t type, const void *data, size_t len) {
+    uint8_t h[4];
+    xls_fuzz_put16(h, type);
+    xls_fuzz_put16(h + 2, (uint16_t)len);
+    xls_gen_bytes(g, h, 4);
+    xls_gen_bytes(g, data, len);
+}
+
+static inline void xls_gen_bof(xls_gen *g, uint16_t dt) {
+    uint8_t b[16] = {0};
+    xls_fuzz_put16(b, 0x0600);      // BIFF8
+    xls_fuzz_put16(b + 2, dt);
+    xls_fuzz_put16(b + 4, 0x0DBB);  // build
+    xls_fuzz_put16(b + 6, 0x07CC);  // year
+    xls_fuzz_put32(b + 12, 0x0006); // lowest BIFF version that can read it
+    xls_gen_record(g, XLS_BIFF_BOF, b, sizeof(b));
+}
+
+// Records whose body is cut into CONTINUE records at g->limit bytes.
+static inline void xls_gen_chunk_open(xls_gen *g, uint16_t type) {
+    g->head = g->out->len;
+    uint8_t h[4] = {0};
+    xls_fuzz_put16(h, type);
+    xls_gen_bytes(g, h, 4);
+}
+
+static inline void xls_gen_chunk_close(xls_gen *g) {
+    if (g->ok) {
+        xls_fuzz_put16(g->out->data + g->head + 2, (uint16_t)(g->out->len - g->head - 4));
+    }
+}
+
+static inline size_t xls_gen_chunk_room(const xls_gen *g) {
+    size_t used = g->out->len - g->head - 4;
+    return used < g->limit ? g->limit - used : 0;
+}
+
+// One shared string (compressed characters, no rich text or phonetic data).
+static inline void xls_gen_sst_string(xls_gen *g, const char *s, size_t len) {
+    if (xls_gen_chunk_room(g) < 4) {
+        xls_gen_chunk_close(g);
+        xls_gen_chunk_open(g, XLS_BIFF_CONTINUE);
+    }
+    uint8_t h[3];
+    xls_fuzz_put16(h, (uint16_t)len);
+    h[2] = 0;
+    xls_gen_bytes(g, h, 3);
+    size_t done = 0;
+    while (g->ok && done < len) {
+        size_t room = xls_gen_chunk_room(g);
+        if (room == 0) {
+            xls_gen_chunk_close(g);
+            xls_gen_chunk_open(g, XLS_BIFF_CONTINUE);
+            uint8_t grbit = 0;
+            xls_gen_bytes(g, &grbit, 1);
+            room = g->limit - 1;
+        }
+        size_t n = len - done < room ? len - done : room;
+        xls_gen_bytes(g, s + done, n);
+        done += n;
+    }
+}
+
+static inline void xls_gen_globals(xls_gen *g, const xls_gen_params *p, size_t *boundsheet, size_t *sst_total) {
+    xls_gen_bof(g, XLS_BIFF_BOF_GLOBALS);
+    uint8_t codepage[2];
+    xls_fuzz_put16(codepage, 1200);     // UTF-16
+    xls_gen_record(g, XLS_BIFF_CODEPAGE, codepage, 2);
+    uint8_t date1904[2] = {0};
+    xls_gen_record(g, XLS_BIFF_1904, date1904, 2);
+
+    // Four fonts (Excel skips index 4), all Arial 10pt.
+    for (int i = 0; i < 4; i++) {
+        uint8_t font[14 + 2 + 5] = {0};
+        xls_fuzz_put16(font, 200);
+        xls_fuzz_put16(font + 4, 0x7FFF);
+        xls_fuzz_put16(font + 6, i == 1 ? 700 : 400);
+        font[14] = 5;
+        memcpy(font + 16, "Arial", 5);
+        xls_gen_record(g, XLS_BIFF_FONT, font, sizeof(font));
+    }
+
+    uint8_t format[2 + 3 + 4];
+    xls_fuzz_put16(format, 164);        // first user-defined format index
+    xls_fuzz_put16(format + 2, 4);
+    format[4] = 0;
+    memcpy(format + 5, "0.00", 4);
+    xls_gen_record(g, XLS_BIFF_FORMAT, format, sizeof(format));
+
+    // 15 style XFs, the default cell XF (15) and one using format 164 (16).
+    for (int i = 0; i < 17; i++) {
+        uint8_t xf[20] = {0};
+        xls_fuzz_put16(xf + 2, i == 16 ? 164 : 0);
+        xls_fuzz_put16(xf + 4, i < 15 ? 0xFFF5 : 0x0001);
+        xf[6] = 0x20;                   // bottom aligned
+        xls_fuzz_put16(xf + 18, 0x20C0);
+        xls_gen_record(g, XLS_BIFF_XF, xf, sizeof(xf));
+    }
+
+    for (int s = 0; s < p->sheets; s++) {
+        uint8_t sheet[8 + 16];
+        int n = snprintf((char *)sheet + 8, 16, "Sheet%d", s + 1);
+        xls_fuzz_put32(sheet, 0);       // lbPlyPos, patched by the caller
+        sheet[4] = 0;                   // visible
+        sheet[5] = 0;                   // worksheet
+        sheet[6] = (uint8_t)n;
+        sheet[7] = 0;
+        boundsheet[s] = g->out->len + 4;
+        xls_gen_record(g, XLS_BIFF_BOUNDSHEET, sheet, 8 + (size_t)n);
+    }
+
+    if (p->sst > 0) {
+        char *str = (char *)malloc((size_t)p->str_len + 16);
+        if (!str) {
+            g->ok = false;
+            return;
+        }
+        g->limit = (size_t)p->split;
+        xls_gen_chunk_open(g, XLS_BIFF_SST);
+        uint8_t counts[8];
+        *sst_total = g->out->len;
+        xls_fuzz_put32(counts, 0);      // cstTotal, patched by the caller
+        xls_fuzz_put32(counts + 4, (uint32_t)p->sst);
+        xls_gen_bytes(g, counts, 8);
+        for (int i = 0; g->ok && i < p->sst; i++) {
+            int n = snprintf(str, 16, "s%d.", i);
+            for (; n < p->str_len; n++) {
+                str[n] = (char)('a' + xls_gen_rand(g) % 26);
+            }
+            xls_gen_sst_string(g, str, (size_t)p->str_len);
+        }
+        xls_gen_chunk_close(g);
+        free(str);
+    }
+    xls_gen_record(g, XLS_BIFF_EOF, NULL, 0);
+}
+
+static inline void xls_gen_formula(xls_gen *g, int r, int c) {
+    uint8_t f[22 + 9];
+    memset(f, 0, sizeof(f));
+    xls_fuzz_put16(f, (uint16_t)r);
+    xls_fuzz_put16(f + 2, (uint16_t)c);
+    xls_fuzz_put16(f + 4, 15);
+    bool string_result = xls_gen_rand(g) % 4 == 0;
+    if (string_result) {
+        f[12] = f[13] = 0xFF;           // cached result is the STRING record below
+    } else {
+        double v = (double)(r + c);
+        memcpy(f + 6, &v, 8);
+    }
+    xls_fuzz_put16(f + 14, 0x0001);     // fAlwaysCalc
+    // The cell to the left (or above) plus one: ptgRef, ptgInt, ptgAdd
+    size_t cce = 0;
+    if (c > 0 || r > 0) {
+        f[22] = 0x24;
+        xls_fuzz_put16(f + 23, (uint16_t)(c > 0 ? r : r - 1));
+        xls_fuzz_put16(f + 25, (uint16_t)(0xC000 | (c > 0 ? c - 1 : c)));
+        cce = 5;
+    }
+    f[22 + cce] = 0x1E;
+    xls_fuzz_put16(f + 23 + cce, 1);
+    cce += 3;
+    if (cce > 3) {
+        f[22 + cce++] = 0x03;
+    }
+    xls_fuzz_put16(f + 20, (uint16_t)cce);
+    xls_gen_record(g, XLS_BIFF_FORMULA, f, 22 + cce);
+
+    if (string_result) {
+        uint8_t s[3 + 24];
+        int n = snprintf((char *)s + 3, 24, "r%dc%d", r, c);
+        xls_fuzz_put16(s, (uint16_t)n);
+        s[2] = 0;
+        xls_gen_record(g, XLS_BIFF_STRING, s, 3 + (size_t)n);
+    }
+}
+
+// Writes one worksheet substream; returns the LABELSST cells written.
+static inline uint32_t xls_gen_sheet(xls_gen *g, const xls_gen_params *p, int sheet) {
+    uint32_t labels = 0;
+    xls_gen_bof(g, XLS_BIFF_BOF_SHEET);
+    uint8_t width[2];
+    xls_fuzz_put16(width, 8);
+    xls_gen_record(g, XLS_BIFF_DEFCOLWIDTH, width, 2);
+    uint8_t dim[14] = {0};
+    xls_fuzz_put32(dim + 4, (uint32_t)(p->cols ? p->rows : 0));
+    xls_fuzz_put16(dim + 10, (uint16_t)(p->rows ? p->cols : 0));
+    xls_gen_record(g, XLS_BIFF_DIMENSIONS, dim, sizeof(dim));
+
+    for (int block = 0; g->ok && block < p->rows; block += 32) {
+        int end = block + 32 < p->rows ? block + 32 : p->rows;
+        for (int r = block; r < end; r++) {
+            uint8_t row[16] = {0};
+            xls_fuzz_put16(row, (uint16_t)r);
+            xls_fuzz_put16(row + 4, (uint16_t)p->cols);
+            xls_fuzz_put16(row + 6, 0x00FF);
+            xls_fuzz_put16(row + 12, 0x0100);
+            xls_fuzz_put16(row + 14, 15);
+            xls_gen_record(g, XLS_BIFF_ROW, row, sizeof(row));
+        }
+        for (int r = block; r < end; r++) {
+            for (int c = 0; c < p->cols; c++) {
+                if ((int)(xls_gen_rand(g) % 100) < p->formula_pct) {
+                    xls_gen_formula(g, r, c);
+                    continue;
+                }
+                uint8_t cell[14];
+                xls_fuzz_put16(cell, (uint16_t)r);
+                xls_fuzz_put16(cell + 2, (uint16_t)c);
+                xls_fuzz_put16(cell + 4, c % 3 == 1 ? 16 : 15);
+                if (c % 3 == 0 && p->sst > 0) {
+                    xls_fuzz_put32(cell + 6, (uint32_t)((sheet + r * p->cols + c) % p->sst));
+                    xls_gen_record(g, XLS_BIFF_LABELSST, cell, 10);
+                    labels++;
+                } else if (c % 3 == 2) {
+                    // Integer RK value
+                    xls_fuzz_put32(cell + 6, ((xls_gen_rand(g) % 1000000) << 2) | 0x02);
+                    xls_gen_record(g, XLS_BIFF_RK, cell, 10);
+                } else {
+                    double v = (double)xls_gen_rand(g) / 1024.0;
+                    memcpy(cell + 6, &v, 8);
+                    xls_gen_record(g, XLS_BIFF_NUMBER, cell, 14);
+                }
+            }
+        }
+    }
+    xls_gen_record(g, XLS_BIFF_EOF, NULL, 0);
+    return labels;
+}
+
+// Writes the BIFF8 Workbook stream to stream (replacing its contents).
+static inline bool xls_gen_stream(const xls_gen_params *params, xls_fuzz_buf *stream) {
+    xls_gen_params p = *params;
+    xls_gen_clamp(&p);
+    stream->len = 0;
+    xls_gen g = {stream, p.seed ? p.seed : 1, true, 0, XLS_BIFF_MAX_DATA};
+    size_t *boundsheet = (size_t *)calloc((size_t)p.sheets, sizeof(size_t));
+    if (!boundsheet) {
+        return false;
+    }
+    size_t sst_total = 0;
+    xls_gen_globals(&g, &p, boundsheet, &sst_total);
+    uint32_t labels = 0;
+    for (int s = 0; g.ok && s < p.sheets; s++) {
+        xls_fuzz_put32(stream->data + boundsheet[s], (uint32_t)stream->len);
+        labels += xls_gen_sheet(&g, &p, s);
+    }
+    if (g.ok && sst_total) {
+        xls_fuzz_put32(stream->data + sst_total, labels);
+    }
+    free(boundsheet);
+    return g.ok;
+}
+
+// Writes a complete .xls file to out (replacing its contents).
+static inline bool xls_gen_workbook(const xls_gen_params *params, xls_fuzz_buf *out) {
+    xls_fuzz_buf stream = {0};
+    xls_cfb cfb;
+    bool ok = xls_gen_stream(params, &stream) && xls_cfb_init(&cfb);
+    if (ok) {
+        ok = xls_cfb_add_stream(&cfb, "Workbook", stream.data, stream.len) >= 0 && xls_cfb_write(&cfb, out);
+        xls_cfb_free(&cfb);
+    }
+    xls_fuzz_buf_free(&stream);
+    return ok;
+}
+
+#endif // XLS_GEN_H
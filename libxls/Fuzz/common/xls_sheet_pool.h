@@ -0,0 +1,324 @@
+/*
+ * Concurrent worksheet parsing for the libxls drivers.
+ *
+ * xls_sheet_pool_check() takes the input buffer and a workbook that has been
+ * opened from it and parsed once.  It parses every worksheet twice.  The
+ * first pass runs the sheets on a pool of worker threads.  Each worker that
+ * claims a sheet opens its own handle on the shared input buffer with
+ * xls_open_buffer + xls_parseWorkBook, and runs xls_getWorkSheet,
+ * xls_parseWorkSheet and xls_close_WS on that handle for the sheets it
+ * claims.  The second pass is the driver's usual sequential loop on the
+ * driver's workbook.  Each sheet's cells are hashed in both passes, and any
+ * difference aborts, so results that depend on thread interleaving are
+ * reported as crashes.  Built with -fsanitize=thread, the concurrent pass
+ * also lets ThreadSanitizer report the data races behind them.  Since no
+ * handle is shared, those are races on state that libxls keeps globally.
+ * The concurrent pass goes first so that such state is set up under
+ * contention.
+ *
+ * An xlsWorkBook must not be shared between threads: xls_parseWorkSheet
+ * seeks and reads the workbook's single OLE2 stream (wb->olestr), so two
+ * sheets parsed at once on one handle race by design.  Set
+ * XLS_FUZZ_SHARED_WORKBOOK=1 to run the workers on the driver's workbook
+ * anyway, as a reproducer for that race.  Any workbook with two or more
+ * sheets then fails the check, so it is not a fuzzing mode.
+ *
+ * The pool is created on the first call, after the AFL forkserver has
+ * forked, and its threads are reused for every later input.
+ * XLS_FUZZ_THREADS sets the worker count (default 4).  Set
+ * XLS_FUZZ_THREAD_LOG to print the per-input and cumulative wall-clock
+ * speedup of the concurrent pass over the sequential one to stderr.  The
+ * concurrent pass includes each worker's own workbook open and parse, which
+ * the sequential pass does not pay, so the log also gives the slowest
+ * worker's open time and its sheet time, and the sheet-only speedup of the
+ * sequential pass over the latter.
+ */
+
+#ifndef XLS_SHEET_POOL_H
+#define XLS_SHEET_POOL_H
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "xls.h"
+
+#define XLS_SHEET_POOL_DEFAULT_THREADS 4
+#define XLS_SHEET_POOL_MAX_THREADS 64
+
+typedef struct xls_sheet_pool {
+    pthread_t threads[XLS_SHEET_POOL_MAX_THREADS];
+    int nthreads;                 // 0 until started, or when starting failed
+    bool started;
+    bool log;
+    bool shared;                  // XLS_FUZZ_SHARED_WORKBOOK: workers use the driver's workbook
+    pthread_mutex_t lock;
+    pthread_cond_t work;          // a new batch was posted, or stop was set
+    pthread_cond_t done;          // the last worker finished the batch
+    unsigned long generation;     // batch counter, workers wait for it to change
+    int busy;                     // workers still inside the batch
+    bool stop;
+    // Current batch
+    const uint8_t *data;
+    size_t size;
+    const char *charset;
+    xlsWorkBook *wb;              // only read in shared mode
+    int count;
+    atomic_int next;              // next sheet index to claim
+    uint64_t *hash;
+    // Slowest worker of the batch, timed only with the log on
+    uint64_t open_ns;             // xls_open_buffer + xls_parseWorkBook
+    uint64_t sheet_ns;            // its sheets
+    // Totals for the log
+    uint64_t seq_ns;
+    uint64_t par_ns;
+    uint64_t par_sheet_ns;
+} xls_sheet_pool;
+
+static inline uint64_t xls_sheet_pool_now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000 + (uint64_t)ts.tv_nsec;
+}
+
+static inline uint64_t xls_sheet_hash_bytes(uint64_t h, const void *p, size_t n) {
+    const uint8_t *b = (const uint8_t *)p;
+    for (size_t i = 0; i < n; i++) {
+        h = (h ^ b[i]) * 0x100000001b3ULL;
+    }
+    return h;
+}
+
+// Parses sheet num and returns an FNV-1a hash of the parse result and of
+// every row and cell, then closes the sheet.
+static inline uint64_t xls_sheet_parse_hash(xlsWorkBook *wb, int num) {
+    uint64_t h = 0xcbf29ce484222325ULL;
+    xlsWorkSheet *ws = xls_getWorkSheet(wb, num);
+    if (!ws) {
+        return h;
+    }
+    int32_t err = (int32_t)xls_parseWorkSheet(ws);
+    h = xls_sheet_hash_bytes(h, &err, sizeof(err));
+    if (err == LIBXLS_OK && ws->rows.row) {
+        h = xls_sheet_hash_bytes(h, &ws->rows.lastrow, sizeof(ws->rows.lastrow));
+        h = xls_sheet_hash_bytes(h, &ws->rows.lastcol, sizeof(ws->rows.lastcol));
+        for (int r = 0; r <= ws->rows.lastrow; r++) {
+            const struct st_row_data *row = &ws->rows.row[r];
+            WORD geom[4] = {row->index, row->height, row->xf, (WORD)row->cells.count};
+            h = xls_sheet_hash_bytes(h, geom, sizeof(geom));
+            for (DWORD c = 0; row->cells.cell && c < row->cells.count; c++) {
+                const struct st_cell_data *cell = &row->cells.cell[c];
+                WORD fields[7] = {cell->id, cell->row, cell->col, cell->xf,
+                                  cell->colspan, cell->rowspan, cell->isHidden};
+                h = xls_sheet_hash_bytes(h, fields, sizeof(fields));
+                h = xls_sheet_hash_bytes(h, &cell->d, sizeof(cell->d));
+                h = xls_sheet_hash_bytes(h, &cell->l, sizeof(cell->l));
+                if (cell->str) {
+                    h = xls_sheet_hash_bytes(h, cell->str, strlen(cell->str) + 1);
+                }
+            }
+        }
+    }
+    xls_close_WS(ws);
+    return h;
+}
+
+static inline void *xls_sheet_pool_worker(void *arg) {
+    xls_sheet_pool *pool = (xls_sheet_pool *)arg;
+    unsigned long seen = 0;
+    pthread_mutex_lock(&pool->lock);
+    for (;;) {
+        while (!pool->stop && pool->generation == seen) {
+            pthread_cond_wait(&pool->work, &pool->lock);
+        }
+        if (pool->stop) {
+            break;
+        }
+        seen = pool->generation;
+        const uint8_t *data = pool->data;
+        size_t size = pool->size;
+        const char *charset = pool->charset;
+        xlsWorkBook *shared = pool->shared ? pool->wb : NULL;
+        int count = pool->count;
+        uint64_t *hash = pool->hash;
+        bool timed = pool->log;
+        pthread_mutex_unlock(&pool->lock);
+
+        // The worker's own handle, opened once it has claimed a sheet.  If
+        // it cannot be opened or parsed, its sheets keep a zero hash and the
+        // check fails, since the driver's handle parsed from the same bytes.
+        xlsWorkBook *wb = shared;
+        bool opened = false;
+        uint64_t open_ns = 0;
+        uint64_t start = timed ? xls_sheet_pool_now_ns() : 0;
+        int i;
+        while ((i = atomic_fetch_add(&pool->next, 1)) < count) {
+            if (!wb && !opened) {
+                opened = true;
+                uint64_t t = timed ? xls_sheet_pool_now_ns() : 0;
+                xls_error_t error = LIBXLS_OK;
+                wb = xls_open_buffer(data, size, charset, &error);
+                if (wb && xls_parseWorkBook(wb) != LIBXLS_OK) {
+                    xls_close_WB(wb);
+                    wb = NULL;
+                }
+                open_ns = timed ? xls_sheet_pool_now_ns() - t : 0;
+            }
+            hash[i] = wb && i < (int)wb->sheets.count ? xls_sheet_parse_hash(wb, i) : 0;
+        }
+        if (wb && wb != shared) {
+            xls_close_WB(wb);
+        }
+        uint64_t sheet_ns = timed ? xls_sheet_pool_now_ns() - start - open_ns : 0;
+
+        pthread_mutex_lock(&pool->lock);
+        if (open_ns > pool->open_ns) {
+            pool->open_ns = open_ns;
+        }
+        if (sheet_ns > pool->sheet_ns) {
+            pool->sheet_ns = sheet_ns;
+        }
+        if (--pool->busy == 0) {
+            pthread_cond_signal(&pool->done);
+        }
+    }
+    pthread_mutex_unlock(&pool->lock);
+    return NULL;
+}
+
+// Starts the workers.  On failure the pool stays empty and only the
+// sequential pass runs.
+static inline void xls_sheet_pool_start(xls_sheet_pool *pool) {
+    pool->started = true;
+    pool->log = getenv("XLS_FUZZ_THREAD_LOG") != NULL;
+    const char *shared = getenv("XLS_FUZZ_SHARED_WORKBOOK");
+    pool->shared = shared && atoi(shared) != 0;
+    int n = XLS_SHEET_POOL_DEFAULT_THREADS;
+    const char *env = getenv("XLS_FUZZ_THREADS");
+    if (env) {
+        n = atoi(env);
+    }
+    if (n < 1) {
+        n = 1;
+    } else if (n > XLS_SHEET_POOL_MAX_THREADS) {
+        n = XLS_SHEET_POOL_MAX_THREADS;
+    }
+
+    pthread_mutex_init(&pool->lock, NULL);
+    pthread_cond_init(&pool->work, NULL);
+    pthread_cond_init(&pool->done, NULL);
+    for (pool->nthreads = 0; pool->nthreads < n; pool->nthreads++) {
+        if (pthread_create(&pool->threads[pool->nthreads], NULL, xls_sheet_pool_worker, pool) != 0) {
+            fprintf(stderr, "xls threads: only %d of %d workers started\n", pool->nthreads, n);
+            break;
+        }
+    }
+}
+
+// Stops and joins the workers.
+static inline void xls_sheet_pool_stop(xls_sheet_pool *pool) {
+    if (!pool->started) {
+        return;
+    }
+    pthread_mutex_lock(&pool->lock);
+    pool->stop = true;
+    pthread_cond_broadcast(&pool->work);
+    pthread_mutex_unlock(&pool->lock);
+    for (int i = 0; i < pool->nthreads; i++) {
+        pthread_join(pool->threads[i], NULL);
+    }
+    pthread_cond_destroy(&pool->done);
+    pthread_cond_destroy(&pool->work);
+    pthread_mutex_destroy(&pool->lock);
+    pool->started = false;
+    pool->nthreads = 0;
+    pool->stop = false;
+}
+
+// Runs one batch: every sheet of the input on the workers, hashes into
+// hash[].
+static inline void xls_sheet_pool_run(xls_sheet_pool *pool, const uint8_t *data, size_t size,
+                                      const char *charset, xlsWorkBook *wb, int count, uint64_t *hash) {
+    pthread_mutex_lock(&pool->lock);
+    pool->data = data;
+    pool->size = size;
+    pool->charset = charset;
+    pool->wb = wb;
+    pool->count = count;
+    pool->hash = hash;
+    atomic_store(&pool->next, 0);
+    pool->open_ns = 0;
+    pool->sheet_ns = 0;
+    pool->busy = pool->nthreads;
+    pool->generation++;
+    pthread_cond_broadcast(&pool->work);
+    while (pool->busy > 0) {
+        pthread_cond_wait(&pool->done, &pool->lock);
+    }
+    pthread_mutex_unlock(&pool->lock);
+}
+
+// Parses every sheet of wb concurrently and then sequentially, and aborts if
+// any sheet comes out differently.  wb must have been opened from data with
+// charset and parsed; the workers open their own handles on data, which has
+// to stay valid until the call returns.
+static inline void xls_sheet_pool_check(xls_sheet_pool *pool, const uint8_t *data, size_t size,
+                                        const char *charset, xlsWorkBook *wb) {
+    if (!pool->started) {
+        xls_sheet_pool_start(pool);
+    }
+    int count = (int)wb->sheets.count;
+    if (count <= 0) {
+        return;
+    }
+    uint64_t *par = (uint64_t *)calloc((size_t)count, sizeof(uint64_t));
+    uint64_t *seq = (uint64_t *)calloc((size_t)count, sizeof(uint64_t));
+    if (!par || !seq) {
+        free(par);
+        free(seq);
+        return;
+    }
+
+    uint64_t t0 = xls_sheet_pool_now_ns();
+    if (pool->nthreads > 0) {
+        xls_sheet_pool_run(pool, data, size, charset, wb, count, par);
+    }
+    uint64_t t1 = xls_sheet_pool_now_ns();
+    for (int i = 0; i < count; i++) {
+        seq[i] = xls_sheet_parse_hash(wb, i);
+    }
+    uint64_t t2 = xls_sheet_pool_now_ns();
+
+    if (pool->nthreads > 0) {
+        pool->par_ns += t1 - t0;
+        pool->seq_ns += t2 - t1;
+        pool->par_sheet_ns += pool->sheet_ns;
+        if (pool->log && t1 > t0) {
+            fprintf(stderr, "xls threads: %d sheets%s, 1 -> %llu us, %d -> %llu us (open %llu us, sheets %llu us), "
+                    "speedup %.2fx, sheets only %.2fx (total %.2fx, sheets only %.2fx)\n",
+                    count, pool->shared ? " (shared workbook)" : "", (unsigned long long)((t2 - t1) / 1000), pool->nthreads,
+                    (unsigned long long)((t1 - t0) / 1000), (unsigned long long)(pool->open_ns / 1000),
+                    (unsigned long long)(pool->sheet_ns / 1000), (double)(t2 - t1) / (double)(t1 - t0),
+                    (double)(t2 - t1) / (double)(pool->sheet_ns ? pool->sheet_ns : 1),
+                    (double)pool->seq_ns / (double)(pool->par_ns ? pool->par_ns : 1),
+                    (double)pool->seq_ns / (double)(pool->par_sheet_ns ? pool->par_sheet_ns : 1));
+        }
+        for (int i = 0; i < count; i++) {
+            if (par[i] != seq[i]) {
+                fprintf(stderr, "xls threads: sheet %d of %d differs between 1 and %d threads "
+                        "(hash %016llx/%016llx)\n",
+                        i, count, pool->nthreads, (unsigned long long)seq[i], (unsigned long long)par[i]);
+                abort();
+            }
+        }
+    }
+    free(par);
+    free(seq);
+}
+
+#endif // XLS_SHEET_POOL_H
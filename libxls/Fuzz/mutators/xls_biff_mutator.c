@@ -0,0 +1,825 @@
+/*
+ * AFL++ custom mutator for the libxls drivers.
+ *
+ * Reads the input as an OLE2 compound file (common/xls_cfb.h) and splits the
+ * Workbook stream into BIFF records (common/xls_biff.h).  It applies one to
+ * three record-level mutations and writes a fresh, consistent container, so
+ * the output gets past xls_open_buffer() and into the record parsers.  The
+ * mutations are:
+ *
+ *  - generic: body field edits, resizes, duplicates, deletes, swaps, records
+ *    spliced from another corpus entry, and whole sheet substreams (BOF ..
+ *    EOF plus a BOUNDSHEET) spliced in;
+ *  - typed: BOF version and substream type; BOUNDSHEET sheet offset, type
+ *    and name header; SST counts, string headers and CONTINUE layout;
+ *    LABELSST string index; FORMULA cce, tokens and cached result with its
+ *    STRING record; MULRK/MULBLANK column ranges; DIMENSIONS and ROW
+ *    bounds; LABEL/FORMAT/STRING character counts and flags; splitting a
+ *    record into CONTINUE records and merging them back.
+ *
+ * BOUNDSHEET offsets follow their BOF records through every mutation unless
+ * a mutation aims them elsewhere on purpose.  One output in sixteen also
+ * gets a header, directory or FAT field of the container changed, which
+ * keeps the OLE2 reader itself covered.  A container without a Workbook
+ * stream, such as the encrypted .xlsx seeds, gets one of its streams mutated
+ * bytewise, or renamed to Workbook.  Input that is not a compound file is
+ * wrapped in a new one as its Workbook stream.
+ *
+ * Inputs of the xls_open_buffer driver start with an option header
+ * (common/xls_fuzz_options.h).  The header is kept as is and only the file
+ * after it is mutated.  With OPTSTATS_FILE set (the same table the driver
+ * publishes to, optstats/optstats.h), one call in eight replaces the header's
+ * option tuple with one picked by the optstats scheduler.
+ *
+ * Build:
+ *   gcc -O2 -shared -fPIC -o xls_biff_mutator.so xls_biff_mutator.c -lm
+ * Use:
+ *   AFL_CUSTOM_MUTATOR_LIBRARY=./xls_biff_mutator.so afl-fuzz ...
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../common/xls_cfb.h"
+#include "../common/xls_biff.h"
+#include "../common/xls_fuzz_options.h"
+#include "../../../optstats/optstats.h"
+
+typedef struct {
+    uint64_t rng;
+    xls_fuzz_buf out;
+    xls_fuzz_buf stream;
+    xls_fuzz_buf framed;        // option header + out
+    optstats_sched sched;
+} xls_biff_mutator;
+
+static const uint16_t interesting16[] = {0, 1, 2, 0x7F, 0x80, 0xFF, 0x100, 0x3FFF, 0x4000, 0x7FFF, 0x8000, 0xFFFE, 0xFFFF};
+static const uint32_t interesting32[] = {0, 1, 0xFF, 0xFFFF, 0x10000, 0x7FFFFFFF, 0x80000000u, 0xFFFFFFFEu, 0xFFFFFFFFu};
+
+// Formula tokens (ptg) including the ones with trailing operands
+static const uint8_t formula_ptgs[] = {0x01, 0x02, 0x03, 0x08, 0x0F, 0x10, 0x11, 0x12, 0x15, 0x16, 0x17, 0x18,
+                                       0x19, 0x1C, 0x1D, 0x1E, 0x1F, 0x20, 0x21, 0x22, 0x23, 0x24, 0x25, 0x26,
+                                       0x27, 0x28, 0x29, 0x2A, 0x2B, 0x2C, 0x2D, 0x39, 0x3A, 0x3B, 0x3C, 0x3D,
+                                       0x41, 0x42, 0x44, 0x5A, 0x7F, 0xFF};
+
+static uint32_t xls_rand(xls_biff_mutator *m) {
+    m->rng ^= m->rng << 13;
+    m->rng ^= m->rng >> 7;
+    m->rng ^= m->rng << 17;
+    return (uint32_t)(m->rng >> 32);
+}
+
+static uint32_t xls_below(xls_biff_mutator *m, uint64_t n) {
+    return n ? (uint32_t)(xls_rand(m) % n) : 0;
+}
+
+static uint16_t pick16(xls_biff_mutator *m) {
+    return interesting16[xls_below(m, sizeof(interesting16) / sizeof(interesting16[0]))];
+}
+
+static uint32_t pick32(xls_biff_mutator *m) {
+    return interesting32[xls_below(m, sizeof(interesting32) / sizeof(interesting32[0]))];
+}
+
+// A count near the real one n: off by one, doubled, zero or extreme.
+static uint32_t near_count(xls_biff_mutator *m, uint32_t n) {
+    switch (xls_below(m, 5)) {
+    case 0: return n + 1;
+    case 1: return n - 1;
+    case 2: return n * 2;
+    case 3: return xls_below(m, n + 2);
+    default: return pick32(m);
+    }
+}
+
+// Bit flips, interesting values and small arithmetic anywhere in the body.
+static void mutate_body(xls_biff_mutator *m, xls_biff_record *r) {
+    if (r->len == 0) {
+        if (xls_biff_resize(r, 1 + xls_below(m, 16))) {
+            r->data[0] = (uint8_t)xls_rand(m);
+        }
+        return;
+    }
+    size_t pos = xls_below(m, r->len);
+    switch (xls_below(m, 4)) {
+    case 0:
+        r->data[pos] ^= (uint8_t)(1u << xls_below(m, 8));
+        break;
+    case 1:
+        if (pos + 2 <= r->len) {
+            xls_fuzz_put16(r->data + pos, pick16(m));
+            break;
+        }
+        // fall through
+    case 2:
+        if (pos + 4 <= r->len) {
+            xls_fuzz_put32(r->data + pos, pick32(m));
+            break;
+        }
+        // fall through
+    default:
+        if (pos + 2 <= r->len) {
+            int delta = 1 + (int)xls_below(m, 16);
+            uint16_t v = xls_fuzz_get16(r->data + pos);
+            xls_fuzz_put16(r->data + pos, (uint16_t)(xls_below(m, 2) ? v + delta : v - delta));
+        } else {
+            r->data[pos] = (uint8_t)pick16(m);
+        }
+        break;
+    }
+}
+
+// Truncates the body, or grows it with zeros or a copy of its own bytes.
+static void mutate_resize(xls_biff_mutator *m, xls_biff_record *r) {
+    size_t len = r->len;
+    if (len && xls_below(m, 2)) {
+        xls_biff_resize(r, xls_below(m, len));
+        return;
+    }
+    size_t grow = 1 + xls_below(m, xls_below(m, 4) ? 64 : XLS_BIFF_MAX_DATA);
+    if (!xls_biff_resize(r, len + grow)) {
+        return;
+    }
+    if (len && xls_below(m, 2)) {
+        for (size_t i = 0; i < grow; i++) {
+            r->data[len + i] = r->data[i % len];
+        }
+    }
+}
+
+// Splits a record into the record and a CONTINUE record, or merges a CONTINUE
+// record into the record before it.
+static void mutate_continue(xls_biff_mutator *m, xls_biff_stream *s, int idx) {
+    xls_biff_record *r = &s->rec[idx];
+    if (r->type == XLS_BIFF_CONTINUE && idx > 0) {
+        xls_biff_record *prev = &s->rec[idx - 1];
+        size_t len = prev->len;
+        if (xls_biff_resize(prev, len + r->len)) {
+            memcpy(prev->data + len, r->data, r->len);
+            xls_biff_remove(s, idx);
+        }
+        return;
+    }
+    if (r->len < 2) {
+        return;
+    }
+    size_t cut = 1 + xls_below(m, r->len - 1);
+    if (xls_biff_insert(s, idx + 1, XLS_BIFF_CONTINUE, s->rec[idx].data + cut, s->rec[idx].len - cut)) {
+        s->rec[idx].len = cut;
+    }
+}
+
+static void mutate_bof(xls_biff_mutator *m, xls_biff_record *r) {
+    static const uint16_t versions[] = {0x0600, 0x0500, 0x0400, 0x0300, 0x0200, 0x0000, 0xFFFF};
+    static const uint16_t types[] = {0x0005, 0x0006, 0x0010, 0x0020, 0x0040, 0x0100, 0x0000, 0xFFFF};
+    if (r->len < 4 && !xls_biff_resize(r, 16)) {
+        return;
+    }
+    switch (xls_below(m, 3)) {
+    case 0:
+        xls_fuzz_put16(r->data, versions[xls_below(m, sizeof(versions) / sizeof(versions[0]))]);
+        break;
+    case 1:
+        xls_fuzz_put16(r->data + 2, types[xls_below(m, sizeof(types) / sizeof(types[0]))]);
+        break;
+    default: {
+        // BOF records of older BIFF versions
+        static const uint16_t bof_types[] = {0x0009, 0x0209, 0x0409, 0x0809};
+        r->type = bof_types[xls_below(m, 4)];
+        break;
+    }
+    }
+}
+
+static void mutate_boundsheet(xls_biff_mutator *m, xls_biff_stream *s, xls_biff_record *r, size_t stream_len) {
+    if (r->len < 8 && !xls_biff_resize(r, 8)) {
+        return;
+    }
+    switch (xls_below(m, 5)) {
+    case 0: {
+        // Point at another BOF record, or at any record.
+        int bofs[64], n = 0;
+        for (int i = 0; i < s->count && n < 64; i++) {
+            if (s->rec[i].type == XLS_BIFF_BOF) {
+                bofs[n++] = i;
+            }
+        }
+        r->target = n && xls_below(m, 2) ? bofs[xls_below(m, n)] : (int)xls_below(m, s->count);
+        break;
+    }
+    case 1: {
+        // Raw offset: inside a record, past the end or extreme.
+        uint32_t off;
+        switch (xls_below(m, 3)) {
+        case 0: off = (uint32_t)stream_len + xls_below(m, 4); break;
+        case 1: off = xls_below(m, stream_len + 1); break;
+        default: off = pick32(m); break;
+        }
+        r->target = -1;
+        xls_fuzz_put32(r->data, off);
+        break;
+    }
+    case 2:
+        // Visibility and sheet type (worksheet, macro, chart, VBA module)
+        r->data[4 + xls_below(m, 2)] = (uint8_t)(xls_below(m, 2) ? xls_below(m, 4) : pick16(m));
+        break;
+    case 3:
+        // Name length in characters
+        r->data[6] = (uint8_t)(xls_below(m, 2) ? near_count(m, r->data[6]) : r->len - 8 + xls_below(m, 3));
+        break;
+    default:
+        r->data[7] ^= 0x01;     // fHighByte
+        break;
+    }
+}
+
+// Offsets of the strings that start in an SST body, up to max.
+static int sst_strings(const uint8_t *p, size_t len, size_t *off, int max) {
+    int n = 0;
+    size_t pos = 8;
+    while (pos + 3 <= len && n < max) {
+        off[n++] = pos;
+        uint16_t cch = xls_fuzz_get16(p + pos);
+        uint8_t flags = p[pos + 2];
+        size_t next = pos + 3;
+        uint16_t runs = 0;
+        uint32_t ext = 0;
+        if (flags & 0x08) {
+            if (next + 2 > len) break;
+            runs = xls_fuzz_get16(p + next);
+            next += 2;
+        }
+        if (flags & 0x04) {
+            if (next + 4 > len) break;
+            ext = xls_fuzz_get32(p + next);
+            next += 4;
+        }
+        next += (size_t)cch * (flags & 0x01 ? 2 : 1) + 4 * (size_t)runs + ext;
+        if (next <= pos) break;
+        pos = next;
+    }
+    return n;
+}
+
+// Joins the SST record and its CONTINUE records, then cuts the body again at
+// string starts or at random points.  A random cut may add the option-flags
+// byte that starts a CONTINUE record which continues a string.
+static void resplit_sst(xls_biff_mutator *m, xls_biff_stream *s, int idx) {
+    xls_biff_record *r = &s->rec[idx];
+    while (idx + 1 < s->count && s->rec[idx + 1].type == XLS_BIFF_CONTINUE) {
+        xls_biff_record *c = &s->rec[idx + 1];
+        size_t len = r->len;
+        if (!xls_biff_resize(r, len + c->len)) {
+            return;
+        }
+        memcpy(r->data + len, c->data, c->len);
+        xls_biff_remove(s, idx + 1);
+        r = &s->rec[idx];
+    }
+    if (r->len <= 8) {
+        return;
+    }
+    size_t starts[256];
+    int nstarts = sst_strings(r->data, r->len, starts, 256);
+    bool at_strings = nstarts > 1 && xls_below(m, 2);
+    size_t max_piece = xls_below(m, 2) ? XLS_BIFF_MAX_DATA : 16 + xls_below(m, 512);
+
+    // Cut from the end so earlier offsets stay valid.
+    size_t end = r->len;
+    int pieces = 0;
+    while (pieces < 64 && end > max_piece) {
+        size_t cut;
+        if (at_strings) {
+            // Widest run of whole strings that fits, or one string if none does.
+            int k = nstarts - 1;
+            while (k >= 0 && starts[k] >= end) {
+                k--;
+            }
+            if (k < 0) break;
+            while (k > 0 && end - starts[k - 1] <= max_piece) {
+                k--;
+            }
+            cut = starts[k];
+            nstarts = k;
+        } else {
+            cut = end - 1 - xls_below(m, max_piece);
+            if (cut < 8) break;
+        }
+        uint8_t grbit = (uint8_t)xls_below(m, 2);
+        bool add_grbit = !at_strings && xls_below(m, 2);
+        if (!xls_biff_insert(s, idx + 1, XLS_BIFF_CONTINUE, r->data + cut, end - cut)) {
+            break;
+        }
+        r = &s->rec[idx];
+        if (add_grbit) {
+            xls_biff_record *c = &s->rec[idx + 1];
+            if (xls_biff_resize(c, c->len + 1)) {
+                memmove(c->data + 1, c->data, c->len - 1);
+                c->data[0] = grbit;
+            }
+        }
+        r->len = cut;
+        end = cut;
+        pieces++;
+    }
+}
+
+static void mutate_sst(xls_biff_mutator *m, xls_biff_stream *s, int idx) {
+    xls_biff_record *r = &s->rec[idx];
+    if (r->len < 8 && !xls_biff_resize(r, 8)) {
+        return;
+    }
+    switch (xls_below(m, 4)) {
+    case 0: {
+        // cstTotal or cstUnique
+        size_t at = 4 * xls_below(m, 2);
+        xls_fuzz_put32(r->data + at, near_count(m, xls_fuzz_get32(r->data + 4)));
+        break;
+    }
+    case 1:
+    case 2: {
+        size_t starts[256];
+        int n = sst_strings(r->data, r->len, starts, 256);
+        if (n == 0) {
+            break;
+        }
+        size_t at = starts[xls_below(m, n)];
+        if (xls_below(m, 2)) {
+            xls_fuzz_put16(r->data + at, (uint16_t)near_count(m, xls_fuzz_get16(r->data + at)));
+        } else {
+            // fHighByte, fExtSt, fRichSt
+            static const uint8_t bits[] = {0x01, 0x04, 0x08};
+            r->data[at + 2] ^= bits[xls_below(m, 3)];
+        }
+        break;
+    }
+    default:
+        resplit_sst(m, s, idx);
+        break;
+    }
+}
+
+static void mutate_labelsst(xls_biff_mutator *m, const xls_biff_stream *s, xls_biff_record *r) {
+    if (r->len < 10 && !xls_biff_resize(r, 10)) {
+        return;
+    }
+    if (xls_below(m, 4) == 0) {
+        // Row or column at the sheet limits
+        static const uint16_t limits[] = {0, 255, 256, 16383, 16384, 65535};
+        xls_fuzz_put16(r->data + 2 * xls_below(m, 2), limits[xls_below(m, 6)]);
+        return;
+    }
+    int sst = xls_biff_find(s, XLS_BIFF_SST, 0);
+    uint32_t unique = sst >= 0 && s->rec[sst].len >= 8 ? xls_fuzz_get32(s->rec[sst].data + 4) : 0;
+    xls_fuzz_put32(r->data + 6, xls_below(m, 3) ? unique - 1 + xls_below(m, 3) : near_count(m, unique));
+}
+
+// FORMULA: rw, col, ixfe, 8-byte cached value, grbit, chn, cce, rgce.
+static void mutate_formula(xls_biff_mutator *m, xls_biff_stream *s, int idx) {
+    xls_biff_record *r = &s->rec[idx];
+    if (r->len < 22 && !xls_biff_resize(r, 22)) {
+        return;
+    }
+    uint16_t cce = xls_fuzz_get16(r->data + 20);
+    switch (xls_below(m, 5)) {
+    case 0:
+        xls_fuzz_put16(r->data + 20, (uint16_t)near_count(m, (uint32_t)(r->len - 22)));
+        break;
+    case 1:
+    case 2: {
+        size_t n = r->len - 22;
+        if (cce < n) {
+            n = cce;
+        }
+        if (n == 0 || xls_below(m, 4) == 0) {
+            // Append one token with room for its operands.
+            if (xls_biff_resize(r, r->len + 1 + xls_below(m, 8))) {
+                r->data[22 + n] = formula_ptgs[xls_below(m, sizeof(formula_ptgs))];
+                xls_fuzz_put16(r->data + 20, (uint16_t)(r->len - 22));
+            }
+        } else {
+            r->data[22 + xls_below(m, n)] = formula_ptgs[xls_below(m, sizeof(formula_ptgs))];
+        }
+        break;
+    }
+    case 3: {
+        // Cached result: string, boolean, error or empty.  A string result
+        // is followed by a STRING record.
+        uint8_t kind = (uint8_t)xls_below(m, 5);
+        memset(r->data + 6, 0, 8);
+        r->data[6] = kind;
+        r->data[8] = (uint8_t)xls_rand(m);
+        r->data[12] = r->data[13] = 0xFF;
+        bool has_string = idx + 1 < s->count && s->rec[idx + 1].type == XLS_BIFF_STRING;
+        if (kind == 0 && !has_string) {
+            uint8_t str[3 + 16];
+            uint16_t cch = (uint16_t)xls_below(m, 17);
+            xls_fuzz_put16(str, xls_below(m, 4) ? cch : pick16(m));
+            str[2] = 0;
+            memset(str + 3, 'a' + (int)xls_below(m, 26), cch);
+            xls_biff_insert(s, idx + 1, XLS_BIFF_STRING, str, 3 + (size_t)cch);
+        } else if (has_string && xls_below(m, 2)) {
+            xls_biff_remove(s, idx + 1);
+        }
+        break;
+    }
+    default:
+        // fAlwaysCalc, fFill, fShrFmla, fClearErrors
+        r->data[14] ^= (uint8_t)(1u << xls_below(m, 4));
+        break;
+    }
+}
+
+// MULRK (6-byte cells) and MULBLANK (2-byte cells): colLast against the
+// number of cells actually present.
+static void mutate_mulcells(xls_biff_mutator *m, xls_biff_record *r) {
+    if (r->len < 6 && !xls_biff_resize(r, 6)) {
+        return;
+    }
+    size_t cell = r->type == XLS_BIFF_MULRK ? 6 : 2;
+    uint16_t first = xls_fuzz_get16(r->data + 2);
+    uint32_t cells = (uint32_t)((r->len - 6) / cell);
+    switch (xls_below(m, 3)) {
+    case 0:
+        xls_fuzz_put16(r->data + r->len - 2, (uint16_t)(first + near_count(m, cells) - 1));
+        break;
+    case 1:
+        xls_fuzz_put16(r->data + 2, pick16(m));
+        break;
+    default:
+        xls_biff_resize(r, r->len + 1 + xls_below(m, cell));
+        break;
+    }
+}
+
+// DIMENSIONS (rwMic, rwMac as 32-bit, colMic, colMac) and ROW (rw, colMic,
+// colMac): bounds that disagree with the cells.
+static void mutate_bounds(xls_biff_mutator *m, xls_biff_record *r) {
+    size_t need = r->type == XLS_BIFF_DIMENSIONS ? 14 : 16;
+    if (r->len < need && !xls_biff_resize(r, need)) {
+        return;
+    }
+    if (r->type == XLS_BIFF_DIMENSIONS && xls_below(m, 2)) {
+        size_t at = 4 * xls_below(m, 2);
+        xls_fuzz_put32(r->data + at, xls_below(m, 2) ? near_count(m, xls_fuzz_get32(r->data + at)) : pick32(m));
+    } else {
+        size_t at = r->type == XLS_BIFF_DIMENSIONS ? 8 + 2 * xls_below(m, 2) : 2 * xls_below(m, 3);
+        xls_fuzz_put16(r->data + at, xls_below(m, 2) ? (uint16_t)near_count(m, xls_fuzz_get16(r->data + at)) : pick16(m));
+    }
+}
+
+// Records with a 16-bit character count followed by an option-flags byte.
+static void mutate_string_record(xls_biff_mutator *m, xls_biff_record *r, size_t at) {
+    if (r->len < at + 3 && !xls_biff_resize(r, at + 3)) {
+        return;
+    }
+    if (xls_below(m, 2)) {
+        xls_fuzz_put16(r->data + at, (uint16_t)near_count(m, (uint32_t)(r->len - at - 3)));
+    } else {
+        r->data[at + 2] ^= xls_below(m, 2) ? 0x01 : 0x08;
+    }
+}
+
+// Inserts one sheet substream (BOF .. EOF) of the other stream at the end of
+// this one, with a BOUNDSHEET record for it after the existing ones.
+static void splice_sheet(xls_biff_mutator *m, xls_biff_stream *s, const xls_biff_stream *other) {
+    int bofs[64], n = 0;
+    for (int i = 1; i < other->count && n < 64; i++) {
+        if (other->rec[i].type == XLS_BIFF_BOF) {
+            bofs[n++] = i;
+        }
+    }
+    if (n == 0) {
+        return;
+    }
+    int from = bofs[xls_below(m, n)];
+    int bof = s->count;
+    // other may be s itself, which grows (and moves) while we append.
+    int end = other->count;
+    for (int i = from; i < end && i - from < 4096; i++) {
+        uint16_t type = other->rec[i].type;
+        if (!xls_biff_append(s, type, other->rec[i].data, other->rec[i].len) || type == XLS_BIFF_EOF) {
+            break;
+        }
+    }
+    if (s->count == bof) {
+        return;
+    }
+    int last = -1;
+    for (int i = 0; i < bof; i++) {
+        if (s->rec[i].type == XLS_BIFF_BOUNDSHEET) {
+            last = i;
+        }
+    }
+    int at = last >= 0 ? last + 1 : bof > 0 ? 1 : 0;
+    if (last >= 0) {
+        // Duplicate the last BOUNDSHEET; its name is as good as any.
+        xls_biff_record copy = s->rec[last];
+        if (!xls_biff_insert(s, at, XLS_BIFF_BOUNDSHEET, copy.data, copy.len)) {
+            return;
+        }
+    } else {
+        static const uint8_t sheet[] = {0, 0, 0, 0, 0, 0, 1, 0, 'S'};
+        if (!xls_biff_insert(s, at, XLS_BIFF_BOUNDSHEET, sheet, sizeof(sheet))) {
+            return;
+        }
+    }
+    s->rec[at].target = bof + 1;
+}
+
+// A random record of a type the typed mutations handle, or -1.
+static int pick_typed(xls_biff_mutator *m, const xls_biff_stream *s) {
+    int found = -1, seen = 0;
+    for (int i = 0; i < s->count; i++) {
+        switch (s->rec[i].type) {
+        case XLS_BIFF_BOF:
+        case XLS_BIFF_BOUNDSHEET:
+        case XLS_BIFF_SST:
+        case XLS_BIFF_LABELSST:
+        case XLS_BIFF_FORMULA:
+        case XLS_BIFF_MULRK:
+        case XLS_BIFF_MULBLANK:
+        case XLS_BIFF_DIMENSIONS:
+        case XLS_BIFF_ROW:
+        case XLS_BIFF_LABEL:
+        case XLS_BIFF_FORMAT:
+        case XLS_BIFF_STRING:
+        case XLS_BIFF_CONTINUE:
+            // Reservoir sampling keeps one uniform pick in a single pass.
+            if (xls_below(m, ++seen) == 0) {
+                found = i;
+            }
+            break;
+        default:
+            break;
+        }
+    }
+    return found;
+}
+
+static void mutate_typed(xls_biff_mutator *m, xls_biff_stream *s, int idx, size_t stream_len) {
+    xls_biff_record *r = &s->rec[idx];
+    switch (r->type) {
+    case XLS_BIFF_BOF: mutate_bof(m, r); break;
+    case XLS_BIFF_BOUNDSHEET: mutate_boundsheet(m, s, r, stream_len); break;
+    case XLS_BIFF_SST: mutate_sst(m, s, idx); break;
+    case XLS_BIFF_LABELSST: mutate_labelsst(m, s, r); break;
+    case XLS_BIFF_FORMULA: mutate_formula(m, s, idx); break;
+    case XLS_BIFF_MULRK:
+    case XLS_BIFF_MULBLANK: mutate_mulcells(m, r); break;
+    case XLS_BIFF_DIMENSIONS:
+    case XLS_BIFF_ROW: mutate_bounds(m, r); break;
+    case XLS_BIFF_LABEL: mutate_string_record(m, r, 6); break;
+    case XLS_BIFF_FORMAT: mutate_string_record(m, r, 2); break;
+    case XLS_BIFF_STRING: mutate_string_record(m, r, 0); break;
+    default: mutate_continue(m, s, idx); break;
+    }
+}
+
+static void mutate_records(xls_biff_mutator *m, xls_biff_stream *s, const xls_biff_stream *other, size_t stream_len) {
+    if (s->count == 0) {
+        // Nothing parsed: start from a globals BOF and EOF.
+        static const uint8_t bof[16] = {0x00, 0x06, 0x05, 0x00};
+        xls_biff_append(s, XLS_BIFF_BOF, bof, sizeof(bof));
+        xls_biff_append(s, XLS_BIFF_EOF, NULL, 0);
+        return;
+    }
+    int idx = (int)xls_below(m, s->count);
+    switch (xls_below(m, 10)) {
+    case 0:
+        mutate_body(m, &s->rec[idx]);
+        break;
+    case 1:
+        mutate_resize(m, &s->rec[idx]);
+        break;
+    case 2: {
+        int target = s->rec[idx].target;
+        xls_biff_record copy = s->rec[idx];
+        if (xls_biff_insert(s, idx + 1, copy.type, copy.data, copy.len)) {
+            s->rec[idx + 1].target = target >= idx + 1 ? target + 1 : target;
+        }
+        break;
+    }
+    case 3:
+        xls_biff_remove(s, idx);
+        break;
+    case 4:
+        xls_biff_swap(s, idx, xls_below(m, 2) && idx + 1 < s->count ? idx + 1 : (int)xls_below(m, s->count));
+        break;
+    case 5:
+        if (other->count) {
+            const xls_biff_record *r = &other->rec[xls_below(m, other->count)];
+            xls_biff_insert(s, idx, r->type, r->data, r->len);
+        } else {
+            mutate_body(m, &s->rec[idx]);
+        }
+        break;
+    case 6:
+        splice_sheet(m, s, other->count ? other : s);
+        break;
+    case 7:
+        mutate_continue(m, s, idx);
+        break;
+    default: {
+        int typed = pick_typed(m, s);
+        if (typed >= 0) {
+            mutate_typed(m, s, typed, stream_len);
+        } else {
+            mutate_body(m, &s->rec[idx]);
+        }
+        break;
+    }
+    }
+}
+
+// Stream without BIFF records: bytewise edits, or renaming it to Workbook
+// so that libxls reads it as one.
+static void mutate_stream(xls_biff_mutator *m, xls_cfb *cfb) {
+    int streams[64], n = 0;
+    for (int i = 1; i < cfb->count && n < 64; i++) {
+        if (cfb->entry[i].type == XLS_CFB_STREAM) {
+            streams[n++] = i;
+        }
+    }
+    if (n == 0) {
+        xls_cfb_add_stream(cfb, "Workbook", NULL, 0);
+        return;
+    }
+    xls_cfb_entry *e = &cfb->entry[streams[xls_below(m, n)]];
+    if (xls_below(m, 4) == 0) {
+        xls_cfb_set_name(e, "Workbook");
+        return;
+    }
+    xls_biff_record r = {0, e->data, e->size, -1};
+    if (xls_below(m, 4)) {
+        mutate_body(m, &r);
+    } else {
+        mutate_resize(m, &r);
+    }
+    e->data = r.data;
+    e->size = r.len;
+}
+
+// Changes one field of a written container: a header field, a directory
+// entry field or a FAT entry.
+static void mutate_container(xls_biff_mutator *m, uint8_t *p, size_t len, int entries) {
+    static const size_t header_fields[] = {0x1A, 0x1E, 0x20, 0x2C, 0x30, 0x38, 0x3C, 0x40, 0x44, 0x48, 0x4C};
+    static const size_t entry_fields[] = {0x40, 0x42, 0x44, 0x48, 0x4C, 0x74, 0x78};
+    size_t at, width = 4;
+    switch (xls_below(m, 3)) {
+    case 0:
+        at = header_fields[xls_below(m, sizeof(header_fields) / sizeof(header_fields[0]))];
+        if (at < 0x2C) {
+            width = 2;      // version, sector shift, mini sector shift
+        }
+        break;
+    case 1: {
+        size_t field = entry_fields[xls_below(m, sizeof(entry_fields) / sizeof(entry_fields[0]))];
+        at = XLS_CFB_HEADER_SIZE * (1 + (size_t)xls_fuzz_get32(p + 0x30)) +
+             XLS_CFB_ENTRY_SIZE * xls_below(m, entries) + field;
+        width = field == 0x42 ? 1 : field == 0x40 ? 2 : 4;   // type, name length
+        break;
+    }
+    default:
+        // An entry of the first FAT sector
+        at = XLS_CFB_HEADER_SIZE * (1 + (size_t)xls_fuzz_get32(p + 0x4C)) + 4 * xls_below(m, XLS_CFB_HEADER_SIZE / 4);
+        break;
+    }
+    if (at >= len || len - at < width) {
+        return;
+    }
+    uint32_t v = width == 4 ? xls_fuzz_get32(p + at) : width == 2 ? xls_fuzz_get16(p + at) : p[at];
+    switch (xls_below(m, 3)) {
+    case 0: v = width == 1 ? xls_below(m, 6) : pick32(m); break;
+    case 1: v += xls_below(m, 2) ? 1 : -1; break;
+    default: v = xls_below(m, len / XLS_CFB_HEADER_SIZE + 1); break;
+    }
+    if (width == 4) {
+        xls_fuzz_put32(p + at, v);
+    } else if (width == 2) {
+        xls_fuzz_put16(p + at, (uint16_t)v);
+    } else {
+        p[at] = (uint8_t)v;
+    }
+}
+
+// Workbook stream records of a corpus entry, for splicing.
+static void read_other(const uint8_t *buf, size_t size, xls_biff_stream *other) {
+    memset(other, 0, sizeof(*other));
+    xls_cfb cfb;
+    if (buf && xls_fuzz_has_options(buf, size)) {
+        buf += XLS_FUZZ_OPTIONS_SIZE;
+        size -= XLS_FUZZ_OPTIONS_SIZE;
+    }
+    if (!buf || !xls_cfb_read(buf, size, &cfb)) {
+        return;
+    }
+    int wb = xls_cfb_workbook(&cfb);
+    if (wb >= 0) {
+        xls_biff_parse(cfb.entry[wb].data, cfb.entry[wb].size, other);
+    }
+    xls_cfb_free(&cfb);
+}
+
+void *afl_custom_init(void *afl, unsigned int seed) {
+    (void)afl;
+    xls_biff_mutator *m = (xls_biff_mutator *)calloc(1, sizeof(xls_biff_mutator));
+    if (!m) {
+        return NULL;
+    }
+    m->rng = ((uint64_t)seed << 1) | 1;
+    optstats_sched_init(&m->sched, XLS_FUZZ_OPTIONS_MAGIC, 4);
+    return m;
+}
+
+size_t afl_custom_fuzz(void *data, uint8_t *buf, size_t buf_size, uint8_t **out_buf,
+                       uint8_t *add_buf, size_t add_buf_size, size_t max_size) {
+    xls_biff_mutator *m = (xls_biff_mutator *)data;
+    *out_buf = buf;
+
+    // The option header is carried over; only the file after it is mutated.
+    uint8_t header[XLS_FUZZ_OPTIONS_SIZE];
+    size_t header_len = xls_fuzz_has_options(buf, buf_size) ? XLS_FUZZ_OPTIONS_SIZE : 0;
+    if (header_len) {
+        memcpy(header, buf, header_len);
+        uint8_t key[OPTSTATS_KEY_MAX];
+        if (xls_below(m, 8) == 0 &&
+            optstats_sched_pick(&m->sched, ((uint64_t)xls_rand(m) << 32) | xls_rand(m), key) == XLS_FUZZ_OPTIONS_SIZE) {
+            // The sheet argument is not part of the tuple and stays.
+            memcpy(header, key, XLS_FUZZ_OPTIONS_SIZE - 1);
+        }
+    }
+    const uint8_t *file = buf + header_len;
+    size_t file_size = buf_size - header_len;
+
+    xls_cfb cfb;
+    int wb;
+    if (xls_cfb_read(file, file_size, &cfb)) {
+        wb = xls_cfb_workbook(&cfb);
+    } else if (xls_cfb_init(&cfb)) {
+        wb = xls_cfb_add_stream(&cfb, "Workbook", file, file_size);
+        if (wb < 0) {
+            xls_cfb_free(&cfb);
+            return buf_size;
+        }
+    } else {
+        return buf_size;
+    }
+
+    bool ok = true;
+    if (wb < 0) {
+        mutate_stream(m, &cfb);
+    } else {
+        xls_cfb_entry *e = &cfb.entry[wb];
+        xls_biff_stream s, other;
+        ok = xls_biff_parse(e->data, e->size, &s);
+        if (ok) {
+            read_other(add_buf, add_buf_size, &other);
+            for (int rounds = 1 + (int)xls_below(m, 3); rounds > 0; rounds--) {
+                mutate_records(m, &s, &other, e->size);
+            }
+            ok = xls_biff_serialize(&s, &m->stream) && xls_cfb_set_data(e, m->stream.data, m->stream.len);
+            xls_biff_free(&other);
+            xls_biff_free(&s);
+        }
+    }
+
+    ok = ok && xls_cfb_write(&cfb, &m->out) && header_len + m->out.len <= max_size;
+    if (ok && xls_below(m, 16) == 0) {
+        mutate_container(m, m->out.data, m->out.len, cfb.count);
+    }
+    xls_cfb_free(&cfb);
+    if (!ok) {
+        return buf_size;
+    }
+    if (!header_len) {
+        *out_buf = m->out.data;
+        return m->out.len;
+    }
+    m->framed.len = 0;
+    if (!xls_fuzz_buf_append(&m->framed, header, header_len) ||
+        !xls_fuzz_buf_append(&m->framed, m->out.data, m->out.len)) {
+        return buf_size;
+    }
+    *out_buf = m->framed.data;
+    return m->framed.len;
+}
+
+const char *afl_custom_describe(void *data, size_t max_description_len) {
+    (void)data;
+    (void)max_description_len;
+    return "xls_biff";
+}
+
+void afl_custom_deinit(void *data) {
+    xls_biff_mutator *m = (xls_biff_mutator *)data;
+    if (m) {
+        optstats_sched_fini(&m->sched);
+        xls_fuzz_buf_free(&m->out);
+        xls_fuzz_buf_free(&m->stream);
+        xls_fuzz_buf_free(&m->framed);
+        free(m);
+    }
+}
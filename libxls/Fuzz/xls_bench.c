@@ -0,0 +1,456 @@
+/*
+ * Parse throughput benchmark for libxls.
+ *
+ * Replays the corpus and synthetic workbooks (common/xls_gen.h) in-process and
+ * times the stages the driver runs:
+ *
+ *   open       xls_open_buffer (OLE2 container, Workbook stream lookup)
+ *   workbook   xls_parseWorkBook (globals: SST, formats, fonts, sheets)
+ *   sheets     xls_getWorkSheet + xls_parseWorkSheet + xls_close_WS for
+ *              every sheet
+ *   total      all of the above plus xls_close_WB, as one driver execution
+ *
+ * For each stage it reports MB/s and ns per cell (cells are libxls' row by
+ * column table, summed over the sheets).  It also reports the allocations per
+ * pass (calls and bytes, counted through malloc/calloc/realloc interposed
+ * below) and the peak heap growth within the stage.
+ *
+ * Each set runs in its own child process, so the peak RSS column is that
+ * set's own peak (from wait4).  When a synthetic set follows another
+ * synthetic set, the "exp" column is the scaling exponent of each stage
+ * between the two: log(time ratio) / log(cell ratio).  A value near 1 is
+ * linear, and values well above 1 show superlinear behaviour.
+ *
+ * -S adds a synthetic workbook.  Its key=N[,key=N...] list (sheets, rows,
+ * cols, sst, strlen, split, formula, seed) is applied on top of the
+ * generator defaults, e.g.
+ *   -S rows=1000 -S rows=10000 -S rows=60000 -S sst=100000,strlen=64
+ *
+ * Build:
+ *   gcc -O2 -I../include -o xls_bench xls_bench.c -L../src/.libs -lxlsreader -lm
+ *
+ * Usage:
+ *   ./xls_bench [-t min_ms] [-c] [-S key=N[,key=N...]]... [dir...]
+ *
+ * Without dirs, xls_parseWorkBook/input is replayed.  -c prints CSV instead
+ * of a table.
+ */
+
+#include <dirent.h>
+#include <math.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "xls.h"
+#include "common/xls_gen.h"
+
+#define BENCH_MAX_INPUTS 4096
+#define BENCH_MAX_SETS   32
+
+/* ---- allocation accounting ---- */
+
+// glibc's allocator entry points; the wrappers below take the public names
+// so that libxls' allocations go through them.
+#if defined(__GLIBC__) && !defined(XLS_BENCH_NO_MALLOC_HOOK)
+#include <malloc.h>
+#define BENCH_MALLOC_HOOK 1
+extern void *__libc_malloc(size_t size);
+extern void *__libc_calloc(size_t n, size_t size);
+extern void *__libc_realloc(void *ptr, size_t size);
+extern void __libc_free(void *ptr);
+#endif
+
+static bool bench_counting;             // inside a timed region
+static uint64_t bench_allocs;           // calls while counting
+static uint64_t bench_alloc_bytes;      // bytes requested while counting
+static int64_t bench_live;              // heap bytes in use
+static int64_t bench_peak;              // high-water mark of bench_live
+
+#ifdef BENCH_MALLOC_HOOK
+static void note_alloc(void *p, size_t requested) {
+    if (!p) {
+        return;
+    }
+    bench_live += (int64_t)malloc_usable_size(p);
+    if (bench_live > bench_peak) {
+        bench_peak = bench_live;
+    }
+    if (bench_counting) {
+        bench_allocs++;
+        bench_alloc_bytes += requested;
+    }
+}
+
+void *malloc(size_t size) {
+    void *p = __libc_malloc(size);
+    note_alloc(p, size);
+    return p;
+}
+
+void *calloc(size_t n, size_t size) {
+    void *p = __libc_calloc(n, size);
+    note_alloc(p, n * size);
+    return p;
+}
+
+void *realloc(void *ptr, size_t size) {
+    int64_t old = ptr ? (int64_t)malloc_usable_size(ptr) : 0;
+    void *p = __libc_realloc(ptr, size);
+    if (p || size == 0) {
+        bench_live -= old;
+    }
+    note_alloc(p, size);
+    return p;
+}
+
+void free(void *ptr) {
+    if (ptr) {
+        bench_live -= (int64_t)malloc_usable_size(ptr);
+    }
+    __libc_free(ptr);
+}
+#endif
+
+/* ---- sets ---- */
+
+enum { STAGE_OPEN, STAGE_WORKBOOK, STAGE_SHEETS, STAGE_TOTAL, STAGE_COUNT };
+
+static const char *const bench_stage_names[STAGE_COUNT] = {"open", "workbook", "sheets", "total"};
+
+typedef struct {
+    char name[64];
+    const char *dir;            // corpus directory, or NULL for a synthetic set
+    xls_gen_params params;
+} bench_set;
+
+typedef struct {
+    uint8_t *data;
+    size_t len;
+} bench_input;
+
+typedef struct {
+    uint64_t passes;
+    uint64_t ns;
+    uint64_t allocs;
+    uint64_t alloc_bytes;
+    uint64_t peak_heap;
+} bench_result;
+
+// What a set's child process sends back to the parent.
+typedef struct {
+    int inputs;
+    int opened;                 // inputs that xls_parseWorkBook accepts
+    uint64_t bytes;
+    uint64_t cells;
+    bench_result stage[STAGE_COUNT];
+} bench_report;
+
+static uint64_t bench_min_ns = 200000000ULL;
+static bool bench_csv;
+
+static uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+static int load_dir(const char *dir, bench_input *in, int max) {
+    DIR *d = opendir(dir);
+    if (!d) {
+        perror(dir);
+        return 0;
+    }
+    int count = 0;
+    struct dirent *e;
+    while (count < max && (e = readdir(d)) != NULL) {
+        if (e->d_name[0] == '.') continue;
+        char path[4096];
+        snprintf(path, sizeof(path), "%s/%s", dir, e->d_name);
+        FILE *file = fopen(path, "rb");
+        if (!file) continue;
+        fseek(file, 0, SEEK_END);
+        long size = ftell(file);
+        fseek(file, 0, SEEK_SET);
+        uint8_t *data = size > 0 ? (uint8_t *)malloc((size_t)size) : NULL;
+        if (data && fread(data, 1, (size_t)size, file) == (size_t)size) {
+            in[count].data = data;
+            in[count].len = (size_t)size;
+            count++;
+        } else {
+            free(data);
+        }
+        fclose(file);
+    }
+    closedir(d);
+    return count;
+}
+
+/* ---- stages ---- */
+
+static uint64_t region_start;
+static int64_t region_base;
+
+static void region_begin(bool on) {
+    if (!on) return;
+    region_base = bench_live;
+    bench_peak = bench_live;
+    bench_counting = true;
+    region_start = now_ns();
+}
+
+static void region_end(bool on, bench_result *r) {
+    if (!on) return;
+    r->ns += now_ns() - region_start;
+    bench_counting = false;
+    if (bench_peak - region_base > (int64_t)r->peak_heap) {
+        r->peak_heap = (uint64_t)(bench_peak - region_base);
+    }
+}
+
+// One driver execution on an input; only the given stage is measured.
+// Returns the cells of the parsed sheets.
+static uint64_t run_input(const bench_input *in, int stage, bench_result *r, bool *opened) {
+    bool total = stage == STAGE_TOTAL;
+    uint64_t cells = 0;
+    xls_error_t error = LIBXLS_OK;
+    region_begin(total || stage == STAGE_OPEN);
+    xlsWorkBook *wb = xls_open_buffer(in->data, in->len, NULL, &error);
+    region_end(stage == STAGE_OPEN, r);
+    if (wb) {
+        region_begin(stage == STAGE_WORKBOOK);
+        xls_error_t parsed = xls_parseWorkBook(wb);
+        region_end(stage == STAGE_WORKBOOK, r);
+        if (parsed == LIBXLS_OK) {
+            *opened = true;
+            region_begin(stage == STAGE_SHEETS);
+            for (int i = 0; i < (int)wb->sheets.count; i++) {
+                xlsWorkSheet *ws = xls_getWorkSheet(wb, i);
+                if (!ws) continue;
+                if (xls_parseWorkSheet(ws) == LIBXLS_OK && ws->rows.row) {
+                    for (int row = 0; row <= ws->rows.lastrow; row++) {
+                        cells += ws->rows.row[row].cells.count;
+                    }
+                }
+                xls_close_WS(ws);
+            }
+            region_end(stage == STAGE_SHEETS, r);
+        }
+        xls_close_WB(wb);
+    }
+    region_end(total, r);
+    return cells;
+}
+
+static void bench_stage(const bench_input *in, int count, int stage, bench_result *r) {
+    uint64_t allocs = bench_allocs, bytes = bench_alloc_bytes, start = now_ns();
+    bool opened;
+    memset(r, 0, sizeof(*r));
+    do {
+        for (int i = 0; i < count; i++) {
+            run_input(&in[i], stage, r, &opened);
+        }
+        r->passes++;
+        // Stages that never run (no input opens) stop on the wall clock.
+    } while (r->ns < bench_min_ns && now_ns() - start < 4 * bench_min_ns);
+    r->allocs = bench_allocs - allocs;
+    r->alloc_bytes = bench_alloc_bytes - bytes;
+}
+
+// Child side: load or generate the inputs and measure every stage.
+static void bench_child(const bench_set *set, bench_report *rep) {
+    static bench_input in[BENCH_MAX_INPUTS];
+    memset(rep, 0, sizeof(*rep));
+    int count = 0;
+    if (set->dir) {
+        count = load_dir(set->dir, in, BENCH_MAX_INPUTS);
+    } else {
+        xls_fuzz_buf out = {0};
+        if (xls_gen_workbook(&set->params, &out)) {
+            in[0].data = out.data;
+            in[0].len = out.len;
+            count = 1;
+        } else {
+            xls_fuzz_buf_free(&out);
+        }
+    }
+    rep->inputs = count;
+    bench_result scratch;
+    for (int i = 0; i < count; i++) {
+        bool opened = false;
+        memset(&scratch, 0, sizeof(scratch));
+        rep->bytes += in[i].len;
+        rep->cells += run_input(&in[i], -1, &scratch, &opened);
+        rep->opened += opened;
+    }
+    for (int s = 0; count && s < STAGE_COUNT; s++) {
+        bench_stage(in, count, s, &rep->stage[s]);
+    }
+    for (int i = 0; i < count; i++) {
+        free(in[i].data);
+    }
+}
+
+/* ---- report ---- */
+
+static void print_row(const bench_set *set, const bench_report *rep, int s, double peak_rss_mb, double exp) {
+    const bench_result *r = &rep->stage[s];
+    double sec = r->ns / 1e9;
+    double mbs = sec > 0 ? (double)rep->bytes * r->passes / sec / 1e6 : 0;
+    double per_cell = rep->cells && r->passes ? (double)r->ns / ((double)rep->cells * r->passes) : 0;
+    double allocs = r->passes ? (double)r->allocs / r->passes : 0;
+    double alloc_kb = r->passes ? (double)r->alloc_bytes / r->passes / 1024 : 0;
+    char scale[16] = "-";
+    if (!isnan(exp)) {
+        snprintf(scale, sizeof(scale), "%.2f", exp);
+    }
+    if (bench_csv) {
+        printf("%s,%s,%d,%d,%llu,%llu,%llu,%.3f,%.2f,%.1f,%.1f,%.1f,%.1f,%.1f,%s\n", set->name,
+               bench_stage_names[s], rep->inputs, rep->opened, (unsigned long long)rep->bytes,
+               (unsigned long long)rep->cells, (unsigned long long)r->passes, r->ns / 1e6, mbs, per_cell,
+               allocs, alloc_kb, r->peak_heap / 1024.0, peak_rss_mb, scale);
+    } else {
+        printf("%-28s %-8s %5d/%-5d %10llu %9llu %7llu %9.1f %8.2f %8.1f %10.1f %10.1f %10.1f %8.1f %5s\n",
+               set->name, bench_stage_names[s], rep->opened, rep->inputs, (unsigned long long)rep->bytes,
+               (unsigned long long)rep->cells, (unsigned long long)r->passes, r->ns / 1e6, mbs, per_cell,
+               allocs, alloc_kb, r->peak_heap / 1024.0, peak_rss_mb, scale);
+    }
+}
+
+static int run_set(const bench_set *set, bench_report *rep, double *peak_rss_mb) {
+    int fds[2];
+    if (pipe(fds) != 0) {
+        perror("pipe");
+        return -1;
+    }
+    fflush(stdout);
+    pid_t pid = fork();
+    if (pid < 0) {
+        perror("fork");
+        close(fds[0]);
+        close(fds[1]);
+        return -1;
+    }
+    if (pid == 0) {
+        close(fds[0]);
+        bench_report child;
+        bench_child(set, &child);
+        ssize_t n = write(fds[1], &child, sizeof(child));
+        _exit(n == (ssize_t)sizeof(child) ? 0 : 1);
+    }
+    close(fds[1]);
+    size_t got = 0;
+    while (got < sizeof(*rep)) {
+        ssize_t n = read(fds[0], (char *)rep + got, sizeof(*rep) - got);
+        if (n <= 0) break;
+        got += (size_t)n;
+    }
+    close(fds[0]);
+    int status = 0;
+    struct rusage usage;
+    memset(&usage, 0, sizeof(usage));
+    wait4(pid, &status, 0, &usage);
+    *peak_rss_mb = usage.ru_maxrss / 1024.0;    // kilobytes on Linux
+    if (got != sizeof(*rep) || !WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+        fprintf(stderr, "%s: benchmark process failed\n", set->name);
+        return -1;
+    }
+    return 0;
+}
+
+static void usage(const char *argv0) {
+    fprintf(stderr, "Usage: %s [-t min_ms] [-c] [-S key=N[,key=N...]]... [dir...]\n", argv0);
+}
+
+int main(int argc, char **argv) {
+    static bench_set sets[BENCH_MAX_SETS];
+    int nsets = 0;
+    static bench_set synthetic[BENCH_MAX_SETS];
+    int nsynthetic = 0;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "t:cS:")) != -1) {
+        switch (opt) {
+        case 't':
+            bench_min_ns = strtoull(optarg, NULL, 0) * 1000000ULL;
+            break;
+        case 'c':
+            bench_csv = true;
+            break;
+        case 'S': {
+            if (nsynthetic >= BENCH_MAX_SETS) break;
+            bench_set *set = &synthetic[nsynthetic];
+            xls_gen_defaults(&set->params);
+            if (!xls_gen_parse(&set->params, optarg)) {
+                fprintf(stderr, "Bad synthetic workbook spec: %s\n", optarg);
+                usage(argv[0]);
+                return EXIT_FAILURE;
+            }
+            snprintf(set->name, sizeof(set->name), "%s", optarg);
+            nsynthetic++;
+            break;
+        }
+        default:
+            usage(argv[0]);
+            return EXIT_FAILURE;
+        }
+    }
+
+    if (optind < argc) {
+        for (int i = optind; i < argc && nsets < BENCH_MAX_SETS; i++) {
+            sets[nsets].dir = argv[i];
+            snprintf(sets[nsets].name, sizeof(sets[nsets].name), "%s", argv[i]);
+            nsets++;
+        }
+    } else {
+        sets[nsets].dir = "xls_parseWorkBook/input";
+        snprintf(sets[nsets].name, sizeof(sets[nsets].name), "xls_parseWorkBook");
+        nsets++;
+    }
+    for (int i = 0; i < nsynthetic && nsets < BENCH_MAX_SETS; i++) {
+        sets[nsets++] = synthetic[i];
+    }
+
+    xls(0);
+    if (bench_csv) {
+        printf("set,stage,inputs,opened,bytes,cells,passes,total_ms,mb_per_s,ns_per_cell,"
+               "allocs_per_pass,alloc_kb_per_pass,peak_heap_kb,peak_rss_mb,exp\n");
+    } else {
+        printf("%-28s %-8s %11s %10s %9s %7s %9s %8s %8s %10s %10s %10s %8s %5s\n", "set", "stage", "opened",
+               "bytes", "cells", "passes", "total_ms", "MB/s", "ns/cell", "allocs/pass", "allocKB/pass",
+               "peakheapKB", "rssMB", "exp");
+    }
+
+    bench_report prev = {0};
+    bool have_prev = false;
+    int failed = 0;
+    for (int s = 0; s < nsets; s++) {
+        bench_report rep;
+        double rss = 0;
+        if (run_set(&sets[s], &rep, &rss) != 0) {
+            failed++;
+            have_prev = false;
+            continue;
+        }
+        bool scaled = !sets[s].dir && have_prev && prev.cells && rep.cells && prev.cells != rep.cells;
+        for (int st = 0; st < STAGE_COUNT; st++) {
+            double exp = NAN;
+            const bench_result *a = &prev.stage[st], *b = &rep.stage[st];
+            if (scaled && a->passes && b->passes && a->ns && b->ns) {
+                double ta = (double)a->ns / a->passes, tb = (double)b->ns / b->passes;
+                exp = log(tb / ta) / log((double)rep.cells / prev.cells);
+            }
+            print_row(&sets[s], &rep, st, rss, exp);
+        }
+        prev = rep;
+        have_prev = !sets[s].dir;
+    }
+    return failed ? EXIT_FAILURE : EXIT_SUCCESS;
+}
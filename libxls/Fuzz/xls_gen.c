@@ -0,0 +1,128 @@
+/*
+ * Synthetic workbook generator for the libxls driver and benchmark.
+ *
+ * Writes valid BIFF8 .xls files (common/xls_gen.h).  The -p list (sheets,
+ * rows, cols, sst, strlen, split, formula, seed) is applied on top of the
+ * generator defaults.  With -n 1 (the default) one workbook with exactly
+ * those parameters is written to <output>.  With -n count, <output> is a
+ * directory that receives count workbooks.  Each one draws every size
+ * parameter between 1 (0 for sst and formula) and the given value, and
+ * half of them shrink the SST record limit to force CONTINUE records.
+ * That makes a seed corpus for xls_parseWorkBook.
+ *
+ * Build (no libxls needed):
+ *   gcc -O2 -o xls_gen xls_gen.c
+ *
+ * Usage:
+ *   ./xls_gen [-p key=N[,key=N...]] [-n count] [-s seed] <output>
+ *
+ * Example:
+ *   ./xls_gen -p sheets=4,rows=200,cols=20,sst=500,formula=20 -n 200 -s 1 xls_parseWorkBook/input
+ */
+
+#include <errno.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "common/xls_gen.h"
+
+static int write_file(const char *path, const xls_fuzz_buf *buf) {
+    FILE *f = fopen(path, "wb");
+    if (!f) {
+        perror(path);
+        return -1;
+    }
+    size_t n = fwrite(buf->data, 1, buf->len, f);
+    if (fclose(f) != 0 || n != buf->len) {
+        perror(path);
+        return -1;
+    }
+    return 0;
+}
+
+static uint32_t next_rand(uint32_t *state) {
+    *state ^= *state << 13;
+    *state ^= *state >> 17;
+    *state ^= *state << 5;
+    return *state;
+}
+
+// Uniform in [lo, hi].
+static int draw(uint32_t *state, int lo, int hi) {
+    return hi <= lo ? hi : lo + (int)(next_rand(state) % (uint32_t)(hi - lo + 1));
+}
+
+static void usage(const char *argv0) {
+    fprintf(stderr, "Usage: %s [-p key=N[,key=N...]] [-n count] [-s seed] <output>\n", argv0);
+}
+
+int main(int argc, char **argv) {
+    xls_gen_params max;
+    xls_gen_defaults(&max);
+    unsigned long count = 1;
+    uint32_t seed = 1;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "p:n:s:")) != -1) {
+        switch (opt) {
+        case 'p':
+            if (!xls_gen_parse(&max, optarg)) {
+                fprintf(stderr, "Bad workbook parameters: %s\n", optarg);
+                usage(argv[0]);
+                return EXIT_FAILURE;
+            }
+            break;
+        case 'n':
+            count = strtoul(optarg, NULL, 0);
+            break;
+        case 's':
+            seed = (uint32_t)strtoul(optarg, NULL, 0);
+            break;
+        default:
+            usage(argv[0]);
+            return EXIT_FAILURE;
+        }
+    }
+    if (optind + 1 != argc || count == 0) {
+        usage(argv[0]);
+        return EXIT_FAILURE;
+    }
+    const char *output = argv[optind];
+
+    xls_fuzz_buf buf = {0};
+    if (count == 1) {
+        int ret = xls_gen_workbook(&max, &buf) ? write_file(output, &buf) : -1;
+        xls_fuzz_buf_free(&buf);
+        return ret == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+
+    if (mkdir(output, 0755) != 0 && errno != EEXIST) {
+        perror(output);
+        return EXIT_FAILURE;
+    }
+    uint32_t state = seed ? seed : 1;
+    unsigned long written = 0;
+    for (unsigned long n = 0; n < count; n++) {
+        xls_gen_params p = max;
+        p.sheets = draw(&state, 1, max.sheets);
+        p.rows = draw(&state, 1, max.rows);
+        p.cols = draw(&state, 1, max.cols);
+        p.sst = draw(&state, 0, max.sst);
+        p.str_len = draw(&state, 1, max.str_len);
+        p.formula_pct = draw(&state, 0, max.formula_pct);
+        p.split = next_rand(&state) % 2 ? draw(&state, 16, max.split) : max.split;
+        p.seed = next_rand(&state);
+        char path[4096];
+        snprintf(path, sizeof(path), "%s/gen_%06lu.xls", output, n);
+        if (xls_gen_workbook(&p, &buf) && write_file(path, &buf) == 0) {
+            written++;
+        }
+    }
+    xls_fuzz_buf_free(&buf);
+    printf("%lu workbooks written to %s\n", written, output);
+    return written == count ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,20 @@
+#include "xls.h"
+#include "../common/xls_fuzz_options.h"
+#include "../common/xls_fuzz_walk.h"
+
+int LLVMFuzzerTestOneInput(const uint8_t *Data, size_t Size) {
+    // 输入带选项头时按选项头运行，否则整个输入按默认选项作为 .xls 文件解析
+    xls_fuzz_options opts;
+    if (xls_fuzz_parse_options(Data, Size, &opts)) {
+        Data += XLS_FUZZ_OPTIONS_SIZE;
+        Size -= XLS_FUZZ_OPTIONS_SIZE;
+    } else {
+        uint8_t header[XLS_FUZZ_OPTIONS_SIZE];
+        xls_fuzz_default_header(header);
+        xls_fuzz_parse_options(header, sizeof(header), &opts);
+    }
+
+    xls_fuzz_phases phases;
+    xls_fuzz_run(Data, Size, &opts, &phases);
+    return 0;
+}
@@ -0,0 +1,97 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include "xls.h"
+#include "../common/xls_fuzz_afl.h"
+#include "../common/xls_fuzz_options.h"
+#include "../common/xls_fuzz_walk.h"
+#include "../../../optstats/optstats.h"
+
+// 使用 afl-clang-fast 编译时自动启用持久模式，可用 -DXLS_FUZZ_NO_PERSISTENT 关闭
+#if defined(__AFL_FUZZ_TESTCASE_LEN) && !defined(XLS_FUZZ_NO_PERSISTENT)
+#define XLS_FUZZ_PERSISTENT 1
+#ifndef XLS_FUZZ_LOOP_COUNT
+#define XLS_FUZZ_LOOP_COUNT 10000
+#endif
+__AFL_FUZZ_INIT();
+#endif
+
+// 单次执行：选项来自输入开头的选项头（common/xls_fuzz_options.h），
+// 决定字符集、解析哪些工作表以及如何遍历单元格；没有选项头的输入按默认选项解析。
+// 各阶段耗时见 common/xls_fuzz_walk.h
+static void parse_input(const uint8_t* data, size_t size) {
+    uint8_t header[XLS_FUZZ_OPTIONS_SIZE];
+    if (xls_fuzz_has_options(data, size)) {
+        memcpy(header, data, XLS_FUZZ_OPTIONS_SIZE);
+        data += XLS_FUZZ_OPTIONS_SIZE;
+        size -= XLS_FUZZ_OPTIONS_SIZE;
+    } else {
+        xls_fuzz_default_header(header);
+    }
+    xls_fuzz_options opts;
+    xls_fuzz_parse_options(header, sizeof(header), &opts);
+
+    // 把本次执行的选项组合发布到共享表（optstats/optstats.h）
+    uint8_t key[XLS_FUZZ_OPTIONS_SIZE];
+    xls_fuzz_options_key(header, key);
+    if (optstats_begin(key, sizeof(key))) {
+        optstats_label("charset=%s sheets=%s walk=%s formats=%d",
+                       opts.charset ? opts.charset : "default", xls_fuzz_sheet_mode_name(opts.sheets),
+                       xls_fuzz_walk_mode_name(opts.walk), (int)opts.formats);
+    }
+
+    xls_fuzz_phases phases;
+    xls_fuzz_run(data, size, &opts, &phases);
+    optstats_end();
+    xls_fuzz_phases_log(&opts, &phases);
+}
+
+int main(int argc, char** argv) {
+#ifndef XLS_FUZZ_PERSISTENT
+    if (argc < 2) {
+        fprintf(stderr, "Usage: %s <input_file>\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+#endif
+
+    // 关闭 libxls 调试输出
+    xls(0);
+    xls_fuzz_warn_leaks_disabled();
+    // 读取 XLS_FUZZ_PHASE_LOG（各阶段耗时日志）
+    xls_fuzz_phases_init();
+    // 设置 OPTSTATS_FILE 时把每次执行的选项组合发布到共享表
+    optstats_init("xls_open_buffer");
+
+#ifdef __AFL_HAVE_MANUAL_CONTROL
+    // 延迟 forkserver：子进程从这里开始
+    __AFL_INIT();
+#endif
+
+    if (argc >= 2) {
+        // 给定文件参数时执行一次（afl-fuzz 使用 @@ 或复现崩溃）
+        size_t size = 0;
+        uint8_t* data = xls_fuzz_read_file(argv[1], &size);
+        if (!data) {
+            return EXIT_FAILURE;
+        }
+        parse_input(data, size);
+        free(data);
+        xls_fuzz_check_leaks(0);
+    }
+#ifdef XLS_FUZZ_PERSISTENT
+    else {
+        // 持久模式：测试用例经共享内存传入，跳过选项头后直接交给 xls_open_buffer
+        const uint8_t* buf = __AFL_FUZZ_TESTCASE_BUF;
+        unsigned long iteration = 0;
+        while (__AFL_LOOP(XLS_FUZZ_LOOP_COUNT)) {
+            parse_input(buf, __AFL_FUZZ_TESTCASE_LEN);
+            xls_fuzz_check_leaks(++iteration);
+        }
+        // 检查最后不足一个间隔的迭代
+        xls_fuzz_check_leaks(0);
+    }
+#endif
+
+    return EXIT_SUCCESS;
+}
@@ -1,45 +1,84 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
 #include "xls.h"
+#include "../common/xls_fuzz_afl.h"
 
+// 使用 afl-clang-fast 编译时自动启用持久模式，可用 -DXLS_FUZZ_NO_PERSISTENT 关闭
+#if defined(__AFL_FUZZ_TESTCASE_LEN) && !defined(XLS_FUZZ_NO_PERSISTENT)
+#define XLS_FUZZ_PERSISTENT 1
+#ifndef XLS_FUZZ_LOOP_COUNT
+#define XLS_FUZZ_LOOP_COUNT 10000
+#endif
+__AFL_FUZZ_INIT();
+#endif
 
-int main(int argc, char** argv) {
-  FILE* file;
-  file = fopen(argv[1], "r");
-  if (!file) return 0;
-  if (fseeko(file, 0, SEEK_END) != 0) {
-    fprintf(stderr, "fseeko error!\n");
-    return 0;
-  }
-  size_t size = ftello(file);
-  // printf("size is %zu\n", size);
-  uint8_t* data;
-  if (fseeko(file, 0, SEEK_SET) != 0) {
-    fprintf(stderr, "fseeko error!\n");
-    return 0;
-  }
-  data = (uint8_t*)malloc(sizeof(char) * size + 1);
-  size_t fread_len = fread(data, size, 1, file);
-  // printf("fread_len is %zu\n", fread_len);
-  
-    xls_error_t error;
-    xlsWorkBook *work_book = xls_open_buffer(data, size, NULL, &error);
-    
-    if (work_book) {
-        // 先解析整个工作簿
-        xls_error_t parse_error = xls_parseWorkBook(work_book);
-        
-        if (parse_error == LIBXLS_OK) {
-            // 如果工作簿解析成功，继续解析每个工作表
-            for (int i = 0; i < work_book->sheets.count; i++) {
-                xlsWorkSheet *work_sheet = xls_getWorkSheet(work_book, i);
-                if (work_sheet) {
-                    xls_parseWorkSheet(work_sheet);
-                    xls_close_WS(work_sheet);
-                }
+// 单次执行：直接在输入缓冲区上打开工作簿（不拷贝），解析工作簿与每个工作表。
+// 本次执行分配的内存全部在返回前通过 xls_close_WS / xls_close_WB 释放
+static void parse_input(const uint8_t* data, size_t size) {
+    xls_error_t error = LIBXLS_OK;
+    xlsWorkBook* work_book = xls_open_buffer(data, size, NULL, &error);
+    if (!work_book) {
+        return;
+    }
+
+    // 先解析整个工作簿
+    if (xls_parseWorkBook(work_book) == LIBXLS_OK) {
+        // 工作簿解析成功后继续解析每个工作表
+        for (int i = 0; i < work_book->sheets.count; i++) {
+            xlsWorkSheet* work_sheet = xls_getWorkSheet(work_book, i);
+            if (work_sheet) {
+                xls_parseWorkSheet(work_sheet);
+                xls_close_WS(work_sheet);
             }
         }
-        
-        xls_close_WB(work_book);
     }
-    
-    return 0;
+
+    xls_close_WB(work_book);
+}
+
+int main(int argc, char** argv) {
+#ifndef XLS_FUZZ_PERSISTENT
+    if (argc < 2) {
+        fprintf(stderr, "Usage: %s <input_file>\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+#endif
+
+    // 关闭 libxls 调试输出
+    xls(0);
+    xls_fuzz_warn_leaks_disabled();
+
+#ifdef __AFL_HAVE_MANUAL_CONTROL
+    // 延迟 forkserver：子进程从这里开始
+    __AFL_INIT();
+#endif
+
+    if (argc >= 2) {
+        // 给定文件参数时执行一次（afl-fuzz 使用 @@ 或复现崩溃）
+        size_t size = 0;
+        uint8_t* data = xls_fuzz_read_file(argv[1], &size);
+        if (!data) {
+            return EXIT_FAILURE;
+        }
+        parse_input(data, size);
+        free(data);
+        xls_fuzz_check_leaks(0);
+    }
+#ifdef XLS_FUZZ_PERSISTENT
+    else {
+        // 持久模式：测试用例经共享内存传入，直接交给 xls_open_buffer
+        const uint8_t* buf = __AFL_FUZZ_TESTCASE_BUF;
+        unsigned long iteration = 0;
+        while (__AFL_LOOP(XLS_FUZZ_LOOP_COUNT)) {
+            parse_input(buf, __AFL_FUZZ_TESTCASE_LEN);
+            xls_fuzz_check_leaks(++iteration);
+        }
+        // 检查最后不足一个间隔的迭代
+        xls_fuzz_check_leaks(0);
+    }
+#endif
+
+    return EXIT_SUCCESS;
 }
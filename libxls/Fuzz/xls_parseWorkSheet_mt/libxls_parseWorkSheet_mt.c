@@ -0,0 +1,22 @@
+#include "xls.h"
+#include "../common/xls_sheet_pool.h"
+
+// 工作线程池在首次调用时创建，之后的输入复用
+static xls_sheet_pool pool;
+
+int LLVMFuzzerTestOneInput(const uint8_t *Data, size_t Size) {
+    xls_error_t error;
+    xlsWorkBook *work_book = xls_open_buffer(Data, Size, NULL, &error);
+
+    if (work_book) {
+        // 每个工作线程在同一输入缓冲区上打开自己的工作簿句柄并发解析全部工作表，
+        // 再用这里的句柄顺序解析一遍并比较结果
+        if (xls_parseWorkBook(work_book) == LIBXLS_OK) {
+            xls_sheet_pool_check(&pool, Data, Size, NULL, work_book);
+        }
+
+        xls_close_WB(work_book);
+    }
+
+    return 0;
+}
@@ -0,0 +1,78 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include "xls.h"
+#include "../common/xls_fuzz_afl.h"
+#include "../common/xls_sheet_pool.h"
+
+// 并发解析工作表的驱动，配合 ThreadSanitizer（-fsanitize=thread）编译。
+// 使用 afl-clang-fast 编译时自动启用持久模式，可用 -DXLS_FUZZ_NO_PERSISTENT 关闭
+#if defined(__AFL_FUZZ_TESTCASE_LEN) && !defined(XLS_FUZZ_NO_PERSISTENT)
+#define XLS_FUZZ_PERSISTENT 1
+#ifndef XLS_FUZZ_LOOP_COUNT
+#define XLS_FUZZ_LOOP_COUNT 10000
+#endif
+__AFL_FUZZ_INIT();
+#endif
+
+// 工作线程池，在 forkserver fork 之后的首次执行时创建
+static xls_sheet_pool pool;
+
+// 单次执行：线程池上每个工作线程用 xls_open_buffer 在同一输入缓冲区上打开
+// 自己的工作簿句柄，并发解析全部工作表；再用这里的句柄顺序解析一遍，
+// 两次结果不一致即 abort。xlsWorkBook 不能跨线程共享（工作表都经由同一个
+// OLE2 流 olestr 读取），XLS_FUZZ_SHARED_WORKBOOK=1 仅用于复现这一竞争
+static void parse_input(const uint8_t* data, size_t size) {
+    xls_error_t error = LIBXLS_OK;
+    xlsWorkBook* work_book = xls_open_buffer(data, size, NULL, &error);
+    if (!work_book) {
+        return;
+    }
+
+    if (xls_parseWorkBook(work_book) == LIBXLS_OK) {
+        xls_sheet_pool_check(&pool, data, size, NULL, work_book);
+    }
+
+    xls_close_WB(work_book);
+}
+
+int main(int argc, char** argv) {
+#ifndef XLS_FUZZ_PERSISTENT
+    if (argc < 2) {
+        fprintf(stderr, "Usage: %s <input_file>\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+#endif
+
+    // 关闭 libxls 调试输出
+    xls(0);
+
+#ifdef __AFL_HAVE_MANUAL_CONTROL
+    // 延迟 forkserver：子进程从这里开始，线程池在此之后才创建
+    __AFL_INIT();
+#endif
+
+    if (argc >= 2) {
+        // 给定文件参数时执行一次（afl-fuzz 使用 @@ 或复现崩溃）
+        size_t size = 0;
+        uint8_t* data = xls_fuzz_read_file(argv[1], &size);
+        if (!data) {
+            return EXIT_FAILURE;
+        }
+        parse_input(data, size);
+        free(data);
+    }
+#ifdef XLS_FUZZ_PERSISTENT
+    else {
+        // 持久模式：测试用例经共享内存传入，直接交给 xls_open_buffer
+        const uint8_t* buf = __AFL_FUZZ_TESTCASE_BUF;
+        while (__AFL_LOOP(XLS_FUZZ_LOOP_COUNT)) {
+            parse_input(buf, __AFL_FUZZ_TESTCASE_LEN);
+        }
+    }
+#endif
+
+    xls_sheet_pool_stop(&pool);
+    return EXIT_SUCCESS;
+}
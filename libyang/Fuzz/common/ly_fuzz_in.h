@@ -0,0 +1,172 @@
+/*
+ * Zero-copy input for the libyang AFL drivers.
+ *
+ * libyang's memory input (ly_in_new_memory) reads until a NUL byte, so the
+ * drivers used to copy every testcase into a malloc'd buffer one byte longer
+ * than the input.  Here the testcase is handed to libyang where it already
+ * is, through one ly_in handle that is pointed at each new input with
+ * ly_in_memory():
+ *
+ *  - ly_fuzz_map_file() maps an input file read-only.  The mapping is laid
+ *    out like libyang's own ly_in_new_fd mapping: the zero-filled tail of the
+ *    last page terminates the text, and a file that ends exactly on a page
+ *    boundary gets an anonymous zero page after it.  The option header is
+ *    skipped by pointing the handle past it, which ly_in_new_fd cannot do.
+ *
+ *  - ly_fuzz_terminate() writes the NUL in place after a persistent-mode
+ *    testcase.  AFL's testcase buffer (__AFL_FUZZ_TESTCASE_BUF) is writable
+ *    and afl-fuzz never reads it back.  Its size is not assumed:
+ *    ly_fuzz_testcase_cap() reads it from the shared memory segment at
+ *    startup (MAX_FILE of the afl-fuzz that created it), so a testcase that
+ *    fills the whole buffer is copied into a staging buffer instead of
+ *    being terminated past its end.
+ */
+
+#ifndef LY_FUZZ_IN_H
+#define LY_FUZZ_IN_H
+
+#include <fcntl.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/shm.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "libyang.h"
+
+// Size of the buffer __AFL_FUZZ_INIT() declares for testcases read from
+// stdin, used when afl-fuzz passes no shared memory testcase buffer
+#ifndef LY_FUZZ_TESTCASE_CAP
+#define LY_FUZZ_TESTCASE_CAP (1024 * 1024)
+#endif
+
+typedef struct {
+    uint8_t *data;      // file contents, followed by at least one NUL byte
+    size_t size;        // file size
+    size_t map_len;     // length of the whole mapping
+} ly_fuzz_map;
+
+// Map path read-only with a NUL byte after its contents.  Empty files are
+// mapped as one zero page so callers need no special case.
+static inline int ly_fuzz_map_file(const char *path, ly_fuzz_map *map) {
+    memset(map, 0, sizeof(*map));
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        perror("Failed to open input file");
+        return -1;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        perror("fstat error");
+        close(fd);
+        return -1;
+    }
+
+    size_t page = (size_t)sysconf(_SC_PAGESIZE);
+    size_t size = (size_t)st.st_size;
+    void *addr;
+    if (size % page) {
+        // The rest of the last page reads as zeros
+        map->map_len = size + 1;
+        addr = mmap(NULL, map->map_len, PROT_READ, MAP_PRIVATE, fd, 0);
+    } else {
+        // Reserve one zero page more than the file, then map the file over the front
+        map->map_len = size + page;
+        addr = mmap(NULL, map->map_len, PROT_READ, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (addr != MAP_FAILED && size &&
+            mmap(addr, size, PROT_READ, MAP_PRIVATE | MAP_FIXED, fd, 0) == MAP_FAILED) {
+            munmap(addr, map->map_len);
+            addr = MAP_FAILED;
+        }
+    }
+    close(fd);
+    if (addr == MAP_FAILED) {
+        perror("Failed to map input file");
+        map->map_len = 0;
+        return -1;
+    }
+    map->data = (uint8_t *)addr;
+    map->size = size;
+    return 0;
+}
+
+static inline void ly_fuzz_unmap(ly_fuzz_map *map) {
+    if (map->data) {
+        munmap(map->data, map->map_len);
+    }
+    memset(map, 0, sizeof(*map));
+}
+
+// Staging buffer for testcases with no room for a terminator
+static char *ly_fuzz_staging = NULL;
+static size_t ly_fuzz_staging_cap = 0;
+
+// Bytes of AFL's testcase buffer, to pass to ly_fuzz_terminate().  With
+// shared memory testcases the buffer is a SysV segment (id in
+// __AFL_SHM_FUZZ_ID) that starts with the 4-byte length, so its size comes
+// from shmctl(IPC_STAT) rather than from a MAX_FILE compiled in here.  An id
+// that is not a SysV id (AFL built with USEMMAP, whose mapping is read-only)
+// or a segment that cannot be queried gives 0: every testcase is staged.
+static inline size_t ly_fuzz_testcase_cap(void) {
+    const char *id = getenv("__AFL_SHM_FUZZ_ID");
+    if (!id) {
+        return LY_FUZZ_TESTCASE_CAP;
+    }
+    char *end;
+    long shm_id = strtol(id, &end, 10);
+    struct shmid_ds ds;
+    if (end == id || *end != '\0' || shmctl((int)shm_id, IPC_STAT, &ds) != 0 ||
+        ds.shm_segsz <= sizeof(uint32_t)) {
+        fprintf(stderr, "AFL testcase buffer size unknown, copying every testcase\n");
+        return 0;
+    }
+    return ds.shm_segsz - sizeof(uint32_t);
+}
+
+// NUL-terminate a testcase that lives in a buffer of cap bytes.  Returns the
+// text to parse: buf itself, or the staging copy if buf is full.
+static inline const char *ly_fuzz_terminate(uint8_t *buf, size_t len, size_t cap) {
+    if (len < cap) {
+        buf[len] = '\0';
+        return (const char *)buf;
+    }
+    if (len + 1 > ly_fuzz_staging_cap) {
+        char *grown = (char *)realloc(ly_fuzz_staging, len + 1);
+        if (!grown) return NULL;
+        ly_fuzz_staging = grown;
+        ly_fuzz_staging_cap = len + 1;
+    }
+    memcpy(ly_fuzz_staging, buf, len);
+    ly_fuzz_staging[len] = '\0';
+    return ly_fuzz_staging;
+}
+
+// The input handle shared by all execs of a driver
+static struct ly_in *ly_fuzz_in_handle = NULL;
+
+// Point the shared handle at NUL-terminated text, creating it on first use
+static inline struct ly_in *ly_fuzz_in(const char *text) {
+    if (!ly_fuzz_in_handle) {
+        if (ly_in_new_memory(text, &ly_fuzz_in_handle) != LY_SUCCESS) {
+            ly_fuzz_in_handle = NULL;
+        }
+        return ly_fuzz_in_handle;
+    }
+    ly_in_memory(ly_fuzz_in_handle, text);
+    return ly_fuzz_in_handle;
+}
+
+static inline void ly_fuzz_in_fini(void) {
+    ly_in_free(ly_fuzz_in_handle, 0);
+    ly_fuzz_in_handle = NULL;
+    free(ly_fuzz_staging);
+    ly_fuzz_staging = NULL;
+    ly_fuzz_staging_cap = 0;
+}
+
+#endif // LY_FUZZ_IN_H
@@ -0,0 +1,354 @@
+/*
+ * In-memory log capture for the libyang AFL drivers.
+ *
+ * The option headers let inputs turn on LY_LOLOG at any log level, and
+ * without a callback libyang prints every message to stderr, which costs a
+ * write per message.  ly_fuzz_log_init() installs a log callback
+ * (ly_set_log_clb) that copies each message into a fixed-size ring buffer
+ * instead, so the logging code is still fuzzed but no I/O happens.
+ *
+ * Per process the layer also counts messages by level together with the
+ * kind of path attached (data path, schema path only, none), and, once an
+ * exec has finished (ly_fuzz_log_end), the returned LY_ERR and every error
+ * libyang stored for the context (LY_LOSTORE) by LY_ERR, and by LY_VECODE
+ * together with its path kind.  The callback is not given the LY_VECODE, so
+ * the validation-stage counts come from stored errors only, i.e. from inputs
+ * whose header sets LY_LOSTORE or LY_LOSTORE_LAST.  Stored errors are cleaned
+ * after counting so they do not pile up in persistent mode.
+ *
+ * The ring and the counters are only written out when something goes wrong:
+ *
+ *  - on SIGSEGV, SIGBUS, SIGFPE, SIGILL and SIGABRT, before the previous
+ *    handler (e.g. ASan's) or the default action runs;
+ *  - from the sanitizer death callback, for reports that do not come from a
+ *    signal;
+ *  - when an exec takes longer than LY_FUZZ_LOG_TIMEOUT_MS milliseconds
+ *    (SIGALRM, set it a bit below afl-fuzz -t); the exec then goes on.
+ *
+ * The dump goes to stderr, or is appended to the file named by
+ * LY_FUZZ_LOG_DUMP (afl-fuzz discards the target's stderr).
+ */
+
+#ifndef LY_FUZZ_LOG_H
+#define LY_FUZZ_LOG_H
+
+#include <fcntl.h>
+#include <signal.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+#include "libyang.h"
+
+#ifndef LY_FUZZ_LOG_RING
+#define LY_FUZZ_LOG_RING (64 * 1024)
+#endif
+#define LY_FUZZ_LOG_MSG_MAX 512
+#define LY_FUZZ_LOG_CODES   16
+
+// libyang 2 passes a single path to the callback and calls the error code "no"
+#if LY_VERSION_MAJOR < 3
+#define LY_FUZZ_LOG_ERR(e) ((e)->no)
+#define LY_FUZZ_LOG_DATA_PATH(e) ((e)->path)
+#define LY_FUZZ_LOG_SCHEMA_PATH(e) ((const char *)NULL)
+#else
+#define LY_FUZZ_LOG_ERR(e) ((e)->err)
+#define LY_FUZZ_LOG_DATA_PATH(e) ((e)->data_path)
+#define LY_FUZZ_LOG_SCHEMA_PATH(e) ((e)->schema_path)
+#endif
+
+// Path kinds a message or stored error is counted under
+enum { LY_FUZZ_LOG_PATH_DATA, LY_FUZZ_LOG_PATH_SCHEMA, LY_FUZZ_LOG_PATH_NONE, LY_FUZZ_LOG_PATHS };
+
+typedef struct {
+    uint64_t execs;
+    uint64_t messages;
+    uint64_t level[4][LY_FUZZ_LOG_PATHS];   // messages per LY_LOG_LEVEL and path kind
+    uint64_t result[LY_FUZZ_LOG_CODES];     // exec results per LY_ERR
+    uint64_t err[LY_FUZZ_LOG_CODES];        // stored errors per LY_ERR
+    uint64_t vecode[LY_FUZZ_LOG_CODES][LY_FUZZ_LOG_PATHS];  // stored errors per LY_VECODE and path kind
+} ly_fuzz_log_stats;
+
+static char ly_fuzz_log_ring[LY_FUZZ_LOG_RING];
+static size_t ly_fuzz_log_pos = 0;
+static bool ly_fuzz_log_wrapped = false;
+static ly_fuzz_log_stats ly_fuzz_log_counts;
+static uint64_t ly_fuzz_log_marked = 0;     // last exec with a marker in the ring
+static size_t ly_fuzz_log_input_len = 0;
+static int ly_fuzz_log_fd = STDERR_FILENO;
+static long ly_fuzz_log_timeout_ms = 0;
+static volatile sig_atomic_t ly_fuzz_log_dumped = 0;
+
+static const int ly_fuzz_log_signals[] = {SIGSEGV, SIGBUS, SIGFPE, SIGILL, SIGABRT};
+static struct sigaction ly_fuzz_log_prev[sizeof(ly_fuzz_log_signals) / sizeof(int)];
+
+// LY_EPLUGIN and anything else out of range share the last slot
+static inline int ly_fuzz_log_slot(int code) {
+    return (code >= 0 && code < LY_FUZZ_LOG_CODES - 1) ? code : LY_FUZZ_LOG_CODES - 1;
+}
+
+// A data path wins over a schema path: it names the failing instance
+static inline int ly_fuzz_log_path_kind(const char *data_path, const char *schema_path) {
+    return data_path ? LY_FUZZ_LOG_PATH_DATA : schema_path ? LY_FUZZ_LOG_PATH_SCHEMA : LY_FUZZ_LOG_PATH_NONE;
+}
+
+static inline void ly_fuzz_log_put(const char *s, size_t n) {
+    while (n) {
+        size_t room = LY_FUZZ_LOG_RING - ly_fuzz_log_pos;
+        size_t chunk = n < room ? n : room;
+        memcpy(ly_fuzz_log_ring + ly_fuzz_log_pos, s, chunk);
+        ly_fuzz_log_pos += chunk;
+        s += chunk;
+        n -= chunk;
+        if (ly_fuzz_log_pos == LY_FUZZ_LOG_RING) {
+            ly_fuzz_log_pos = 0;
+            ly_fuzz_log_wrapped = true;
+        }
+    }
+}
+
+static inline void ly_fuzz_log_puts(const char *s) {
+    ly_fuzz_log_put(s, strlen(s));
+}
+
+// Decimal formatting without stdio, usable from a signal handler
+static inline size_t ly_fuzz_log_u64(char *out, uint64_t v) {
+    char tmp[20];
+    size_t n = 0;
+    do {
+        tmp[n++] = (char)('0' + v % 10);
+        v /= 10;
+    } while (v);
+    for (size_t i = 0; i < n; i++) {
+        out[i] = tmp[n - 1 - i];
+    }
+    return n;
+}
+
+static inline void ly_fuzz_log_put_u64(uint64_t v) {
+    char num[20];
+    ly_fuzz_log_put(num, ly_fuzz_log_u64(num, v));
+}
+
+static inline void ly_fuzz_log_message(LY_LOG_LEVEL level, const char *msg, const char *data_path,
+                                       const char *schema_path) {
+    static const char *const tags[4] = {"[ERR] ", "[WRN] ", "[VRB] ", "[DBG] "};
+    int lvl = (level >= 0 && level < 4) ? (int)level : 3;
+
+    ly_fuzz_log_counts.messages++;
+    ly_fuzz_log_counts.level[lvl][ly_fuzz_log_path_kind(data_path, schema_path)]++;
+
+    if (ly_fuzz_log_marked != ly_fuzz_log_counts.execs) {
+        ly_fuzz_log_marked = ly_fuzz_log_counts.execs;
+        ly_fuzz_log_puts("--- exec ");
+        ly_fuzz_log_put_u64(ly_fuzz_log_marked);
+        ly_fuzz_log_puts(" ---\n");
+    }
+    ly_fuzz_log_puts(tags[lvl]);
+    size_t len = msg ? strlen(msg) : 0;
+    ly_fuzz_log_put(msg ? msg : "", len < LY_FUZZ_LOG_MSG_MAX ? len : LY_FUZZ_LOG_MSG_MAX);
+    if (data_path) {
+        ly_fuzz_log_puts(" (data: ");
+        ly_fuzz_log_puts(data_path);
+        ly_fuzz_log_puts(")");
+    }
+    if (schema_path) {
+        ly_fuzz_log_puts(" (schema: ");
+        ly_fuzz_log_puts(schema_path);
+        ly_fuzz_log_puts(")");
+    }
+    ly_fuzz_log_puts("\n");
+}
+
+#if LY_VERSION_MAJOR < 3
+static inline void ly_fuzz_log_clb(LY_LOG_LEVEL level, const char *msg, const char *path) {
+    ly_fuzz_log_message(level, msg, path, NULL);
+}
+#else
+static inline void ly_fuzz_log_clb(LY_LOG_LEVEL level, const char *msg, const char *data_path,
+                                   const char *schema_path, uint64_t line) {
+    (void)line;
+    ly_fuzz_log_message(level, msg, data_path, schema_path);
+}
+#endif
+
+static inline void ly_fuzz_log_write(const char *s, size_t n) {
+    while (n) {
+        ssize_t w = write(ly_fuzz_log_fd, s, n);
+        if (w <= 0) return;
+        s += w;
+        n -= (size_t)w;
+    }
+}
+
+static inline void ly_fuzz_log_write_str(const char *s) {
+    ly_fuzz_log_write(s, strlen(s));
+}
+
+static inline void ly_fuzz_log_write_field(const char *name, uint64_t v) {
+    char num[20];
+    ly_fuzz_log_write_str(" ");
+    ly_fuzz_log_write_str(name);
+    ly_fuzz_log_write_str("=");
+    ly_fuzz_log_write(num, ly_fuzz_log_u64(num, v));
+}
+
+static const char *const ly_fuzz_log_path_names[LY_FUZZ_LOG_PATHS] = {"data", "schema", "none"};
+
+// One field per non-zero count, named prefix/path kind
+static inline void ly_fuzz_log_write_paths(const char *prefix, const uint64_t *counts) {
+    for (int k = 0; k < LY_FUZZ_LOG_PATHS; k++) {
+        if (counts[k]) {
+            char label[24];
+            size_t n = strlen(prefix);
+            memcpy(label, prefix, n);
+            label[n++] = '/';
+            size_t m = strlen(ly_fuzz_log_path_names[k]);
+            memcpy(label + n, ly_fuzz_log_path_names[k], m + 1);
+            ly_fuzz_log_write_field(label, counts[k]);
+        }
+    }
+}
+
+static inline void ly_fuzz_log_write_codes(const char *name, const uint64_t *counts) {
+    ly_fuzz_log_write_str(name);
+    for (int i = 0; i < LY_FUZZ_LOG_CODES; i++) {
+        if (counts[i]) {
+            char label[8];
+            size_t n = ly_fuzz_log_u64(label, (uint64_t)i);
+            label[n] = '\0';
+            ly_fuzz_log_write_field(label, counts[i]);
+        }
+    }
+    ly_fuzz_log_write_str("\n");
+}
+
+// Write the counters and the ring, oldest message first.  Async-signal-safe.
+static inline void ly_fuzz_log_dump(const char *reason) {
+    if (ly_fuzz_log_dumped) return;
+    ly_fuzz_log_dumped = 1;
+
+    const ly_fuzz_log_stats *c = &ly_fuzz_log_counts;
+    ly_fuzz_log_write_str("=== libyang log ring: ");
+    ly_fuzz_log_write_str(reason);
+    ly_fuzz_log_write_field("exec", c->execs);
+    ly_fuzz_log_write_field("input_len", ly_fuzz_log_input_len);
+    ly_fuzz_log_write_str(" ===\nmessages (level/path):");
+    ly_fuzz_log_write_field("total", c->messages);
+    ly_fuzz_log_write_paths("err", c->level[LY_LLERR]);
+    ly_fuzz_log_write_paths("wrn", c->level[LY_LLWRN]);
+    ly_fuzz_log_write_paths("vrb", c->level[LY_LLVRB]);
+    ly_fuzz_log_write_paths("dbg", c->level[LY_LLDBG]);
+    ly_fuzz_log_write_str("\n");
+    ly_fuzz_log_write_codes("results (LY_ERR):", c->result);
+    ly_fuzz_log_write_codes("stored errors (LY_ERR):", c->err);
+    ly_fuzz_log_write_str("stored errors (LY_VECODE/path):");
+    for (int i = 0; i < LY_FUZZ_LOG_CODES; i++) {
+        char code[8];
+        code[ly_fuzz_log_u64(code, (uint64_t)i)] = '\0';
+        ly_fuzz_log_write_paths(code, c->vecode[i]);
+    }
+    ly_fuzz_log_write_str("\n");
+    if (ly_fuzz_log_wrapped) {
+        ly_fuzz_log_write(ly_fuzz_log_ring + ly_fuzz_log_pos, LY_FUZZ_LOG_RING - ly_fuzz_log_pos);
+    }
+    ly_fuzz_log_write(ly_fuzz_log_ring, ly_fuzz_log_pos);
+    ly_fuzz_log_write_str("=== end of log ring ===\n");
+}
+
+static inline void ly_fuzz_log_on_signal(int sig, siginfo_t *info, void *uctx) {
+    (void)uctx;
+    if (sig == SIGALRM) {
+        ly_fuzz_log_dump("timeout");
+        return;
+    }
+    ly_fuzz_log_dump("crash");
+
+    // Hand the signal to whoever had it before: a fault re-executes and traps
+    // into the restored handler, anything sent with kill/raise is raised again
+    for (size_t i = 0; i < sizeof(ly_fuzz_log_signals) / sizeof(int); i++) {
+        if (ly_fuzz_log_signals[i] == sig) {
+            sigaction(sig, &ly_fuzz_log_prev[i], NULL);
+        }
+    }
+    if (!info || info->si_code <= 0) {
+        raise(sig);
+    }
+}
+
+static inline void ly_fuzz_log_on_death(void) {
+    ly_fuzz_log_dump("sanitizer");
+}
+
+void __sanitizer_set_death_callback(void (*callback)(void)) __attribute__((weak));
+
+// Install the callback and the dump handlers; call once, before __AFL_INIT()
+static inline void ly_fuzz_log_init(void) {
+    ly_set_log_clb(ly_fuzz_log_clb
+#if LY_VERSION_MAJOR < 3
+                   , 1
+#endif
+    );
+
+    const char *path = getenv("LY_FUZZ_LOG_DUMP");
+    if (path && *path) {
+        int fd = open(path, O_WRONLY | O_CREAT | O_APPEND, 0644);
+        if (fd >= 0) ly_fuzz_log_fd = fd;
+    }
+    const char *timeout = getenv("LY_FUZZ_LOG_TIMEOUT_MS");
+    ly_fuzz_log_timeout_ms = timeout ? atol(timeout) : 0;
+
+    struct sigaction sa;
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_sigaction = ly_fuzz_log_on_signal;
+    sa.sa_flags = SA_SIGINFO | SA_NODEFER;
+    sigemptyset(&sa.sa_mask);
+    for (size_t i = 0; i < sizeof(ly_fuzz_log_signals) / sizeof(int); i++) {
+        sigaction(ly_fuzz_log_signals[i], &sa, &ly_fuzz_log_prev[i]);
+    }
+    if (ly_fuzz_log_timeout_ms > 0) {
+        sigaction(SIGALRM, &sa, NULL);
+    }
+    if (__sanitizer_set_death_callback) {
+        __sanitizer_set_death_callback(ly_fuzz_log_on_death);
+    }
+}
+
+static inline void ly_fuzz_log_arm(long ms) {
+    struct itimerval it;
+    memset(&it, 0, sizeof(it));
+    it.it_value.tv_sec = ms / 1000;
+    it.it_value.tv_usec = (ms % 1000) * 1000;
+    setitimer(ITIMER_REAL, &it, NULL);
+}
+
+// Start of one exec on an input of len bytes
+static inline void ly_fuzz_log_begin(size_t len) {
+    ly_fuzz_log_counts.execs++;
+    ly_fuzz_log_input_len = len;
+    ly_fuzz_log_dumped = 0;
+    if (ly_fuzz_log_timeout_ms > 0) {
+        ly_fuzz_log_arm(ly_fuzz_log_timeout_ms);
+    }
+}
+
+// End of the exec: count its result and the errors stored for ctx, then clean them
+static inline void ly_fuzz_log_end(const struct ly_ctx *ctx, LY_ERR ret) {
+    if (ly_fuzz_log_timeout_ms > 0) {
+        ly_fuzz_log_arm(0);
+    }
+    ly_fuzz_log_counts.result[ly_fuzz_log_slot(ret)]++;
+    if (!ctx) return;
+    for (const struct ly_err_item *e = ly_err_first(ctx); e; e = e->next) {
+        ly_fuzz_log_counts.err[ly_fuzz_log_slot(LY_FUZZ_LOG_ERR(e))]++;
+        int kind = ly_fuzz_log_path_kind(LY_FUZZ_LOG_DATA_PATH(e), LY_FUZZ_LOG_SCHEMA_PATH(e));
+        ly_fuzz_log_counts.vecode[ly_fuzz_log_slot(e->vecode)][kind]++;
+    }
+    ly_err_clean((struct ly_ctx *)ctx, NULL);
+}
+
+#endif // LY_FUZZ_LOG_H
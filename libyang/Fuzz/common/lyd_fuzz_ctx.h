@@ -0,0 +1,164 @@
+/*
+ * Cached schema contexts for the lyd_parse_mem AFL drivers.
+ *
+ * Both drivers parse data against the same two modules: "defs" (identities)
+ * and "types" (identities, leafrefs, instance-identifiers, unions, patterns,
+ * ranges).  Compiling them costs far more than parsing a small data
+ * instance, so the contexts are built once, before the fork point or the
+ * persistent loop, and every exec only parses and validates data.
+ *
+ * The only context options the drivers vary are LY_CTX_NO_YANGLIBRARY and
+ * LY_CTX_DISABLE_SEARCHDIRS, which gives LYD_FUZZ_CTX_VARIANTS contexts.
+ * lyd_fuzz_ctx_get() maps any option word onto one of them.  A data tree
+ * parsed in a cached context must be freed with lyd_free_all() before the
+ * next exec; the context itself is never destroyed until exit.
+ *
+ * Built with -DLYD_FUZZ_PRINTED_CTX, lyd_fuzz_ctx_init() first tries to map
+ * the printed-context blob named by LYD_FUZZ_CTX_BLOB (default
+ * LYD_FUZZ_CTX_BLOB_PATH, see lyd_fuzz_printed.h) and only compiles the
+ * schemas when that fails.  Set LYD_FUZZ_CTX_LOG to print which path was
+ * taken and how long it took.
+ */
+
+#ifndef LYD_FUZZ_CTX_H
+#define LYD_FUZZ_CTX_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "libyang.h"
+
+#define LYD_FUZZ_CTX_OPTIONS (LY_CTX_NO_YANGLIBRARY | LY_CTX_DISABLE_SEARCHDIRS)
+#define LYD_FUZZ_CTX_VARIANTS 4
+
+static const char lyd_fuzz_schema_defs[] =
+    "module defs {namespace urn:tests:defs;prefix d;yang-version 1.1;"
+    "identity crypto-alg; identity interface-type; identity ethernet {base interface-type;}"
+    "identity fast-ethernet {base ethernet;}}";
+
+static const char lyd_fuzz_schema_types[] =
+    "module types {namespace urn:tests:types;prefix t;yang-version 1.1; import defs {prefix defs;}"
+    "feature f; identity gigabit-ethernet { base defs:ethernet;}"
+    "container cont {leaf leaftarget {type empty;}"
+    "list listtarget {key id; max-elements 5;leaf id {type uint8;} leaf value {type string;}}"
+    "leaf-list leaflisttarget {type uint8; max-elements 5;}}"
+    "list list {key id; leaf id {type string;} leaf value {type string;} leaf-list targets {type string;}}"
+    "list list2 {key \"id value\"; leaf id {type string;} leaf value {type string;}}"
+    "list list_inst {key id; leaf id {type instance-identifier {require-instance true;}} leaf value {type string;}}"
+    "list list_ident {key id; leaf id {type identityref {base defs:interface-type;}} leaf value {type string;}}"
+    "leaf-list leaflisttarget {type string;}"
+    "leaf binary {type binary {length 5 {error-message \"This base64 value must be of length 5.\";}}}"
+    "leaf binary-norestr {type binary;}"
+    "leaf int8 {type int8 {range 10..20;}}"
+    "leaf uint8 {type uint8 {range 150..200;}}"
+    "leaf int16 {type int16 {range -20..-10;}}"
+    "leaf uint16 {type uint16 {range 150..200;}}"
+    "leaf int32 {type int32;}"
+    "leaf uint32 {type uint32;}"
+    "leaf int64 {type int64;}"
+    "leaf uint64 {type uint64;}"
+    "leaf bits {type bits {bit zero; bit one {if-feature f;} bit two;}}"
+    "leaf enums {type enumeration {enum white; enum yellow {if-feature f;}}}"
+    "leaf dec64 {type decimal64 {fraction-digits 1; range 1.5..10;}}"
+    "leaf dec64-norestr {type decimal64 {fraction-digits 18;}}"
+    "leaf str {type string {length 8..10; pattern '[a-z ]*';}}"
+    "leaf str-norestr {type string;}"
+    "leaf str-utf8 {type string{length 2..5; pattern '€*';}}"
+    "leaf bool {type boolean;}"
+    "leaf empty {type empty;}"
+    "leaf ident {type identityref {base defs:interface-type;}}"
+    "leaf inst {type instance-identifier {require-instance true;}}"
+    "leaf inst-noreq {type instance-identifier {require-instance false;}}"
+    "leaf lref {type leafref {path /leaflisttarget; require-instance true;}}"
+    "leaf lref2 {type leafref {path \"../list[id = current()/../str-norestr]/targets\"; require-instance true;}}"
+    "leaf un1 {type union {"
+    "type leafref {path /int8; require-instance true;}"
+    "type union { type identityref {base defs:interface-type;} type instance-identifier {require-instance true;} }"
+    "type string {length 1..20;}}}}";
+
+static struct ly_ctx *lyd_fuzz_ctx_cache[LYD_FUZZ_CTX_VARIANTS];
+
+// Context options of variant i: bit 0 no yang-library, bit 1 no search dirs.
+static inline uint32_t lyd_fuzz_ctx_variant_options(int variant) {
+    uint32_t options = 0;
+    if (variant & 1) options |= LY_CTX_NO_YANGLIBRARY;
+    if (variant & 2) options |= LY_CTX_DISABLE_SEARCHDIRS;
+    return options;
+}
+
+static inline int lyd_fuzz_ctx_variant(uint32_t ctx_options) {
+    return ((ctx_options & LY_CTX_NO_YANGLIBRARY) ? 1 : 0) |
+           ((ctx_options & LY_CTX_DISABLE_SEARCHDIRS) ? 2 : 0);
+}
+
+// Creates a context with both modules; NULL if either fails to compile.
+static inline struct ly_ctx *lyd_fuzz_ctx_build(uint32_t ctx_options) {
+    struct ly_ctx *ctx = NULL;
+    if (ly_ctx_new(NULL, ctx_options, &ctx) != LY_SUCCESS) {
+        return NULL;
+    }
+    if (lys_parse_mem(ctx, lyd_fuzz_schema_defs, LYS_IN_YANG, NULL) != LY_SUCCESS ||
+        lys_parse_mem(ctx, lyd_fuzz_schema_types, LYS_IN_YANG, NULL) != LY_SUCCESS) {
+        ly_ctx_destroy(ctx);
+        return NULL;
+    }
+    return ctx;
+}
+
+#ifdef LYD_FUZZ_PRINTED_CTX
+#ifndef LYD_FUZZ_CTX_BLOB_PATH
+#define LYD_FUZZ_CTX_BLOB_PATH "lyd_fuzz_ctx.blob"
+#endif
+static inline int lyd_fuzz_printed_load(const char *path);
+#endif
+
+static inline uint64_t lyd_fuzz_now_us(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+// Builds every variant. Call once, before __AFL_INIT / the persistent loop.
+static inline int lyd_fuzz_ctx_init(void) {
+    uint64_t start = lyd_fuzz_now_us();
+    const char *how = "source";
+#ifdef LYD_FUZZ_PRINTED_CTX
+    const char *blob = getenv("LYD_FUZZ_CTX_BLOB");
+    if (lyd_fuzz_printed_load(blob ? blob : LYD_FUZZ_CTX_BLOB_PATH) == 0) {
+        how = "printed";
+    }
+#endif
+    for (int i = 0; i < LYD_FUZZ_CTX_VARIANTS; i++) {
+        if (lyd_fuzz_ctx_cache[i]) continue;
+        lyd_fuzz_ctx_cache[i] = lyd_fuzz_ctx_build(lyd_fuzz_ctx_variant_options(i));
+        if (!lyd_fuzz_ctx_cache[i]) {
+            fprintf(stderr, "Failed to build schema context variant %d\n", i);
+            return -1;
+        }
+    }
+    if (getenv("LYD_FUZZ_CTX_LOG")) {
+        fprintf(stderr, "lyd ctx: %d contexts from %s in %llu us\n", LYD_FUZZ_CTX_VARIANTS,
+                how, (unsigned long long)(lyd_fuzz_now_us() - start));
+    }
+    return 0;
+}
+
+// Cached context for the given option word (only LYD_FUZZ_CTX_OPTIONS count).
+static inline const struct ly_ctx *lyd_fuzz_ctx_get(uint32_t ctx_options) {
+    return lyd_fuzz_ctx_cache[lyd_fuzz_ctx_variant(ctx_options)];
+}
+
+static inline void lyd_fuzz_ctx_fini(void) {
+    for (int i = 0; i < LYD_FUZZ_CTX_VARIANTS; i++) {
+        ly_ctx_destroy(lyd_fuzz_ctx_cache[i]);
+        lyd_fuzz_ctx_cache[i] = NULL;
+    }
+}
+
+#ifdef LYD_FUZZ_PRINTED_CTX
+#include "lyd_fuzz_printed.h"
+#endif
+
+#endif /* LYD_FUZZ_CTX_H */
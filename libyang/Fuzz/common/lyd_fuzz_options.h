@@ -0,0 +1,177 @@
+/*
+ * Option header for the lyd_parse_mem AFL drivers.
+ *
+ * The input is a fixed-size header followed by the data payload; option
+ * bytes are never part of the parsed data.  Every header value maps onto
+ * arguments lyd_parse_data_mem accepts:
+ *
+ *   offset  size  field
+ *   0       4     magic "LYDF"
+ *   4       1     layout version (LYD_FUZZ_OPTIONS_VERSION)
+ *   5       1     bits 0-1: context variant (lyd_fuzz_ctx.h)
+ *                 bits 2-4: ly_log_options (LY_LOLOG, LY_LOSTORE, LY_LOSTORE_LAST)
+ *   6       1     format, value % 3: 0 the driver's native format, 1 the
+ *                 other text format, 2 LYB
+ *   7       2     LYD_PARSE_* flags (LE), one bit per lyd_fuzz_parse_flags[]
+ *   9       1     LYD_VALIDATE_* flags, one bit per lyd_fuzz_validate_flags[]
+ *   10      2     reserved
+ *   12      ...   data
+ *
+ * Flags missing from the libyang being built against map to 0, and the
+ * validate flags are cleared when LYD_PARSE_ONLY is set, since libyang
+ * rejects that combination.
+ */
+
+#ifndef LYD_FUZZ_OPTIONS_H
+#define LYD_FUZZ_OPTIONS_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "libyang.h"
+#include "lyd_fuzz_ctx.h"
+
+#define LYD_FUZZ_OPTIONS_MAGIC   "LYDF"
+#define LYD_FUZZ_OPTIONS_VERSION 1
+#define LYD_FUZZ_OPTIONS_SIZE    12
+
+#ifndef LYD_PARSE_ORDERED
+#define LYD_PARSE_ORDERED 0
+#endif
+#ifndef LYD_PARSE_WHEN_TRUE
+#define LYD_PARSE_WHEN_TRUE 0
+#endif
+#ifndef LYD_PARSE_NO_NEW
+#define LYD_PARSE_NO_NEW 0
+#endif
+#ifndef LYD_PARSE_STORE_ONLY
+#define LYD_PARSE_STORE_ONLY 0
+#endif
+#ifndef LYD_PARSE_JSON_NULL
+#define LYD_PARSE_JSON_NULL 0
+#endif
+#ifndef LYD_PARSE_JSON_STRING_DATATYPES
+#define LYD_PARSE_JSON_STRING_DATATYPES 0
+#endif
+#ifndef LYD_VALIDATE_MULTI_ERROR
+#define LYD_VALIDATE_MULTI_ERROR 0
+#endif
+#ifndef LYD_VALIDATE_OPERATIONAL
+#define LYD_VALIDATE_OPERATIONAL 0
+#endif
+#ifndef LYD_VALIDATE_NO_DEFAULTS
+#define LYD_VALIDATE_NO_DEFAULTS 0
+#endif
+
+// Header bit i of the parse flags selects lyd_fuzz_parse_flags[i].
+// LYD_PARSE_SUBTREE is left out: it needs a parent node.
+static const uint32_t lyd_fuzz_parse_flags[16] = {
+    LYD_PARSE_ONLY,
+    LYD_PARSE_STRICT,
+    LYD_PARSE_OPAQ,
+    LYD_PARSE_NO_STATE,
+    LYD_PARSE_LYB_MOD_UPDATE,
+    LYD_PARSE_ORDERED,
+    LYD_PARSE_WHEN_TRUE,
+    LYD_PARSE_NO_NEW,
+    LYD_PARSE_STORE_ONLY,
+    LYD_PARSE_JSON_NULL,
+    LYD_PARSE_JSON_STRING_DATATYPES,
+};
+
+// Header bit i of the validate flags selects lyd_fuzz_validate_flags[i].
+static const uint32_t lyd_fuzz_validate_flags[8] = {
+    LYD_VALIDATE_NO_STATE,
+    LYD_VALIDATE_PRESENT,
+    LYD_VALIDATE_MULTI_ERROR,
+    LYD_VALIDATE_OPERATIONAL,
+    LYD_VALIDATE_NO_DEFAULTS,
+};
+
+typedef struct {
+    uint32_t ctx_options;       // LY_CTX_* mask selecting the cached context
+    uint32_t log_options;       // LY_LO* mask
+    LYD_FORMAT format;
+    uint32_t parse_options;     // LYD_PARSE_* mask
+    uint32_t validate_options;  // LYD_VALIDATE_* mask
+} lyd_fuzz_options;
+
+static inline bool lyd_fuzz_has_options(const uint8_t *buf, size_t len) {
+    return len >= LYD_FUZZ_OPTIONS_SIZE &&
+           memcmp(buf, LYD_FUZZ_OPTIONS_MAGIC, 4) == 0 &&
+           buf[4] == LYD_FUZZ_OPTIONS_VERSION;
+}
+
+// Decodes the header for a driver whose native format is native (LYD_JSON
+// or LYD_XML). Returns false if buf does not start with a header of the
+// supported version.
+static inline bool lyd_fuzz_parse_options(const uint8_t *buf, size_t len, LYD_FORMAT native,
+                                          lyd_fuzz_options *opts) {
+    if (!lyd_fuzz_has_options(buf, len)) {
+        return false;
+    }
+    opts->ctx_options = lyd_fuzz_ctx_variant_options(buf[5] & 0x3);
+
+    opts->log_options = 0;
+    if (buf[5] & 0x04) opts->log_options |= LY_LOLOG;
+    if (buf[5] & 0x08) opts->log_options |= LY_LOSTORE;
+    if (buf[5] & 0x10) opts->log_options |= LY_LOSTORE_LAST;
+
+    switch (buf[6] % 3) {
+    case 0: opts->format = native; break;
+    case 1: opts->format = native == LYD_JSON ? LYD_XML : LYD_JSON; break;
+    default: opts->format = LYD_LYB; break;
+    }
+
+    uint32_t bits = buf[7] | ((uint32_t)buf[8] << 8);
+    opts->parse_options = 0;
+    for (int i = 0; i < 16; i++) {
+        if (bits & (1u << i)) opts->parse_options |= lyd_fuzz_parse_flags[i];
+    }
+    opts->validate_options = 0;
+    for (int i = 0; i < 8; i++) {
+        if (buf[9] & (1u << i)) opts->validate_options |= lyd_fuzz_validate_flags[i];
+    }
+    if (opts->parse_options & LYD_PARSE_ONLY) {
+        opts->validate_options = 0;
+    }
+    return true;
+}
+
+// Writes a header selecting variant 0, the native format, no parse flags
+// and LYD_VALIDATE_PRESENT.
+static inline void lyd_fuzz_default_header(uint8_t *out) {
+    memset(out, 0, LYD_FUZZ_OPTIONS_SIZE);
+    memcpy(out, LYD_FUZZ_OPTIONS_MAGIC, 4);
+    out[4] = LYD_FUZZ_OPTIONS_VERSION;
+    out[9] = 0x02;
+}
+
+// Writes the normalised form of a header that passes lyd_fuzz_has_options()
+// to key (LYD_FUZZ_OPTIONS_SIZE bytes): bits that select nothing on this
+// libyang are cleared, so headers that decode to the same options get the
+// same key, and the key itself is a valid header.
+static inline void lyd_fuzz_options_key(const uint8_t *hdr, uint8_t *key) {
+    memset(key, 0, LYD_FUZZ_OPTIONS_SIZE);
+    memcpy(key, hdr, 5);
+    key[5] = hdr[5] & 0x1f;
+    key[6] = hdr[6] % 3;
+
+    uint32_t bits = hdr[7] | ((uint32_t)hdr[8] << 8);
+    uint32_t parse_options = 0;
+    for (int i = 0; i < 16; i++) {
+        if ((bits & (1u << i)) && lyd_fuzz_parse_flags[i]) {
+            key[7 + i / 8] |= (uint8_t)(1u << (i % 8));
+            parse_options |= lyd_fuzz_parse_flags[i];
+        }
+    }
+    if (!(parse_options & LYD_PARSE_ONLY)) {
+        for (int i = 0; i < 8; i++) {
+            if ((hdr[9] & (1u << i)) && lyd_fuzz_validate_flags[i]) key[9] |= (uint8_t)(1u << i);
+        }
+    }
+}
+
+#endif /* LYD_FUZZ_OPTIONS_H */
@@ -0,0 +1,206 @@
+/*
+ * Printed-context blob for the lyd_parse_mem AFL drivers.
+ *
+ * libyang can serialise a compiled context into one flat memory block
+ * (ly_ctx_compiled_print) and use such a block directly as a context
+ * (ly_ctx_new_printed), without parsing or compiling any schema.  The block
+ * holds absolute pointers, so it is only usable at the address it was
+ * printed at.
+ *
+ * lyd_ctx_print (../lyd_ctx_print.c) compiles every context variant of
+ * lyd_fuzz_ctx.h, prints them into a region at a fixed base address and
+ * writes the region to a file.  lyd_fuzz_printed_load() maps that file back
+ * at the same address (MAP_FIXED_NOREPLACE, so nothing already mapped there
+ * is clobbered) and instantiates one context per variant.
+ *
+ * The file starts with a page-sized header:
+ *
+ *   magic "LYDFCTX1", format version, variant count, base address,
+ *   mapping size, stamp, then per variant: ctx options, offset, size
+ *
+ * The stamp hashes the schema sources, the variant options, LY_VERSION and
+ * the pointer size.  Any mismatch (or a missing file, or an occupied base
+ * address) makes the loader fail, and the caller compiles from source.
+ *
+ * Requires a libyang with the printed-context API; the drivers only use
+ * this code when built with -DLYD_FUZZ_PRINTED_CTX.
+ */
+
+#ifndef LYD_FUZZ_PRINTED_H
+#define LYD_FUZZ_PRINTED_H
+
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include "libyang.h"
+#include "lyd_fuzz_ctx.h"
+
+#define LYD_FUZZ_PRINTED_MAGIC   "LYDFCTX1"
+#define LYD_FUZZ_PRINTED_FORMAT  1
+#define LYD_FUZZ_PRINTED_HDR     4096
+#define LYD_FUZZ_PRINTED_BASE    0x7e8000000000ULL
+
+typedef struct {
+    char     magic[8];
+    uint32_t format;
+    uint32_t variants;
+    uint64_t base;
+    uint64_t map_size;
+    uint64_t stamp;
+    struct {
+        uint32_t ctx_options;
+        uint32_t reserved;
+        uint64_t offset;
+        uint64_t size;
+    } entry[LYD_FUZZ_CTX_VARIANTS];
+} lyd_fuzz_printed_hdr;
+
+static inline uint64_t lyd_fuzz_fnv(uint64_t h, const void *p, size_t n) {
+    const uint8_t *b = (const uint8_t *)p;
+    for (size_t i = 0; i < n; i++) {
+        h = (h ^ b[i]) * 0x100000001b3ULL;
+    }
+    return h;
+}
+
+// Identifies what a blob was printed from; a blob with another stamp is stale.
+static inline uint64_t lyd_fuzz_printed_stamp(void) {
+    uint64_t h = 0xcbf29ce484222325ULL;
+    h = lyd_fuzz_fnv(h, lyd_fuzz_schema_defs, sizeof(lyd_fuzz_schema_defs));
+    h = lyd_fuzz_fnv(h, lyd_fuzz_schema_types, sizeof(lyd_fuzz_schema_types));
+    h = lyd_fuzz_fnv(h, LY_VERSION, sizeof(LY_VERSION));
+    for (int i = 0; i < LYD_FUZZ_CTX_VARIANTS; i++) {
+        uint32_t options = lyd_fuzz_ctx_variant_options(i);
+        h = lyd_fuzz_fnv(h, &options, sizeof(options));
+    }
+    uint32_t ptr_size = sizeof(void *);
+    return lyd_fuzz_fnv(h, &ptr_size, sizeof(ptr_size));
+}
+
+static inline size_t lyd_fuzz_page_align(size_t n) {
+    size_t page = (size_t)sysconf(_SC_PAGESIZE);
+    return (n + page - 1) & ~(page - 1);
+}
+
+// Maps len bytes of fd (or anonymous memory if fd < 0) exactly at base.
+static inline void *lyd_fuzz_map_at(uint64_t base, size_t len, int fd) {
+    int flags = fd < 0 ? MAP_PRIVATE | MAP_ANONYMOUS : MAP_PRIVATE;
+#ifdef MAP_FIXED_NOREPLACE
+    flags |= MAP_FIXED_NOREPLACE;
+#endif
+    void *p = mmap((void *)(uintptr_t)base, len, PROT_READ | PROT_WRITE, flags, fd, 0);
+    if (p == MAP_FAILED) {
+        return NULL;
+    }
+    if (p != (void *)(uintptr_t)base) {
+        // Old kernels treat the address as a hint only.
+        munmap(p, len);
+        return NULL;
+    }
+    return p;
+}
+
+// Loads every variant from the blob at path into lyd_fuzz_ctx_cache.
+// Returns 0 on success; on failure nothing is left mapped or cached.
+static inline int lyd_fuzz_printed_load(const char *path) {
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        return -1;
+    }
+    lyd_fuzz_printed_hdr hdr;
+    if (pread(fd, &hdr, sizeof(hdr), 0) != (ssize_t)sizeof(hdr) ||
+        memcmp(hdr.magic, LYD_FUZZ_PRINTED_MAGIC, sizeof(hdr.magic)) != 0 ||
+        hdr.format != LYD_FUZZ_PRINTED_FORMAT ||
+        hdr.variants != LYD_FUZZ_CTX_VARIANTS ||
+        hdr.stamp != lyd_fuzz_printed_stamp() ||
+        (off_t)hdr.map_size != lseek(fd, 0, SEEK_END)) {
+        close(fd);
+        return -1;
+    }
+    uint8_t *map = (uint8_t *)lyd_fuzz_map_at(hdr.base, hdr.map_size, fd);
+    close(fd);
+    if (!map) {
+        return -1;
+    }
+
+    for (int i = 0; i < LYD_FUZZ_CTX_VARIANTS; i++) {
+        struct ly_ctx *ctx = NULL;
+        if (hdr.entry[i].ctx_options != lyd_fuzz_ctx_variant_options(i) ||
+            hdr.entry[i].offset + hdr.entry[i].size > hdr.map_size ||
+            ly_ctx_new_printed(map + hdr.entry[i].offset, &ctx) != LY_SUCCESS) {
+            for (int j = 0; j < i; j++) {
+                ly_ctx_destroy(lyd_fuzz_ctx_cache[j]);
+                lyd_fuzz_ctx_cache[j] = NULL;
+            }
+            munmap(map, hdr.map_size);
+            return -1;
+        }
+        lyd_fuzz_ctx_cache[i] = ctx;
+    }
+    // The mapping stays for the life of the process.
+    return 0;
+}
+
+// Compiles every variant and writes the blob for base address base.
+static inline int lyd_fuzz_printed_write(const char *path, uint64_t base) {
+    struct ly_ctx *ctx[LYD_FUZZ_CTX_VARIANTS] = {NULL};
+    lyd_fuzz_printed_hdr hdr;
+    memset(&hdr, 0, sizeof(hdr));
+    memcpy(hdr.magic, LYD_FUZZ_PRINTED_MAGIC, sizeof(hdr.magic));
+    hdr.format = LYD_FUZZ_PRINTED_FORMAT;
+    hdr.variants = LYD_FUZZ_CTX_VARIANTS;
+    hdr.base = base;
+    hdr.stamp = lyd_fuzz_printed_stamp();
+
+    int ret = -1;
+    size_t offset = LYD_FUZZ_PRINTED_HDR;
+    for (int i = 0; i < LYD_FUZZ_CTX_VARIANTS; i++) {
+        ctx[i] = lyd_fuzz_ctx_build(lyd_fuzz_ctx_variant_options(i));
+        int size = ctx[i] ? ly_ctx_compiled_size(ctx[i]) : -1;
+        if (size <= 0) {
+            fprintf(stderr, "Failed to compile context variant %d\n", i);
+            goto cleanup;
+        }
+        hdr.entry[i].ctx_options = lyd_fuzz_ctx_variant_options(i);
+        hdr.entry[i].offset = offset;
+        hdr.entry[i].size = (uint64_t)size;
+        offset += lyd_fuzz_page_align((size_t)size);
+    }
+    hdr.map_size = offset;
+
+    uint8_t *map = (uint8_t *)lyd_fuzz_map_at(base, hdr.map_size, -1);
+    if (!map) {
+        fprintf(stderr, "Base address 0x%llx is not available\n", (unsigned long long)base);
+        goto cleanup;
+    }
+    memcpy(map, &hdr, sizeof(hdr));
+    for (int i = 0; i < LYD_FUZZ_CTX_VARIANTS && ret != -2; i++) {
+        void *end = NULL;
+        if (ly_ctx_compiled_print(ctx[i], map + hdr.entry[i].offset, &end) != LY_SUCCESS) {
+            fprintf(stderr, "Failed to print context variant %d\n", i);
+            ret = -2;
+        }
+    }
+    if (ret != -2) {
+        FILE *file = fopen(path, "wb");
+        if (file && fwrite(map, 1, hdr.map_size, file) == hdr.map_size) {
+            ret = 0;
+        } else {
+            perror(path);
+        }
+        if (file) fclose(file);
+    }
+    munmap(map, hdr.map_size);
+
+cleanup:
+    for (int i = 0; i < LYD_FUZZ_CTX_VARIANTS; i++) {
+        ly_ctx_destroy(ctx[i]);
+    }
+    return ret == 0 ? 0 : -1;
+}
+
+#endif /* LYD_FUZZ_PRINTED_H */
@@ -0,0 +1,1216 @@
+/*
+ * Schema-driven instance-data generator for the lyd_parse_mem drivers.
+ *
+ * The "types" module of lyd_fuzz_ctx.h constrains almost every leaf (ranges,
+ * lengths, patterns, identityrefs, leafrefs and instance-identifiers with
+ * require-instance), so random bytes rarely get past type checking.  This
+ * generator walks the compiled schema with lys_getnext() and builds data
+ * trees whose values are picked from each leaf's compiled type:
+ *
+ *   - numbers and decimal64 from the range parts, favouring the bounds
+ *   - strings and binary from the length parts; a pattern is approximated by
+ *     the characters its expression admits (bracket classes and literals)
+ *   - enums, bits and identityrefs (derived identities only) by name
+ *   - leafrefs from existing instances of lysc_node_lref_target(), and
+ *     instance-identifiers as paths to existing nodes, both filled in after
+ *     the rest of the tree exists so the references resolve
+ *
+ * In near-valid mode each decision is, with probability near_pct, pushed just
+ * past a constraint: a bound +-1, a length +-1, a character outside the
+ * pattern, an unknown enum/bit, a base identity, a dangling reference, a
+ * duplicate key or one entry over max-elements.
+ *
+ * Trees are printed as JSON (RFC 7951) or XML by this header, and existing
+ * inputs are read back with lyd_parse_data_mem(LYD_PARSE_ONLY |
+ * LYD_PARSE_OPAQ), so values that fail type checking survive as opaque nodes.
+ * lyd_gen_mutate() then mutates at node level (add, delete, duplicate,
+ * splice) and value level (regenerate, re-resolve references, JSON encoding
+ * flips).  Used by ../lyd_seeds_gen.c and ../mutators/lyd_gen_mutator.c.
+ */
+
+#ifndef LYD_GEN_H
+#define LYD_GEN_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "libyang.h"
+
+#define LYD_GEN_MAX_SNODES   128
+#define LYD_GEN_MAX_MODULES  8
+#define LYD_GEN_MAX_ENTRIES  3     // list / leaf-list entries per parent in valid mode
+#define LYD_GEN_MAX_NODES    4096  // nodes considered by one mutation
+
+// Schema node of the generator model (data nodes only, choices are transparent).
+typedef struct lyd_gen_snode {
+    const struct lysc_node *node;
+    struct lyd_gen_snode *parent, *child, *next;
+} lyd_gen_snode;
+
+// Instance node. The root of every tree is a dummy node with snode NULL.
+typedef struct lyd_gen_node {
+    const lyd_gen_snode *snode;
+    char *value;            // term nodes: JSON lexical form ("mod:ident", "/mod:a/b")
+    LY_DATA_TYPE vtype;     // type the value was made for (a union member), 0 if unknown
+    bool flip;              // JSON only: print a number quoted or a string bare
+    struct lyd_gen_node *parent, *child, *next;
+} lyd_gen_node;
+
+typedef struct {
+    const char *name, *prefix, *ns;
+} lyd_gen_module;
+
+typedef struct {
+    uint64_t rng;
+    int near_pct;           // chance of a near-valid decision, 0 for valid trees
+    lyd_gen_snode snode[LYD_GEN_MAX_SNODES];
+    int snode_count;
+    lyd_gen_snode *top;
+    lyd_gen_module module[LYD_GEN_MAX_MODULES];
+    int module_count;
+} lyd_gen;
+
+typedef struct {
+    char *data;
+    size_t len, cap;
+} lyd_gen_buf;
+
+static inline void lyd_gen_put(lyd_gen_buf *b, const char *s, size_t n) {
+    if (b->len + n + 1 > b->cap) {
+        size_t cap = b->cap ? b->cap : 256;
+        while (b->len + n + 1 > cap) cap *= 2;
+        char *grown = (char *)realloc(b->data, cap);
+        if (!grown) return;
+        b->data = grown;
+        b->cap = cap;
+    }
+    memcpy(b->data + b->len, s, n);
+    b->len += n;
+    b->data[b->len] = '\0';
+}
+
+static inline void lyd_gen_puts(lyd_gen_buf *b, const char *s) {
+    lyd_gen_put(b, s, strlen(s));
+}
+
+static inline void lyd_gen_printf(lyd_gen_buf *b, const char *fmt, unsigned long long v, bool neg) {
+    char tmp[32];
+    snprintf(tmp, sizeof(tmp), fmt, neg ? "-" : "", v);
+    lyd_gen_puts(b, tmp);
+}
+
+// Takes ownership of the buffer contents.
+static inline char *lyd_gen_take(lyd_gen_buf *b) {
+    char *s = b->data ? b->data : strdup("");
+    b->data = NULL;
+    b->len = b->cap = 0;
+    return s;
+}
+
+static inline uint64_t lyd_gen_rand64(lyd_gen *g) {
+    g->rng ^= g->rng << 13;
+    g->rng ^= g->rng >> 7;
+    g->rng ^= g->rng << 17;
+    return g->rng;
+}
+
+static inline uint32_t lyd_gen_below(lyd_gen *g, uint32_t n) {
+    return n ? (uint32_t)(lyd_gen_rand64(g) >> 32) % n : 0;
+}
+
+static inline bool lyd_gen_near(lyd_gen *g) {
+    return g->near_pct > 0 && (int)lyd_gen_below(g, 100) < g->near_pct;
+}
+
+/* ---- schema model ---- */
+
+static inline void lyd_gen_add_module(lyd_gen *g, const struct lys_module *mod) {
+    for (int i = 0; i < g->module_count; i++) {
+        if (!strcmp(g->module[i].name, mod->name)) return;
+    }
+    if (g->module_count < LYD_GEN_MAX_MODULES) {
+        lyd_gen_module *m = &g->module[g->module_count++];
+        m->name = mod->name;
+        m->prefix = mod->prefix;
+        m->ns = mod->ns;
+    }
+}
+
+static inline const lyd_gen_module *lyd_gen_find_module(const lyd_gen *g, const char *name, size_t len) {
+    for (int i = 0; i < g->module_count; i++) {
+        if (strlen(g->module[i].name) == len && !memcmp(g->module[i].name, name, len)) {
+            return &g->module[i];
+        }
+    }
+    return NULL;
+}
+
+static inline void lyd_gen_add_ident_modules(lyd_gen *g, struct lysc_ident **idents, int depth) {
+    for (LY_ARRAY_COUNT_TYPE i = 0; i < LY_ARRAY_COUNT(idents) && depth < 8; i++) {
+        lyd_gen_add_module(g, idents[i]->module);
+        lyd_gen_add_ident_modules(g, idents[i]->derived, depth + 1);
+    }
+}
+
+// Identity values name other modules; XML needs their namespaces.
+static inline void lyd_gen_add_type_modules(lyd_gen *g, const struct lysc_type *type) {
+    if (type->basetype == LY_TYPE_IDENT) {
+        lyd_gen_add_ident_modules(g, ((const struct lysc_type_identityref *)type)->bases, 0);
+    } else if (type->basetype == LY_TYPE_UNION) {
+        struct lysc_type **types = ((const struct lysc_type_union *)type)->types;
+        for (LY_ARRAY_COUNT_TYPE i = 0; i < LY_ARRAY_COUNT(types); i++) {
+            lyd_gen_add_type_modules(g, types[i]);
+        }
+    } else if (type->basetype == LY_TYPE_LEAFREF) {
+        lyd_gen_add_type_modules(g, ((const struct lysc_type_leafref *)type)->realtype);
+    }
+}
+
+static inline const struct lysc_type *lyd_gen_type(const lyd_gen_snode *s) {
+    if (s->node->nodetype == LYS_LEAF) return ((const struct lysc_node_leaf *)s->node)->type;
+    if (s->node->nodetype == LYS_LEAFLIST) return ((const struct lysc_node_leaflist *)s->node)->type;
+    return NULL;
+}
+
+static inline lyd_gen_snode *lyd_gen_walk(lyd_gen *g, const struct lysc_node *parent,
+                                          const struct lysc_module *module, lyd_gen_snode *sparent) {
+    lyd_gen_snode *first = NULL, *last = NULL;
+    const struct lysc_node *node = NULL;
+    while ((node = lys_getnext(node, parent, module, 0)) && g->snode_count < LYD_GEN_MAX_SNODES) {
+        if (!(node->nodetype & (LYS_CONTAINER | LYS_LIST | LYS_LEAF | LYS_LEAFLIST))) continue;
+        lyd_gen_snode *s = &g->snode[g->snode_count++];
+        s->node = node;
+        s->parent = sparent;
+        s->child = s->next = NULL;
+        if (last) last->next = s; else first = s;
+        last = s;
+        lyd_gen_add_module(g, node->module);
+        if (node->nodetype & (LYS_CONTAINER | LYS_LIST)) {
+            s->child = lyd_gen_walk(g, node, NULL, s);
+        } else {
+            lyd_gen_add_type_modules(g, lyd_gen_type(s));
+        }
+    }
+    return first;
+}
+
+// Builds the model from the implemented module module_name. Returns -1 if
+// the module is missing.
+static inline int lyd_gen_init(lyd_gen *g, const struct ly_ctx *ctx, const char *module_name, uint64_t seed) {
+    memset(g, 0, sizeof(*g));
+    g->rng = seed ? seed : 0x9e3779b97f4a7c15ULL;
+    const struct lys_module *mod = ly_ctx_get_module_implemented(ctx, module_name);
+    if (!mod || !mod->compiled) {
+        return -1;
+    }
+    g->top = lyd_gen_walk(g, NULL, mod->compiled, NULL);
+    return g->top ? 0 : -1;
+}
+
+/* ---- instance tree ---- */
+
+static inline lyd_gen_node *lyd_gen_new(const lyd_gen_snode *s, lyd_gen_node *parent, lyd_gen_node *after) {
+    lyd_gen_node *n = (lyd_gen_node *)calloc(1, sizeof(*n));
+    if (!n) return NULL;
+    n->snode = s;
+    n->parent = parent;
+    if (!parent) return n;
+    if (after) {
+        n->next = after->next;
+        after->next = n;
+    } else if (!parent->child) {
+        parent->child = n;
+    } else {
+        lyd_gen_node *last = parent->child;
+        while (last->next) last = last->next;
+        last->next = n;
+    }
+    return n;
+}
+
+static inline void lyd_gen_free(lyd_gen_node *n) {
+    while (n) {
+        lyd_gen_node *next = n->next;
+        lyd_gen_free(n->child);
+        free(n->value);
+        free(n);
+        n = next;
+    }
+}
+
+static inline void lyd_gen_unlink(lyd_gen_node *n) {
+    lyd_gen_node **pp = &n->parent->child;
+    while (*pp && *pp != n) pp = &(*pp)->next;
+    if (*pp) *pp = n->next;
+    n->next = NULL;
+    n->parent = NULL;
+}
+
+static inline lyd_gen_node *lyd_gen_copy(const lyd_gen_node *src, lyd_gen_node *parent, lyd_gen_node *after) {
+    lyd_gen_node *n = lyd_gen_new(src->snode, parent, after);
+    if (!n) return NULL;
+    n->value = src->value ? strdup(src->value) : NULL;
+    n->vtype = src->vtype;
+    n->flip = src->flip;
+    for (const lyd_gen_node *c = src->child; c; c = c->next) {
+        lyd_gen_copy(c, n, NULL);
+    }
+    return n;
+}
+
+static inline bool lyd_gen_is_term(const lyd_gen_snode *s) {
+    return s && (s->node->nodetype & (LYS_LEAF | LYS_LEAFLIST));
+}
+
+// Collects the nodes of the tree below root in document order.
+static inline int lyd_gen_collect(lyd_gen_node *root, lyd_gen_node **out, int max) {
+    int count = 0;
+    lyd_gen_node *n = root->child;
+    while (n && count < max) {
+        out[count++] = n;
+        if (n->child) {
+            n = n->child;
+            continue;
+        }
+        while (n && !n->next && n != root) n = n->parent;
+        if (!n || n == root) break;
+        n = n->next;
+    }
+    return count;
+}
+
+/* ---- values ---- */
+
+static inline void lyd_gen_int_bounds(LY_DATA_TYPE t, int64_t *min, int64_t *max) {
+    switch (t) {
+    case LY_TYPE_INT8:  *min = INT8_MIN;  *max = INT8_MAX;  break;
+    case LY_TYPE_INT16: *min = INT16_MIN; *max = INT16_MAX; break;
+    case LY_TYPE_INT32: *min = INT32_MIN; *max = INT32_MAX; break;
+    default:            *min = INT64_MIN; *max = INT64_MAX; break;
+    }
+}
+
+static inline uint64_t lyd_gen_uint_max(LY_DATA_TYPE t) {
+    switch (t) {
+    case LY_TYPE_UINT8:  return UINT8_MAX;
+    case LY_TYPE_UINT16: return UINT16_MAX;
+    case LY_TYPE_UINT32: return UINT32_MAX;
+    default:             return UINT64_MAX;
+    }
+}
+
+// Picks from [min, max]: a bound, a bound's neighbour or a uniform value.
+static inline uint64_t lyd_gen_pick_span(lyd_gen *g, uint64_t lo, uint64_t hi) {
+    uint64_t span = hi - lo;
+    switch (lyd_gen_below(g, 5)) {
+    case 0: return lo;
+    case 1: return hi;
+    case 2: return span ? lo + 1 : lo;
+    default: return span == UINT64_MAX ? lyd_gen_rand64(g) : lo + lyd_gen_rand64(g) % (span + 1);
+    }
+}
+
+// Signed value (also decimal64, scaled) from the range parts, or just
+// outside them when near.
+static inline int64_t lyd_gen_signed(lyd_gen *g, const struct lysc_range *range, int64_t tmin, int64_t tmax,
+                                     bool near, bool *overflow) {
+    int64_t lo = tmin, hi = tmax;
+    if (range && LY_ARRAY_COUNT(range->parts)) {
+        const struct lysc_range_part *p = &range->parts[lyd_gen_below(g, LY_ARRAY_COUNT(range->parts))];
+        lo = p->min_64;
+        hi = p->max_64;
+    }
+    *overflow = false;
+    if (near) {
+        if (lo > tmin && (hi == tmax || lyd_gen_below(g, 2))) return lo - 1;
+        if (hi < tmax) return hi + 1;
+        *overflow = true;  // caller prints tmax + 1
+        return tmax;
+    }
+    return (int64_t)((uint64_t)lo + lyd_gen_pick_span(g, 0, (uint64_t)hi - (uint64_t)lo));
+}
+
+static inline void lyd_gen_number(lyd_gen *g, const struct lysc_type *type, bool near, lyd_gen_buf *out) {
+    const struct lysc_range *range = ((const struct lysc_type_num *)type)->range;
+    if (type->basetype >= LY_TYPE_UINT8 && type->basetype <= LY_TYPE_UINT64) {
+        uint64_t tmax = lyd_gen_uint_max(type->basetype), lo = 0, hi = tmax;
+        if (range && LY_ARRAY_COUNT(range->parts)) {
+            const struct lysc_range_part *p = &range->parts[lyd_gen_below(g, LY_ARRAY_COUNT(range->parts))];
+            lo = p->min_u64;
+            hi = p->max_u64;
+        }
+        if (near) {
+            if (lo > 0 && (hi == tmax || lyd_gen_below(g, 2))) {
+                lyd_gen_printf(out, "%s%llu", lo - 1, false);
+            } else if (hi < tmax) {
+                lyd_gen_printf(out, "%s%llu", hi + 1, false);
+            } else {
+                lyd_gen_puts(out, tmax == UINT64_MAX ? "18446744073709551616" : "-1");
+            }
+            return;
+        }
+        lyd_gen_printf(out, "%s%llu", lyd_gen_pick_span(g, lo, hi), false);
+        return;
+    }
+    int64_t tmin, tmax;
+    bool overflow;
+    lyd_gen_int_bounds(type->basetype, &tmin, &tmax);
+    int64_t v = lyd_gen_signed(g, range, tmin, tmax, near, &overflow);
+    if (overflow) {
+        lyd_gen_printf(out, "%s%llu", (unsigned long long)tmax + 1, false);
+    } else {
+        lyd_gen_printf(out, "%s%llu", v < 0 ? 0 - (unsigned long long)v : (unsigned long long)v, v < 0);
+    }
+}
+
+static inline void lyd_gen_dec64(lyd_gen *g, const struct lysc_type_dec *type, bool near, lyd_gen_buf *out) {
+    int digits = type->fraction_digits > 18 ? 18 : type->fraction_digits;
+    uint64_t scale = 1;
+    for (int i = 0; i < digits; i++) scale *= 10;
+    bool overflow, extra_digit = near && lyd_gen_below(g, 2);
+    int64_t v = lyd_gen_signed(g, type->range, INT64_MIN, INT64_MAX, near && !extra_digit, &overflow);
+    unsigned long long mag = v < 0 ? 0 - (unsigned long long)v : (unsigned long long)v;
+    if (overflow) mag++;  // INT64_MAX + 1: outside the type
+    char frac[24];
+    snprintf(frac, sizeof(frac), "%0*llu", digits, mag % scale);
+    lyd_gen_printf(out, "%s%llu", mag / scale, v < 0);
+    lyd_gen_puts(out, ".");
+    lyd_gen_puts(out, digits ? frac : "0");
+    if (extra_digit) lyd_gen_puts(out, "5");  // one fraction digit too many
+}
+
+// Length from the length parts (characters or bytes), capped for size.
+static inline uint64_t lyd_gen_length(lyd_gen *g, const struct lysc_range *length, bool near) {
+    uint64_t lo = 0, hi = 16;
+    if (length && LY_ARRAY_COUNT(length->parts)) {
+        const struct lysc_range_part *p = &length->parts[lyd_gen_below(g, LY_ARRAY_COUNT(length->parts))];
+        lo = p->min_u64;
+        hi = p->max_u64;
+        if (near) return (lo > 0 && lyd_gen_below(g, 2)) ? lo - 1 : hi + 1;
+    }
+    if (hi > lo + 24) hi = lo + 24;
+    return lyd_gen_pick_span(g, lo, hi);
+}
+
+#define LYD_GEN_ALPHABET_MAX 96
+
+typedef struct {
+    char ch[LYD_GEN_ALPHABET_MAX][5];
+    int count;
+} lyd_gen_alphabet;
+
+static inline int lyd_gen_utf8_len(unsigned char c) {
+    return c < 0x80 ? 1 : c < 0xe0 ? 2 : c < 0xf0 ? 3 : 4;
+}
+
+static inline void lyd_gen_alphabet_add(lyd_gen_alphabet *a, const char *c, int len) {
+    for (int i = 0; i < a->count; i++) {
+        if ((int)strlen(a->ch[i]) == len && !memcmp(a->ch[i], c, len)) return;
+    }
+    if (a->count < LYD_GEN_ALPHABET_MAX && len > 0 && len < 5) {
+        memcpy(a->ch[a->count], c, len);
+        a->ch[a->count++][len] = '\0';
+    }
+}
+
+// Characters a pattern admits: bracket classes (with ASCII ranges) and
+// literal characters. Anything wider falls back to a small default set.
+static inline void lyd_gen_pattern_alphabet(const struct lysc_type_str *type, lyd_gen_alphabet *a) {
+    a->count = 0;
+    struct lysc_pattern **patterns = type->patterns;
+    for (LY_ARRAY_COUNT_TYPE i = 0; i < LY_ARRAY_COUNT(patterns) && !a->count; i++) {
+        if (patterns[i]->inverted) continue;
+        const char *p = patterns[i]->expr;
+        bool in_class = false, any = false;
+        while (*p) {
+            int len = lyd_gen_utf8_len((unsigned char)*p);
+            if (*p == '\\' && p[1]) {
+                if (p[1] == 'd') {
+                    for (char c = '0'; c <= '9'; c++) lyd_gen_alphabet_add(a, &c, 1);
+                } else if (strchr("sSwWDpPi", p[1])) {
+                    any = true;
+                } else {
+                    lyd_gen_alphabet_add(a, p + 1, 1);
+                }
+                p += 2;
+            } else if (*p == '[') {
+                in_class = true;
+                if (p[1] == '^') any = true;
+                p++;
+            } else if (*p == ']') {
+                in_class = false;
+                p++;
+            } else if (in_class && p[1] == '-' && p[2] && p[2] != ']' && len == 1) {
+                for (int c = (unsigned char)p[0]; c <= (unsigned char)p[2]; c++) {
+                    char ch = (char)c;
+                    lyd_gen_alphabet_add(a, &ch, 1);
+                }
+                p += 3;
+            } else if (!in_class && strchr(".*+?()|{}^$", *p)) {
+                if (*p == '.') any = true;
+                if (*p == '{') {
+                    while (*p && *p != '}') p++;
+                    if (*p) p++;
+                } else {
+                    p++;
+                }
+            } else {
+                lyd_gen_alphabet_add(a, p, len);
+                p += len;
+            }
+        }
+        if (any) a->count = 0;
+    }
+    if (!a->count) {
+        const char *def = "abcxyz019 _-.";
+        for (const char *c = def; *c; c++) lyd_gen_alphabet_add(a, c, 1);
+    }
+}
+
+static inline void lyd_gen_string(lyd_gen *g, const struct lysc_type_str *type, bool near, lyd_gen_buf *out) {
+    lyd_gen_alphabet a;
+    lyd_gen_pattern_alphabet(type, &a);
+    bool bad_char = near && LY_ARRAY_COUNT(type->patterns) && lyd_gen_below(g, 2);
+    uint64_t n = lyd_gen_length(g, type->length, near && !bad_char);
+    uint64_t bad_at = bad_char ? lyd_gen_below(g, (uint32_t)(n ? n : 1)) : UINT64_MAX;
+    for (uint64_t i = 0; i < n || (bad_char && i == 0); i++) {
+        if (i == bad_at) {
+            // a character the pattern's alphabet does not contain
+            const char *probe = "#~Q7";
+            for (const char *c = probe; *c; c++) {
+                bool known = false;
+                for (int j = 0; j < a.count && !known; j++) known = a.ch[j][0] == *c && !a.ch[j][1];
+                if (!known) {
+                    lyd_gen_put(out, c, 1);
+                    break;
+                }
+            }
+        } else {
+            lyd_gen_puts(out, a.ch[lyd_gen_below(g, a.count)]);
+        }
+    }
+}
+
+static inline void lyd_gen_binary(lyd_gen *g, const struct lysc_type_bin *type, bool near, lyd_gen_buf *out) {
+    static const char b64[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+    bool bad_char = near && lyd_gen_below(g, 3) == 0;
+    uint64_t n = lyd_gen_length(g, type->length, near && !bad_char);
+    if (n > 64) n = 64;
+    uint8_t raw[66];
+    for (uint64_t i = 0; i < n; i++) raw[i] = (uint8_t)lyd_gen_below(g, 256);
+    for (uint64_t i = 0; i < n; i += 3) {
+        uint32_t v = (uint32_t)raw[i] << 16 | (i + 1 < n ? raw[i + 1] << 8 : 0) | (i + 2 < n ? raw[i + 2] : 0);
+        char quad[4] = {b64[v >> 18], b64[(v >> 12) & 63],
+                        i + 1 < n ? b64[(v >> 6) & 63] : '=', i + 2 < n ? b64[v & 63] : '='};
+        lyd_gen_put(out, quad, 4);
+    }
+    if (bad_char) lyd_gen_puts(out, "!");
+}
+
+static inline const struct lysc_type_bitenum_item *lyd_gen_items(const struct lysc_type *type) {
+    return type->basetype == LY_TYPE_ENUM ? ((const struct lysc_type_enum *)type)->enums
+                                          : ((const struct lysc_type_bits *)type)->bits;
+}
+
+static inline void lyd_gen_bitenum(lyd_gen *g, const struct lysc_type *type, bool near, lyd_gen_buf *out) {
+    const struct lysc_type_bitenum_item *items = lyd_gen_items(type);
+    uint32_t count = (uint32_t)LY_ARRAY_COUNT(items);
+    if (type->basetype == LY_TYPE_ENUM) {
+        lyd_gen_puts(out, (near || !count) ? "undefined-enum" : items[lyd_gen_below(g, count)].name);
+        return;
+    }
+    bool first = true;
+    for (uint32_t i = 0; i < count; i++) {
+        if (lyd_gen_below(g, 2)) continue;
+        if (!first) lyd_gen_puts(out, " ");
+        lyd_gen_puts(out, items[i].name);
+        first = false;
+    }
+    if (near) {
+        if (!first) lyd_gen_puts(out, " ");
+        // an unknown bit, or a bit named twice
+        lyd_gen_puts(out, (count && lyd_gen_below(g, 2)) ? items[0].name : "undefined-bit");
+        if (count && !first) {
+            lyd_gen_puts(out, " ");
+            lyd_gen_puts(out, items[0].name);
+        }
+    }
+}
+
+static inline int lyd_gen_derived(struct lysc_ident **idents, const struct lysc_ident **out, int count, int max, int depth) {
+    for (LY_ARRAY_COUNT_TYPE i = 0; i < LY_ARRAY_COUNT(idents) && count < max && depth < 8; i++) {
+        out[count++] = idents[i];
+        count = lyd_gen_derived(idents[i]->derived, out, count, max, depth + 1);
+    }
+    return count;
+}
+
+static inline void lyd_gen_ident(lyd_gen *g, const struct lysc_type_identityref *type, bool near, lyd_gen_buf *out) {
+    const struct lysc_ident *pool[32];
+    int count = 0;
+    for (LY_ARRAY_COUNT_TYPE i = 0; i < LY_ARRAY_COUNT(type->bases); i++) {
+        count = lyd_gen_derived(type->bases[i]->derived, pool, count, 32, 0);
+    }
+    const struct lysc_ident *ident;
+    if ((near || !count) && LY_ARRAY_COUNT(type->bases)) {
+        ident = type->bases[0];  // the base itself is not a valid value
+    } else if (count) {
+        ident = pool[lyd_gen_below(g, count)];
+    } else {
+        lyd_gen_puts(out, "undefined-ident");
+        return;
+    }
+    lyd_gen_puts(out, ident->module->name);
+    lyd_gen_puts(out, ":");
+    lyd_gen_puts(out, ident->name);
+}
+
+static inline bool lyd_gen_is_ref(const struct lysc_type *type) {
+    if (type->basetype == LY_TYPE_LEAFREF || type->basetype == LY_TYPE_INST) return true;
+    if (type->basetype == LY_TYPE_UNION) {
+        struct lysc_type **types = ((const struct lysc_type_union *)type)->types;
+        for (LY_ARRAY_COUNT_TYPE i = 0; i < LY_ARRAY_COUNT(types); i++) {
+            if (lyd_gen_is_ref(types[i])) return true;
+        }
+    }
+    return false;
+}
+
+// Appends a quoted predicate value, picking the quote the value lacks.
+static inline void lyd_gen_put_quoted(lyd_gen_buf *out, const char *v) {
+    const char *q = strchr(v, '\'') ? "\"" : "'";
+    lyd_gen_puts(out, q);
+    lyd_gen_puts(out, v);
+    lyd_gen_puts(out, q);
+}
+
+// JSON-style instance-identifier of n: module name on the first node and
+// wherever the module changes, key predicates on list entries, a value
+// predicate on leaf-list entries.
+static inline void lyd_gen_path(const lyd_gen_node *n, lyd_gen_buf *out) {
+    if (!n->snode) return;
+    lyd_gen_path(n->parent, out);
+    const struct lysc_node *s = n->snode->node;
+    lyd_gen_puts(out, "/");
+    if (!n->parent->snode || n->parent->snode->node->module != s->module) {
+        lyd_gen_puts(out, s->module->name);
+        lyd_gen_puts(out, ":");
+    }
+    lyd_gen_puts(out, s->name);
+    if (s->nodetype == LYS_LIST) {
+        for (const lyd_gen_node *k = n->child; k; k = k->next) {
+            if (!(k->snode->node->flags & LYS_KEY) || !k->value) continue;
+            lyd_gen_puts(out, "[");
+            lyd_gen_puts(out, k->snode->node->name);
+            lyd_gen_puts(out, "=");
+            lyd_gen_put_quoted(out, k->value);
+            lyd_gen_puts(out, "]");
+        }
+    } else if (s->nodetype == LYS_LEAFLIST && n->value) {
+        lyd_gen_puts(out, "[.=");
+        lyd_gen_put_quoted(out, n->value);
+        lyd_gen_puts(out, "]");
+    }
+}
+
+static inline lyd_gen_node *lyd_gen_pick_node(lyd_gen *g, lyd_gen_node *root, const struct lysc_node *schema) {
+    lyd_gen_node *all[LYD_GEN_MAX_NODES];
+    int count = lyd_gen_collect(root, all, LYD_GEN_MAX_NODES), matches = 0;
+    lyd_gen_node *pick = NULL;
+    for (int i = 0; i < count; i++) {
+        if (schema && all[i]->snode->node != schema) continue;
+        if (schema && lyd_gen_is_term(all[i]->snode) && !all[i]->value) continue;
+        // reservoir sampling over the matches
+        if (lyd_gen_below(g, ++matches) == 0) pick = all[i];
+    }
+    return pick;
+}
+
+static inline void lyd_gen_type_value(lyd_gen *g, lyd_gen_node *root, const lyd_gen_node *self,
+                                      const struct lysc_type *type, bool near, lyd_gen_buf *out, LY_DATA_TYPE *vtype);
+
+static inline void lyd_gen_leafref(lyd_gen *g, lyd_gen_node *root, const lyd_gen_node *self,
+                                   const struct lysc_type_leafref *type, bool near, lyd_gen_buf *out, LY_DATA_TYPE *vtype) {
+    const struct lysc_node *target = lysc_node_lref_target(self->snode->node);
+    lyd_gen_node *hit = (!near && target) ? lyd_gen_pick_node(g, root, target) : NULL;
+    if (hit && hit != self) {
+        lyd_gen_puts(out, hit->value);
+        *vtype = hit->vtype;
+        return;
+    }
+    // no instance to point at (or near-valid): a value of the real type,
+    // which most likely dangles
+    lyd_gen_type_value(g, root, self, type->realtype, false, out, vtype);
+    if (near || !target || !out->data) return;
+
+    // valid mode: create the target instance when its parent exists
+    const lyd_gen_snode *ts = NULL;
+    for (int i = 0; i < g->snode_count && !ts; i++) {
+        if (g->snode[i].node == target) ts = &g->snode[i];
+    }
+    lyd_gen_node *parent = (ts && ts->parent) ? lyd_gen_pick_node(g, root, ts->parent->node) : root;
+    if (ts && parent && lyd_gen_is_term(ts) && !(ts->node->flags & LYS_KEY)) {
+        lyd_gen_node *n = lyd_gen_new(ts, parent, NULL);
+        if (n) {
+            n->value = strdup(out->data);
+            n->vtype = *vtype;
+        }
+    }
+}
+
+static inline void lyd_gen_instanceid(lyd_gen *g, lyd_gen_node *root, const lyd_gen_node *self, bool near,
+                                      lyd_gen_buf *out) {
+    lyd_gen_node *hit = near ? NULL : lyd_gen_pick_node(g, root, NULL);
+    // a node whose path holds this very value cannot be its own target
+    for (const lyd_gen_node *p = self; hit && p; p = p->parent) {
+        if (p == hit) hit = NULL;
+    }
+    if (hit) {
+        lyd_gen_path(hit, out);
+        return;
+    }
+    lyd_gen_puts(out, "/");
+    lyd_gen_puts(out, self->snode->node->module->name);
+    lyd_gen_puts(out, lyd_gen_below(g, 2) ? ":undefined" : ":list[id='missing']/value");
+}
+
+static inline void lyd_gen_type_value(lyd_gen *g, lyd_gen_node *root, const lyd_gen_node *self,
+                                      const struct lysc_type *type, bool near, lyd_gen_buf *out, LY_DATA_TYPE *vtype) {
+    *vtype = type->basetype;
+    switch (type->basetype) {
+    case LY_TYPE_INT8: case LY_TYPE_INT16: case LY_TYPE_INT32: case LY_TYPE_INT64:
+    case LY_TYPE_UINT8: case LY_TYPE_UINT16: case LY_TYPE_UINT32: case LY_TYPE_UINT64:
+        lyd_gen_number(g, type, near, out);
+        break;
+    case LY_TYPE_DEC64:
+        lyd_gen_dec64(g, (const struct lysc_type_dec *)type, near, out);
+        break;
+    case LY_TYPE_STRING:
+        lyd_gen_string(g, (const struct lysc_type_str *)type, near, out);
+        break;
+    case LY_TYPE_BINARY:
+        lyd_gen_binary(g, (const struct lysc_type_bin *)type, near, out);
+        break;
+    case LY_TYPE_BOOL:
+        lyd_gen_puts(out, near ? "yes" : lyd_gen_below(g, 2) ? "true" : "false");
+        break;
+    case LY_TYPE_EMPTY:
+        if (near) lyd_gen_puts(out, "x");
+        break;
+    case LY_TYPE_ENUM:
+    case LY_TYPE_BITS:
+        lyd_gen_bitenum(g, type, near, out);
+        break;
+    case LY_TYPE_IDENT:
+        lyd_gen_ident(g, (const struct lysc_type_identityref *)type, near, out);
+        break;
+    case LY_TYPE_INST:
+        lyd_gen_instanceid(g, root, self, near, out);
+        break;
+    case LY_TYPE_LEAFREF:
+        lyd_gen_leafref(g, root, self, (const struct lysc_type_leafref *)type, near, out, vtype);
+        break;
+    case LY_TYPE_UNION: {
+        struct lysc_type **types = ((const struct lysc_type_union *)type)->types;
+        if (LY_ARRAY_COUNT(types)) {
+            lyd_gen_type_value(g, root, self, types[lyd_gen_below(g, LY_ARRAY_COUNT(types))], near, out, vtype);
+        }
+        break;
+    }
+    default:
+        break;
+    }
+}
+
+// True if another entry of the same list (same key) or leaf-list under the
+// same parent already has value v.
+static inline bool lyd_gen_taken(const lyd_gen_node *n, const char *v) {
+    const lyd_gen_snode *s = n->snode;
+    bool key = s->node->flags & LYS_KEY;
+    const lyd_gen_node *siblings = key ? n->parent->parent->child : n->parent->child;
+    for (const lyd_gen_node *o = siblings; o; o = o->next) {
+        if (key) {
+            if (o == n->parent || o->snode != n->parent->snode) continue;
+            for (const lyd_gen_node *k = o->child; k; k = k->next) {
+                if (k->snode == s && k->value && !strcmp(k->value, v)) return true;
+            }
+        } else if (o != n && o->snode == s && o->value && !strcmp(o->value, v)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// (Re)generates the value of term node n against the tree under root.
+static inline void lyd_gen_fill(lyd_gen *g, lyd_gen_node *root, lyd_gen_node *n) {
+    bool near = lyd_gen_near(g);
+    bool unique = !near && ((n->snode->node->flags & LYS_KEY) || n->snode->node->nodetype == LYS_LEAFLIST);
+    for (int attempt = 0; attempt < 4; attempt++) {
+        lyd_gen_buf b = {0};
+        lyd_gen_type_value(g, root, n, lyd_gen_type(n->snode), near, &b, &n->vtype);
+        free(n->value);
+        n->value = lyd_gen_take(&b);
+        if (!unique || !lyd_gen_taken(n, n->value)) break;
+    }
+    n->flip = false;
+}
+
+static inline uint32_t lyd_gen_count(lyd_gen *g, const lyd_gen_snode *s) {
+    const struct lysc_node *node = s->node;
+    if (node->flags & LYS_KEY) {
+        return lyd_gen_near(g) && lyd_gen_below(g, 8) == 0 ? 0 : 1;
+    }
+    if (node->nodetype & (LYS_LIST | LYS_LEAFLIST)) {
+        uint32_t max = node->nodetype == LYS_LIST ? ((const struct lysc_node_list *)node)->max
+                                                  : ((const struct lysc_node_leaflist *)node)->max;
+        if (max && max <= 8 && lyd_gen_near(g)) return max + 1;
+        uint32_t cap = (max && max < LYD_GEN_MAX_ENTRIES) ? max : LYD_GEN_MAX_ENTRIES;
+        return lyd_gen_below(g, cap + 1);
+    }
+    return lyd_gen_below(g, 3) ? 1 : 0;
+}
+
+// Adds one instance of s under parent. Values of reference types stay NULL
+// until lyd_gen_resolve() runs over the finished tree.
+static inline lyd_gen_node *lyd_gen_instance(lyd_gen *g, lyd_gen_node *root, const lyd_gen_snode *s,
+                                             lyd_gen_node *parent, lyd_gen_node *after) {
+    lyd_gen_node *n = lyd_gen_new(s, parent, after);
+    if (!n) return NULL;
+    if (lyd_gen_is_term(s)) {
+        if (!lyd_gen_is_ref(lyd_gen_type(s))) lyd_gen_fill(g, root, n);
+        return n;
+    }
+    for (const lyd_gen_snode *c = s->child; c; c = c->next) {
+        for (uint32_t i = lyd_gen_count(g, c); i > 0; i--) {
+            lyd_gen_instance(g, root, c, n, NULL);
+        }
+    }
+    return n;
+}
+
+static inline void lyd_gen_resolve(lyd_gen *g, lyd_gen_node *root) {
+    lyd_gen_node *all[LYD_GEN_MAX_NODES];
+    int count = lyd_gen_collect(root, all, LYD_GEN_MAX_NODES);
+    for (int i = 0; i < count; i++) {
+        if (lyd_gen_is_term(all[i]->snode) && !all[i]->value) lyd_gen_fill(g, root, all[i]);
+    }
+}
+
+// Generates a whole tree: every top-level node with its usual probability.
+static inline lyd_gen_node *lyd_gen_generate(lyd_gen *g) {
+    lyd_gen_node *root = lyd_gen_new(NULL, NULL, NULL);
+    if (!root) return NULL;
+    for (const lyd_gen_snode *s = g->top; s; s = s->next) {
+        for (uint32_t i = lyd_gen_count(g, s); i > 0; i--) {
+            lyd_gen_instance(g, root, s, root, NULL);
+        }
+    }
+    lyd_gen_resolve(g, root);
+    return root;
+}
+
+/* ---- printing ---- */
+
+static inline bool lyd_gen_is_number(const char *v) {
+    if (*v == '-') v++;
+    if (!*v) return false;
+    for (; *v; v++) {
+        if ((*v < '0' || *v > '9') && *v != '.') return false;
+    }
+    return true;
+}
+
+static inline void lyd_gen_json_string(lyd_gen_buf *out, const char *v) {
+    lyd_gen_puts(out, "\"");
+    for (; *v; v++) {
+        char esc[8];
+        if (*v == '"' || *v == '\\') {
+            esc[0] = '\\';
+            esc[1] = *v;
+            lyd_gen_put(out, esc, 2);
+        } else if ((unsigned char)*v < 0x20) {
+            snprintf(esc, sizeof(esc), "\\u%04x", (unsigned char)*v);
+            lyd_gen_puts(out, esc);
+        } else {
+            lyd_gen_put(out, v, 1);
+        }
+    }
+    lyd_gen_puts(out, "\"");
+}
+
+// RFC 7951 encoding: 8-32 bit integers as numbers, booleans as literals,
+// empty as [null], everything else as a string. flip inverts the choice.
+static inline void lyd_gen_json_value(lyd_gen_buf *out, const lyd_gen_node *n) {
+    const char *v = n->value ? n->value : "";
+    bool bare;
+    switch (n->vtype) {
+    case LY_TYPE_INT8: case LY_TYPE_INT16: case LY_TYPE_INT32:
+    case LY_TYPE_UINT8: case LY_TYPE_UINT16: case LY_TYPE_UINT32:
+        bare = lyd_gen_is_number(v);
+        break;
+    case LY_TYPE_BOOL:
+        bare = !strcmp(v, "true") || !strcmp(v, "false");
+        break;
+    case LY_TYPE_EMPTY:
+        if (!*v && !n->flip) {
+            lyd_gen_puts(out, "[null]");
+            return;
+        }
+        bare = false;
+        break;
+    default:
+        bare = false;
+        break;
+    }
+    if (n->flip) bare = !bare && lyd_gen_is_number(v);
+    if (bare) lyd_gen_puts(out, v);
+    else lyd_gen_json_string(out, v);
+}
+
+static inline void lyd_gen_json_name(lyd_gen_buf *out, const lyd_gen_node *n) {
+    const struct lysc_node *s = n->snode->node;
+    lyd_gen_puts(out, "\"");
+    if (!n->parent->snode || n->parent->snode->node->module != s->module) {
+        lyd_gen_puts(out, s->module->name);
+        lyd_gen_puts(out, ":");
+    }
+    lyd_gen_puts(out, s->name);
+    lyd_gen_puts(out, "\":");
+}
+
+static inline void lyd_gen_print_json_members(const lyd_gen_node *parent, lyd_gen_buf *out);
+
+static inline void lyd_gen_print_json_entry(const lyd_gen_node *n, lyd_gen_buf *out) {
+    if (lyd_gen_is_term(n->snode)) {
+        lyd_gen_json_value(out, n);
+    } else {
+        lyd_gen_puts(out, "{");
+        lyd_gen_print_json_members(n, out);
+        lyd_gen_puts(out, "}");
+    }
+}
+
+// Lists and leaf-lists are grouped into one array per schema node; a leaf or
+// container that occurs twice is printed twice, as a duplicate member.
+static inline void lyd_gen_print_json_members(const lyd_gen_node *parent, lyd_gen_buf *out) {
+    bool first = true;
+    for (const lyd_gen_node *n = parent->child; n; n = n->next) {
+        bool multi = n->snode->node->nodetype & (LYS_LIST | LYS_LEAFLIST);
+        if (multi) {
+            bool seen = false;
+            for (const lyd_gen_node *p = parent->child; p != n && !seen; p = p->next) seen = p->snode == n->snode;
+            if (seen) continue;
+        }
+        if (!first) lyd_gen_puts(out, ",");
+        first = false;
+        lyd_gen_json_name(out, n);
+        if (!multi) {
+            lyd_gen_print_json_entry(n, out);
+            continue;
+        }
+        lyd_gen_puts(out, "[");
+        for (const lyd_gen_node *e = n; e; e = e->next) {
+            if (e->snode != n->snode) continue;
+            if (e != n) lyd_gen_puts(out, ",");
+            lyd_gen_print_json_entry(e, out);
+        }
+        lyd_gen_puts(out, "]");
+    }
+}
+
+static inline void lyd_gen_xml_text(lyd_gen_buf *out, const char *v, bool attr) {
+    for (; *v; v++) {
+        switch (*v) {
+        case '<': lyd_gen_puts(out, "&lt;"); break;
+        case '>': lyd_gen_puts(out, "&gt;"); break;
+        case '&': lyd_gen_puts(out, "&amp;"); break;
+        case '"': lyd_gen_puts(out, attr ? "&quot;" : "\""); break;
+        default: lyd_gen_put(out, v, 1); break;
+        }
+    }
+}
+
+static inline bool lyd_gen_is_name_char(char c) {
+    return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') ||
+           c == '_' || c == '-' || c == '.';
+}
+
+// Rewrites the "module:" qualifiers of an identityref or instance-identifier
+// value into XML prefixes. For instance-identifiers every node name gets the
+// prefix of its (inherited) module, as XML requires. used collects the
+// modules whose xmlns:prefix the element must declare.
+static inline void lyd_gen_xml_qualify(const lyd_gen *g, const char *v, bool path, const lyd_gen_module *deflt,
+                                       lyd_gen_buf *out, uint32_t *used) {
+    const lyd_gen_module *cur = deflt;
+    bool name_pos = !path;
+    char quote = 0;
+    for (const char *p = v; *p;) {
+        if (quote) {
+            if (*p == quote) quote = 0;
+            lyd_gen_put(out, p++, 1);
+            continue;
+        }
+        if (*p == '\'' || *p == '"') {
+            quote = *p;
+            lyd_gen_put(out, p++, 1);
+            continue;
+        }
+        if (path && (*p == '/' || *p == '[')) {
+            name_pos = true;
+            lyd_gen_put(out, p++, 1);
+            continue;
+        }
+        if (name_pos && ((*p >= 'a' && *p <= 'z') || (*p >= 'A' && *p <= 'Z') || *p == '_')) {
+            const char *end = p;
+            while (lyd_gen_is_name_char(*end)) end++;
+            const lyd_gen_module *m = (*end == ':') ? lyd_gen_find_module(g, p, (size_t)(end - p)) : NULL;
+            if (m) {
+                cur = m;
+                p = end + 1;
+                end = p;
+                while (lyd_gen_is_name_char(*end)) end++;
+            } else if (*end == ':' || !path) {
+                // unknown module or unqualified identity: leave as is
+                lyd_gen_put(out, p, (size_t)(end - p));
+                p = end;
+                name_pos = false;
+                continue;
+            }
+            if (cur) {
+                *used |= 1u << (cur - g->module);
+                lyd_gen_puts(out, cur->prefix);
+                lyd_gen_puts(out, ":");
+            }
+            lyd_gen_put(out, p, (size_t)(end - p));
+            p = end;
+            name_pos = false;
+            continue;
+        }
+        name_pos = false;
+        lyd_gen_put(out, p++, 1);
+    }
+}
+
+static inline void lyd_gen_print_xml_nodes(const lyd_gen *g, const lyd_gen_node *parent, lyd_gen_buf *out) {
+    for (const lyd_gen_node *n = parent->child; n; n = n->next) {
+        const struct lysc_node *s = n->snode->node;
+        lyd_gen_puts(out, "<");
+        lyd_gen_puts(out, s->name);
+        if (!parent->snode || parent->snode->node->module != s->module) {
+            lyd_gen_puts(out, " xmlns=\"");
+            lyd_gen_xml_text(out, s->module->ns, true);
+            lyd_gen_puts(out, "\"");
+        }
+        if (!lyd_gen_is_term(n->snode)) {
+            lyd_gen_puts(out, ">");
+            lyd_gen_print_xml_nodes(g, n, out);
+        } else {
+            const char *v = n->value ? n->value : "";
+            lyd_gen_buf text = {0};
+            uint32_t used = 0;
+            if (n->vtype == LY_TYPE_IDENT || n->vtype == LY_TYPE_INST) {
+                lyd_gen_xml_qualify(g, v, n->vtype == LY_TYPE_INST,
+                                    lyd_gen_find_module(g, s->module->name, strlen(s->module->name)), &text, &used);
+                v = text.data ? text.data : "";
+            }
+            for (int i = 0; i < g->module_count; i++) {
+                if (!(used & (1u << i))) continue;
+                lyd_gen_puts(out, " xmlns:");
+                lyd_gen_puts(out, g->module[i].prefix);
+                lyd_gen_puts(out, "=\"");
+                lyd_gen_xml_text(out, g->module[i].ns, true);
+                lyd_gen_puts(out, "\"");
+            }
+            if (!*v) {
+                lyd_gen_puts(out, "/>");
+                free(text.data);
+                continue;
+            }
+            lyd_gen_puts(out, ">");
+            lyd_gen_xml_text(out, v, false);
+            free(text.data);
+        }
+        lyd_gen_puts(out, "</");
+        lyd_gen_puts(out, s->name);
+        lyd_gen_puts(out, ">");
+    }
+}
+
+// Prints the tree as format (LYD_JSON or LYD_XML) into out (appending).
+static inline void lyd_gen_print(const lyd_gen *g, const lyd_gen_node *root, LYD_FORMAT format, lyd_gen_buf *out) {
+    if (format == LYD_XML) {
+        lyd_gen_print_xml_nodes(g, root, out);
+    } else {
+        lyd_gen_puts(out, "{");
+        lyd_gen_print_json_members(root, out);
+        lyd_gen_puts(out, "}");
+    }
+}
+
+/* ---- reading inputs back ---- */
+
+// Format of a text payload by its first significant character.
+static inline LYD_FORMAT lyd_gen_detect(const char *data, size_t len) {
+    for (size_t i = 0; i < len; i++) {
+        if (data[i] == '{') return LYD_JSON;
+        if (data[i] == '<') return LYD_XML;
+        if (data[i] != ' ' && data[i] != '\t' && data[i] != '\r' && data[i] != '\n') break;
+    }
+    return LYD_UNKNOWN;
+}
+
+static inline const lyd_gen_snode *lyd_gen_find_snode(const lyd_gen_snode *first, const char *name) {
+    for (const lyd_gen_snode *s = first; s; s = s->next) {
+        if (!strcmp(s->node->name, name)) return s;
+    }
+    return NULL;
+}
+
+static inline LY_DATA_TYPE lyd_gen_guess_vtype(const lyd_gen_snode *s, const char *v) {
+    const struct lysc_type *type = lyd_gen_type(s);
+    while (type->basetype == LY_TYPE_LEAFREF) type = ((const struct lysc_type_leafref *)type)->realtype;
+    if (type->basetype != LY_TYPE_UNION) return type->basetype;
+    if (v[0] == '/') return LY_TYPE_INST;
+    if (lyd_gen_is_number(v) && !strchr(v, '.')) return LY_TYPE_INT64;  // printed quoted
+    return strchr(v, ':') ? LY_TYPE_IDENT : LY_TYPE_STRING;
+}
+
+static inline void lyd_gen_import(const struct lyd_node *first, lyd_gen_node *parent, const lyd_gen_snode *schild) {
+    for (const struct lyd_node *d = first; d; d = d->next) {
+        const lyd_gen_snode *s = lyd_gen_find_snode(schild, LYD_NAME(d));
+        if (!s) continue;
+        lyd_gen_node *n = lyd_gen_new(s, parent, NULL);
+        if (!n) return;
+        if (lyd_gen_is_term(s)) {
+            const char *v = lyd_get_value(d);
+            n->value = strdup(v ? v : "");
+            n->vtype = lyd_gen_guess_vtype(s, n->value);
+        } else {
+            lyd_gen_import(lyd_child(d), n, s->child);
+        }
+    }
+}
+
+// Reads a JSON or XML payload into a tree. Returns NULL if libyang cannot
+// parse it even as opaque data.
+static inline lyd_gen_node *lyd_gen_parse(const lyd_gen *g, const struct ly_ctx *ctx, const char *text, LYD_FORMAT format) {
+    struct lyd_node *tree = NULL;
+    if (lyd_parse_data_mem(ctx, text, format, LYD_PARSE_ONLY | LYD_PARSE_OPAQ, 0, &tree) != LY_SUCCESS) {
+        lyd_free_all(tree);
+        return NULL;
+    }
+    lyd_gen_node *root = lyd_gen_new(NULL, NULL, NULL);
+    if (root) lyd_gen_import(tree, root, g->top);
+    lyd_free_all(tree);
+    return root;
+}
+
+/* ---- mutations ---- */
+
+enum {
+    LYD_GEN_MUT_VALUE,      // regenerate a value (valid or near-valid)
+    LYD_GEN_MUT_REF,        // re-resolve a leafref / instance-identifier
+    LYD_GEN_MUT_DELETE,     // drop a subtree
+    LYD_GEN_MUT_DUP,        // duplicate an entry, sometimes with fresh keys
+    LYD_GEN_MUT_ADD,        // generate a new instance under an existing parent
+    LYD_GEN_MUT_FLIP,       // JSON encoding of one value
+    LYD_GEN_MUT_SPLICE,     // graft a subtree of another input
+    LYD_GEN_MUT_COUNT
+};
+
+static inline lyd_gen_node *lyd_gen_pick(lyd_gen *g, lyd_gen_node **all, int count, bool term, bool ref) {
+    lyd_gen_node *pick = NULL;
+    int matches = 0;
+    for (int i = 0; i < count; i++) {
+        if (term && !lyd_gen_is_term(all[i]->snode)) continue;
+        if (ref && !lyd_gen_is_ref(lyd_gen_type(all[i]->snode))) continue;
+        if (lyd_gen_below(g, ++matches) == 0) pick = all[i];
+    }
+    return pick;
+}
+
+// Finds an instance that can hold a child of schema node s (root for
+// top-level nodes).
+static inline lyd_gen_node *lyd_gen_pick_parent(lyd_gen *g, lyd_gen_node *root, lyd_gen_node **all, int count,
+                                                const lyd_gen_snode *s) {
+    if (!s->parent) return root;
+    lyd_gen_node *pick = NULL;
+    int matches = 0;
+    for (int i = 0; i < count; i++) {
+        if (all[i]->snode == s->parent && lyd_gen_below(g, ++matches) == 0) pick = all[i];
+    }
+    return pick;
+}
+
+// Applies one mutation to the tree. other (may be NULL) is the tree of the
+// splice partner. Returns false if nothing applicable was found.
+static inline bool lyd_gen_mutate_one(lyd_gen *g, lyd_gen_node *root, const lyd_gen_node *other, int op) {
+    lyd_gen_node *all[LYD_GEN_MAX_NODES];
+    int count = lyd_gen_collect(root, all, LYD_GEN_MAX_NODES);
+    lyd_gen_node *n;
+    switch (op) {
+    case LYD_GEN_MUT_VALUE:
+    case LYD_GEN_MUT_REF:
+        n = lyd_gen_pick(g, all, count, true, op == LYD_GEN_MUT_REF);
+        if (!n) return false;
+        lyd_gen_fill(g, root, n);
+        return true;
+    case LYD_GEN_MUT_DELETE:
+        n = lyd_gen_pick(g, all, count, false, false);
+        if (!n) return false;
+        lyd_gen_unlink(n);
+        lyd_gen_free(n);
+        return true;
+    case LYD_GEN_MUT_DUP:
+        n = lyd_gen_pick(g, all, count, false, false);
+        if (!n) return false;
+        n = lyd_gen_copy(n, n->parent, n);
+        if (n && n->snode->node->nodetype == LYS_LIST && lyd_gen_below(g, 2)) {
+            for (lyd_gen_node *k = n->child; k; k = k->next) {
+                if (k->snode->node->flags & LYS_KEY) lyd_gen_fill(g, root, k);
+            }
+        }
+        return n != NULL;
+    case LYD_GEN_MUT_ADD: {
+        const lyd_gen_snode *s = &g->snode[lyd_gen_below(g, g->snode_count)];
+        lyd_gen_node *parent = lyd_gen_pick_parent(g, root, all, count, s);
+        if (!parent) return false;
+        n = lyd_gen_instance(g, root, s, parent, NULL);
+        lyd_gen_resolve(g, root);
+        return n != NULL;
+    }
+    case LYD_GEN_MUT_FLIP:
+        n = lyd_gen_pick(g, all, count, true, false);
+        if (!n) return false;
+        n->flip = !n->flip;
+        return true;
+    case LYD_GEN_MUT_SPLICE: {
+        if (!other || !other->child) return false;
+        lyd_gen_node *src[LYD_GEN_MAX_NODES];
+        int src_count = lyd_gen_collect((lyd_gen_node *)other, src, LYD_GEN_MAX_NODES);
+        const lyd_gen_node *pick = lyd_gen_pick(g, src, src_count, false, false);
+        lyd_gen_node *parent = pick ? lyd_gen_pick_parent(g, root, all, count, pick->snode) : NULL;
+        return parent && lyd_gen_copy(pick, parent, NULL);
+    }
+    default:
+        return false;
+    }
+}
+
+// Applies 1-4 mutations; a fresh tree replaces root now and then.
+static inline lyd_gen_node *lyd_gen_mutate(lyd_gen *g, lyd_gen_node *root, const lyd_gen_node *other) {
+    if (!root || lyd_gen_below(g, 32) == 0) {
+        lyd_gen_free(root);
+        return lyd_gen_generate(g);
+    }
+    int rounds = 1 + (int)lyd_gen_below(g, 4);
+    for (int i = 0, tries = 0; i < rounds && tries < 16; tries++) {
+        if (lyd_gen_mutate_one(g, root, other, (int)lyd_gen_below(g, LYD_GEN_MUT_COUNT))) i++;
+    }
+    return root;
+}
+
+#endif /* LYD_GEN_H */
@@ -0,0 +1,173 @@
+/*
+ * In-memory module bundles for the lys_parse_mem AFL driver.
+ *
+ * With the bundle bit of the option header set (lys_fuzz_options.h), the
+ * schema text after the header holds several modules separated by NUL
+ * bytes.  The driver parses every module in bundle order, and an import
+ * callback (ly_ctx_set_module_imp_clb) serves imports and includes from the
+ * other modules of the bundle, so import, augment and deviation resolution
+ * run without touching the filesystem.  Put importing modules first so their
+ * imports go through the callback instead of finding an already loaded module.
+ *
+ * A module is found by the name after its "module"/"submodule" keyword (or
+ * the name attribute of the YIN root element); revisions are left for
+ * libyang to check.  Modules whose name cannot be read are still parsed,
+ * they just cannot be imported.
+ */
+
+#ifndef LYS_FUZZ_BUNDLE_H
+#define LYS_FUZZ_BUNDLE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <string.h>
+
+#include "libyang.h"
+
+#define LYS_FUZZ_BUNDLE_MAX 16
+
+typedef struct {
+    const char *data;       // NUL-terminated module text
+    const char *name;       // points into data, not terminated
+    size_t name_len;
+    bool submodule;
+} lys_fuzz_bundle_module;
+
+typedef struct {
+    lys_fuzz_bundle_module mod[LYS_FUZZ_BUNDLE_MAX];
+    int count;
+    LYS_INFORMAT format;
+} lys_fuzz_bundle;
+
+static inline bool lys_fuzz_is_space(char c) {
+    return c == ' ' || c == '\t' || c == '\n' || c == '\r';
+}
+
+// Skips whitespace and YANG comments.
+static inline const char *lys_fuzz_skip_yang_sep(const char *p) {
+    for (;;) {
+        while (lys_fuzz_is_space(*p)) p++;
+        if (p[0] == '/' && p[1] == '/') {
+            p = strchr(p, '\n');
+            if (!p) return "";
+        } else if (p[0] == '/' && p[1] == '*') {
+            p = strstr(p + 2, "*/");
+            if (!p) return "";
+            p += 2;
+        } else {
+            return p;
+        }
+    }
+}
+
+// Reads the module name of a YANG module: "module NAME" or "submodule NAME".
+static inline bool lys_fuzz_yang_name(lys_fuzz_bundle_module *m) {
+    const char *p = lys_fuzz_skip_yang_sep(m->data);
+    if (strncmp(p, "submodule", 9) == 0) {
+        m->submodule = true;
+        p += 9;
+    } else if (strncmp(p, "module", 6) == 0) {
+        p += 6;
+    } else {
+        return false;
+    }
+    if (!lys_fuzz_is_space(*p) && *p != '/') {
+        return false;
+    }
+    p = lys_fuzz_skip_yang_sep(p);
+    char quote = 0;
+    if (*p == '"' || *p == '\'') {
+        quote = *p++;
+    }
+    const char *end = p;
+    while (*end && (quote ? *end != quote : !lys_fuzz_is_space(*end) && *end != '{' && *end != ';')) {
+        end++;
+    }
+    m->name = p;
+    m->name_len = (size_t)(end - p);
+    return m->name_len > 0;
+}
+
+// Reads the name attribute of the YIN root element (<module> / <submodule>,
+// with or without a namespace prefix).
+static inline bool lys_fuzz_yin_name(lys_fuzz_bundle_module *m) {
+    const char *p = m->data;
+    while ((p = strchr(p, '<')) != NULL) {
+        p++;
+        if (*p == '?' || *p == '!') continue;
+        const char *colon = strpbrk(p, ": \t\r\n>");
+        if (colon && *colon == ':') p = colon + 1;
+        if (strncmp(p, "submodule", 9) == 0) {
+            m->submodule = true;
+        } else if (strncmp(p, "module", 6) != 0) {
+            return false;
+        }
+        const char *tag_end = strchr(p, '>');
+        const char *attr = strstr(p, "name=");
+        if (!attr || (tag_end && attr > tag_end) || (attr[5] != '"' && attr[5] != '\'')) {
+            return false;
+        }
+        const char *end = strchr(attr + 6, attr[5]);
+        if (!end) return false;
+        m->name = attr + 6;
+        m->name_len = (size_t)(end - m->name);
+        return m->name_len > 0;
+    }
+    return false;
+}
+
+// Splits buf (len bytes plus a terminating NUL) into the NUL-separated
+// modules it already holds. buf is only read: the modules point into it, so it
+// must outlive the bundle. Empty pieces are skipped, pieces past
+// LYS_FUZZ_BUNDLE_MAX ignored.
+static inline void lys_fuzz_bundle_split(const char *buf, size_t len, LYS_INFORMAT format, lys_fuzz_bundle *bundle) {
+    bundle->count = 0;
+    bundle->format = format;
+    size_t pos = 0;
+    while (pos < len && bundle->count < LYS_FUZZ_BUNDLE_MAX) {
+        size_t piece = strlen(buf + pos);
+        if (piece) {
+            lys_fuzz_bundle_module *m = &bundle->mod[bundle->count++];
+            memset(m, 0, sizeof(*m));
+            m->data = buf + pos;
+            if (!(format == LYS_IN_YIN ? lys_fuzz_yin_name(m) : lys_fuzz_yang_name(m))) {
+                m->name = NULL;
+                m->name_len = 0;
+            }
+        }
+        pos += piece + 1;
+    }
+}
+
+static inline const lys_fuzz_bundle_module *lys_fuzz_bundle_find(const lys_fuzz_bundle *bundle,
+                                                                 const char *name, bool submodule) {
+    size_t len = strlen(name);
+    for (int i = 0; i < bundle->count; i++) {
+        const lys_fuzz_bundle_module *m = &bundle->mod[i];
+        if (m->name && m->submodule == submodule && m->name_len == len &&
+            memcmp(m->name, name, len) == 0) {
+            return m;
+        }
+    }
+    return NULL;
+}
+
+// ly_module_imp_clb serving modules and submodules from the bundle in user_data.
+static inline LY_ERR lys_fuzz_bundle_imp_clb(const char *mod_name, const char *mod_rev, const char *submod_name,
+                                             const char *sub_rev, void *user_data, LYS_INFORMAT *format,
+                                             const char **module_data, ly_module_imp_data_free_clb *free_module_data) {
+    (void)mod_rev;
+    (void)sub_rev;
+    const lys_fuzz_bundle *bundle = (const lys_fuzz_bundle *)user_data;
+    const lys_fuzz_bundle_module *m = submod_name ? lys_fuzz_bundle_find(bundle, submod_name, true)
+                                                  : lys_fuzz_bundle_find(bundle, mod_name, false);
+    if (!m) {
+        return LY_ENOTFOUND;
+    }
+    *format = bundle->format;
+    *module_data = m->data;
+    *free_module_data = NULL; // the bundle owns the text
+    return LY_SUCCESS;
+}
+
+#endif /* LYS_FUZZ_BUNDLE_H */
@@ -0,0 +1,127 @@
+/*
+ * Option header for the lys_parse_mem AFL driver.
+ *
+ * The input is a fixed-size header followed by the schema text, so the
+ * options no longer depend on the input length and every header value maps
+ * onto arguments libyang accepts:
+ *
+ *   offset  size  field
+ *   0       4     magic "LYSF"
+ *   4       1     layout version (LYS_FUZZ_OPTIONS_VERSION)
+ *   5       1     ly_ctx_new flags, one bit per entry of lys_fuzz_ctx_flags[0..7]
+ *   6       1     ly_ctx_new flags, one bit per entry of lys_fuzz_ctx_flags[8..15]
+ *   7       1     bit 0: format (0 YANG, 1 YIN)
+ *                 bits 1-3: ly_log_options (LY_LOLOG, LY_LOSTORE, LY_LOSTORE_LAST)
+ *                 bits 4-5: ly_log_level (error .. debug)
+ *                 bit 6: bundle, several NUL-separated modules (lys_fuzz_bundle.h)
+ *                 bit 7: reserved
+ *   8       ...   schema text
+ *
+ * Context flags missing from the libyang being built against map to 0.
+ * Bundles always get LY_CTX_DISABLE_SEARCHDIRS, so imports are resolved from
+ * the bundle only.
+ */
+
+#ifndef LYS_FUZZ_OPTIONS_H
+#define LYS_FUZZ_OPTIONS_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "libyang.h"
+
+#define LYS_FUZZ_OPTIONS_MAGIC   "LYSF"
+#define LYS_FUZZ_OPTIONS_VERSION 1
+#define LYS_FUZZ_OPTIONS_SIZE    8
+
+#ifndef LY_CTX_ENABLE_IMP_FEATURES
+#define LY_CTX_ENABLE_IMP_FEATURES 0
+#endif
+#ifndef LY_CTX_LEAFREF_EXTENDED
+#define LY_CTX_LEAFREF_EXTENDED 0
+#endif
+#ifndef LY_CTX_LEAFREF_LINKING
+#define LY_CTX_LEAFREF_LINKING 0
+#endif
+#ifndef LY_CTX_BUILTIN_PLUGINS_ONLY
+#define LY_CTX_BUILTIN_PLUGINS_ONLY 0
+#endif
+
+// Header bit i selects lys_fuzz_ctx_flags[i].
+static const uint32_t lys_fuzz_ctx_flags[16] = {
+    LY_CTX_ALL_IMPLEMENTED,
+    LY_CTX_REF_IMPLEMENTED,
+    LY_CTX_NO_YANGLIBRARY,
+    LY_CTX_DISABLE_SEARCHDIRS,
+    LY_CTX_DISABLE_SEARCHDIR_CWD,
+    LY_CTX_PREFER_SEARCHDIRS,
+    LY_CTX_SET_PRIV_PARSED,
+    LY_CTX_EXPLICIT_COMPILE,
+    LY_CTX_ENABLE_IMP_FEATURES,
+    LY_CTX_LEAFREF_EXTENDED,
+    LY_CTX_LEAFREF_LINKING,
+    LY_CTX_BUILTIN_PLUGINS_ONLY,
+};
+
+typedef struct {
+    uint32_t ctx_options;   // LY_CTX_* mask
+    LYS_INFORMAT format;    // LYS_IN_YANG or LYS_IN_YIN
+    uint32_t log_options;   // LY_LO* mask
+    LY_LOG_LEVEL log_level;
+    bool bundle;            // schema text is a lys_fuzz_bundle.h bundle
+} lys_fuzz_options;
+
+static inline bool lys_fuzz_has_options(const uint8_t *buf, size_t len) {
+    return len >= LYS_FUZZ_OPTIONS_SIZE &&
+           memcmp(buf, LYS_FUZZ_OPTIONS_MAGIC, 4) == 0 &&
+           buf[4] == LYS_FUZZ_OPTIONS_VERSION;
+}
+
+// Decodes the header. Returns false if buf does not start with a header of
+// the supported version.
+static inline bool lys_fuzz_parse_options(const uint8_t *buf, size_t len, lys_fuzz_options *opts) {
+    if (!lys_fuzz_has_options(buf, len)) {
+        return false;
+    }
+    uint32_t bits = buf[5] | ((uint32_t)buf[6] << 8);
+    opts->ctx_options = 0;
+    for (int i = 0; i < 16; i++) {
+        if (bits & (1u << i)) opts->ctx_options |= lys_fuzz_ctx_flags[i];
+    }
+    opts->format = (buf[7] & 1) ? LYS_IN_YIN : LYS_IN_YANG;
+    opts->log_options = 0;
+    if (buf[7] & 0x02) opts->log_options |= LY_LOLOG;
+    if (buf[7] & 0x04) opts->log_options |= LY_LOSTORE;
+    if (buf[7] & 0x08) opts->log_options |= LY_LOSTORE_LAST;
+    opts->log_level = (LY_LOG_LEVEL)((buf[7] >> 4) & 0x3);
+    opts->bundle = (buf[7] & 0x40) != 0;
+    if (opts->bundle) {
+        opts->ctx_options |= LY_CTX_DISABLE_SEARCHDIRS;
+        opts->ctx_options &= ~(uint32_t)LY_CTX_PREFER_SEARCHDIRS;
+    }
+    return true;
+}
+
+// Writes the normalised form of a header that passes lys_fuzz_has_options()
+// to key (LYS_FUZZ_OPTIONS_SIZE bytes): context bits missing from this
+// libyang and the reserved bit are cleared and the bundle context flags are
+// applied, so headers that decode to the same options get the same key.
+static inline void lys_fuzz_options_key(const uint8_t *hdr, uint8_t *key) {
+    memcpy(key, hdr, 5);
+    uint32_t bits = hdr[5] | ((uint32_t)hdr[6] << 8);
+    if (hdr[7] & 0x40) {
+        bits |= 1u << 3;    // LY_CTX_DISABLE_SEARCHDIRS
+        bits &= ~(1u << 5); // LY_CTX_PREFER_SEARCHDIRS
+    }
+    uint32_t kept = 0;
+    for (int i = 0; i < 16; i++) {
+        if ((bits & (1u << i)) && lys_fuzz_ctx_flags[i]) kept |= 1u << i;
+    }
+    key[5] = (uint8_t)kept;
+    key[6] = (uint8_t)(kept >> 8);
+    key[7] = hdr[7] & 0x7f;
+}
+
+#endif /* LYS_FUZZ_OPTIONS_H */
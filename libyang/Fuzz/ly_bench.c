@@ -0,0 +1,568 @@
+/*
+ * Throughput benchmark for libyang parsing, validation and printing.
+ *
+ * Replays the driver corpora in-process against one cached context and
+ * reports MB/s and ns per data node for every stage and option combination:
+ *
+ *   parse      lyd_parse_data_mem with LYD_PARSE_ONLY (+ LYD_PARSE_OPAQ), or
+ *              parsing and validating in one call (LYD_VALIDATE_PRESENT,
+ *              + NO_STATE, + MULTI_ERROR, or all modules)
+ *   validate   lyd_validate_all on a freshly parsed tree (only the call is timed)
+ *   print      lyd_print_mem to JSON, XML and LYB
+ *   roundtrip  lyd_print_mem and parsing the output back
+ *   schema     ly_ctx_new + lys_parse_mem (+ bundles, lys_fuzz_bundle.h) +
+ *              ly_ctx_destroy per module, next to a ctx-only baseline; for
+ *              these rows a "node" is one module
+ *
+ * Option headers (lyd_fuzz_options.h, lys_fuzz_options.h) are stripped; the
+ * data format is taken from the payload.  Inputs that fail to parse still
+ * count for the parse stages and are left out of the later ones.
+ *
+ * -S adds synthetic inputs of the "bench" module built here, to see how cost
+ * grows with document size: list=N is one document with N list entries
+ * (each with a leafref to an earlier entry), depth=N one with N nested
+ * containers.  Both are generated as JSON and as XML.
+ *
+ * Build:
+ *   gcc -O2 -I../build/libyang -o ly_bench ly_bench.c -L../build -lyang
+ *
+ * Usage:
+ *   ./ly_bench [-t min_ms] [-c] [-S list=N|depth=N]... [dir...]
+ *
+ * Without dirs, lyd_parse_mem_json/input, lyd_parse_mem_xml/input and
+ * lys_parse_mem/input are replayed.  -c prints CSV instead of a table.
+ */
+
+#include <dirent.h>
+#include <stdarg.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "libyang.h"
+#include "common/lyd_fuzz_ctx.h"
+#include "common/lyd_fuzz_options.h"
+#include "common/lys_fuzz_options.h"
+#include "common/lys_fuzz_bundle.h"
+
+#define BENCH_MAX_INPUTS 4096
+#define BENCH_MAX_SETS   32
+
+typedef struct {
+    char *text;             // payload, NUL-terminated
+    size_t len;
+    LYD_FORMAT format;      // data inputs
+    lys_fuzz_options lys;   // schema inputs
+    uint64_t nodes;         // data nodes of the parse-only tree, modules for schemas
+    bool ok;                // parses (data) or compiles (schema)
+} bench_input;
+
+typedef struct {
+    char name[64];
+    bool schema;
+    bench_input *in;
+    int count;
+} bench_set;
+
+static const struct {
+    const char *name;
+    uint32_t parse;
+    uint32_t validate;
+} bench_parse_modes[] = {
+    {"parse-only", LYD_PARSE_ONLY, 0},
+    {"parse-only-opaq", LYD_PARSE_ONLY | LYD_PARSE_OPAQ, 0},
+    {"parse+validate-present", 0, LYD_VALIDATE_PRESENT},
+    {"parse+validate-present-nostate", 0, LYD_VALIDATE_PRESENT | LYD_VALIDATE_NO_STATE},
+    {"parse+validate-present-multierr", 0, LYD_VALIDATE_PRESENT | LYD_VALIDATE_MULTI_ERROR},
+    {"parse+validate-all", 0, 0},
+};
+
+static const struct {
+    const char *name;
+    uint32_t validate;
+} bench_validate_modes[] = {
+    {"validate-present", LYD_VALIDATE_PRESENT},
+    {"validate-all", 0},
+};
+
+static const struct {
+    const char *name;
+    LYD_FORMAT format;
+} bench_print_formats[] = {
+    {"json", LYD_JSON},
+    {"xml", LYD_XML},
+    {"lyb", LYD_LYB},
+};
+
+static const struct ly_ctx *bench_ctx;
+static uint64_t bench_min_ns = 200000000ULL;
+static bool bench_csv;
+
+static uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+static uint64_t count_nodes(const struct lyd_node *first) {
+    uint64_t n = 0;
+    for (const struct lyd_node *d = first; d; d = d->next) {
+        n += 1 + count_nodes(lyd_child(d));
+    }
+    return n;
+}
+
+/* ---- inputs ---- */
+
+static bench_set *new_set(bench_set *sets, int *nsets, const char *name, bool schema) {
+    if (*nsets >= BENCH_MAX_SETS) {
+        return NULL;
+    }
+    bench_set *set = &sets[(*nsets)++];
+    memset(set, 0, sizeof(*set));
+    snprintf(set->name, sizeof(set->name), "%s", name);
+    set->schema = schema;
+    set->in = (bench_input *)calloc(BENCH_MAX_INPUTS, sizeof(bench_input));
+    return set->in ? set : NULL;
+}
+
+static void add_input(bench_set *set, const uint8_t *data, size_t size, LYD_FORMAT native) {
+    if (set->count >= BENCH_MAX_INPUTS) {
+        return;
+    }
+    bench_input *in = &set->in[set->count];
+    memset(in, 0, sizeof(*in));
+    if (set->schema) {
+        if (lys_fuzz_parse_options(data, size, &in->lys)) {
+            data += LYS_FUZZ_OPTIONS_SIZE;
+            size -= LYS_FUZZ_OPTIONS_SIZE;
+        } else {
+            in->lys.ctx_options = LY_CTX_DISABLE_SEARCHDIRS;
+            in->lys.format = LYS_IN_YANG;
+        }
+    } else if (lyd_fuzz_has_options(data, size)) {
+        data += LYD_FUZZ_OPTIONS_SIZE;
+        size -= LYD_FUZZ_OPTIONS_SIZE;
+    }
+    in->text = (char *)malloc(size + 1);
+    if (!in->text) {
+        return;
+    }
+    memcpy(in->text, data, size);
+    in->text[size] = '\0';
+    in->len = size;
+    in->format = native;
+    for (size_t i = 0; i < size; i++) {
+        if (in->text[i] == '{') { in->format = LYD_JSON; break; }
+        if (in->text[i] == '<') { in->format = LYD_XML; break; }
+        if (in->text[i] != ' ' && in->text[i] != '\t' && in->text[i] != '\r' && in->text[i] != '\n') break;
+    }
+    set->count++;
+}
+
+static int load_dir(bench_set *sets, int *nsets, const char *dir) {
+    DIR *d = opendir(dir);
+    if (!d) {
+        perror(dir);
+        return -1;
+    }
+    bool schema = strstr(dir, "lys_") != NULL;
+    LYD_FORMAT native = strstr(dir, "xml") ? LYD_XML : LYD_JSON;
+    // "lyd_parse_mem_json/input" -> "lyd_parse_mem_json"
+    char name[64];
+    size_t len = strlen(dir);
+    while (len && dir[len - 1] == '/') len--;
+    if (len >= 6 && !strncmp(dir + len - 6, "/input", 6)) len -= 6;
+    size_t start = len;
+    while (start && dir[start - 1] != '/') start--;
+    snprintf(name, sizeof(name), "%.*s", (int)(len - start), dir + start);
+    bench_set *set = new_set(sets, nsets, name, schema);
+    struct dirent *e;
+    while (set && (e = readdir(d)) != NULL) {
+        if (e->d_name[0] == '.') continue;
+        char path[4096];
+        snprintf(path, sizeof(path), "%s/%s", dir, e->d_name);
+        FILE *file = fopen(path, "rb");
+        if (!file) continue;
+        fseek(file, 0, SEEK_END);
+        long size = ftell(file);
+        fseek(file, 0, SEEK_SET);
+        uint8_t *data = size > 0 ? (uint8_t *)malloc((size_t)size) : NULL;
+        if (data && fread(data, 1, (size_t)size, file) == (size_t)size) {
+            add_input(set, data, (size_t)size, native);
+        }
+        free(data);
+        fclose(file);
+    }
+    closedir(d);
+    return set ? 0 : -1;
+}
+
+/* ---- synthetic inputs ---- */
+
+typedef struct {
+    char *data;
+    size_t len, cap;
+} bench_buf;
+
+static void put(bench_buf *b, const char *fmt, ...) __attribute__((format(printf, 2, 3)));
+
+static void put(bench_buf *b, const char *fmt, ...) {
+    va_list ap;
+    for (;;) {
+        va_start(ap, fmt);
+        int n = vsnprintf(b->data ? b->data + b->len : NULL, b->data ? b->cap - b->len : 0, fmt, ap);
+        va_end(ap);
+        if (n < 0) return;
+        if (b->data && b->len + (size_t)n < b->cap) {
+            b->len += (size_t)n;
+            return;
+        }
+        size_t cap = b->cap ? b->cap * 2 : 4096;
+        while (cap < b->len + (size_t)n + 1) cap *= 2;
+        char *grown = (char *)realloc(b->data, cap);
+        if (!grown) return;
+        b->data = grown;
+        b->cap = cap;
+    }
+}
+
+// Schema of the synthetic inputs: a list with a leafref into itself and a
+// chain of depth nested containers.
+static char *bench_schema(int depth) {
+    bench_buf b = {0};
+    put(&b, "module bench {yang-version 1.1; namespace urn:bench; prefix b;"
+            "list item {key id; leaf id {type uint32;} leaf name {type string {length 1..32;}}"
+            "leaf-list tag {type string;} leaf ref {type leafref {path /b:item/b:id;}}}");
+    for (int i = 1; i <= depth; i++) {
+        put(&b, "container d%d {leaf v {type string;}", i);
+    }
+    for (int i = 1; i <= depth; i++) {
+        put(&b, "}");
+    }
+    put(&b, "}");
+    return b.data;
+}
+
+static void bench_list_doc(bench_buf *b, int n, LYD_FORMAT format) {
+    if (format == LYD_JSON) {
+        put(b, "{\"bench:item\":[");
+        for (int i = 0; i < n; i++) {
+            put(b, "%s{\"id\":%d,\"name\":\"n%d\",\"tag\":[\"a\",\"b\"],\"ref\":%d}", i ? "," : "", i, i, i / 2);
+        }
+        put(b, "]}");
+    } else {
+        for (int i = 0; i < n; i++) {
+            put(b, "<item xmlns=\"urn:bench\"><id>%d</id><name>n%d</name><tag>a</tag><tag>b</tag>"
+                   "<ref>%d</ref></item>", i, i, i / 2);
+        }
+    }
+}
+
+static void bench_depth_doc(bench_buf *b, int n, LYD_FORMAT format) {
+    for (int i = 1; i <= n; i++) {
+        if (format == LYD_JSON) {
+            put(b, i == 1 ? "{\"bench:d1\":{\"v\":\"x\"" : ",\"d%d\":{\"v\":\"x\"", i);
+        } else {
+            put(b, i == 1 ? "<d1 xmlns=\"urn:bench\"><v>x</v>" : "<d%d><v>x</v>", i);
+        }
+    }
+    for (int i = n; i >= 1; i--) {
+        if (format == LYD_JSON) put(b, "}");
+        else put(b, "</d%d>", i);
+    }
+    if (format == LYD_JSON) put(b, "}");
+}
+
+/* ---- stages ---- */
+
+static void report(const bench_set *set, const char *format, const char *stage, uint64_t bytes,
+                   uint64_t nodes, uint64_t passes, uint64_t ns) {
+    double sec = ns / 1e9;
+    double mbs = sec > 0 ? (double)bytes * passes / sec / 1e6 : 0;
+    double per_node = nodes ? (double)ns / ((double)nodes * passes) : 0;
+    if (bench_csv) {
+        printf("%s,%s,%s,%d,%llu,%llu,%llu,%.3f,%.2f,%.1f\n", set->name, format, stage, set->count,
+               (unsigned long long)bytes, (unsigned long long)nodes, (unsigned long long)passes,
+               ns / 1e6, mbs, per_node);
+    } else {
+        printf("%-20s %-4s %-32s %6d %10llu %9llu %7llu %10.1f %9.2f %9.1f\n", set->name, format, stage,
+               set->count, (unsigned long long)bytes, (unsigned long long)nodes,
+               (unsigned long long)passes, ns / 1e6, mbs, per_node);
+    }
+}
+
+static const char *format_name(LYD_FORMAT format) {
+    return format == LYD_XML ? "xml" : format == LYD_JSON ? "json" : "lyb";
+}
+
+// Parse-only pass that fills nodes/ok; inputs of other formats are skipped.
+static void prepare_data(bench_set *set) {
+    for (int i = 0; i < set->count; i++) {
+        bench_input *in = &set->in[i];
+        struct lyd_node *tree = NULL;
+        in->ok = lyd_parse_data_mem(bench_ctx, in->text, in->format, LYD_PARSE_ONLY, 0, &tree) == LY_SUCCESS;
+        in->nodes = in->ok ? count_nodes(tree) : 0;
+        lyd_free_all(tree);
+    }
+}
+
+static void totals(const bench_set *set, LYD_FORMAT format, bool ok_only, uint64_t *bytes, uint64_t *nodes) {
+    *bytes = *nodes = 0;
+    for (int i = 0; i < set->count; i++) {
+        const bench_input *in = &set->in[i];
+        if (in->format != format || (ok_only && !in->ok)) continue;
+        *bytes += in->len;
+        *nodes += in->nodes;
+    }
+}
+
+static void bench_parse(const bench_set *set, LYD_FORMAT format) {
+    uint64_t bytes, nodes;
+    totals(set, format, false, &bytes, &nodes);
+    if (!bytes) return;
+    for (size_t m = 0; m < sizeof(bench_parse_modes) / sizeof(bench_parse_modes[0]); m++) {
+        uint64_t passes = 0, start = now_ns(), ns;
+        do {
+            for (int i = 0; i < set->count; i++) {
+                const bench_input *in = &set->in[i];
+                if (in->format != format) continue;
+                struct lyd_node *tree = NULL;
+                lyd_parse_data_mem(bench_ctx, in->text, format, bench_parse_modes[m].parse,
+                                   bench_parse_modes[m].validate, &tree);
+                lyd_free_all(tree);
+            }
+            passes++;
+            ns = now_ns() - start;
+        } while (ns < bench_min_ns);
+        report(set, format_name(format), bench_parse_modes[m].name, bytes, nodes, passes, ns);
+    }
+}
+
+static void bench_validate(const bench_set *set, LYD_FORMAT format) {
+    uint64_t bytes, nodes;
+    totals(set, format, true, &bytes, &nodes);
+    if (!bytes) return;
+    for (size_t m = 0; m < sizeof(bench_validate_modes) / sizeof(bench_validate_modes[0]); m++) {
+        uint64_t passes = 0, ns = 0;
+        do {
+            for (int i = 0; i < set->count; i++) {
+                const bench_input *in = &set->in[i];
+                if (in->format != format || !in->ok) continue;
+                struct lyd_node *tree = NULL;
+                lyd_parse_data_mem(bench_ctx, in->text, format, LYD_PARSE_ONLY, 0, &tree);
+                uint64_t start = now_ns();
+                lyd_validate_all(&tree, bench_ctx, bench_validate_modes[m].validate, NULL);
+                ns += now_ns() - start;
+                lyd_free_all(tree);
+            }
+            passes++;
+        } while (ns < bench_min_ns && passes < 1000000);
+        report(set, format_name(format), bench_validate_modes[m].name, bytes, nodes, passes, ns);
+    }
+}
+
+static void bench_print(const bench_set *set, LYD_FORMAT format) {
+    uint64_t bytes, nodes;
+    totals(set, format, true, &bytes, &nodes);
+    if (!bytes) return;
+
+    struct lyd_node **trees = (struct lyd_node **)calloc(set->count, sizeof(*trees));
+    if (!trees) return;
+    for (int i = 0; i < set->count; i++) {
+        const bench_input *in = &set->in[i];
+        if (in->format == format && in->ok) {
+            lyd_parse_data_mem(bench_ctx, in->text, format, LYD_PARSE_ONLY, 0, &trees[i]);
+        }
+    }
+    for (size_t f = 0; f < sizeof(bench_print_formats) / sizeof(bench_print_formats[0]); f++) {
+        LYD_FORMAT out = bench_print_formats[f].format;
+        for (int roundtrip = 0; roundtrip < 2; roundtrip++) {
+            uint64_t passes = 0, start = now_ns(), ns;
+            do {
+                for (int i = 0; i < set->count; i++) {
+                    if (!trees[i]) continue;
+                    char *str = NULL;
+                    lyd_print_mem(&str, trees[i], out, LYD_PRINT_WITHSIBLINGS);
+                    if (roundtrip && str) {
+                        struct lyd_node *back = NULL;
+                        lyd_parse_data_mem(bench_ctx, str, out, LYD_PARSE_ONLY, 0, &back);
+                        lyd_free_all(back);
+                    }
+                    free(str);
+                }
+                passes++;
+                ns = now_ns() - start;
+            } while (ns < bench_min_ns);
+            char stage[48];
+            snprintf(stage, sizeof(stage), "%s-%s", roundtrip ? "roundtrip" : "print", bench_print_formats[f].name);
+            report(set, format_name(format), stage, bytes, nodes, passes, ns);
+        }
+    }
+    for (int i = 0; i < set->count; i++) {
+        lyd_free_all(trees[i]);
+    }
+    free(trees);
+}
+
+static LY_ERR parse_schema(const bench_input *in) {
+    struct ly_ctx *ctx = NULL;
+    if (ly_ctx_new(NULL, in->lys.ctx_options, &ctx) != LY_SUCCESS) {
+        return LY_EINT;
+    }
+    LY_ERR err = LY_SUCCESS;
+    if (in->lys.bundle) {
+        // The modules are already NUL-separated in the text, and
+        // lys_fuzz_bundle_split only points into it, so no copy is needed
+        lys_fuzz_bundle bundle;
+        lys_fuzz_bundle_split(in->text, in->len, in->lys.format, &bundle);
+        ly_ctx_set_module_imp_clb(ctx, lys_fuzz_bundle_imp_clb, &bundle);
+        for (int i = 0; i < bundle.count; i++) {
+            LY_ERR e = lys_parse_mem(ctx, bundle.mod[i].data, in->lys.format, NULL);
+            if (e != LY_SUCCESS && e != LY_EEXIST) err = e;
+        }
+        ly_ctx_destroy(ctx);
+    } else {
+        err = lys_parse_mem(ctx, in->text, in->lys.format, NULL);
+        ly_ctx_destroy(ctx);
+    }
+    return err;
+}
+
+static void bench_schema_set(bench_set *set) {
+    uint64_t bytes = 0, modules = 0;
+    for (int i = 0; i < set->count; i++) {
+        bench_input *in = &set->in[i];
+        in->ok = parse_schema(in) == LY_SUCCESS;
+        in->nodes = 1;
+        if (in->lys.bundle) {
+            for (size_t j = 0; j < in->len; j++) in->nodes += in->text[j] == '\0';
+        }
+        bytes += in->len;
+        modules += in->nodes;
+    }
+
+    uint64_t passes = 0, start = now_ns(), ns;
+    do {
+        for (int i = 0; i < set->count; i++) {
+            struct ly_ctx *ctx = NULL;
+            if (ly_ctx_new(NULL, set->in[i].lys.ctx_options, &ctx) == LY_SUCCESS) ly_ctx_destroy(ctx);
+        }
+        passes++;
+        ns = now_ns() - start;
+    } while (ns < bench_min_ns);
+    report(set, "yang", "ctx-new-destroy", bytes, modules, passes, ns);
+
+    passes = 0;
+    start = now_ns();
+    do {
+        for (int i = 0; i < set->count; i++) {
+            parse_schema(&set->in[i]);
+        }
+        passes++;
+        ns = now_ns() - start;
+    } while (ns < bench_min_ns);
+    report(set, "yang", "ctx+lys_parse_mem", bytes, modules, passes, ns);
+}
+
+static void bench_data_set(bench_set *set) {
+    prepare_data(set);
+    const LYD_FORMAT formats[] = {LYD_JSON, LYD_XML};
+    for (int f = 0; f < 2; f++) {
+        bench_parse(set, formats[f]);
+        bench_validate(set, formats[f]);
+        bench_print(set, formats[f]);
+    }
+}
+
+static void usage(const char *argv0) {
+    fprintf(stderr, "Usage: %s [-t min_ms] [-c] [-S list=N|depth=N]... [dir...]\n", argv0);
+}
+
+int main(int argc, char **argv) {
+    static bench_set sets[BENCH_MAX_SETS];
+    int nsets = 0;
+    int scale_list[16], nlist = 0, scale_depth[16], ndepth = 0, max_depth = 1;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "t:cS:")) != -1) {
+        switch (opt) {
+        case 't':
+            bench_min_ns = strtoull(optarg, NULL, 0) * 1000000ULL;
+            break;
+        case 'c':
+            bench_csv = true;
+            break;
+        case 'S':
+            if (!strncmp(optarg, "list=", 5) && nlist < 16) {
+                scale_list[nlist++] = atoi(optarg + 5);
+            } else if (!strncmp(optarg, "depth=", 6) && ndepth < 16) {
+                scale_depth[ndepth] = atoi(optarg + 6);
+                if (scale_depth[ndepth] > max_depth) max_depth = scale_depth[ndepth];
+                ndepth++;
+            } else {
+                usage(argv[0]);
+                return EXIT_FAILURE;
+            }
+            break;
+        default:
+            usage(argv[0]);
+            return EXIT_FAILURE;
+        }
+    }
+
+    ly_log_options(0);
+    struct ly_ctx *ctx = lyd_fuzz_ctx_build(0);
+    char *schema = bench_schema(max_depth);
+    if (!ctx || !schema || lys_parse_mem(ctx, schema, LYS_IN_YANG, NULL) != LY_SUCCESS) {
+        fprintf(stderr, "Failed to build the benchmark context\n");
+        ly_ctx_destroy(ctx);
+        free(schema);
+        return EXIT_FAILURE;
+    }
+    free(schema);
+    bench_ctx = ctx;
+
+    if (optind < argc) {
+        for (int i = optind; i < argc; i++) load_dir(sets, &nsets, argv[i]);
+    } else {
+        load_dir(sets, &nsets, "lyd_parse_mem_json/input");
+        load_dir(sets, &nsets, "lyd_parse_mem_xml/input");
+        load_dir(sets, &nsets, "lys_parse_mem/input");
+    }
+    for (int s = 0; s < nlist + ndepth; s++) {
+        bool list = s < nlist;
+        int n = list ? scale_list[s] : scale_depth[s - nlist];
+        char name[64];
+        snprintf(name, sizeof(name), "%s-%d", list ? "list" : "depth", n);
+        bench_set *set = new_set(sets, &nsets, name, false);
+        const LYD_FORMAT formats[] = {LYD_JSON, LYD_XML};
+        for (int f = 0; set && f < 2; f++) {
+            bench_buf b = {0};
+            if (list) bench_list_doc(&b, n, formats[f]);
+            else bench_depth_doc(&b, n, formats[f]);
+            if (b.data) add_input(set, (const uint8_t *)b.data, b.len, formats[f]);
+            free(b.data);
+        }
+    }
+
+    if (bench_csv) {
+        printf("set,format,stage,inputs,bytes,nodes,passes,total_ms,mb_per_s,ns_per_node\n");
+    } else {
+        printf("%-20s %-4s %-32s %6s %10s %9s %7s %10s %9s %9s\n", "set", "fmt", "stage", "inputs",
+               "bytes", "nodes", "passes", "total_ms", "MB/s", "ns/node");
+    }
+    for (int s = 0; s < nsets; s++) {
+        if (sets[s].schema) bench_schema_set(&sets[s]);
+        else bench_data_set(&sets[s]);
+        for (int i = 0; i < sets[s].count; i++) free(sets[s].in[i].text);
+        free(sets[s].in);
+    }
+
+    ly_ctx_destroy(ctx);
+    return EXIT_SUCCESS;
+}
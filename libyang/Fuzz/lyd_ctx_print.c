@@ -0,0 +1,62 @@
+/*
+ * Build step for the printed-context blob of the lyd_parse_mem AFL drivers
+ * (common/lyd_fuzz_printed.h).
+ *
+ * Compiles every context variant of common/lyd_fuzz_ctx.h once, prints them
+ * at a fixed base address and writes the result to a file.  Drivers built
+ * with -DLYD_FUZZ_PRINTED_CTX map that file at startup instead of compiling
+ * the schemas.  Rerun it whenever libyang or the schemas change; the drivers
+ * detect a stale blob and fall back to compiling from source.
+ *
+ * Build:
+ *   gcc -O2 -I../build/libyang -o lyd_ctx_print lyd_ctx_print.c -L../build -lyang
+ *
+ * Usage:
+ *   ./lyd_ctx_print [-b base_address] <output_file>
+ */
+
+#define LYD_FUZZ_PRINTED_CTX 1
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "libyang.h"
+#include "common/lyd_fuzz_ctx.h"
+
+int main(int argc, char **argv) {
+    uint64_t base = LYD_FUZZ_PRINTED_BASE;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "b:")) != -1) {
+        switch (opt) {
+        case 'b':
+            base = strtoull(optarg, NULL, 0);
+            break;
+        default:
+            fprintf(stderr, "Usage: %s [-b base_address] <output_file>\n", argv[0]);
+            return EXIT_FAILURE;
+        }
+    }
+    if (optind >= argc) {
+        fprintf(stderr, "Usage: %s [-b base_address] <output_file>\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    ly_log_options(LY_LOLOG);
+    if (lyd_fuzz_printed_write(argv[optind], base) != 0) {
+        return EXIT_FAILURE;
+    }
+
+    // Check the blob loads back the way the drivers will load it.
+    if (lyd_fuzz_printed_load(argv[optind]) != 0) {
+        fprintf(stderr, "Written blob does not load back\n");
+        return EXIT_FAILURE;
+    }
+    lyd_fuzz_ctx_fini();
+
+    fprintf(stderr, "wrote %d contexts to %s at base 0x%llx\n", LYD_FUZZ_CTX_VARIANTS,
+            argv[optind], (unsigned long long)base);
+    return EXIT_SUCCESS;
+}
@@ -3,6 +3,7 @@
 #include <stdbool.h>
 
 #include "libyang.h"
+#include "../common/lyd_fuzz_options.h"
 
 int LLVMFuzzerTestOneInput(uint8_t const *buf, size_t len)
 {
@@ -69,6 +70,12 @@ int LLVMFuzzerTestOneInput(uint8_t const *buf, size_t len)
     lys_parse_mem(ctx, schema_a, LYS_IN_YANG, NULL);
     lys_parse_mem(ctx, schema_b, LYS_IN_YANG, NULL);
 
+    /* The shared corpus is written for the AFL driver; skip its option header. */
+    if (lyd_fuzz_has_options(buf, len)) {
+        buf += LYD_FUZZ_OPTIONS_SIZE;
+        len -= LYD_FUZZ_OPTIONS_SIZE;
+    }
+
     data = malloc(len + 1);
     if (data == NULL) {
         return 0;
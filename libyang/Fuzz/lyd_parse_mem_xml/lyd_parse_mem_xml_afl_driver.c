@@ -3,126 +3,104 @@
 #include <stdbool.h>
 #include <string.h>
 #include "libyang.h"
-
-// Helper function to read options from input data
-uint32_t get_options_from_data(const uint8_t* data, size_t* offset, size_t max_size) {
-    uint32_t options = 0;
-    if (*offset + sizeof(uint32_t) <= max_size) {
-        memcpy(&options, data + *offset, sizeof(uint32_t));
-        *offset += sizeof(uint32_t);
+#include "../common/lyd_fuzz_ctx.h"
+#include "../common/lyd_fuzz_options.h"
+#include "../common/ly_fuzz_in.h"
+#include "../common/ly_fuzz_log.h"
+#include "../../../optstats/optstats.h"
+
+// Persistent mode when built with afl-clang-fast; -DLYD_FUZZ_NO_PERSISTENT disables it
+#if defined(__AFL_FUZZ_TESTCASE_LEN) && !defined(LYD_FUZZ_NO_PERSISTENT)
+#define LYD_FUZZ_PERSISTENT 1
+#ifndef LYD_FUZZ_LOOP_COUNT
+#define LYD_FUZZ_LOOP_COUNT 10000
+#endif
+__AFL_FUZZ_INIT();
+#endif
+
+// Per-exec work: pick the cached context, parse the data, free the tree.
+// The input is an option header (common/lyd_fuzz_options.h) followed by the
+// data, so no option byte is ever part of the parsed document.  libyang
+// reads the data in place, so input_data[size] must be a NUL byte.
+static void parse_input(const uint8_t* input_data, size_t size) {
+    lyd_fuzz_options opts;
+    if (!lyd_fuzz_parse_options(input_data, size, LYD_XML, &opts)) {
+        return;
+    }
+    ly_log_options(opts.log_options);
+    const struct ly_ctx* ctx = lyd_fuzz_ctx_get(opts.ctx_options);
+
+    struct ly_in* in = ly_fuzz_in((const char*)input_data + LYD_FUZZ_OPTIONS_SIZE);
+    if (!in) return;
+
+    // Publish the option tuple of this exec (optstats/optstats.h)
+    uint8_t key[LYD_FUZZ_OPTIONS_SIZE];
+    lyd_fuzz_options_key(input_data, key);
+    if (optstats_begin(key, sizeof(key))) {
+        optstats_label("variant=%d log=0x%x format=%s parse=0x%x validate=0x%x",
+                       lyd_fuzz_ctx_variant(opts.ctx_options), opts.log_options,
+                       opts.format == LYD_JSON ? "json" : opts.format == LYD_XML ? "xml" : "lyb",
+                       opts.parse_options, opts.validate_options);
     }
-    return options;
+
+    // Messages go to the log ring (common/ly_fuzz_log.h), not to stderr
+    ly_fuzz_log_begin(size);
+    struct lyd_node *tree = NULL;
+    LY_ERR ret = lyd_parse_data(ctx, NULL, in, opts.format, opts.parse_options, opts.validate_options, &tree);
+    ly_fuzz_log_end(ctx, ret);
+
+    // Only the data tree is per-exec; the context and the input handle are reused
+    lyd_free_all(tree);
+    optstats_end();
 }
 
 int main(int argc, char** argv) {
+#ifndef LYD_FUZZ_PERSISTENT
     if (argc != 2) {
         fprintf(stderr, "Usage: %s <input_file>\n", argv[0]);
         return 0;
     }
+#endif
 
-    FILE* file = fopen(argv[1], "r");
-    if (!file) return 0;
-
-    if (fseeko(file, 0, SEEK_END) != 0) {
-        fprintf(stderr, "fseeko error!\n");
-        return 0;
-    }
-    size_t size = ftello(file);
-
-    if (fseeko(file, 0, SEEK_SET) != 0) {
-        fprintf(stderr, "fseeko error!\n");
-        return 0;
-    }
-
-    uint8_t* input_data = (uint8_t*)malloc(size);
-    if (!input_data) {
-        fclose(file);
-        return 0;
-    }
-
-    if (fread(input_data, 1, size, file) != size) {
-        free(input_data);
-        fclose(file);
-        return 0;
-    }
-    fclose(file);
-
-    // Keep track of where we are in the input data
-    size_t offset = 0;
-
-    struct ly_ctx *ctx = NULL;
-    static bool log = false;
-
-    // Get options for ly_log_options from input
-    uint32_t log_opts = get_options_from_data(input_data, &offset, size);
-    if (!log) {
-        ly_log_options(log_opts);
-        log = true;
-    }
-
-    // Get options for ly_ctx_new from input
-    uint32_t ctx_opts = get_options_from_data(input_data, &offset, size);
-    LY_ERR err = ly_ctx_new(NULL, ctx_opts, &ctx);
-    if (err != LY_SUCCESS) {
-        free(input_data);
+    // One-time setup: the schema contexts for every ly_ctx_new option variant
+    ly_log_options(0);
+    ly_fuzz_log_init();
+    optstats_init("lyd_parse_mem_xml");
+    if (lyd_fuzz_ctx_init() != 0) {
         return 0;
     }
 
-    const char *schema_a =
-            "module defs {namespace urn:tests:defs;prefix d;yang-version 1.1;"
-            "identity crypto-alg; identity interface-type; identity ethernet {base interface-type;}"
-            "identity fast-ethernet {base ethernet;}}";
-    const char *schema_b =
-            "module types {namespace urn:tests:types;prefix t;yang-version 1.1; import defs {prefix defs;}"
-            "feature f; identity gigabit-ethernet { base defs:ethernet;}"
-            // ... [rest of schema_b definition remains the same]
-            "type string {length 1..20;}}}}";
-
-    // Parse schemas - note that we don't fuzz the module parameter as it's for output
-    struct lys_module *module_a = NULL;
-    if (lys_parse_mem(ctx, schema_a, LYS_IN_YANG, &module_a) != LY_SUCCESS) {
-        ly_ctx_destroy(ctx);
-        free(input_data);
-        return 0;
+#ifdef __AFL_HAVE_MANUAL_CONTROL
+    // Deferred forkserver: children start with the contexts already compiled
+    __AFL_INIT();
+#endif
+
+    if (argc >= 2) {
+        ly_fuzz_map map;
+        if (ly_fuzz_map_file(argv[1], &map) == 0) {
+            parse_input(map.data, map.size);
+            ly_fuzz_unmap(&map);
+        }
     }
-
-    struct lys_module *module_b = NULL;
-    if (lys_parse_mem(ctx, schema_b, LYS_IN_YANG, &module_b) != LY_SUCCESS) {
-        ly_ctx_destroy(ctx);
-        free(input_data);
-        return 0;
+#ifdef LYD_FUZZ_PERSISTENT
+    else {
+        // Persistent mode: testcases arrive through shared memory and are
+        // terminated in place
+        uint8_t* buf = __AFL_FUZZ_TESTCASE_BUF;
+        size_t cap = ly_fuzz_testcase_cap();
+        while (__AFL_LOOP(LYD_FUZZ_LOOP_COUNT)) {
+            size_t len = __AFL_FUZZ_TESTCASE_LEN;
+            const char* text = ly_fuzz_terminate(buf, len, cap);
+            if (text) {
+                parse_input((const uint8_t*)text, len);
+            }
+        }
     }
-
-    // The remaining data is our YANG data to parse
-    if (offset >= size) {
-        ly_ctx_destroy(ctx);
-        free(input_data);
-        return 0;
-    }
-
-    size_t data_size = size - offset;
-    char* yang_data = malloc(data_size + 1);
-    if (!yang_data) {
-        ly_ctx_destroy(ctx);
-        free(input_data);
-        return 0;
-    }
-    memcpy(yang_data, input_data + offset, data_size);
-    yang_data[data_size] = 0;
-
-    // Get options for lyd_parse_data_mem from input
-    uint32_t format_opts = get_options_from_data(input_data, &offset, size);
-    uint32_t parse_data_opts = get_options_from_data(input_data, &offset, size);
-    uint32_t validate_opts = get_options_from_data(input_data, &offset, size);
-
-    struct lyd_node *tree = NULL;
-    lyd_parse_data_mem(ctx, yang_data, format_opts, parse_data_opts, validate_opts, &tree);
+#endif
 
     // Cleanup
-    lyd_free_all(tree);
-    ly_ctx_destroy(ctx);
-    free(yang_data);
-    free(input_data);
+    ly_fuzz_in_fini();
+    lyd_fuzz_ctx_fini();
 
     return 0;
-}
\ No newline at end of file
+}
@@ -0,0 +1,108 @@
+/*
+ * Seed generator for the lyd_parse_mem drivers (common/lyd_gen.h).
+ *
+ * Compiles the context of common/lyd_fuzz_ctx.h, walks the "types" module
+ * and writes count instances, each behind a default option header
+ * (common/lyd_fuzz_options.h).  Most instances are valid; every fourth one
+ * (or the share given with -i) is near-valid, with a value, reference or
+ * entry count just past its constraint.
+ *
+ * Build:
+ *   gcc -O2 -I../build/libyang -o lyd_seeds_gen lyd_seeds_gen.c -L../build -lyang
+ *
+ * Usage:
+ *   ./lyd_seeds_gen [-n count] [-s seed] [-f json|xml] [-i near_valid_percent] <output_dir>
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "libyang.h"
+#include "common/lyd_fuzz_ctx.h"
+#include "common/lyd_fuzz_options.h"
+#include "common/lyd_gen.h"
+
+static void usage(const char *argv0) {
+    fprintf(stderr, "Usage: %s [-n count] [-s seed] [-f json|xml] [-i near_valid_percent] <output_dir>\n",
+            argv0);
+}
+
+int main(int argc, char **argv) {
+    int count = 64;
+    uint64_t seed = 1;
+    LYD_FORMAT format = LYD_JSON;
+    int near_share = 25;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "n:s:f:i:")) != -1) {
+        switch (opt) {
+        case 'n':
+            count = atoi(optarg);
+            break;
+        case 's':
+            seed = strtoull(optarg, NULL, 0);
+            break;
+        case 'f':
+            if (!strcmp(optarg, "json")) {
+                format = LYD_JSON;
+            } else if (!strcmp(optarg, "xml")) {
+                format = LYD_XML;
+            } else {
+                usage(argv[0]);
+                return EXIT_FAILURE;
+            }
+            break;
+        case 'i':
+            near_share = atoi(optarg);
+            break;
+        default:
+            usage(argv[0]);
+            return EXIT_FAILURE;
+        }
+    }
+    if (optind >= argc) {
+        usage(argv[0]);
+        return EXIT_FAILURE;
+    }
+    const char *outdir = argv[optind];
+
+    ly_log_options(LY_LOLOG);
+    struct ly_ctx *ctx = lyd_fuzz_ctx_build(0);
+    lyd_gen g;
+    if (!ctx || lyd_gen_init(&g, ctx, "types", seed) != 0) {
+        fprintf(stderr, "Failed to build the types schema\n");
+        ly_ctx_destroy(ctx);
+        return EXIT_FAILURE;
+    }
+
+    uint8_t header[LYD_FUZZ_OPTIONS_SIZE];
+    lyd_fuzz_default_header(header);
+    int written = 0;
+    for (int i = 0; i < count; i++) {
+        bool near = (int)lyd_gen_below(&g, 100) < near_share;
+        g.near_pct = near ? 10 : 0;
+        lyd_gen_node *root = lyd_gen_generate(&g);
+        lyd_gen_buf text = {0};
+        lyd_gen_print(&g, root, format, &text);
+        lyd_gen_free(root);
+
+        char path[4096];
+        snprintf(path, sizeof(path), "%s/gen_%s_%04d", outdir, near ? "near" : "valid", i);
+        FILE *file = fopen(path, "wb");
+        if (!file || fwrite(header, 1, sizeof(header), file) != sizeof(header) ||
+            fwrite(text.data, 1, text.len, file) != text.len) {
+            perror(path);
+        } else {
+            written++;
+        }
+        if (file) fclose(file);
+        free(text.data);
+    }
+
+    ly_ctx_destroy(ctx);
+    fprintf(stderr, "wrote %d seeds to %s\n", written, outdir);
+    return written == count ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -3,6 +3,7 @@
 #include <stdbool.h>
 
 #include "libyang.h"
+#include "../common/lys_fuzz_options.h"
 
 int LLVMFuzzerTestOneInput(uint8_t const *buf, size_t len)
 {
@@ -22,6 +23,12 @@ int LLVMFuzzerTestOneInput(uint8_t const *buf, size_t len)
         exit(EXIT_FAILURE);
     }
 
+    /* The shared corpus is written for the AFL driver; skip its option header. */
+    if (lys_fuzz_has_options(buf, len)) {
+        buf += LYS_FUZZ_OPTIONS_SIZE;
+        len -= LYS_FUZZ_OPTIONS_SIZE;
+    }
+
     data = malloc(len + 1);
     if (data == NULL) {
         return 0;
@@ -4,6 +4,11 @@
 #include <stdint.h>
 #include <string.h>
 #include "libyang.h"
+#include "../common/lys_fuzz_options.h"
+#include "../common/lys_fuzz_bundle.h"
+#include "../common/ly_fuzz_in.h"
+#include "../common/ly_fuzz_log.h"
+#include "../../../optstats/optstats.h"
 
 int main(int argc, char** argv) {
     if (argc < 2) {
@@ -11,80 +16,89 @@ int main(int argc, char** argv) {
         return 1;
     }
 
-    FILE* file = fopen(argv[1], "rb");
-    if (!file) {
-        perror("Failed to open input file");
-        return 1;
-    }
-
-    if (fseeko(file, 0, SEEK_END) != 0) {
-        fprintf(stderr, "fseeko error!\n");
-        fclose(file);
-        return 1;
-    }
+    // 日志经回调写入进程内环形缓冲区（common/ly_fuzz_log.h），不输出到 stderr，仅在崩溃或超时时转储
+    ly_fuzz_log_init();
+    // 设置 OPTSTATS_FILE 时把每次执行的选项组合发布到共享表（optstats/optstats.h）
+    optstats_init("lys_parse_mem");
 
-    size_t size = ftello(file);
-    if (fseeko(file, 0, SEEK_SET) != 0) {
-        fprintf(stderr, "fseeko error!\n");
-        fclose(file);
+    // 以只读方式映射输入文件，映射末尾保证有 '\0'，libyang 直接在映射上解析，不再拷贝
+    ly_fuzz_map map;
+    if (ly_fuzz_map_file(argv[1], &map) != 0) {
         return 1;
     }
+    const uint8_t* data = map.data;
+    size_t size = map.size;
 
     if (size == 0) {
         fprintf(stderr, "Input file is empty\n");
-        fclose(file);
+        ly_fuzz_unmap(&map);
         return 1;
     }
 
-    uint8_t* data = (uint8_t*)malloc(size);
-    if (!data) {
-        perror("Failed to allocate memory");
-        fclose(file);
-        return 1;
+    // 选项来自输入开头的选项头（common/lys_fuzz_options.h），不再依赖文件大小；
+    // 每个取值都对应合法的 LY_CTX_* 组合与 LYS_IN_* 格式
+    lys_fuzz_options opts;
+    if (!lys_fuzz_parse_options(data, size, &opts)) {
+        ly_fuzz_unmap(&map);
+        return 0;
     }
-
-    if (fread(data, 1, size, file) != size) {
-        perror("Failed to read input file");
-        free(data);
-        fclose(file);
-        return 1;
+    uint8_t key[LYS_FUZZ_OPTIONS_SIZE];
+    lys_fuzz_options_key(data, key);
+    if (optstats_begin(key, sizeof(key))) {
+        optstats_label("ctx=0x%x format=%s log=0x%x level=%d bundle=%d", opts.ctx_options,
+                       opts.format == LYS_IN_YIN ? "yin" : "yang", opts.log_options,
+                       (int)opts.log_level, (int)opts.bundle);
     }
-    fclose(file);
-
-    // 动态生成选项
-    uint32_t ctx_options = size % 0xFFFF; // 根据文件大小生成一个 16 位的选项值
-    uint32_t format_option = size % 10;   // 根据文件大小决定格式（0, 1, 2 对应合法的 LYS_IN_* 枚举）
-    const char* yang_data = (const char*)data;
-    size_t yang_data_len = size;
+    const char* yang_data = (const char*)data + LYS_FUZZ_OPTIONS_SIZE;
+    size_t yang_data_len = size - LYS_FUZZ_OPTIONS_SIZE;
+    struct ly_in* in = NULL;
 
     struct ly_ctx* ctx = NULL;
-    LY_ERR err = ly_ctx_new(NULL, ctx_options, &ctx);
+    LY_ERR err = ly_ctx_new(NULL, opts.ctx_options, &ctx);
     if (err != LY_SUCCESS) {
-        fprintf(stderr, "Failed to create context with options: 0x%X\n", ctx_options);
-        free(data);
+        fprintf(stderr, "Failed to create context with options: 0x%X\n", opts.ctx_options);
+        optstats_end();
+        ly_fuzz_unmap(&map);
         return 1;
     }
 
-    ly_log_options(size % 8); // 动态设置日志选项：0-禁用，1-错误，2-警告，3-调试
+    ly_log_options(opts.log_options); // 日志选项：LY_LOLOG / LY_LOSTORE / LY_LOSTORE_LAST
+    ly_log_level(opts.log_level);     // 日志级别：错误、警告、详细、调试
+    ly_fuzz_log_begin(size);
+    LY_ERR ret = LY_SUCCESS;
 
-    // 为 YANG 数据添加终止符
-    char* yang_buffer = (char*)malloc(yang_data_len + 1);
-    if (!yang_buffer) {
-        perror("Failed to allocate memory for YANG data");
-        ly_ctx_destroy(ctx);
-        free(data);
-        return 1;
+    if (opts.bundle) {
+        // 模块包：按顺序解析包内每个模块，import/include 由回调从包内存中提供，不访问磁盘
+        lys_fuzz_bundle bundle;
+        lys_fuzz_bundle_split(yang_data, yang_data_len, opts.format, &bundle);
+        ly_ctx_set_module_imp_clb(ctx, lys_fuzz_bundle_imp_clb, &bundle);
+        for (int i = 0; i < bundle.count; i++) {
+            // 同一个输入句柄依次指向包内各模块
+            in = ly_fuzz_in(bundle.mod[i].data);
+            if (in) {
+                LY_ERR r = lys_parse(ctx, in, opts.format, NULL, NULL);
+                if (r != LY_SUCCESS && ret == LY_SUCCESS) {
+                    ret = r; // 记录包内第一个失败模块的错误码
+                }
+            }
+        }
+        ly_fuzz_log_end(ctx, ret);
+        ly_ctx_destroy(ctx); // 回调引用栈上的 bundle，先销毁上下文
+        ctx = NULL;
+    } else {
+        // 解析 YANG 数据
+        in = ly_fuzz_in(yang_data);
+        if (in) {
+            ret = lys_parse(ctx, in, opts.format, NULL, NULL);
+        }
+        ly_fuzz_log_end(ctx, ret);
     }
-    memcpy(yang_buffer, yang_data, yang_data_len);
-    yang_buffer[yang_data_len] = '\0';
-
-    // 解析 YANG 数据
-    lys_parse_mem(ctx, yang_buffer, format_option, NULL);
 
     // 释放资源
-    free(yang_buffer);
+    ly_fuzz_in_fini();
     ly_ctx_destroy(ctx);
-    free(data);
+    optstats_end();
+    ly_fuzz_unmap(&map);
 
     return 0;
 }
@@ -0,0 +1,219 @@
+/*
+ * AFL++ custom mutator for the lyd_parse_mem JSON and XML drivers.
+ *
+ * Reads the data after the option header (common/lyd_fuzz_options.h) back
+ * into a lyd_gen tree, applies node-level and value-level mutations driven by
+ * the compiled "types" schema (common/lyd_gen.h) and prints the tree in the
+ * format the output header selects.  Inputs that libyang cannot parse even as
+ * opaque data are replaced by a freshly generated instance.  The option header
+ * is kept as is, or a default one is added.  With OPTSTATS_FILE set (the same
+ * table the driver publishes to, optstats/optstats.h), one call in eight
+ * replaces the header with an option tuple picked by the optstats scheduler;
+ * other header changes are left to the other mutators.
+ *
+ * The header format byte is relative to the driver's native format, so the
+ * mutator learns that format from the driver name in the optstats table or
+ * from the first input whose header and payload agree on it.  A picked tuple
+ * that selects LYB, which lyd_gen cannot print, keeps the input's format byte.
+ *
+ * LYD_GEN_NEAR sets the near-valid percentage of each decision (default 10).
+ *
+ * Build:
+ *   gcc -O2 -shared -fPIC -I../../build/libyang -o lyd_gen_mutator.so lyd_gen_mutator.c -L../../build -lyang -lm
+ * Use:
+ *   AFL_CUSTOM_MUTATOR_LIBRARY=./lyd_gen_mutator.so afl-fuzz ...
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "libyang.h"
+#include "../common/lyd_fuzz_ctx.h"
+#include "../common/lyd_fuzz_options.h"
+#include "../common/lyd_gen.h"
+#include "../../../optstats/optstats.h"
+
+typedef struct {
+    struct ly_ctx *ctx;
+    lyd_gen gen;
+    LYD_FORMAT native;          // the driver's native format, LYD_UNKNOWN until known
+    int near_pct;
+    uint8_t *out;
+    size_t out_cap;
+    char *text;
+    size_t text_cap;
+    optstats_sched sched;
+} lyd_gen_mutator;
+
+static bool reserve(uint8_t **buf, size_t *cap, size_t n) {
+    if (n <= *cap) {
+        return true;
+    }
+    uint8_t *grown = (uint8_t *)realloc(*buf, n);
+    if (!grown) {
+        return false;
+    }
+    *buf = grown;
+    *cap = n;
+    return true;
+}
+
+// NUL-terminated copy of the payload of an input, for lyd_parse_data_mem.
+static const char *payload_text(lyd_gen_mutator *m, const uint8_t *buf, size_t size, LYD_FORMAT *format) {
+    *format = LYD_UNKNOWN;
+    if (lyd_fuzz_has_options(buf, size)) {
+        buf += LYD_FUZZ_OPTIONS_SIZE;
+        size -= LYD_FUZZ_OPTIONS_SIZE;
+    }
+    if (!reserve((uint8_t **)&m->text, &m->text_cap, size + 1)) {
+        return NULL;
+    }
+    memcpy(m->text, buf, size);
+    m->text[size] = '\0';
+    *format = lyd_gen_detect(m->text, size);
+    return m->text;
+}
+
+static LYD_FORMAT other_text_format(LYD_FORMAT format) {
+    return format == LYD_JSON ? LYD_XML : LYD_JSON;
+}
+
+// Format a header selects for a driver whose native format is native, as
+// lyd_fuzz_parse_options() decodes its format byte.
+static LYD_FORMAT header_format(const uint8_t *header, LYD_FORMAT native) {
+    switch (header[6] % 3) {
+    case 0: return native;
+    case 1: return other_text_format(native);
+    default: return LYD_LYB;
+    }
+}
+
+// Learns the driver's native format: from the driver name in the optstats
+// table, or from an input with a header whose payload is in the format the
+// header selects (format byte 0: native, 1: the other text format).
+static void learn_native(lyd_gen_mutator *m, const uint8_t *buf, size_t size, LYD_FORMAT payload) {
+    if (m->native != LYD_UNKNOWN) {
+        return;
+    }
+    if (m->sched.table) {
+        const char *driver = m->sched.table->driver;
+        if (strstr(driver, "_json")) {
+            m->native = LYD_JSON;
+            return;
+        }
+        if (strstr(driver, "_xml")) {
+            m->native = LYD_XML;
+            return;
+        }
+    }
+    if (payload == LYD_UNKNOWN || !lyd_fuzz_has_options(buf, size)) {
+        return;
+    }
+    if (header_format(buf, payload) != LYD_LYB) {
+        // The payload is in header_format(buf, native), and both text
+        // formats map onto each other the same way.
+        m->native = header_format(buf, payload);
+    }
+}
+
+static lyd_gen_node *read_tree(lyd_gen_mutator *m, const uint8_t *buf, size_t size, LYD_FORMAT *format) {
+    const char *text = payload_text(m, buf, size, format);
+    if (!text || *format == LYD_UNKNOWN) {
+        return NULL;
+    }
+    return lyd_gen_parse(&m->gen, m->ctx, text, *format);
+}
+
+void *afl_custom_init(void *afl, unsigned int seed) {
+    (void)afl;
+    lyd_gen_mutator *m = (lyd_gen_mutator *)calloc(1, sizeof(*m));
+    if (!m) {
+        return NULL;
+    }
+    ly_log_options(0);
+    m->ctx = lyd_fuzz_ctx_build(0);
+    if (!m->ctx || lyd_gen_init(&m->gen, m->ctx, "types", ((uint64_t)seed << 1) | 1) != 0) {
+        ly_ctx_destroy(m->ctx);
+        free(m);
+        return NULL;
+    }
+    m->native = LYD_UNKNOWN;
+    const char *near = getenv("LYD_GEN_NEAR");
+    m->near_pct = near ? atoi(near) : 10;
+    optstats_sched_init(&m->sched, LYD_FUZZ_OPTIONS_MAGIC, 4);
+    return m;
+}
+
+size_t afl_custom_fuzz(void *data, uint8_t *buf, size_t buf_size, uint8_t **out_buf,
+                       uint8_t *add_buf, size_t add_buf_size, size_t max_size) {
+    lyd_gen_mutator *m = (lyd_gen_mutator *)data;
+
+    uint8_t header[LYD_FUZZ_OPTIONS_SIZE];
+    if (lyd_fuzz_has_options(buf, buf_size)) {
+        memcpy(header, buf, LYD_FUZZ_OPTIONS_SIZE);
+    } else {
+        lyd_fuzz_default_header(header);
+    }
+    uint8_t key[OPTSTATS_KEY_MAX];
+    if (lyd_gen_below(&m->gen, 8) == 0 &&
+        optstats_sched_pick(&m->sched, lyd_gen_rand64(&m->gen), key) == LYD_FUZZ_OPTIONS_SIZE) {
+        memcpy(header, key, LYD_FUZZ_OPTIONS_SIZE);
+    }
+
+    // Each value or count the mutations pick is near-valid with this chance.
+    m->gen.near_pct = m->near_pct;
+    LYD_FORMAT format, other_format;
+    lyd_gen_node *root = read_tree(m, buf, buf_size, &format);
+    learn_native(m, buf, buf_size, format);
+
+    // Print in the format the output header selects for this driver; until
+    // the native format is known, in the payload's own format (JSON for a
+    // fresh instance).  LYB cannot be printed, so a picked tuple selecting
+    // it keeps the input's format byte, and an input selecting it is moved
+    // to the native format.
+    LYD_FORMAT native = m->native != LYD_UNKNOWN ? m->native : format != LYD_UNKNOWN ? format : LYD_JSON;
+    if (header_format(header, native) == LYD_LYB) {
+        header[6] = lyd_fuzz_has_options(buf, buf_size) && buf[6] % 3 != 2 ? buf[6] : 0;
+    }
+    format = header_format(header, native);
+    lyd_gen_node *other = add_buf ? read_tree(m, add_buf, add_buf_size, &other_format) : NULL;
+    root = lyd_gen_mutate(&m->gen, root, other);
+    lyd_gen_free(other);
+
+    lyd_gen_buf text = {0};
+    if (root) {
+        lyd_gen_print(&m->gen, root, format, &text);
+        lyd_gen_free(root);
+    }
+    size_t len = LYD_FUZZ_OPTIONS_SIZE + text.len;
+    if (!text.data || len > max_size || !reserve(&m->out, &m->out_cap, len)) {
+        free(text.data);
+        *out_buf = buf;
+        return buf_size;
+    }
+    memcpy(m->out, header, LYD_FUZZ_OPTIONS_SIZE);
+    memcpy(m->out + LYD_FUZZ_OPTIONS_SIZE, text.data, text.len);
+    free(text.data);
+
+    *out_buf = m->out;
+    return len;
+}
+
+const char *afl_custom_describe(void *data, size_t max_description_len) {
+    (void)data;
+    (void)max_description_len;
+    return "lyd_gen";
+}
+
+void afl_custom_deinit(void *data) {
+    lyd_gen_mutator *m = (lyd_gen_mutator *)data;
+    if (m) {
+        optstats_sched_fini(&m->sched);
+        ly_ctx_destroy(m->ctx);
+        free(m->out);
+        free(m->text);
+        free(m);
+    }
+}
@@ -0,0 +1,290 @@
+/*
+ * Decode-budget planner shared by the openjpeg fuzz drivers.
+ *
+ * After opj_read_header() the planner looks at the codestream parameters
+ * (tile size, component count, resolutions, layers) and picks the decode
+ * area, the resolution reduction and therefore the set of tiles to decode so
+ * that a single exec stays within a memory and time budget.  Inputs whose
+ * smallest possible decode still exceeds the budget are skipped.
+ *
+ * The cost model is deliberately coarse: openjpeg decodes every tile that
+ * intersects the decode area, one tile at a time, into 32-bit samples, and
+ * reads one packet per layer, resolution and component of each tile, so
+ *   memory ~ one tile (plus code-block data) + the output image
+ *   time   ~ decoded samples of all covered tiles * ns per sample
+ *          + packets of all covered tiles * ns per packet
+ * In tile-streaming mode no output image is allocated; the reusable tile
+ * buffer is counted instead.  Every product saturates at UINT64_MAX, since
+ * the codestream parameters come straight from the fuzzed SIZ/COD markers
+ * and a wrapped estimate would let a huge decode through.
+ *
+ * Budgets are read once from the environment:
+ *   OPJ_FUZZ_MEM_BUDGET_MB   memory budget per exec   (default 256)
+ *   OPJ_FUZZ_TIME_BUDGET_MS  time budget per exec     (default 200)
+ *   OPJ_FUZZ_NS_PER_SAMPLE   cost model calibration   (default 40)
+ *   OPJ_FUZZ_NS_PER_PACKET   cost model calibration   (default 200)
+ *   OPJ_FUZZ_PLAN_LOG        if set, log every plan to stderr
+ */
+
+#ifndef OPJ_FUZZ_BUDGET_H
+#define OPJ_FUZZ_BUDGET_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "openjpeg.h"
+
+typedef struct {
+    uint64_t nMemBytes;
+    uint64_t nTimeNs;
+    uint64_t nNsPerSample;
+    uint64_t nNsPerPacket;
+    bool     bLog;
+} OpjFuzzBudget;
+
+typedef struct {
+    // Codestream parameters the plan was derived from.
+    OPJ_UINT32 nTileW, nTileH, nNumComps, nNumRes, nNumLayers;
+    // Chosen plan.
+    OPJ_UINT32 nReduce;
+    OPJ_UINT32 x0, y0, x1, y1;
+    OPJ_UINT32 nTilesX, nTilesY;
+    uint64_t   nEstBytes;
+    uint64_t   nEstNs;
+    bool       bStreaming;
+    bool       bSkip;
+} OpjFuzzPlan;
+
+static inline uint64_t OpjFuzzEnvU64(const char* name, uint64_t def)
+{
+    const char* value = getenv(name);
+    if (!value || !*value) {
+        return def;
+    }
+    return strtoull(value, NULL, 10);
+}
+
+// Process-wide budget, read from the environment on first use.
+static inline const OpjFuzzBudget* OpjFuzzBudgetGet()
+{
+    static OpjFuzzBudget budget;
+    static bool bInit = false;
+    if (!bInit) {
+        budget.nMemBytes = OpjFuzzEnvU64("OPJ_FUZZ_MEM_BUDGET_MB", 256) << 20;
+        budget.nTimeNs = OpjFuzzEnvU64("OPJ_FUZZ_TIME_BUDGET_MS", 200) * 1000000;
+        budget.nNsPerSample = OpjFuzzEnvU64("OPJ_FUZZ_NS_PER_SAMPLE", 40);
+        budget.nNsPerPacket = OpjFuzzEnvU64("OPJ_FUZZ_NS_PER_PACKET", 200);
+        budget.bLog = getenv("OPJ_FUZZ_PLAN_LOG") != NULL;
+        bInit = true;
+    }
+    return &budget;
+}
+
+static inline uint64_t OpjFuzzMulSat(uint64_t a, uint64_t b)
+{
+    uint64_t r;
+    return __builtin_mul_overflow(a, b, &r) ? UINT64_MAX : r;
+}
+
+static inline uint64_t OpjFuzzAddSat(uint64_t a, uint64_t b)
+{
+    uint64_t r;
+    return __builtin_add_overflow(a, b, &r) ? UINT64_MAX : r;
+}
+
+// ceil(v / 2^shift) for v < 2^32; an out-of-range reduction leaves one sample.
+static inline uint64_t OpjFuzzCeilShift(uint64_t v, OPJ_UINT32 shift)
+{
+    if (shift >= 32) {
+        return v != 0;
+    }
+    return (v + ((uint64_t)1 << shift) - 1) >> shift;
+}
+
+// Number of tiles of size tdx starting at tx0 touched by [a, b).
+static inline OPJ_UINT32 OpjFuzzTilesCovered(OPJ_UINT32 a, OPJ_UINT32 b,
+                                             OPJ_UINT32 t0, OPJ_UINT32 td)
+{
+    if (td == 0 || b <= a) {
+        return 0;
+    }
+    OPJ_UINT32 first = (a > t0) ? (a - t0) / td : 0;
+    OPJ_UINT32 last = (b - 1 > t0) ? (b - 1 - t0) / td : 0;
+    return last - first + 1;
+}
+
+static inline void OpjFuzzPlanEstimate(OpjFuzzPlan* plan, OPJ_UINT32 tx0,
+                                       OPJ_UINT32 ty0, const OpjFuzzBudget* budget)
+{
+    uint64_t nTileSamples = OpjFuzzMulSat(
+        OpjFuzzMulSat(OpjFuzzCeilShift(plan->nTileW, plan->nReduce),
+                      OpjFuzzCeilShift(plan->nTileH, plan->nReduce)),
+        plan->nNumComps);
+    uint64_t nAreaSamples = OpjFuzzMulSat(
+        OpjFuzzMulSat(OpjFuzzCeilShift(plan->x1 - plan->x0, plan->nReduce),
+                      OpjFuzzCeilShift(plan->y1 - plan->y0, plan->nReduce)),
+        plan->nNumComps);
+
+    plan->nTilesX = OpjFuzzTilesCovered(plan->x0, plan->x1, tx0, plan->nTileW);
+    plan->nTilesY = OpjFuzzTilesCovered(plan->y0, plan->y1, ty0, plan->nTileH);
+    uint64_t nTiles = (uint64_t)plan->nTilesX * plan->nTilesY;
+
+    // Tile-component data plus code-block buffers, and the output image
+    // (or, when streaming tiles, the buffer a single tile is copied into).
+    plan->nEstBytes = OpjFuzzAddSat(
+        OpjFuzzMulSat(nTileSamples, sizeof(OPJ_INT32) * 2),
+        OpjFuzzMulSat(plan->bStreaming ? nTileSamples : nAreaSamples,
+                      sizeof(OPJ_INT32)));
+
+    // Packet headers are read for every layer of every decoded resolution,
+    // so a codestream with many layers costs time even when its tiles are
+    // small.
+    OPJ_UINT32 nRes = plan->nNumRes > plan->nReduce ? plan->nNumRes - plan->nReduce : 1;
+    OPJ_UINT32 nLayers = plan->nNumLayers ? plan->nNumLayers : 1;
+    uint64_t nPackets = OpjFuzzMulSat(
+        OpjFuzzMulSat(OpjFuzzMulSat(nTiles, nLayers), nRes), plan->nNumComps);
+    plan->nEstNs = OpjFuzzAddSat(
+        OpjFuzzMulSat(OpjFuzzMulSat(nTiles, nTileSamples), budget->nNsPerSample),
+        OpjFuzzMulSat(nPackets, budget->nNsPerPacket));
+}
+
+static inline bool OpjFuzzPlanFits(const OpjFuzzPlan* plan, const OpjFuzzBudget* budget)
+{
+    return plan->nEstBytes <= budget->nMemBytes && plan->nEstNs <= budget->nTimeNs;
+}
+
+/*
+ * Plans the decode of psImage with the codestream parameters in
+ * pCodeStreamInfo (NULL if openjpeg gave none: the image is then treated as
+ * a single tile).  nReqReduce and nReqW x nReqH are what the driver's
+ * options asked for (0 meaning the full image); the plan never decodes more
+ * than that, and only raises the reduction or shrinks the area (keeping its
+ * origin) when needed to fit the budget.  bStreaming selects the memory
+ * model of the tile-streaming decode mode.
+ */
+static inline void OpjFuzzPlanCompute(const opj_image_t* psImage,
+                                      const opj_codestream_info_v2_t* pCodeStreamInfo,
+                                      const OpjFuzzBudget* budget,
+                                      OPJ_UINT32 nReqReduce,
+                                      OPJ_UINT32 nReqW, OPJ_UINT32 nReqH,
+                                      bool bStreaming, OpjFuzzPlan* plan)
+{
+    OPJ_UINT32 width = psImage->x1 - psImage->x0;
+    OPJ_UINT32 height = psImage->y1 - psImage->y0;
+    OPJ_UINT32 tx0 = psImage->x0, ty0 = psImage->y0;
+
+    plan->nTileW = width;
+    plan->nTileH = height;
+    plan->nNumComps = psImage->numcomps;
+    plan->nNumRes = 1;
+    plan->nNumLayers = 1;
+
+    if (pCodeStreamInfo) {
+        tx0 = pCodeStreamInfo->tx0;
+        ty0 = pCodeStreamInfo->ty0;
+        plan->nTileW = pCodeStreamInfo->tdx;
+        plan->nTileH = pCodeStreamInfo->tdy;
+        plan->nNumLayers = pCodeStreamInfo->m_default_tile_info.numlayers;
+        const opj_tccp_info_t* tccp = pCodeStreamInfo->m_default_tile_info.tccp_info;
+        if (tccp && pCodeStreamInfo->nbcomps > 0) {
+            plan->nNumRes = tccp[0].numresolutions;
+            for (OPJ_UINT32 c = 1; c < pCodeStreamInfo->nbcomps; c++) {
+                if (tccp[c].numresolutions < plan->nNumRes) {
+                    plan->nNumRes = tccp[c].numresolutions;
+                }
+            }
+        }
+    }
+
+    plan->x0 = psImage->x0;
+    plan->y0 = psImage->y0;
+    plan->x1 = psImage->x0 + ((nReqW && nReqW < width) ? nReqW : width);
+    plan->y1 = psImage->y0 + ((nReqH && nReqH < height) ? nReqH : height);
+    plan->nReduce = nReqReduce;
+    plan->bStreaming = bStreaming;
+    plan->bSkip = false;
+
+    // A reduction the codestream cannot honour is left for openjpeg to
+    // reject; there is nothing to plan around.
+    OPJ_UINT32 nMaxReduce = plan->nNumRes ? plan->nNumRes - 1 : 0;
+    if (nReqReduce > nMaxReduce) {
+        OpjFuzzPlanEstimate(plan, tx0, ty0, budget);
+        return;
+    }
+
+    for (;;) {
+        OpjFuzzPlanEstimate(plan, tx0, ty0, budget);
+        if (OpjFuzzPlanFits(plan, budget)) {
+            return;
+        }
+        // Shrink the larger side of the area first, down to a single tile.
+        // Halving rounds up without w + 1, which wraps for a 2^32-1 wide image.
+        OPJ_UINT32 w = plan->x1 - plan->x0;
+        OPJ_UINT32 h = plan->y1 - plan->y0;
+        if (plan->nTilesX > 1 || plan->nTilesY > 1 ||
+                (uint64_t)w * h > (uint64_t)plan->nTileW * plan->nTileH) {
+            if ((plan->nTilesX >= plan->nTilesY && w > 1) || h <= 1) {
+                plan->x1 = plan->x0 + (w - w / 2);
+            } else {
+                plan->y1 = plan->y0 + (h - h / 2);
+            }
+            continue;
+        }
+        // A single tile still does not fit: decode it at a lower resolution.
+        if (plan->nReduce < nMaxReduce) {
+            plan->nReduce++;
+            continue;
+        }
+        plan->bSkip = true;
+        return;
+    }
+}
+
+// OpjFuzzPlanCompute() with the codestream parameters of pCodec.
+static inline void OpjFuzzPlanDecode(opj_codec_t* pCodec, const opj_image_t* psImage,
+                                     const OpjFuzzBudget* budget,
+                                     OPJ_UINT32 nReqReduce,
+                                     OPJ_UINT32 nReqW, OPJ_UINT32 nReqH,
+                                     bool bStreaming, OpjFuzzPlan* plan)
+{
+    opj_codestream_info_v2_t* pCodeStreamInfo = opj_get_cstr_info(pCodec);
+    OpjFuzzPlanCompute(psImage, pCodeStreamInfo, budget, nReqReduce, nReqW, nReqH,
+                       bStreaming, plan);
+    if (pCodeStreamInfo) {
+        opj_destroy_cstr_info(&pCodeStreamInfo);
+    }
+}
+
+static inline void OpjFuzzPlanLog(const OpjFuzzPlan* plan, const OpjFuzzBudget* budget)
+{
+    if (!budget->bLog) {
+        return;
+    }
+    fprintf(stderr,
+            "opj plan: tile %ux%u comps %u res %u layers %u -> reduce %u "
+            "area %ux%u+%u+%u tiles %ux%u%s est %llu KiB %llu us%s\n",
+            plan->nTileW, plan->nTileH, plan->nNumComps, plan->nNumRes,
+            plan->nNumLayers, plan->nReduce,
+            plan->x1 - plan->x0, plan->y1 - plan->y0, plan->x0, plan->y0,
+            plan->nTilesX, plan->nTilesY, plan->bStreaming ? " streamed" : "",
+            (unsigned long long)(plan->nEstBytes >> 10),
+            (unsigned long long)(plan->nEstNs / 1000),
+            plan->bSkip ? " SKIP" : "");
+}
+
+// Applies a non-skipped plan to the codec. Returns false if openjpeg
+// rejected the reduction or the decode area.
+static inline bool OpjFuzzPlanApply(opj_codec_t* pCodec, opj_image_t* psImage,
+                                    const OpjFuzzPlan* plan, OPJ_UINT32 nReqReduce)
+{
+    if (plan->nReduce != nReqReduce &&
+            !opj_set_decoded_resolution_factor(pCodec, plan->nReduce)) {
+        return false;
+    }
+    return opj_set_decode_area(pCodec, psImage,
+                               (OPJ_INT32)plan->x0, (OPJ_INT32)plan->y0,
+                               (OPJ_INT32)plan->x1, (OPJ_INT32)plan->y1) != OPJ_FALSE;
+}
+
+#endif /* OPJ_FUZZ_BUDGET_H */
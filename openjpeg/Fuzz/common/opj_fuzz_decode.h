@@ -0,0 +1,268 @@
+/*
+ * Decode pipeline shared by the openjpeg AFL drivers: codec and stream
+ * setup, budget planning, decoding and cleanup for one input, driven by an
+ * OpjFuzzDecodeOptions filled in from the option header
+ * (OpjFuzzApplyOptions).
+ *
+ * Two decode modes are available:
+ *  - OPJ_FUZZ_DECODE_IMAGE decodes the planned area with opj_decode() into a
+ *    full output image.
+ *  - OPJ_FUZZ_DECODE_TILES walks the tiles of the planned area with
+ *    opj_read_tile_header() / opj_decode_tile_data() into one reusable tile
+ *    buffer, so peak memory follows the tile size rather than the image
+ *    size (the streaming API used for huge rasters).
+ *
+ * OpjFuzzDecodeThreadCheck() decodes the same input once single-threaded and
+ * once with the requested thread count, compares the output images by hash
+ * and aborts on any difference, so races and nondeterminism in openjpeg's
+ * threaded tile / code-block decoding show up as crashes.  Set
+ * OPJ_FUZZ_THREAD_LOG to print the per-input speedup to stderr.
+ */
+
+#ifndef OPJ_FUZZ_DECODE_H
+#define OPJ_FUZZ_DECODE_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "openjpeg.h"
+#include "opj_fuzz_stream.h"
+#include "opj_fuzz_budget.h"
+#include "opj_fuzz_options.h"
+
+typedef enum {
+    OPJ_FUZZ_DECODE_IMAGE = 0,
+    OPJ_FUZZ_DECODE_TILES = 1
+} OpjFuzzDecodeMode;
+
+typedef struct {
+    OPJ_CODEC_FORMAT  eCodecFormat;
+    opj_dparameters_t parameters;
+    OpjFuzzStreamMode eStreamMode;
+    uint8_t           nChunkSelector;
+    OpjFuzzDecodeMode eDecodeMode;
+    OPJ_UINT32        nDecodeW;       // 0 = full image
+    OPJ_UINT32        nDecodeH;       // 0 = full image
+    int               nThreads;       // 1 = single-threaded
+    opj_msg_callback  pfnError;
+    opj_msg_callback  pfnWarning;
+    opj_msg_callback  pfnInfo;
+} OpjFuzzDecodeOptions;
+
+typedef struct {
+    bool     bHeader;     // opj_read_header succeeded
+    bool     bDecoded;    // decoding succeeded
+    uint64_t nHash;       // hash of the decoded samples, if requested
+    uint64_t nDecodeNs;   // wall-clock time of the decode step
+} OpjFuzzDecodeResult;
+
+// Decoder parameters from the schema-decoded option header.
+static inline void OpjFuzzApplyParameters(const OpjFuzzOptions* options,
+                                          opj_dparameters_t* parameters)
+{
+    opj_set_default_decoder_parameters(parameters);
+    parameters->cp_reduce = options->nReduce;
+    parameters->cp_layer = options->nLayer;
+    parameters->nb_tile_to_decode = options->nTileIndex;
+    parameters->flags = options->nFlags;
+}
+
+// Fills everything but the codec format and message callbacks from the
+// schema-decoded option header.
+static inline void OpjFuzzApplyOptions(const OpjFuzzOptions* options,
+                                       OpjFuzzDecodeOptions* opts)
+{
+    OpjFuzzApplyParameters(options, &opts->parameters);
+    opts->eStreamMode = options->bChunked ? OPJ_FUZZ_STREAM_CHUNKED
+                                          : OPJ_FUZZ_STREAM_WHOLE;
+    opts->nChunkSelector = options->nChunkSelector;
+    opts->eDecodeMode = options->bTiles ? OPJ_FUZZ_DECODE_TILES
+                                        : OPJ_FUZZ_DECODE_IMAGE;
+    opts->nDecodeW = options->nDecodeW;
+    opts->nDecodeH = options->nDecodeH;
+    opts->nThreads = options->nThreads;
+}
+
+static inline uint64_t OpjFuzzNowNs()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static inline uint64_t OpjFuzzHashBytes(uint64_t h, const void* p, size_t n)
+{
+    const uint8_t* b = (const uint8_t*)p;
+    for (size_t i = 0; i < n; i++) {
+        h = (h ^ b[i]) * 0x100000001b3ULL;
+    }
+    return h;
+}
+
+// FNV-1a over the geometry and samples of every component.
+static inline uint64_t OpjFuzzHashImage(const opj_image_t* psImage)
+{
+    uint64_t h = 0xcbf29ce484222325ULL;
+    h = OpjFuzzHashBytes(h, &psImage->numcomps, sizeof(psImage->numcomps));
+    for (OPJ_UINT32 c = 0; c < psImage->numcomps; c++) {
+        const opj_image_comp_t* comp = &psImage->comps[c];
+        OPJ_UINT32 geom[4] = {comp->w, comp->h, comp->prec, comp->sgnd};
+        h = OpjFuzzHashBytes(h, geom, sizeof(geom));
+        if (comp->data) {
+            h = OpjFuzzHashBytes(h, comp->data,
+                                 (size_t)comp->w * comp->h * sizeof(OPJ_INT32));
+        }
+    }
+    return h;
+}
+
+// Tile buffer reused across tiles and across inputs; it only grows, up to
+// the memory budget.
+static OPJ_BYTE*  g_pOpjFuzzTileBuf = NULL;
+static OPJ_UINT32 g_nOpjFuzzTileCap = 0;
+
+// Streams the tiles selected by the decode area through the tile buffer.
+static inline bool OpjFuzzDecodeTiles(opj_codec_t* pCodec, opj_stream_t* pStream,
+                                      const OpjFuzzBudget* budget, bool bHash,
+                                      uint64_t* pHash)
+{
+    uint64_t h = 0xcbf29ce484222325ULL;
+    for (;;) {
+        OPJ_UINT32 nTileIndex, nDataSize, nComps;
+        OPJ_INT32 tx0, ty0, tx1, ty1;
+        OPJ_BOOL bGoOn = OPJ_FALSE;
+        if (!opj_read_tile_header(pCodec, pStream, &nTileIndex, &nDataSize,
+                                  &tx0, &ty0, &tx1, &ty1, &nComps, &bGoOn)) {
+            return false;
+        }
+        if (!bGoOn) {
+            break;
+        }
+        if (nDataSize > budget->nMemBytes) {
+            return false;
+        }
+        if (nDataSize > g_nOpjFuzzTileCap) {
+            OPJ_BYTE* pGrown = (OPJ_BYTE*)realloc(g_pOpjFuzzTileBuf, nDataSize);
+            if (!pGrown) {
+                return false;
+            }
+            g_pOpjFuzzTileBuf = pGrown;
+            g_nOpjFuzzTileCap = nDataSize;
+        }
+        if (!opj_decode_tile_data(pCodec, nTileIndex, g_pOpjFuzzTileBuf,
+                                  nDataSize, pStream)) {
+            return false;
+        }
+        if (bHash) {
+            h = OpjFuzzHashBytes(h, &nTileIndex, sizeof(nTileIndex));
+            h = OpjFuzzHashBytes(h, g_pOpjFuzzTileBuf, nDataSize);
+        }
+    }
+    *pHash = h;
+    return true;
+}
+
+// Decodes buf[0..len) with opts. Every resource is released before return.
+static inline void OpjFuzzDecode(const uint8_t* buf, size_t len,
+                                 const OpjFuzzDecodeOptions* opts, bool bHash,
+                                 OpjFuzzDecodeResult* result)
+{
+    result->bHeader = false;
+    result->bDecoded = false;
+    result->nHash = 0;
+    result->nDecodeNs = 0;
+
+    opj_codec_t* pCodec = opj_create_decompress(opts->eCodecFormat);
+    if (!pCodec) {
+        return;
+    }
+    opj_set_info_handler(pCodec, opts->pfnInfo, NULL);
+    opj_set_warning_handler(pCodec, opts->pfnWarning, NULL);
+    opj_set_error_handler(pCodec, opts->pfnError, NULL);
+
+    opj_dparameters_t parameters = opts->parameters;
+    opj_setup_decoder(pCodec, &parameters);
+    if (opts->nThreads > 1) {
+        // Fails harmlessly when libopenjp2 was built without thread support.
+        opj_codec_set_threads(pCodec, opts->nThreads);
+    }
+
+    MemFile memFile;
+    opj_stream_t* pStream = MemFileStreamCreate(&memFile, buf, len,
+                                                opts->eStreamMode,
+                                                opts->nChunkSelector);
+    if (!pStream) {
+        opj_destroy_codec(pCodec);
+        return;
+    }
+
+    opj_image_t* psImage = NULL;
+    if (!opj_read_header(pStream, pCodec, &psImage)) {
+        opj_stream_destroy(pStream);
+        opj_destroy_codec(pCodec);
+        opj_image_destroy(psImage);
+        return;
+    }
+    result->bHeader = true;
+
+    const OpjFuzzBudget* budget = OpjFuzzBudgetGet();
+    OpjFuzzPlan plan;
+    bool bTiles = opts->eDecodeMode == OPJ_FUZZ_DECODE_TILES;
+    OpjFuzzPlanDecode(pCodec, psImage, budget, parameters.cp_reduce,
+                      opts->nDecodeW, opts->nDecodeH, bTiles, &plan);
+    OpjFuzzPlanLog(&plan, budget);
+
+    if (!plan.bSkip && OpjFuzzPlanApply(pCodec, psImage, &plan, parameters.cp_reduce)) {
+        uint64_t t0 = OpjFuzzNowNs();
+        if (bTiles) {
+            result->bDecoded = OpjFuzzDecodeTiles(pCodec, pStream, budget,
+                                                  bHash, &result->nHash);
+        } else {
+            result->bDecoded = opj_decode(pCodec, pStream, psImage) != OPJ_FALSE;
+            if (result->bDecoded && bHash) {
+                result->nHash = OpjFuzzHashImage(psImage);
+            }
+        }
+        result->nDecodeNs = OpjFuzzNowNs() - t0;
+    }
+
+    opj_end_decompress(pCodec, pStream);
+    opj_stream_destroy(pStream);
+    opj_destroy_codec(pCodec);
+    opj_image_destroy(psImage);
+}
+
+// Decodes with 1 and opts->nThreads threads and aborts if the outputs differ.
+static inline void OpjFuzzDecodeThreadCheck(const uint8_t* buf, size_t len,
+                                            const OpjFuzzDecodeOptions* opts)
+{
+    OpjFuzzDecodeOptions single = *opts;
+    single.nThreads = 1;
+
+    OpjFuzzDecodeResult r1, rN;
+    OpjFuzzDecode(buf, len, &single, true, &r1);
+    if (!r1.bHeader) {
+        return;
+    }
+    OpjFuzzDecode(buf, len, opts, true, &rN);
+
+    if (getenv("OPJ_FUZZ_THREAD_LOG") && rN.nDecodeNs) {
+        fprintf(stderr, "opj threads: 1 -> %llu us, %d -> %llu us, speedup %.2fx\n",
+                (unsigned long long)(r1.nDecodeNs / 1000), opts->nThreads,
+                (unsigned long long)(rN.nDecodeNs / 1000),
+                (double)r1.nDecodeNs / (double)rN.nDecodeNs);
+    }
+
+    if (r1.bHeader != rN.bHeader || r1.bDecoded != rN.bDecoded ||
+            r1.nHash != rN.nHash) {
+        fprintf(stderr, "opj threads: output mismatch between 1 and %d threads "
+                "(decoded %d/%d, hash %016llx/%016llx)\n",
+                opts->nThreads, (int)r1.bDecoded, (int)rN.bDecoded,
+                (unsigned long long)r1.nHash, (unsigned long long)rN.nHash);
+        abort();
+    }
+}
+
+#endif /* OPJ_FUZZ_DECODE_H */
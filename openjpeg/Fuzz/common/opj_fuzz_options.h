@@ -0,0 +1,282 @@
+/*
+ * Versioned option header for the openjpeg drivers.
+ *
+ * The input is a fixed-size option header followed by the codestream / file
+ * payload, so option bytes never overlap the format signature:
+ *
+ *   offset  size  field
+ *   0       4     magic "OJFZ"
+ *   4       1     layout version (OPJ_FUZZ_OPTIONS_VERSION)
+ *   5..15         option fields, see OPJ_FUZZ_OPTION_SCHEMA
+ *   16      ...   payload
+ *
+ * OPJ_FUZZ_OPTION_SCHEMA is the single description of the option fields.
+ * Each row gives the field's OpjFuzzOptions member and type, its byte offset
+ * and width (little endian), the bit shift and bit count inside those bytes,
+ * and its legal values base .. base + count - 1 with a default.  A raw value
+ * r maps to base + r % count, so every value of a field byte is legal and
+ * only the magic and version can make a driver reject an input.
+ *
+ * Everything else is generated from the table: the OpjFuzzOptions struct,
+ * one OpjFuzzOptionField<> instantiation per field whose Decode() / Encode()
+ * compile down to a load, shift, mask and modulo by constants, the
+ * kOpjFuzzOptionSchema descriptor array for mutators and reports, and the
+ * helpers that enumerate the option space for sweeps.  Fields added in the
+ * reserved bytes must keep 0 as the old behaviour, or bump the version.
+ */
+
+#ifndef OPJ_FUZZ_OPTIONS_H
+#define OPJ_FUZZ_OPTIONS_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#define OPJ_FUZZ_OPTIONS_MAGIC   "OJFZ"
+#define OPJ_FUZZ_OPTIONS_VERSION 1
+#define OPJ_FUZZ_OPTIONS_SIZE    16
+
+//     ID              member          type      offset width shift bits count base default
+#define OPJ_FUZZ_OPTION_SCHEMA(X) \
+    X(REDUCE,         nReduce,        uint32_t, 5,     1,    0,    8,   10,   0,   0) \
+    X(LAYER,          nLayer,         uint32_t, 6,     1,    0,    8,   5,    0,   0) \
+    X(THREADS,        nThreads,       int,      7,     1,    0,    3,   8,    1,   1) \
+    X(THREAD_CHECK,   bThreadCheck,   bool,     7,     1,    7,    1,   2,    0,   0) \
+    X(DECODE_W,       nDecodeW,       uint32_t, 8,     2,    0,    16,  4096, 0,   0) \
+    X(DECODE_H,       nDecodeH,       uint32_t, 10,    2,    0,    16,  4096, 0,   0) \
+    X(CHUNKED,        bChunked,       bool,     12,    1,    0,    1,   2,    0,   0) \
+    X(CHUNK_SELECTOR, nChunkSelector, uint8_t,  12,    1,    1,    7,   11,   0,   0) \
+    X(TILES,          bTiles,         bool,     13,    1,    0,    1,   2,    0,   0) \
+    X(TILE_INDEX,     nTileIndex,     uint32_t, 14,    1,    0,    8,   5,    0,   0) \
+    X(FLAGS,          nFlags,         uint32_t, 15,    1,    0,    1,   2,    0,   0)
+
+// Field meanings:
+//   nReduce         cp_reduce
+//   nLayer          cp_layer
+//   nThreads        opj_codec_set_threads
+//   bThreadCheck    decode with 1 and with nThreads threads and compare
+//   nDecodeW/H      decode area size, 0 = full image
+//   bChunked        feed the stream in chunks of MemFileChunkSize(nChunkSelector)
+//   bTiles          tile-streaming decode instead of opj_decode
+//   nTileIndex      nb_tile_to_decode
+//   nFlags          opj_dparameters_t.flags (IGNORE_PCLR_CMAP_CDEF)
+
+typedef struct {
+#define OPJ_FUZZ_X(id, member, type, off, width, shift, bits, count, base, def) \
+    type member;
+    OPJ_FUZZ_OPTION_SCHEMA(OPJ_FUZZ_X)
+#undef OPJ_FUZZ_X
+} OpjFuzzOptions;
+
+// Field ids, in schema order.
+enum {
+#define OPJ_FUZZ_X(id, member, type, off, width, shift, bits, count, base, def) \
+    OPJ_FUZZ_OPT_##id,
+    OPJ_FUZZ_OPTION_SCHEMA(OPJ_FUZZ_X)
+#undef OPJ_FUZZ_X
+    OPJ_FUZZ_OPT_COUNT
+};
+
+template <unsigned Offset, unsigned Width, unsigned Shift, unsigned Bits,
+          uint32_t Count, uint32_t Base>
+struct OpjFuzzOptionField {
+    static_assert(Offset >= 5 && Offset + Width <= OPJ_FUZZ_OPTIONS_SIZE,
+                  "option field outside the header");
+    static_assert(Width == 1 || Width == 2, "option fields are 1 or 2 bytes");
+    static_assert(Bits >= 1 && Shift + Bits <= 8 * Width,
+                  "option bits outside the field bytes");
+    static_assert(Count >= 1 && Count <= (1u << Bits),
+                  "legal values do not fit the option bits");
+
+    static const uint32_t kMask = (1u << Bits) - 1;
+
+    static uint32_t Decode(const uint8_t* hdr)
+    {
+        uint32_t raw = hdr[Offset];
+        if (Width == 2) {
+            raw |= (uint32_t)hdr[Offset + 1] << 8;
+        }
+        return Base + ((raw >> Shift) & kMask) % Count;
+    }
+
+    // ORs the field into hdr, which starts zeroed outside other fields.
+    static void Encode(uint32_t value, uint8_t* hdr)
+    {
+        uint32_t raw = (((value - Base) % Count) & kMask) << Shift;
+        hdr[Offset] |= (uint8_t)raw;
+        if (Width == 2) {
+            hdr[Offset + 1] |= (uint8_t)(raw >> 8);
+        }
+    }
+};
+
+#define OPJ_FUZZ_X(id, member, type, off, width, shift, bits, count, base, def) \
+    typedef OpjFuzzOptionField<off, width, shift, bits, count, base> OpjFuzzOption_##id;
+OPJ_FUZZ_OPTION_SCHEMA(OPJ_FUZZ_X)
+#undef OPJ_FUZZ_X
+
+// Runtime view of the schema, for mutators, sweeps and reports.
+typedef struct {
+    const char* pszName;
+    uint8_t     nOffset;
+    uint8_t     nWidth;
+    uint8_t     nShift;
+    uint8_t     nBits;
+    uint32_t    nCount;
+    uint32_t    nBase;
+    uint32_t    nDefault;
+} OpjFuzzOptionDesc;
+
+static const OpjFuzzOptionDesc kOpjFuzzOptionSchema[OPJ_FUZZ_OPT_COUNT] = {
+#define OPJ_FUZZ_X(id, member, type, off, width, shift, bits, count, base, def) \
+    {#member, off, width, shift, bits, count, base, def},
+    OPJ_FUZZ_OPTION_SCHEMA(OPJ_FUZZ_X)
+#undef OPJ_FUZZ_X
+};
+
+static inline uint32_t OpjFuzzGetOption(const OpjFuzzOptions* opts, int field)
+{
+    switch (field) {
+#define OPJ_FUZZ_X(id, member, type, off, width, shift, bits, count, base, def) \
+    case OPJ_FUZZ_OPT_##id: return (uint32_t)opts->member;
+    OPJ_FUZZ_OPTION_SCHEMA(OPJ_FUZZ_X)
+#undef OPJ_FUZZ_X
+    }
+    return 0;
+}
+
+// Sets a field; value must be in base .. base + count - 1.
+static inline void OpjFuzzSetOption(OpjFuzzOptions* opts, int field, uint32_t value)
+{
+    switch (field) {
+#define OPJ_FUZZ_X(id, member, type, off, width, shift, bits, count, base, def) \
+    case OPJ_FUZZ_OPT_##id: opts->member = (type)value; break;
+    OPJ_FUZZ_OPTION_SCHEMA(OPJ_FUZZ_X)
+#undef OPJ_FUZZ_X
+    }
+}
+
+static inline bool OpjFuzzHasOptions(const uint8_t* buf, size_t len)
+{
+    return len >= OPJ_FUZZ_OPTIONS_SIZE &&
+           memcmp(buf, OPJ_FUZZ_OPTIONS_MAGIC, 4) == 0 &&
+           buf[4] == OPJ_FUZZ_OPTIONS_VERSION;
+}
+
+// Cross-field rules the table cannot express.
+static inline void OpjFuzzNormalizeOptions(OpjFuzzOptions* opts)
+{
+    if (opts->nThreads <= 1) {
+        opts->bThreadCheck = false;
+    }
+}
+
+// Decodes the header. Returns false if buf does not start with a header of
+// the supported version.
+static inline bool OpjFuzzParseOptions(const uint8_t* buf, size_t len, OpjFuzzOptions* opts)
+{
+    if (!OpjFuzzHasOptions(buf, len)) {
+        return false;
+    }
+#define OPJ_FUZZ_X(id, member, type, off, width, shift, bits, count, base, def) \
+    opts->member = (type)OpjFuzzOption_##id::Decode(buf);
+    OPJ_FUZZ_OPTION_SCHEMA(OPJ_FUZZ_X)
+#undef OPJ_FUZZ_X
+    OpjFuzzNormalizeOptions(opts);
+    return true;
+}
+
+// Encodes opts into out[0..OPJ_FUZZ_OPTIONS_SIZE).
+static inline void OpjFuzzWriteOptions(const OpjFuzzOptions* opts, uint8_t* out)
+{
+    memset(out, 0, OPJ_FUZZ_OPTIONS_SIZE);
+    memcpy(out, OPJ_FUZZ_OPTIONS_MAGIC, 4);
+    out[4] = OPJ_FUZZ_OPTIONS_VERSION;
+#define OPJ_FUZZ_X(id, member, type, off, width, shift, bits, count, base, def) \
+    OpjFuzzOption_##id::Encode((uint32_t)opts->member, out);
+    OPJ_FUZZ_OPTION_SCHEMA(OPJ_FUZZ_X)
+#undef OPJ_FUZZ_X
+}
+
+static inline void OpjFuzzDefaultOptions(OpjFuzzOptions* opts)
+{
+#define OPJ_FUZZ_X(id, member, type, off, width, shift, bits, count, base, def) \
+    opts->member = (type)(def);
+    OPJ_FUZZ_OPTION_SCHEMA(OPJ_FUZZ_X)
+#undef OPJ_FUZZ_X
+}
+
+// Writes the fields that differ from their default as "name=value ..." to
+// out, or "default" if none do; for reports.
+static inline void OpjFuzzFormatOptions(const OpjFuzzOptions* opts, char* out, size_t size)
+{
+    size_t len = 0;
+    out[0] = '\0';
+    for (int f = 0; f < OPJ_FUZZ_OPT_COUNT && len < size; f++) {
+        uint32_t value = OpjFuzzGetOption(opts, f);
+        if (value == kOpjFuzzOptionSchema[f].nDefault) {
+            continue;
+        }
+        int n = snprintf(out + len, size - len, "%s%s=%u", len ? " " : "",
+                         kOpjFuzzOptionSchema[f].pszName, value);
+        if (n < 0) {
+            break;
+        }
+        len += (size_t)n;
+    }
+    if (!len) {
+        snprintf(out, size, "default");
+    }
+}
+
+// ---------------------------------------------------------------------------
+// Option space enumeration.
+//
+// A sweep varies the fields in a bit mask (1 << OPJ_FUZZ_OPT_xxx) and keeps
+// the others at their default.  Fields with more than nMaxPerField legal
+// values are sampled at nMaxPerField evenly spaced values (including the
+// first), so the space stays small enough to walk.
+
+static inline uint32_t OpjFuzzSweepCount(int field, uint32_t nMaxPerField)
+{
+    uint32_t count = kOpjFuzzOptionSchema[field].nCount;
+    return (nMaxPerField && count > nMaxPerField) ? nMaxPerField : count;
+}
+
+static inline uint32_t OpjFuzzSweepValue(int field, uint32_t k, uint32_t nMaxPerField)
+{
+    const OpjFuzzOptionDesc* d = &kOpjFuzzOptionSchema[field];
+    uint32_t n = OpjFuzzSweepCount(field, nMaxPerField);
+    return d->nBase + (uint32_t)((uint64_t)k * d->nCount / n);
+}
+
+static inline uint64_t OpjFuzzSweepSize(uint32_t nFieldMask, uint32_t nMaxPerField)
+{
+    uint64_t size = 1;
+    for (int f = 0; f < OPJ_FUZZ_OPT_COUNT; f++) {
+        if (nFieldMask & (1u << f)) {
+            size *= OpjFuzzSweepCount(f, nMaxPerField);
+        }
+    }
+    return size;
+}
+
+// Fills opts with the index-th combination (mixed radix, first field
+// fastest). Returns false once index is past the end of the space.
+static inline bool OpjFuzzSweepAt(uint64_t index, uint32_t nFieldMask,
+                                  uint32_t nMaxPerField, OpjFuzzOptions* opts)
+{
+    OpjFuzzDefaultOptions(opts);
+    for (int f = 0; f < OPJ_FUZZ_OPT_COUNT; f++) {
+        if (!(nFieldMask & (1u << f))) {
+            continue;
+        }
+        uint32_t n = OpjFuzzSweepCount(f, nMaxPerField);
+        OpjFuzzSetOption(opts, f, OpjFuzzSweepValue(f, (uint32_t)(index % n), nMaxPerField));
+        index /= n;
+    }
+    return index == 0;
+}
+
+#endif /* OPJ_FUZZ_OPTIONS_H */
@@ -0,0 +1,119 @@
+/*
+ * In-memory opj_stream_t shared by the openjpeg fuzz drivers.
+ *
+ * The stream reads straight from the caller's buffer (no copy of the input
+ * is made) and every callback is bounds-checked against the input length.
+ *
+ * Two buffering modes are offered:
+ *  - OPJ_FUZZ_STREAM_WHOLE sizes the opj_stream_t buffer to the input, so
+ *    the whole codestream is served by a single ReadCallback call.
+ *  - OPJ_FUZZ_STREAM_CHUNKED uses a chunk size picked from a selector byte
+ *    of the input (1 KiB .. 1 MiB, never larger than the input), which keeps
+ *    the refill / seek paths of opj_stream_t under test.
+ */
+
+#ifndef OPJ_FUZZ_STREAM_H
+#define OPJ_FUZZ_STREAM_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "openjpeg.h"
+
+typedef struct {
+    const uint8_t* pabyData;
+    size_t         nCurPos;
+    size_t         nLength;
+} MemFile;
+
+typedef enum {
+    OPJ_FUZZ_STREAM_WHOLE = 0,
+    OPJ_FUZZ_STREAM_CHUNKED = 1
+} OpjFuzzStreamMode;
+
+static inline OPJ_SIZE_T MemFileRead(void* pBuffer, OPJ_SIZE_T nBytes, void* pUserData)
+{
+    MemFile* memFile = (MemFile*)pUserData;
+    if (nBytes == 0 || memFile->nCurPos >= memFile->nLength) {
+        return (OPJ_SIZE_T)-1;
+    }
+    size_t nToRead = memFile->nLength - memFile->nCurPos;
+    if (nBytes < nToRead) {
+        nToRead = nBytes;
+    }
+    memcpy(pBuffer, memFile->pabyData + memFile->nCurPos, nToRead);
+    memFile->nCurPos += nToRead;
+    return nToRead;
+}
+
+static inline OPJ_BOOL MemFileSeek(OPJ_OFF_T nBytes, void* pUserData)
+{
+    MemFile* memFile = (MemFile*)pUserData;
+    if (nBytes < 0 || (uint64_t)nBytes > memFile->nLength) {
+        return OPJ_FALSE;
+    }
+    memFile->nCurPos = (size_t)nBytes;
+    return OPJ_TRUE;
+}
+
+static inline OPJ_OFF_T MemFileSkip(OPJ_OFF_T nBytes, void* pUserData)
+{
+    MemFile* memFile = (MemFile*)pUserData;
+    if (nBytes < 0) {
+        if ((uint64_t)(-nBytes) > memFile->nCurPos) {
+            return -1;
+        }
+        memFile->nCurPos -= (size_t)(-nBytes);
+        return nBytes;
+    }
+    size_t nRemaining = memFile->nLength - memFile->nCurPos;
+    if (nRemaining == 0) {
+        return -1;
+    }
+    if ((uint64_t)nBytes > nRemaining) {
+        memFile->nCurPos = memFile->nLength;
+        return (OPJ_OFF_T)nRemaining;
+    }
+    memFile->nCurPos += (size_t)nBytes;
+    return nBytes;
+}
+
+// Chunk size used by OPJ_FUZZ_STREAM_CHUNKED: 1 KiB << (selector % 11),
+// clamped to the input length.
+static inline OPJ_SIZE_T MemFileChunkSize(size_t len, uint8_t selector)
+{
+    size_t nChunk = (size_t)1024 << (selector % 11);
+    if (nChunk > len) {
+        nChunk = len;
+    }
+    return nChunk ? nChunk : 1;
+}
+
+// Creates a read stream over buf[0..len). memFile must outlive the stream.
+static inline opj_stream_t* MemFileStreamCreate(MemFile* memFile,
+                                                const uint8_t* buf, size_t len,
+                                                OpjFuzzStreamMode mode,
+                                                uint8_t selector)
+{
+    memFile->pabyData = buf;
+    memFile->nLength = len;
+    memFile->nCurPos = 0;
+
+    OPJ_SIZE_T nBufferSize = (mode == OPJ_FUZZ_STREAM_WHOLE)
+                             ? (len ? len : 1)
+                             : MemFileChunkSize(len, selector);
+
+    opj_stream_t* pStream = opj_stream_create(nBufferSize, OPJ_TRUE);
+    if (!pStream) {
+        return NULL;
+    }
+    opj_stream_set_user_data_length(pStream, len);
+    opj_stream_set_read_function(pStream, MemFileRead);
+    opj_stream_set_seek_function(pStream, MemFileSeek);
+    opj_stream_set_skip_function(pStream, MemFileSkip);
+    opj_stream_set_user_data(pStream, memFile, NULL);
+    return pStream;
+}
+
+#endif /* OPJ_FUZZ_STREAM_H */
@@ -0,0 +1,260 @@
+/*
+ * AFL++ custom mutator for inputs that start with the openjpeg option header
+ * (common/opj_fuzz_options.h).
+ *
+ * Each call either rewrites one header field with a value from its legal
+ * range, as listed in the option schema table, or mutates the payload only
+ * (bit flips, byte sets, block insert/delete, splicing the payload of
+ * another corpus entry).  The magic and version bytes are never touched, and
+ * an input without a header, including an empty one, gets a default one.
+ * Payload mutations keep the format signature the drivers check before
+ * decoding: the 12-byte `jP  ` signature box of a JP2 file and the SOC marker
+ * of a J2K codestream are never changed, so no mutation produces an input
+ * the driver rejects up front.  An empty payload gets bytes spliced from
+ * another corpus entry or a random block.
+ *
+ * With OPTSTATS_FILE naming the driver's optstats table (optstats/optstats.h),
+ * half of the header mutations instead take a whole option tuple from the
+ * optstats scheduler, which favours tuples that found new coverage per exec
+ * and tuples that have had few execs.
+ *
+ * Build:
+ *   g++ -O2 -shared -fPIC -o opj_option_mutator.so opj_option_mutator.cpp
+ * Use:
+ *   AFL_CUSTOM_MUTATOR_LIBRARY=./opj_option_mutator.so afl-fuzz ...
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../common/opj_fuzz_options.h"
+#include "../../../optstats/optstats.h"
+
+typedef struct {
+    uint64_t rng;
+    uint8_t* out;
+    size_t   out_cap;
+    optstats_sched sched;
+} OptionMutator;
+
+static uint32_t NextRand(OptionMutator* m)
+{
+    m->rng ^= m->rng << 13;
+    m->rng ^= m->rng >> 7;
+    m->rng ^= m->rng << 17;
+    return (uint32_t)(m->rng >> 32);
+}
+
+static uint32_t RandBelow(OptionMutator* m, uint32_t n)
+{
+    return n ? NextRand(m) % n : 0;
+}
+
+static bool Reserve(OptionMutator* m, size_t n)
+{
+    if (n <= m->out_cap) {
+        return true;
+    }
+    uint8_t* grown = (uint8_t*)realloc(m->out, n);
+    if (!grown) {
+        return false;
+    }
+    m->out = grown;
+    m->out_cap = n;
+    return true;
+}
+
+// Takes a tuple from the optstats scheduler, or sets one header field to a
+// random legal value from the option schema.  Wide fields (the decode area)
+// favour small values, where the interesting area-clipping cases are; 0
+// (full image) is one of them.
+static void MutateHeader(OptionMutator* m, OpjFuzzOptions* opts)
+{
+    uint8_t key[OPTSTATS_KEY_MAX];
+    if (RandBelow(m, 2) &&
+        optstats_sched_pick(&m->sched, m->rng, key) == OPJ_FUZZ_OPTIONS_SIZE &&
+        OpjFuzzParseOptions(key, OPJ_FUZZ_OPTIONS_SIZE, opts)) {
+        return;
+    }
+    int field = (int)RandBelow(m, OPJ_FUZZ_OPT_COUNT);
+    const OpjFuzzOptionDesc* d = &kOpjFuzzOptionSchema[field];
+    uint32_t count = d->nCount;
+    if (count > 256 && RandBelow(m, 2)) {
+        count = 65;
+    }
+    OpjFuzzSetOption(opts, field, d->nBase + RandBelow(m, count));
+    if (field == OPJ_FUZZ_OPT_THREADS) {
+        opts->bThreadCheck = opts->nThreads > 1 && RandBelow(m, 4) == 0;
+    }
+    OpjFuzzNormalizeOptions(opts);
+}
+
+static const uint8_t kInteresting[] = {0x00, 0x01, 0x7f, 0x80, 0xff, 0x4f, 0x51, 0x52, 0x90, 0x93, 0xd9};
+
+// Length of the signature at the start of the payload that the drivers check
+// before decoding: the JP2 signature box (length, `jP  `, 0x0d0a870a) or the
+// J2K SOC marker.  0 when the payload has neither.
+static size_t SignatureLen(const uint8_t* payload, size_t len)
+{
+    if (len >= 12 && memcmp(payload + 4, "\x6a\x50\x20\x20", 4) == 0) {
+        return 12;
+    }
+    if (len >= 2 && memcmp(payload, "\xff\x4f", 2) == 0) {
+        return 2;
+    }
+    return 0;
+}
+
+// Mutates payload[0..len) in place or by resizing; returns the new length.
+// The signature prefix is left as it is: every position that is changed,
+// inserted at or deleted from lies after it.
+static size_t MutatePayload(OptionMutator* m, uint8_t* payload, size_t len,
+                            size_t cap, const uint8_t* add, size_t add_len)
+{
+    if (OpjFuzzHasOptions(add, add_len)) {
+        add += OPJ_FUZZ_OPTIONS_SIZE;
+        add_len -= OPJ_FUZZ_OPTIONS_SIZE;
+    }
+    size_t lo = SignatureLen(payload, len);
+    uint32_t op = RandBelow(m, add_len ? 5 : 4);
+    if (len == lo && op != 4) {
+        // Nothing to flip, set or delete: grow the payload instead.
+        op = add_len && RandBelow(m, 2) ? 4 : 2;
+    }
+    switch (op) {
+    case 0: {
+        size_t pos = lo + RandBelow(m, (uint32_t)(len - lo));
+        payload[pos] ^= (uint8_t)(1u << RandBelow(m, 8));
+        break;
+    }
+    case 1: {
+        size_t pos = lo + RandBelow(m, (uint32_t)(len - lo));
+        payload[pos] = kInteresting[RandBelow(m, sizeof(kInteresting))];
+        break;
+    }
+    case 2: {
+        // Duplicate a block at a random position; into an empty payload,
+        // insert a block of interesting bytes.
+        size_t n = 1 + RandBelow(m, 32);
+        if (len + n > cap) {
+            n = cap - len;
+        }
+        if (n == 0) {
+            break;
+        }
+        if (len == 0) {
+            for (size_t i = 0; i < n; i++) {
+                payload[i] = kInteresting[RandBelow(m, sizeof(kInteresting))];
+            }
+            len = n;
+            break;
+        }
+        size_t src = RandBelow(m, (uint32_t)len);
+        size_t dst = lo + RandBelow(m, (uint32_t)(len - lo) + 1);
+        if (src + n > len) {
+            n = len - src;
+        }
+        uint8_t block[32];
+        memcpy(block, payload + src, n);
+        memmove(payload + dst + n, payload + dst, len - dst);
+        memcpy(payload + dst, block, n);
+        len += n;
+        break;
+    }
+    case 3: {
+        size_t pos = lo + RandBelow(m, (uint32_t)(len - lo));
+        size_t n = 1 + RandBelow(m, 32);
+        if (pos + n > len) {
+            n = len - pos;
+        }
+        memmove(payload + pos, payload + pos + n, len - pos - n);
+        len -= n;
+        break;
+    }
+    default: {
+        // Splice: keep a prefix of ours, append a suffix of the other payload.
+        size_t keep = lo + RandBelow(m, (uint32_t)(len - lo) + 1);
+        size_t from = RandBelow(m, (uint32_t)add_len);
+        size_t n = add_len - from;
+        if (keep + n > cap) {
+            n = cap - keep;
+        }
+        memcpy(payload + keep, add + from, n);
+        len = keep + n;
+        break;
+    }
+    }
+    return len;
+}
+
+extern "C" void* afl_custom_init(void* afl, unsigned int seed)
+{
+    (void)afl;
+    OptionMutator* m = (OptionMutator*)calloc(1, sizeof(OptionMutator));
+    if (!m) {
+        return NULL;
+    }
+    m->rng = ((uint64_t)seed << 1) | 1;
+    optstats_sched_init(&m->sched, OPJ_FUZZ_OPTIONS_MAGIC, 4);
+    return m;
+}
+
+extern "C" size_t afl_custom_fuzz(void* data, uint8_t* buf, size_t buf_size,
+                                  uint8_t** out_buf, uint8_t* add_buf,
+                                  size_t add_buf_size, size_t max_size)
+{
+    OptionMutator* m = (OptionMutator*)data;
+
+    OpjFuzzOptions opts;
+    const uint8_t* payload = buf;
+    size_t payload_len = buf_size;
+    if (OpjFuzzParseOptions(buf, buf_size, &opts)) {
+        payload += OPJ_FUZZ_OPTIONS_SIZE;
+        payload_len -= OPJ_FUZZ_OPTIONS_SIZE;
+    } else {
+        OpjFuzzDefaultOptions(&opts);
+    }
+
+    if (max_size < OPJ_FUZZ_OPTIONS_SIZE || !Reserve(m, max_size)) {
+        *out_buf = buf;
+        return buf_size;
+    }
+    size_t cap = max_size - OPJ_FUZZ_OPTIONS_SIZE;
+    if (payload_len > cap) {
+        payload_len = cap;
+    }
+    uint8_t* out_payload = m->out + OPJ_FUZZ_OPTIONS_SIZE;
+    if (payload_len) {
+        memmove(out_payload, payload, payload_len);
+    }
+
+    if (RandBelow(m, 3) == 0) {
+        MutateHeader(m, &opts);
+    } else {
+        payload_len = MutatePayload(m, out_payload, payload_len, cap,
+                                    add_buf, add_buf_size);
+    }
+    OpjFuzzWriteOptions(&opts, m->out);
+
+    *out_buf = m->out;
+    return OPJ_FUZZ_OPTIONS_SIZE + payload_len;
+}
+
+extern "C" const char* afl_custom_describe(void* data, size_t max_description_len)
+{
+    (void)data;
+    (void)max_description_len;
+    return "opj_options";
+}
+
+extern "C" void afl_custom_deinit(void* data)
+{
+    OptionMutator* m = (OptionMutator*)data;
+    if (m) {
+        optstats_sched_fini(&m->sched);
+        free(m->out);
+        free(m);
+    }
+}
@@ -0,0 +1,694 @@
+/*
+ * Marker- and box-aware AFL++ custom mutator for JPEG 2000 inputs.
+ *
+ * The payload (after the optional option header of common/opj_fuzz_options.h,
+ * which is kept as is) is parsed as either
+ *  - a J2K codestream: main-header marker segments (SIZ, COD, COC, QCD, QCC,
+ *    ...), then tile-parts (SOT, tile-part header segments, SOD, data),
+ *    then EOC; or
+ *  - a JP2 file: top-level boxes (jP, ftyp, jp2h with ihdr / colr, jp2c),
+ *    the jp2c box holding a codestream parsed as above.
+ *
+ * Mutations work on the parsed structure: semantic SIZ / COD / QCD / SOT /
+ * ihdr / colr fields (image and tile sizes, component count and depth,
+ * decomposition levels, code-block size and style, progression order, layer
+ * count, tile indices), duplicating / dropping / reordering marker segments
+ * and tile-parts, and splicing tile-parts from another corpus entry.  On
+ * serialisation every Lxxx, Psot and box length is recomputed and the
+ * COD/QCD payloads are resized to match the decomposition levels, so the
+ * result still parses past opj_read_header.  Inputs that cannot be parsed
+ * fall back to a few byte flips.
+ *
+ * Build:
+ *   g++ -O2 -shared -fPIC -o opj_structure_mutator.so opj_structure_mutator.cpp
+ * Use (optionally together with opj_option_mutator.so, separated by ';'):
+ *   AFL_CUSTOM_MUTATOR_LIBRARY=./opj_structure_mutator.so afl-fuzz ...
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <vector>
+
+#include "../common/opj_fuzz_options.h"
+
+typedef std::vector<uint8_t> Bytes;
+
+enum {
+    J2K_SOC = 0xff4f,
+    J2K_SIZ = 0xff51,
+    J2K_COD = 0xff52,
+    J2K_COC = 0xff53,
+    J2K_QCD = 0xff5c,
+    J2K_QCC = 0xff5d,
+    J2K_SOT = 0xff90,
+    J2K_SOD = 0xff93,
+    J2K_EOC = 0xffd9
+};
+
+struct Segment {
+    uint16_t marker;
+    Bytes    body;      // without marker and length field
+};
+
+struct TilePart {
+    Bytes                sot;       // SOT body (Isot, Psot, TPsot, TNsot)
+    std::vector<Segment> header;
+    Bytes                data;      // after SOD
+};
+
+struct Codestream {
+    std::vector<Segment>  main;
+    std::vector<TilePart> tiles;
+};
+
+struct Box {
+    uint32_t         type;
+    Bytes            payload;       // leaf boxes
+    std::vector<Box> children;      // jp2h
+    bool             super;
+};
+
+struct StructureMutator {
+    uint64_t rng;
+    Bytes    out;
+};
+
+// ---------------------------------------------------------------------------
+// Helpers
+
+static uint32_t NextRand(StructureMutator* m)
+{
+    m->rng ^= m->rng << 13;
+    m->rng ^= m->rng >> 7;
+    m->rng ^= m->rng << 17;
+    return (uint32_t)(m->rng >> 32);
+}
+
+static uint32_t RandBelow(StructureMutator* m, uint32_t n)
+{
+    return n ? NextRand(m) % n : 0;
+}
+
+static uint32_t Get16(const uint8_t* p) { return (p[0] << 8) | p[1]; }
+static uint32_t Get32(const uint8_t* p)
+{
+    return ((uint32_t)p[0] << 24) | (p[1] << 16) | (p[2] << 8) | p[3];
+}
+static void Put16(uint8_t* p, uint32_t v) { p[0] = (uint8_t)(v >> 8); p[1] = (uint8_t)v; }
+static void Put32(uint8_t* p, uint32_t v)
+{
+    p[0] = (uint8_t)(v >> 24); p[1] = (uint8_t)(v >> 16);
+    p[2] = (uint8_t)(v >> 8);  p[3] = (uint8_t)v;
+}
+static void Append16(Bytes* b, uint32_t v) { b->push_back((uint8_t)(v >> 8)); b->push_back((uint8_t)v); }
+static void Append32(Bytes* b, uint32_t v) { Append16(b, v >> 16); Append16(b, v & 0xffff); }
+
+static uint32_t BoxType(const char* t) { return Get32((const uint8_t*)t); }
+
+// ---------------------------------------------------------------------------
+// J2K parsing / serialisation
+
+static bool ParseSegments(const uint8_t* p, size_t len, size_t* pos,
+                          std::vector<Segment>* segs, uint16_t stop)
+{
+    while (*pos + 2 <= len) {
+        uint16_t marker = (uint16_t)Get16(p + *pos);
+        if (marker == stop || marker == J2K_EOC) {
+            return true;
+        }
+        if ((marker >> 8) != 0xff || *pos + 4 > len) {
+            return false;
+        }
+        uint32_t l = Get16(p + *pos + 2);
+        if (l < 2 || *pos + 2 + l > len) {
+            return false;
+        }
+        Segment s;
+        s.marker = marker;
+        s.body.assign(p + *pos + 4, p + *pos + 2 + l);
+        segs->push_back(s);
+        *pos += 2 + l;
+    }
+    return true;
+}
+
+static bool ParseCodestream(const uint8_t* p, size_t len, Codestream* cs)
+{
+    if (len < 2 || Get16(p) != J2K_SOC) {
+        return false;
+    }
+    size_t pos = 2;
+    if (!ParseSegments(p, len, &pos, &cs->main, J2K_SOT)) {
+        return false;
+    }
+    while (pos + 12 <= len && Get16(p + pos) == J2K_SOT) {
+        size_t start = pos;
+        if (Get16(p + pos + 2) != 10) {
+            return false;
+        }
+        TilePart tp;
+        tp.sot.assign(p + pos + 4, p + pos + 12);
+        uint32_t psot = Get32(p + pos + 6);
+        pos += 12;
+        if (!ParseSegments(p, len, &pos, &tp.header, J2K_SOD) ||
+                pos + 2 > len || Get16(p + pos) != J2K_SOD) {
+            return false;
+        }
+        pos += 2;
+        size_t end;
+        if (psot == 0 || start + psot > len || start + psot < pos) {
+            // Psot 0 (last tile-part up to EOC) or bogus: take up to EOC.
+            end = len;
+            if (end >= pos + 2 && Get16(p + end - 2) == J2K_EOC) {
+                end -= 2;
+            }
+        } else {
+            end = start + psot;
+        }
+        tp.data.assign(p + pos, p + end);
+        cs->tiles.push_back(tp);
+        pos = end;
+    }
+    return true;
+}
+
+static void SerializeSegment(const Segment& s, Bytes* out)
+{
+    Append16(out, s.marker);
+    Append16(out, (uint32_t)(s.body.size() + 2));
+    out->insert(out->end(), s.body.begin(), s.body.end());
+}
+
+static void SerializeCodestream(const Codestream& cs, Bytes* out)
+{
+    Append16(out, J2K_SOC);
+    for (size_t i = 0; i < cs.main.size(); i++) {
+        SerializeSegment(cs.main[i], out);
+    }
+    for (size_t t = 0; t < cs.tiles.size(); t++) {
+        const TilePart& tp = cs.tiles[t];
+        size_t start = out->size();
+        Append16(out, J2K_SOT);
+        Append16(out, 10);
+        Bytes sot = tp.sot;
+        sot.resize(8);
+        out->insert(out->end(), sot.begin(), sot.end());
+        for (size_t i = 0; i < tp.header.size(); i++) {
+            SerializeSegment(tp.header[i], out);
+        }
+        Append16(out, J2K_SOD);
+        out->insert(out->end(), tp.data.begin(), tp.data.end());
+        Put32(&(*out)[start + 6], (uint32_t)(out->size() - start));  // Psot
+    }
+    Append16(out, J2K_EOC);
+}
+
+static Segment* FindSegment(std::vector<Segment>* segs, uint16_t marker)
+{
+    for (size_t i = 0; i < segs->size(); i++) {
+        if ((*segs)[i].marker == marker) {
+            return &(*segs)[i];
+        }
+    }
+    return NULL;
+}
+
+static const Segment* FindSegment(const std::vector<Segment>* segs, uint16_t marker)
+{
+    return FindSegment(const_cast<std::vector<Segment>*>(segs), marker);
+}
+
+// Resizes the COD precinct list and the QCD/QCC step sizes to the number of
+// decomposition levels, as the decoder expects.
+static void FixupCoding(Codestream* cs)
+{
+    Segment* cod = FindSegment(&cs->main, J2K_COD);
+    uint32_t levels = 5;
+    if (cod && cod->body.size() >= 10) {
+        levels = cod->body[5] % 33;
+        cod->body[5] = (uint8_t)levels;
+        size_t want = 10 + ((cod->body[0] & 1) ? levels + 1 : 0);
+        cod->body.resize(want, 0x77);
+    }
+    for (size_t i = 0; i < cs->main.size(); i++) {
+        Segment& s = cs->main[i];
+        size_t off;
+        if (s.marker == J2K_QCD) {
+            off = 1;
+        } else if (s.marker == J2K_QCC) {
+            off = 2;  // assumes Csiz < 257
+        } else {
+            continue;
+        }
+        if (s.body.size() < off) {
+            continue;
+        }
+        uint32_t style = s.body[off - 1] & 0x1f;
+        size_t bands = 3 * levels + 1;
+        size_t want = off + (style == 0 ? bands : style == 1 ? 2 : 2 * bands);
+        uint8_t fill = s.body.size() > off ? s.body.back() : 0x40;
+        s.body.resize(want, fill);
+    }
+}
+
+// Semantic edits of SIZ: image / tile geometry and components.
+static void MutateSiz(StructureMutator* m, Segment* siz)
+{
+    Bytes& b = siz->body;
+    if (b.size() < 38) {
+        return;
+    }
+    uint32_t xsiz = Get32(&b[2]), ysiz = Get32(&b[6]);
+    switch (RandBelow(m, 6)) {
+    case 0: {
+        // Tile size: a fraction of the image, a power of two, or tiny.
+        uint32_t choice = RandBelow(m, 3);
+        uint32_t tdx = choice == 0 ? xsiz / (1 + RandBelow(m, 8))
+                     : choice == 1 ? 1u << RandBelow(m, 16)
+                     : 1 + RandBelow(m, 16);
+        uint32_t tdy = RandBelow(m, 2) ? tdx : ysiz / (1 + RandBelow(m, 8));
+        Put32(&b[18], tdx ? tdx : 1);
+        Put32(&b[22], tdy ? tdy : 1);
+        break;
+    }
+    case 1:
+        Put32(&b[2], xsiz + RandBelow(m, 64) - 32);
+        Put32(&b[6], ysiz + RandBelow(m, 64) - 32);
+        break;
+    case 2:
+        // Image / tile origin.
+        Put32(&b[10], RandBelow(m, 4) ? 0 : RandBelow(m, xsiz + 1));
+        Put32(&b[14], RandBelow(m, 4) ? 0 : RandBelow(m, ysiz + 1));
+        Put32(&b[26], RandBelow(m, 4) ? 0 : RandBelow(m, 16));
+        Put32(&b[30], RandBelow(m, 4) ? 0 : RandBelow(m, 16));
+        break;
+    case 3: {
+        // Component count, adding or dropping per-component entries.
+        uint32_t csiz = 1 + RandBelow(m, RandBelow(m, 8) ? 4 : 300);
+        b.resize(36);
+        Put16(&b[34], csiz);
+        for (uint32_t c = 0; c < csiz; c++) {
+            b.push_back(7);
+            b.push_back(1);
+            b.push_back(1);
+        }
+        break;
+    }
+    case 4: {
+        // Bit depth / signedness of one component.
+        uint32_t csiz = Get16(&b[34]);
+        if (csiz && b.size() >= 36 + 3 * (size_t)csiz) {
+            uint32_t c = RandBelow(m, csiz);
+            b[36 + 3 * c] = (uint8_t)(RandBelow(m, 38) | (RandBelow(m, 4) ? 0 : 0x80));
+        }
+        break;
+    }
+    default: {
+        // Sub-sampling of one component.
+        uint32_t csiz = Get16(&b[34]);
+        if (csiz && b.size() >= 36 + 3 * (size_t)csiz) {
+            uint32_t c = RandBelow(m, csiz);
+            b[37 + 3 * c] = (uint8_t)(1 + RandBelow(m, 4));
+            b[38 + 3 * c] = (uint8_t)(1 + RandBelow(m, 4));
+        }
+        break;
+    }
+    }
+}
+
+// Semantic edits of COD: progression, layers, MCT, levels, code-blocks.
+static void MutateCod(StructureMutator* m, Segment* cod)
+{
+    Bytes& b = cod->body;
+    if (b.size() < 10) {
+        return;
+    }
+    switch (RandBelow(m, 7)) {
+    case 0:
+        b[1] = (uint8_t)RandBelow(m, 6);                          // progression
+        break;
+    case 1:
+        Put16(&b[2], RandBelow(m, 4) ? 1 + RandBelow(m, 8) : RandBelow(m, 65536));
+        break;
+    case 2:
+        b[4] = (uint8_t)RandBelow(m, 3);                          // MCT
+        break;
+    case 3:
+        b[5] = (uint8_t)(RandBelow(m, 4) ? RandBelow(m, 8) : RandBelow(m, 33));
+        break;
+    case 4:
+        b[6] = (uint8_t)RandBelow(m, 10);                         // xcb - 2
+        b[7] = (uint8_t)RandBelow(m, 10);                         // ycb - 2
+        break;
+    case 5:
+        b[8] = (uint8_t)RandBelow(m, 128);                        // cblk style
+        break;
+    default:
+        b[0] ^= (uint8_t)(1u << RandBelow(m, 3));                 // precincts / SOP / EPH
+        b[9] = (uint8_t)RandBelow(m, 2);                          // 9/7 or 5/3
+        break;
+    }
+}
+
+static void MutateQcd(StructureMutator* m, Segment* qcd)
+{
+    Bytes& b = qcd->body;
+    if (b.empty()) {
+        return;
+    }
+    if (RandBelow(m, 2)) {
+        b[0] = (uint8_t)((RandBelow(m, 8) << 5) | RandBelow(m, 3));  // guard bits, style
+    } else if (b.size() > 1) {
+        b[1 + RandBelow(m, (uint32_t)b.size() - 1)] = (uint8_t)NextRand(m);
+    }
+}
+
+static void MutateSot(StructureMutator* m, TilePart* tp, uint32_t ntiles)
+{
+    tp->sot.resize(8);
+    switch (RandBelow(m, 3)) {
+    case 0:
+        Put16(&tp->sot[0], RandBelow(m, 4) ? RandBelow(m, ntiles + 2) : RandBelow(m, 65536));
+        break;
+    case 1:
+        tp->sot[6] = (uint8_t)RandBelow(m, 4);                      // TPsot
+        break;
+    default:
+        tp->sot[7] = (uint8_t)RandBelow(m, 4);                      // TNsot
+        break;
+    }
+}
+
+static void MutateCodestream(StructureMutator* m, Codestream* cs,
+                             const Codestream* other)
+{
+    uint32_t ntiles = (uint32_t)cs->tiles.size();
+    switch (RandBelow(m, other ? 9 : 8)) {
+    case 0: case 1: {
+        Segment* siz = FindSegment(&cs->main, J2K_SIZ);
+        if (siz) MutateSiz(m, siz);
+        break;
+    }
+    case 2: case 3: {
+        Segment* cod = FindSegment(&cs->main, J2K_COD);
+        if (cod) MutateCod(m, cod);
+        break;
+    }
+    case 4: {
+        Segment* qcd = FindSegment(&cs->main, J2K_QCD);
+        if (qcd) MutateQcd(m, qcd);
+        break;
+    }
+    case 5:
+        if (ntiles) MutateSot(m, &cs->tiles[RandBelow(m, ntiles)], ntiles);
+        break;
+    case 6:
+        // Duplicate or drop a main-header segment (never SIZ, which must
+        // come first).
+        if (cs->main.size() > 1) {
+            size_t i = 1 + RandBelow(m, (uint32_t)cs->main.size() - 1);
+            if (RandBelow(m, 2)) {
+                cs->main.insert(cs->main.begin() + i, cs->main[i]);
+            } else {
+                cs->main.erase(cs->main.begin() + i);
+            }
+        }
+        break;
+    case 7:
+        // Duplicate, drop or swap tile-parts.
+        if (ntiles) {
+            size_t i = RandBelow(m, ntiles);
+            size_t j = RandBelow(m, ntiles);
+            switch (RandBelow(m, 3)) {
+            case 0: cs->tiles.insert(cs->tiles.begin() + i, cs->tiles[j]); break;
+            case 1: if (ntiles > 1) cs->tiles.erase(cs->tiles.begin() + i); break;
+            default: {
+                TilePart tmp = cs->tiles[i];
+                cs->tiles[i] = cs->tiles[j];
+                cs->tiles[j] = tmp;
+                break;
+            }
+            }
+        }
+        break;
+    default:
+        // Splice a tile-part from another corpus entry.
+        if (other && !other->tiles.empty()) {
+            const TilePart& tp = other->tiles[RandBelow(m, (uint32_t)other->tiles.size())];
+            if (ntiles && RandBelow(m, 2)) {
+                cs->tiles[RandBelow(m, ntiles)] = tp;
+            } else {
+                cs->tiles.insert(cs->tiles.begin() + RandBelow(m, ntiles + 1), tp);
+            }
+        }
+        break;
+    }
+    FixupCoding(cs);
+}
+
+// ---------------------------------------------------------------------------
+// JP2 parsing / serialisation
+
+static bool ParseBoxes(const uint8_t* p, size_t len, std::vector<Box>* boxes, int depth)
+{
+    size_t pos = 0;
+    while (pos + 8 <= len) {
+        uint64_t lbox = Get32(p + pos);
+        uint32_t type = Get32(p + pos + 4);
+        size_t hdr = 8;
+        if (lbox == 1) {
+            if (pos + 16 > len) return false;
+            lbox = ((uint64_t)Get32(p + pos + 8) << 32) | Get32(p + pos + 12);
+            hdr = 16;
+        } else if (lbox == 0) {
+            lbox = len - pos;
+        }
+        if (lbox < hdr || lbox > len - pos) {
+            return false;
+        }
+        Box box;
+        box.type = type;
+        box.super = depth == 0 && type == BoxType("jp2h");
+        if (box.super) {
+            if (!ParseBoxes(p + pos + hdr, lbox - hdr, &box.children, depth + 1)) {
+                return false;
+            }
+        } else {
+            box.payload.assign(p + pos + hdr, p + pos + lbox);
+        }
+        boxes->push_back(box);
+        pos += lbox;
+    }
+    return pos == len;
+}
+
+static void SerializeBoxes(const std::vector<Box>& boxes, Bytes* out)
+{
+    for (size_t i = 0; i < boxes.size(); i++) {
+        const Box& box = boxes[i];
+        size_t start = out->size();
+        Append32(out, 0);
+        Append32(out, box.type);
+        if (box.super) {
+            SerializeBoxes(box.children, out);
+        } else {
+            out->insert(out->end(), box.payload.begin(), box.payload.end());
+        }
+        Put32(&(*out)[start], (uint32_t)(out->size() - start));
+    }
+}
+
+static Box* FindBox(std::vector<Box>* boxes, uint32_t type)
+{
+    for (size_t i = 0; i < boxes->size(); i++) {
+        if ((*boxes)[i].type == type) {
+            return &(*boxes)[i];
+        }
+        if ((*boxes)[i].super) {
+            Box* b = FindBox(&(*boxes)[i].children, type);
+            if (b) return b;
+        }
+    }
+    return NULL;
+}
+
+static void MutateJp2Header(StructureMutator* m, std::vector<Box>* boxes,
+                            const Codestream* cs)
+{
+    Box* ihdr = FindBox(boxes, BoxType("ihdr"));
+    Box* colr = FindBox(boxes, BoxType("colr"));
+    Box* jp2h = FindBox(boxes, BoxType("jp2h"));
+    switch (RandBelow(m, 5)) {
+    case 0:
+        // ihdr geometry: match the codestream SIZ or pick something else.
+        if (ihdr && ihdr->payload.size() >= 14) {
+            Bytes& b = ihdr->payload;
+            const Segment* siz = cs ? FindSegment(&cs->main, J2K_SIZ) : NULL;
+            if (siz && siz->body.size() >= 36 && RandBelow(m, 2)) {
+                Put32(&b[0], Get32(&siz->body[6]) - Get32(&siz->body[14]));
+                Put32(&b[4], Get32(&siz->body[2]) - Get32(&siz->body[10]));
+                Put16(&b[8], Get16(&siz->body[34]));
+            } else {
+                Put32(&b[0], RandBelow(m, 4096));
+                Put32(&b[4], RandBelow(m, 4096));
+                Put16(&b[8], 1 + RandBelow(m, 4));
+            }
+        }
+        break;
+    case 1:
+        if (ihdr && ihdr->payload.size() >= 14) {
+            ihdr->payload[10] = RandBelow(m, 4) ? (uint8_t)RandBelow(m, 16) : 0xff;  // BPC
+            ihdr->payload[11] = (uint8_t)(RandBelow(m, 4) ? 7 : NextRand(m));        // C
+            ihdr->payload[12] = (uint8_t)RandBelow(m, 2);                             // UnkC
+            ihdr->payload[13] = (uint8_t)RandBelow(m, 2);                             // IPR
+        }
+        break;
+    case 2:
+        if (colr && colr->payload.size() >= 7) {
+            static const uint32_t kEnumCS[] = {16, 17, 18, 12, 14, 24, 0, 0xffffffffu};
+            colr->payload[0] = (uint8_t)(1 + RandBelow(m, 2));
+            Put32(&colr->payload[3], kEnumCS[RandBelow(m, 8)]);
+        }
+        break;
+    case 3:
+        // Duplicate or drop a jp2h child box (pclr / cmap / cdef / res paths).
+        if (jp2h && !jp2h->children.empty()) {
+            size_t i = RandBelow(m, (uint32_t)jp2h->children.size());
+            if (RandBelow(m, 2)) {
+                jp2h->children.push_back(jp2h->children[i]);
+            } else if (jp2h->children.size() > 1) {
+                jp2h->children.erase(jp2h->children.begin() + i);
+            }
+        }
+        break;
+    default: {
+        Box* ftyp = FindBox(boxes, BoxType("ftyp"));
+        if (ftyp && ftyp->payload.size() >= 8) {
+            Put32(&ftyp->payload[0], RandBelow(m, 2) ? BoxType("jp2 ") : BoxType("jpx "));
+            Put32(&ftyp->payload[4], RandBelow(m, 3));
+        }
+        break;
+    }
+    }
+}
+
+// ---------------------------------------------------------------------------
+// Input handling
+
+struct Parsed {
+    bool             jp2;
+    std::vector<Box> boxes;
+    Codestream       cs;
+    bool             haveCs;
+};
+
+static bool ParseInput(const uint8_t* p, size_t len, Parsed* parsed)
+{
+    parsed->haveCs = false;
+    if (len >= 2 && Get16(p) == J2K_SOC) {
+        parsed->jp2 = false;
+        parsed->haveCs = ParseCodestream(p, len, &parsed->cs);
+        return parsed->haveCs;
+    }
+    parsed->jp2 = true;
+    if (!ParseBoxes(p, len, &parsed->boxes, 0)) {
+        return false;
+    }
+    Box* jp2c = FindBox(&parsed->boxes, BoxType("jp2c"));
+    if (jp2c) {
+        parsed->haveCs = ParseCodestream(jp2c->payload.data(), jp2c->payload.size(), &parsed->cs);
+    }
+    return true;
+}
+
+static void SerializeInput(Parsed* parsed, Bytes* out)
+{
+    if (!parsed->jp2) {
+        SerializeCodestream(parsed->cs, out);
+        return;
+    }
+    if (parsed->haveCs) {
+        Box* jp2c = FindBox(&parsed->boxes, BoxType("jp2c"));
+        jp2c->payload.clear();
+        SerializeCodestream(parsed->cs, &jp2c->payload);
+    }
+    SerializeBoxes(parsed->boxes, out);
+}
+
+static void StripHeader(const uint8_t** p, size_t* len)
+{
+    if (OpjFuzzHasOptions(*p, *len)) {
+        *p += OPJ_FUZZ_OPTIONS_SIZE;
+        *len -= OPJ_FUZZ_OPTIONS_SIZE;
+    }
+}
+
+extern "C" void* afl_custom_init(void* afl, unsigned int seed)
+{
+    (void)afl;
+    StructureMutator* m = new StructureMutator();
+    m->rng = ((uint64_t)seed << 1) | 1;
+    return m;
+}
+
+extern "C" size_t afl_custom_fuzz(void* data, uint8_t* buf, size_t buf_size,
+                                  uint8_t** out_buf, uint8_t* add_buf,
+                                  size_t add_buf_size, size_t max_size)
+{
+    StructureMutator* m = (StructureMutator*)data;
+    m->out.clear();
+
+    const uint8_t* payload = buf;
+    size_t payload_len = buf_size;
+    StripHeader(&payload, &payload_len);
+    m->out.insert(m->out.end(), (const uint8_t*)buf, payload);
+
+    Parsed parsed;
+    if (ParseInput(payload, payload_len, &parsed)) {
+        Parsed other;
+        const Codestream* otherCs = NULL;
+        if (add_buf && add_buf_size) {
+            const uint8_t* add = add_buf;
+            size_t add_len = add_buf_size;
+            StripHeader(&add, &add_len);
+            if (ParseInput(add, add_len, &other) && other.haveCs) {
+                otherCs = &other.cs;
+            }
+        }
+        if (parsed.jp2 && (!parsed.haveCs || RandBelow(m, 4) == 0)) {
+            MutateJp2Header(m, &parsed.boxes, parsed.haveCs ? &parsed.cs : NULL);
+        } else if (parsed.haveCs) {
+            MutateCodestream(m, &parsed.cs, otherCs);
+        }
+        SerializeInput(&parsed, &m->out);
+    } else {
+        // Unparseable: a few byte flips, leaving the structure to havoc.
+        m->out.insert(m->out.end(), payload, payload + payload_len);
+        size_t start = buf_size - payload_len;
+        for (uint32_t n = 1 + RandBelow(m, 4); n && m->out.size() > start; n--) {
+            m->out[start + RandBelow(m, (uint32_t)(m->out.size() - start))] ^=
+                (uint8_t)(1u << RandBelow(m, 8));
+        }
+    }
+
+    if (m->out.size() > max_size) {
+        m->out.resize(max_size);
+    }
+    *out_buf = m->out.data();
+    return m->out.size();
+}
+
+extern "C" const char* afl_custom_describe(void* data, size_t max_description_len)
+{
+    (void)data;
+    (void)max_description_len;
+    return "opj_structure";
+}
+
+extern "C" void afl_custom_deinit(void* data)
+{
+    delete (StructureMutator*)data;
+}
@@ -6,12 +6,18 @@
 #include <stdio.h>
 
 #include "openjpeg.h"
-
-typedef struct {
-    const uint8_t* pabyData;
-    size_t         nCurPos;
-    size_t         nLength;
-} MemFile;
+#include "../common/opj_fuzz_decode.h"
+#include "../common/opj_fuzz_options.h"
+#include "../../../optstats/optstats.h"
+
+// 使用 afl-clang-fast++ 编译时自动启用持久模式，可用 -DOPJ_FUZZ_NO_PERSISTENT 关闭
+#if defined(__AFL_FUZZ_TESTCASE_LEN) && !defined(OPJ_FUZZ_NO_PERSISTENT)
+#define OPJ_FUZZ_PERSISTENT 1
+#ifndef OPJ_FUZZ_LOOP_COUNT
+#define OPJ_FUZZ_LOOP_COUNT 10000
+#endif
+__AFL_FUZZ_INIT();
+#endif
 
 static void ErrorCallback(const char * msg, void *)
 {
@@ -30,40 +36,6 @@ static void InfoCallback(const char * msg, void *)
     // fprintf(stderr, "OpenJPEG Info: %s\n", msg);
 }
 
-static OPJ_SIZE_T ReadCallback(void* pBuffer, OPJ_SIZE_T nBytes, void *pUserData)
-{
-    MemFile* memFile = (MemFile*)pUserData;
-    if (memFile->nCurPos >= memFile->nLength) {
-        return -1;
-    }
-    if (memFile->nCurPos + nBytes >= memFile->nLength) {
-        size_t nToRead = memFile->nLength - memFile->nCurPos;
-        memcpy(pBuffer, memFile->pabyData + memFile->nCurPos, nToRead);
-        memFile->nCurPos = memFile->nLength;
-        return nToRead;
-    }
-    if (nBytes == 0) {
-        return -1;
-    }
-    memcpy(pBuffer, memFile->pabyData + memFile->nCurPos, nBytes);
-    memFile->nCurPos += nBytes;
-    return nBytes;
-}
-
-static OPJ_BOOL SeekCallback(OPJ_OFF_T nBytes, void * pUserData)
-{
-    MemFile* memFile = (MemFile*)pUserData;
-    memFile->nCurPos = nBytes;
-    return OPJ_TRUE;
-}
-
-static OPJ_OFF_T SkipCallback(OPJ_OFF_T nBytes, void * pUserData)
-{
-    MemFile* memFile = (MemFile*)pUserData;
-    memFile->nCurPos += nBytes;
-    return nBytes;
-}
-
 // 动态确定编解码器格式的函数
 OPJ_CODEC_FORMAT determine_codec_format(const uint8_t *data, size_t size) 
 {
@@ -84,93 +56,52 @@ OPJ_CODEC_FORMAT determine_codec_format(const uint8_t *data, size_t size)
     return OPJ_CODEC_J2K;
 }
 
-// 动态配置解码器参数的函数
-void configure_decoder_params(opj_dparameters_t* parameters, const uint8_t* data, size_t size) 
-{
-    // 首先重置为默认参数
-    opj_set_default_decoder_parameters(parameters);
-
-    if (size > 10) {
-        // 降低解析精度 (0-4)
-        parameters->cp_reduce = data[5] % 5;
-        
-        // 解码层数 (0-2)
-        parameters->cp_layer = data[6] % 3;
-
-        // 动态调整解码区域参数
-        parameters->nb_tile_to_decode = (data[7] % 5);
-
-        // 颜色空间处理：随机选择是否设置标志
-        parameters->flags = (data[9] % 2) ? 1 : 0;
-    }
-}
-
+// 输入布局：16 字节选项头（common/opj_fuzz_options.h，由选项表统一解码）+ 码流
+// 选项与码流不再重叠，修改选项不会破坏 J2K/JP2 标识
 int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size) 
 {
-    if (size < 10) return 0;  // 输入太小直接返回
+    OpjFuzzOptions options;
+    if (!OpjFuzzParseOptions(data, size, &options)) return 0;  // 缺少选项头直接返回
 
+    const uint8_t* payload = data + OPJ_FUZZ_OPTIONS_SIZE;
+    size_t payload_size = size - OPJ_FUZZ_OPTIONS_SIZE;
+    if (payload_size < 2) return 0;  // 码流太小直接返回
+
+    OpjFuzzDecodeOptions opts;
     // 动态确定编解码器格式
-    OPJ_CODEC_FORMAT eCodecFormat = determine_codec_format(data, size);
-
-    opj_codec_t* pCodec = opj_create_decompress(eCodecFormat);
-    opj_set_info_handler(pCodec, InfoCallback, NULL);
-    opj_set_warning_handler(pCodec, WarningCallback, NULL);
-    opj_set_error_handler(pCodec, ErrorCallback, NULL);
-
-    opj_dparameters_t parameters;
-    // 根据输入文件动态配置参数
-    configure_decoder_params(&parameters, data, size);
-
-    opj_setup_decoder(pCodec, &parameters);
-
-    opj_stream_t *pStream = opj_stream_create(1024, OPJ_TRUE);
-    MemFile memFile;
-    memFile.pabyData = data;
-    memFile.nLength = size;
-    memFile.nCurPos = 0;
-    opj_stream_set_user_data_length(pStream, size);
-    opj_stream_set_read_function(pStream, ReadCallback);
-    opj_stream_set_seek_function(pStream, SeekCallback);
-    opj_stream_set_skip_function(pStream, SkipCallback);
-    opj_stream_set_user_data(pStream, &memFile, NULL);
-
-    opj_image_t * psImage = NULL;
-    if (!opj_read_header(pStream, pCodec, &psImage)) {
-        opj_destroy_codec(pCodec);
-        opj_stream_destroy(pStream);
-        return 0;
+    opts.eCodecFormat = determine_codec_format(payload, payload_size);
+    // 解码参数、流缓冲模式、解码模式、解码区域与线程数均来自选项头
+    OpjFuzzApplyOptions(&options, &opts);
+
+    opts.pfnError = ErrorCallback;
+    opts.pfnWarning = WarningCallback;
+    opts.pfnInfo = InfoCallback;
+
+    // 发布本次执行的选项组合（optstats/optstats.h），键为重新编码后的规范选项头
+    uint8_t key[OPJ_FUZZ_OPTIONS_SIZE];
+    OpjFuzzWriteOptions(&options, key);
+    if (optstats_begin(key, sizeof(key))) {
+        char label[OPTSTATS_LABEL_MAX];
+        OpjFuzzFormatOptions(&options, label, sizeof(label));
+        optstats_label("%s", label);
     }
 
-    // 限制解码区域大小
-    OPJ_UINT32 width = psImage->x1 - psImage->x0;
-    OPJ_UINT32 height = psImage->y1 - psImage->y0;
-    OPJ_UINT32 width_to_read = (width > 1024) ? 1024 : width;
-    OPJ_UINT32 height_to_read = (height > 1024) ? 1024 : height;
-
-    if (opj_set_decode_area(pCodec, psImage,
-                            psImage->x0, psImage->y0,
-                            psImage->x0 + width_to_read,
-                            psImage->y0 + height_to_read)) {
-        opj_decode(pCodec, pStream, psImage);
+    if (options.bThreadCheck) {
+        // 同一输入分别以 1 个和 N 个线程解码并比对输出
+        OpjFuzzDecodeThreadCheck(payload, payload_size, &opts);
+    } else {
+        OpjFuzzDecodeResult result;
+        OpjFuzzDecode(payload, payload_size, &opts, false, &result);
     }
-
-    // 清理资源
-    opj_end_decompress(pCodec, pStream);
-    opj_stream_destroy(pStream);
-    opj_destroy_codec(pCodec);
-    opj_image_destroy(psImage);
+    optstats_end();
 
     return 0;
 }
 
-// 为传统的main函数保留入口，以支持独立编译
-int main(int argc, char** argv) {
-    if (argc < 2) {
-        fprintf(stderr, "Usage: %s <input_file>\n", argv[0]);
-        return 1;
-    }
-
-    FILE* file = fopen(argv[1], "rb");
+// 为传统的main函数保留入口，以支持独立编译和崩溃复现
+static int run_file(const char* path)
+{
+    FILE* file = fopen(path, "rb");
     if (!file) return 0;
 
     fseek(file, 0, SEEK_END);
@@ -185,4 +116,28 @@ int main(int argc, char** argv) {
     free(data);
 
     return result;
-}
\ No newline at end of file
+}
+
+int main(int argc, char** argv) {
+    // 设置 OPTSTATS_FILE 时映射选项组合统计表
+    optstats_init("opj_decompress_fuzzer_J2K");
+
+    // 给定文件参数时按文件执行一次（afl-fuzz 使用 @@ 或复现崩溃）
+    if (argc >= 2) {
+        return run_file(argv[1]);
+    }
+
+#ifdef OPJ_FUZZ_PERSISTENT
+    // 持久模式：测试用例通过共享内存传入，省去 fork/exec 与文件读写
+    __AFL_INIT();
+    const uint8_t* buf = __AFL_FUZZ_TESTCASE_BUF;
+    while (__AFL_LOOP(OPJ_FUZZ_LOOP_COUNT)) {
+        size_t len = __AFL_FUZZ_TESTCASE_LEN;
+        LLVMFuzzerTestOneInput(buf, len);
+    }
+    return 0;
+#else
+    fprintf(stderr, "Usage: %s <input_file>\n", argv[0]);
+    return 1;
+#endif
+}
@@ -35,17 +35,11 @@
 #include <limits.h>
 
 #include "openjpeg.h"
+#include "../common/opj_fuzz_decode.h"
 
 extern "C" int LLVMFuzzerInitialize(int* argc, char*** argv);
 extern "C" int LLVMFuzzerTestOneInput(const uint8_t *buf, size_t len);
 
-typedef struct {
-    const uint8_t* pabyData;
-    size_t         nCurPos;
-    size_t         nLength;
-} MemFile;
-
-
 static void ErrorCallback(const char * msg, void *)
 {
     (void)msg;
@@ -61,46 +55,9 @@ static void InfoCallback(const char *, void *)
 {
 }
 
-static OPJ_SIZE_T ReadCallback(void* pBuffer, OPJ_SIZE_T nBytes,
-                               void *pUserData)
-{
-    MemFile* memFile = (MemFile*)pUserData;
-    //printf("want to read %d bytes at %d\n", (int)memFile->nCurPos, (int)nBytes);
-    if (memFile->nCurPos >= memFile->nLength) {
-        return -1;
-    }
-    if (memFile->nCurPos + nBytes >= memFile->nLength) {
-        size_t nToRead = memFile->nLength - memFile->nCurPos;
-        memcpy(pBuffer, memFile->pabyData + memFile->nCurPos, nToRead);
-        memFile->nCurPos = memFile->nLength;
-        return nToRead;
-    }
-    if (nBytes == 0) {
-        return -1;
-    }
-    memcpy(pBuffer, memFile->pabyData + memFile->nCurPos, nBytes);
-    memFile->nCurPos += nBytes;
-    return nBytes;
-}
-
-static OPJ_BOOL SeekCallback(OPJ_OFF_T nBytes, void * pUserData)
-{
-    MemFile* memFile = (MemFile*)pUserData;
-    //printf("seek to %d\n", (int)nBytes);
-    memFile->nCurPos = nBytes;
-    return OPJ_TRUE;
-}
-
-static OPJ_OFF_T SkipCallback(OPJ_OFF_T nBytes, void * pUserData)
-{
-    MemFile* memFile = (MemFile*)pUserData;
-    memFile->nCurPos += nBytes;
-    return nBytes;
-}
-
-
 int LLVMFuzzerInitialize(int* /*argc*/, char*** argv)
 {
+    OpjFuzzBudgetGet();
     return 0;
 }
 
@@ -109,6 +66,11 @@ static const unsigned char jp2_box_jp[] = {0x6a, 0x50, 0x20, 0x20}; /* 'jP  ' */
 
 int LLVMFuzzerTestOneInput(const uint8_t *buf, size_t len)
 {
+    // The shared corpus is written for the AFL driver; skip its option header.
+    if (OpjFuzzHasOptions(buf, len)) {
+        buf += OPJ_FUZZ_OPTIONS_SIZE;
+        len -= OPJ_FUZZ_OPTIONS_SIZE;
+    }
 
     OPJ_CODEC_FORMAT eCodecFormat;
     if (len >= 4 + sizeof(jp2_box_jp) &&
@@ -123,21 +85,17 @@ int LLVMFuzzerTestOneInput(const uint8_t *buf, size_t len)
     opj_set_warning_handler(pCodec, WarningCallback, NULL);
     opj_set_error_handler(pCodec, ErrorCallback, NULL);
 
+    // No fuzzed options here: decode with the option schema defaults.
+    OpjFuzzOptions options;
+    OpjFuzzDefaultOptions(&options);
     opj_dparameters_t parameters;
-    opj_set_default_decoder_parameters(&parameters);
+    OpjFuzzApplyParameters(&options, &parameters);
 
     opj_setup_decoder(pCodec, &parameters);
 
-    opj_stream_t *pStream = opj_stream_create(1024, OPJ_TRUE);
     MemFile memFile;
-    memFile.pabyData = buf;
-    memFile.nLength = len;
-    memFile.nCurPos = 0;
-    opj_stream_set_user_data_length(pStream, len);
-    opj_stream_set_read_function(pStream, ReadCallback);
-    opj_stream_set_seek_function(pStream, SeekCallback);
-    opj_stream_set_skip_function(pStream, SkipCallback);
-    opj_stream_set_user_data(pStream, &memFile, NULL);
+    opj_stream_t *pStream = MemFileStreamCreate(&memFile, buf, len,
+                                                OPJ_FUZZ_STREAM_WHOLE, 0);
 
     opj_image_t * psImage = NULL;
     if (!opj_read_header(pStream, pCodec, &psImage)) {
@@ -147,15 +105,14 @@ int LLVMFuzzerTestOneInput(const uint8_t *buf, size_t len)
         return 0;
     }
 
-    OPJ_UINT32 width = psImage->x1 - psImage->x0;
-    OPJ_UINT32 height = psImage->y1 - psImage->y0;
-
-#if 0
-    // Reject too big images since that will require allocating a lot of
-    // memory
-    if (width != 0 && psImage->numcomps != 0 &&
-            (width > INT_MAX / psImage->numcomps ||
-             height > INT_MAX / (width * psImage->numcomps * sizeof(OPJ_UINT32)))) {
+    // Pick the decode area, reduction and tiles that fit the per-exec
+    // memory/time budget instead of a fixed 1024x1024 area.
+    const OpjFuzzBudget* budget = OpjFuzzBudgetGet();
+    OpjFuzzPlan plan;
+    OpjFuzzPlanDecode(pCodec, psImage, budget, parameters.cp_reduce, 0, 0,
+                      false, &plan);
+    OpjFuzzPlanLog(&plan, budget);
+    if (plan.bSkip) {
         opj_stream_destroy(pStream);
         opj_destroy_codec(pCodec);
         opj_image_destroy(psImage);
@@ -163,36 +120,7 @@ int LLVMFuzzerTestOneInput(const uint8_t *buf, size_t len)
         return 0;
     }
 
-    // Also reject too big tiles.
-    // TODO: remove this limitation when subtile decoding no longer imply
-    // allocation memory for whole tile
-    opj_codestream_info_v2_t* pCodeStreamInfo = opj_get_cstr_info(pCodec);
-    OPJ_UINT32 nTileW, nTileH;
-    nTileW = pCodeStreamInfo->tdx;
-    nTileH = pCodeStreamInfo->tdy;
-    opj_destroy_cstr_info(&pCodeStreamInfo);
-    if (nTileW > 2048 || nTileH > 2048) {
-        opj_stream_destroy(pStream);
-        opj_destroy_codec(pCodec);
-        opj_image_destroy(psImage);
-
-        return 0;
-    }
-#endif
-
-    OPJ_UINT32 width_to_read = width;
-    if (width_to_read > 1024) {
-        width_to_read = 1024;
-    }
-    OPJ_UINT32 height_to_read = height;
-    if (height_to_read > 1024) {
-        height_to_read = 1024;
-    }
-
-    if (opj_set_decode_area(pCodec, psImage,
-                            psImage->x0, psImage->y0,
-                            psImage->x0 + width_to_read,
-                            psImage->y0 + height_to_read)) {
+    if (OpjFuzzPlanApply(pCodec, psImage, &plan, parameters.cp_reduce)) {
         if (opj_decode(pCodec, pStream, psImage)) {
             //printf("success\n");
         }
@@ -4,17 +4,19 @@
 #include <limits.h>
 #include <stdlib.h>
 #include <stdio.h>
+#ifdef OPJ_FUZZ_STARTUP_TIMING
+#include <time.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
 #include "openjpeg.h"
+#include "../common/opj_fuzz_decode.h"
+#include "../common/opj_fuzz_options.h"
+#include "../../../optstats/optstats.h"
 
 // Define jp2_box_jp here
 static const unsigned char jp2_box_jp[] = {0x6a, 0x50, 0x20, 0x20}; /* 'jP  ' */
 
-typedef struct {
-    const uint8_t* pabyData;
-    size_t         nCurPos;
-    size_t         nLength;
-} MemFile;
-
 static void ErrorCallback(const char * msg, void *) {
     (void)msg;
 }
@@ -25,118 +27,186 @@ static void WarningCallback(const char *, void *) {
 static void InfoCallback(const char *, void *) {
 }
 
-static OPJ_SIZE_T ReadCallback(void* pBuffer, OPJ_SIZE_T nBytes, void *pUserData) {
-    MemFile* memFile = (MemFile*)pUserData;
-    if (memFile->nCurPos >= memFile->nLength) {
-        return -1;
-    }
-    size_t nToRead = (nBytes + memFile->nCurPos > memFile->nLength)
-                     ? memFile->nLength - memFile->nCurPos
-                     : nBytes;
-    memcpy(pBuffer, memFile->pabyData + memFile->nCurPos, nToRead);
-    memFile->nCurPos += nToRead;
-    return nToRead;
+int LLVMFuzzerInitialize(int* /*argc*/, char*** argv) {
+    return 0;
 }
 
-static OPJ_BOOL SeekCallback(OPJ_OFF_T nBytes, void * pUserData) {
-    MemFile* memFile = (MemFile*)pUserData;
-    if (nBytes < 0 || (size_t)nBytes > memFile->nLength) return OPJ_FALSE;
-    memFile->nCurPos = (size_t)nBytes;
-    return OPJ_TRUE;
+#ifdef OPJ_FUZZ_STARTUP_TIMING
+static uint64_t NowMicros() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
 }
-
-static OPJ_OFF_T SkipCallback(OPJ_OFF_T nBytes, void * pUserData) {
-    MemFile* memFile = (MemFile*)pUserData;
-    size_t newPos = memFile->nCurPos + nBytes;
-    if (newPos > memFile->nLength) {
-        memFile->nCurPos = memFile->nLength;
-        return -1;
+#endif
+
+// Input buffer reused by every exec; it only grows.
+static uint8_t* g_input_buf = NULL;
+static size_t g_input_cap = 0;
+
+// One-time setup done before the forkserver starts: everything in here is
+// paid once per campaign instead of once per exec.
+static bool InitOnce(int* argc, char*** argv) {
+    LLVMFuzzerInitialize(argc, argv);
+
+    // Touch libopenjp2 once so lazy symbol binding, relocation of its data
+    // and first-use page faults happen in the parent, not in every child.
+    opj_version();
+    opj_codec_t* pCodec = opj_create_decompress(OPJ_CODEC_JP2);
+    if (pCodec) {
+        opj_set_info_handler(pCodec, InfoCallback, NULL);
+        opj_set_warning_handler(pCodec, WarningCallback, NULL);
+        opj_set_error_handler(pCodec, ErrorCallback, NULL);
+        opj_dparameters_t parameters;
+        opj_set_default_decoder_parameters(&parameters);
+        opj_setup_decoder(pCodec, &parameters);
+        opj_destroy_codec(pCodec);
+    }
+    opj_stream_t* pStream = opj_stream_create(1024, OPJ_TRUE);
+    if (pStream) {
+        opj_stream_destroy(pStream);
     }
-    memFile->nCurPos = newPos;
-    return nBytes;
-}
 
-int LLVMFuzzerInitialize(int* /*argc*/, char*** argv) {
-    return 0;
+    OpjFuzzBudgetGet();
+    optstats_init("opj_decompress_fuzzer_JP2");
+
+    g_input_cap = 64 * 1024;
+    g_input_buf = (uint8_t*)malloc(g_input_cap);
+    return g_input_buf != NULL;
 }
 
-int main(int argc, char** argv) {
-    if (argc < 2) return 0;
-    FILE* file = fopen(argv[1], "rb");
-    if (!file) return 0;
+// Reads the testcase into the shared input buffer, growing it if needed.
+static bool ReadInput(const char* path, size_t* out_size) {
+    FILE* file = fopen(path, "rb");
+    if (!file) return false;
 
-    if (fseeko(file, 0, SEEK_END) != 0) return 0;
+    if (fseeko(file, 0, SEEK_END) != 0) {
+        fclose(file);
+        return false;
+    }
     size_t size = ftello(file);
-    if (size < 8) return 0; // Require at least 8 bytes for options.
     rewind(file);
 
-    uint8_t* buf = (uint8_t*)malloc(size);
-    if (!buf) return 0;
-    fread(buf, 1, size, file);
+    if (size > g_input_cap) {
+        uint8_t* grown = (uint8_t*)realloc(g_input_buf, size);
+        if (!grown) {
+            fclose(file);
+            return false;
+        }
+        g_input_buf = grown;
+        g_input_cap = size;
+    }
+    size_t read_len = fread(g_input_buf, 1, size, file);
     fclose(file);
 
-    // Parse options from the first 8 bytes of input
-    uint32_t cp_reduce = buf[0] % 10; // Reduce level: 0 to 9
-    uint32_t cp_layer = buf[1] % 5;  // Quality layer: 0 to 4
-    uint32_t decode_width = (buf[2] | (buf[3] << 8)) % 4096; // Decode width limit
-    uint32_t decode_height = (buf[4] | (buf[5] << 8)) % 4096; // Decode height limit
-    uint32_t buffer_size = (buf[6] | (buf[7] << 8)) % 8192 + 1024; // Buffer size
-
-    OPJ_CODEC_FORMAT eCodecFormat;
-    if (size >= 4 + sizeof(jp2_box_jp) &&
-        memcmp(buf + 4, jp2_box_jp, sizeof(jp2_box_jp)) == 0) {
-        eCodecFormat = OPJ_CODEC_JP2;
-    } else {
-        free(buf);
+    *out_size = read_len;
+    return true;
+}
+
+// Per-input work: option parsing, codec and stream setup, decoding.
+// The input is an option header (common/opj_fuzz_options.h) followed by the
+// JP2 file.
+static int DecodeInput(const uint8_t* buf, size_t size) {
+    OpjFuzzOptions options;
+    if (!OpjFuzzParseOptions(buf, size, &options)) return 0;
+
+    const uint8_t* payload = buf + OPJ_FUZZ_OPTIONS_SIZE;
+    size_t payload_size = size - OPJ_FUZZ_OPTIONS_SIZE;
+    if (payload_size < 4 + sizeof(jp2_box_jp) ||
+        memcmp(payload + 4, jp2_box_jp, sizeof(jp2_box_jp)) != 0) {
         return 0;
     }
 
-    opj_codec_t* pCodec = opj_create_decompress(eCodecFormat);
-    opj_set_info_handler(pCodec, InfoCallback, NULL);
-    opj_set_warning_handler(pCodec, WarningCallback, NULL);
-    opj_set_error_handler(pCodec, ErrorCallback, NULL);
-
-    opj_dparameters_t parameters;
-    opj_set_default_decoder_parameters(&parameters);
-    parameters.cp_reduce = cp_reduce;
-    parameters.cp_layer = cp_layer;
-    opj_setup_decoder(pCodec, &parameters);
-
-    opj_stream_t *pStream = opj_stream_create(buffer_size, OPJ_TRUE);
-    MemFile memFile = {buf, 0, size};
-    opj_stream_set_user_data_length(pStream, size);
-    opj_stream_set_read_function(pStream, ReadCallback);
-    opj_stream_set_seek_function(pStream, SeekCallback);
-    opj_stream_set_skip_function(pStream, SkipCallback);
-    opj_stream_set_user_data(pStream, &memFile, NULL);
-
-    opj_image_t * psImage = NULL;
-    if (!opj_read_header(pStream, pCodec, &psImage)) {
-        opj_destroy_codec(pCodec);
-        opj_stream_destroy(pStream);
-        free(buf);
-        return 0;
+    OpjFuzzDecodeOptions opts;
+    opts.eCodecFormat = OPJ_CODEC_JP2;
+    OpjFuzzApplyOptions(&options, &opts);
+    opts.pfnError = ErrorCallback;
+    opts.pfnWarning = WarningCallback;
+    opts.pfnInfo = InfoCallback;
+
+    // Publish the option tuple of this exec (optstats/optstats.h); the key
+    // is the header re-encoded from the decoded options.
+    uint8_t key[OPJ_FUZZ_OPTIONS_SIZE];
+    OpjFuzzWriteOptions(&options, key);
+    if (optstats_begin(key, sizeof(key))) {
+        char label[OPTSTATS_LABEL_MAX];
+        OpjFuzzFormatOptions(&options, label, sizeof(label));
+        optstats_label("%s", label);
+    }
+
+    if (options.bThreadCheck) {
+        OpjFuzzDecodeThreadCheck(payload, payload_size, &opts);
+    } else {
+        OpjFuzzDecodeResult result;
+        OpjFuzzDecode(payload, payload_size, &opts, false, &result);
     }
+    optstats_end();
+
+    return 0;
+}
 
-    // Limit decode area based on extracted options
-    uint32_t width = psImage->x1 - psImage->x0;
-    uint32_t height = psImage->y1 - psImage->y0;
+#ifdef OPJ_FUZZ_STARTUP_TIMING
+#ifndef OPJ_FUZZ_STARTUP_RUNS
+#define OPJ_FUZZ_STARTUP_RUNS 200
+#endif
+
+// Emulates a forkserver on one input: forks OPJ_FUZZ_STARTUP_RUNS children
+// and returns the mean wall-clock time per exec in microseconds.  With
+// bInitInChild every child runs InitOnce() first, as with the forkserver at
+// main() entry; otherwise the children start after the caller's InitOnce(),
+// as with __AFL_INIT().
+static double TimeExecs(const char* path, bool bInitInChild, int* argc, char*** argv) {
+    uint64_t t0 = NowMicros();
+    for (int i = 0; i < OPJ_FUZZ_STARTUP_RUNS; i++) {
+        pid_t pid = fork();
+        if (pid < 0) return -1.0;
+        if (pid == 0) {
+            if (bInitInChild && !InitOnce(argc, argv)) _exit(1);
+            size_t size = 0;
+            if (ReadInput(path, &size)) DecodeInput(g_input_buf, size);
+            _exit(0);
+        }
+        int status;
+        waitpid(pid, &status, 0);
+    }
+    return (double)(NowMicros() - t0) / OPJ_FUZZ_STARTUP_RUNS;
+}
+#endif
 
-    uint32_t width_to_read = (decode_width < width) ? decode_width : width;
-    uint32_t height_to_read = (decode_height < height) ? decode_height : height;
+int main(int argc, char** argv) {
+    if (argc < 2) return 0;
 
-    if (opj_set_decode_area(pCodec, psImage,
-                            psImage->x0, psImage->y0,
-                            psImage->x0 + width_to_read,
-                            psImage->y0 + height_to_read)) {
-        opj_decode(pCodec, pStream, psImage);
+#ifdef OPJ_FUZZ_STARTUP_TIMING
+    // Both fork points, measured before this process has touched libopenjp2
+    // (not deferred) and after InitOnce() (deferred).
+    double not_deferred_us = TimeExecs(argv[1], true, &argc, &argv);
+    uint64_t t_start = NowMicros();
+#endif
+    if (!InitOnce(&argc, &argv)) return 0;
+#ifdef OPJ_FUZZ_STARTUP_TIMING
+    uint64_t t_init = NowMicros();
+    double deferred_us = TimeExecs(argv[1], false, &argc, &argv);
+    uint64_t t_input = NowMicros();
+#endif
+
+#ifdef __AFL_HAVE_MANUAL_CONTROL
+    // Deferred forkserver: children start from here, after InitOnce().
+    __AFL_INIT();
+#endif
+
+    size_t size = 0;
+    if (ReadInput(argv[1], &size)) {
+        DecodeInput(g_input_buf, size);
     }
 
-    opj_end_decompress(pCodec, pStream);
-    opj_stream_destroy(pStream);
-    opj_destroy_codec(pCodec);
-    opj_image_destroy(psImage);
-    free(buf);
+#ifdef OPJ_FUZZ_STARTUP_TIMING
+    uint64_t t_end = NowMicros();
+    fprintf(stderr, "startup: init %llu us, input %llu us; per exec over %d forks: "
+            "not deferred %.1f us, deferred %.1f us\n",
+            (unsigned long long)(t_init - t_start),
+            (unsigned long long)(t_end - t_input),
+            OPJ_FUZZ_STARTUP_RUNS, not_deferred_us, deferred_us);
+#endif
 
+    free(g_input_buf);
     return 0;
 }
@@ -0,0 +1,165 @@
+/*
+ * Checks of the decode-budget planner (common/opj_fuzz_budget.h).
+ *
+ * Each case is the main header of a codestream as opj_read_header() and
+ * opj_get_cstr_info() report it: the SIZ image and tile grid, the component
+ * count, and the COD resolutions and layers.  The planner is run on it
+ * against a fixed budget, and the plan is checked:
+ *
+ *  - huge-tile SIZ markers, whose sample counts overflow 64 bits, must be
+ *    skipped rather than accepted on a wrapped estimate;
+ *  - every plan that is not skipped must really fit the budget, with its
+ *    cost recomputed in long double;
+ *  - the layer count must reach the time estimate.
+ *
+ * Only openjpeg.h is needed, not libopenjp2:
+ *   g++ -O2 -I../src/lib/openjp2 -o opj_fuzz_budget_test opj_fuzz_budget_test.cpp
+ *   ./opj_fuzz_budget_test
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "openjpeg.h"
+#include "common/opj_fuzz_budget.h"
+
+typedef struct {
+    const char* name;
+    // SIZ
+    OPJ_UINT32 x0, y0, x1, y1;
+    OPJ_UINT32 tx0, ty0, tdx, tdy;
+    OPJ_UINT32 nNumComps;
+    // COD
+    OPJ_UINT32 nNumRes, nNumLayers;
+    // Expected outcome: skipped, or else the reduction picked (-1: any).
+    bool bSkip;
+    int nReduce;
+} BudgetCase;
+
+static const BudgetCase kCases[] = {
+    // One 2^32-1 square tile: the tile sample count alone is ~2^64.
+    { "huge tile", 0, 0, 0xFFFFFFFFu, 0xFFFFFFFFu, 0, 0, 0xFFFFFFFFu, 0xFFFFFFFFu,
+      1, 6, 1, true, -1 },
+    // 2^31 square tile and image: 2^62 samples, so the byte and time
+    // products wrap to exactly 0 without saturation.
+    { "2^31 tile", 0, 0, 0x80000000u, 0x80000000u, 0, 0, 0x80000000u, 0x80000000u,
+      1, 6, 1, true, -1 },
+    // Two components over a 2^32 square area wrap the output image size;
+    // small tiles let the planner shrink the area until it fits, and the
+    // area must not collapse to nothing on the way.
+    { "2^32 area, 2 comps", 0, 0, 0xFFFFFFFFu, 0xFFFFFFFFu, 0, 0, 1024, 1024,
+      2, 6, 1, false, -1 },
+    // Small image, one layer: decoded as asked.
+    { "small, 1 layer", 0, 0, 64, 64, 0, 0, 64, 64, 3, 6, 1, false, 0 },
+    // Same image with 65535 layers: only the packet count differs, and it
+    // pushes the decode to a lower resolution.
+    { "small, 65535 layers", 0, 0, 64, 64, 0, 0, 64, 64, 3, 6, 65535, false, 1 },
+};
+
+// The planner's cost model, in long double so nothing wraps.
+static void ExactCost(const OpjFuzzPlan* plan, const OpjFuzzBudget* budget,
+                      long double* pBytes, long double* pNs)
+{
+    long double tw = (long double)OpjFuzzCeilShift(plan->nTileW, plan->nReduce);
+    long double th = (long double)OpjFuzzCeilShift(plan->nTileH, plan->nReduce);
+    long double aw = (long double)OpjFuzzCeilShift(plan->x1 - plan->x0, plan->nReduce);
+    long double ah = (long double)OpjFuzzCeilShift(plan->y1 - plan->y0, plan->nReduce);
+    long double tile = tw * th * plan->nNumComps;
+    long double area = aw * ah * plan->nNumComps;
+    long double tiles = (long double)plan->nTilesX * plan->nTilesY;
+    long double res = plan->nNumRes > plan->nReduce ? plan->nNumRes - plan->nReduce : 1;
+    long double layers = plan->nNumLayers ? plan->nNumLayers : 1;
+    *pBytes = tile * sizeof(OPJ_INT32) * 2 +
+              (plan->bStreaming ? tile : area) * sizeof(OPJ_INT32);
+    *pNs = tiles * tile * budget->nNsPerSample +
+           tiles * layers * res * plan->nNumComps * budget->nNsPerPacket;
+}
+
+static bool RunCase(const BudgetCase* c, const OpjFuzzBudget* budget, bool bStreaming)
+{
+    opj_image_comp_t comps[4];
+    memset(comps, 0, sizeof(comps));
+    opj_image_t image;
+    memset(&image, 0, sizeof(image));
+    image.x0 = c->x0;
+    image.y0 = c->y0;
+    image.x1 = c->x1;
+    image.y1 = c->y1;
+    image.numcomps = c->nNumComps;
+    image.comps = comps;
+
+    opj_tccp_info_t tccp[4];
+    memset(tccp, 0, sizeof(tccp));
+    for (OPJ_UINT32 i = 0; i < c->nNumComps; i++) {
+        tccp[i].numresolutions = c->nNumRes;
+    }
+    opj_codestream_info_v2_t info;
+    memset(&info, 0, sizeof(info));
+    info.tx0 = c->tx0;
+    info.ty0 = c->ty0;
+    info.tdx = c->tdx;
+    info.tdy = c->tdy;
+    info.nbcomps = c->nNumComps;
+    info.m_default_tile_info.numlayers = c->nNumLayers;
+    info.m_default_tile_info.tccp_info = tccp;
+
+    OpjFuzzPlan plan;
+    OpjFuzzPlanCompute(&image, &info, budget, 0, 0, 0, bStreaming, &plan);
+
+    bool ok = true;
+    if (plan.bSkip != c->bSkip) {
+        printf("FAIL %s%s: %s, expected %s\n", c->name, bStreaming ? " (streamed)" : "",
+               plan.bSkip ? "skipped" : "accepted", c->bSkip ? "skipped" : "accepted");
+        ok = false;
+    }
+    if (!plan.bSkip) {
+        long double bytes, ns;
+        ExactCost(&plan, budget, &bytes, &ns);
+        if (bytes > budget->nMemBytes || ns > budget->nTimeNs) {
+            printf("FAIL %s%s: accepted plan needs %.0Lf bytes, %.0Lf ns\n", c->name,
+                   bStreaming ? " (streamed)" : "", bytes, ns);
+            ok = false;
+        }
+        if (plan.x1 <= plan.x0 || plan.y1 <= plan.y0) {
+            printf("FAIL %s%s: empty decode area\n", c->name, bStreaming ? " (streamed)" : "");
+            ok = false;
+        }
+        if (c->nReduce >= 0 && plan.nReduce != (OPJ_UINT32)c->nReduce) {
+            printf("FAIL %s%s: reduce %u, expected %d\n", c->name,
+                   bStreaming ? " (streamed)" : "", plan.nReduce, c->nReduce);
+            ok = false;
+        }
+    }
+    if (ok) {
+        printf("ok   %s%s: %s reduce %u area %ux%u est %llu KiB %llu us\n", c->name,
+               bStreaming ? " (streamed)" : "", plan.bSkip ? "skip" : "plan",
+               plan.nReduce, plan.x1 - plan.x0, plan.y1 - plan.y0,
+               (unsigned long long)(plan.nEstBytes >> 10),
+               (unsigned long long)(plan.nEstNs / 1000));
+    }
+    return ok;
+}
+
+int main()
+{
+    // The defaults of OpjFuzzBudgetGet(), fixed so the environment does not
+    // change the outcome.
+    OpjFuzzBudget budget;
+    budget.nMemBytes = (uint64_t)256 << 20;
+    budget.nTimeNs = (uint64_t)200 * 1000000;
+    budget.nNsPerSample = 40;
+    budget.nNsPerPacket = 200;
+    budget.bLog = false;
+
+    int failed = 0;
+    for (size_t i = 0; i < sizeof(kCases) / sizeof(kCases[0]); i++) {
+        failed += !RunCase(&kCases[i], &budget, false);
+        failed += !RunCase(&kCases[i], &budget, true);
+    }
+    if (failed) {
+        printf("%d check(s) failed\n", failed);
+        return 1;
+    }
+    return 0;
+}
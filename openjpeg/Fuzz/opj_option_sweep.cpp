@@ -0,0 +1,243 @@
+/*
+ * Option-space sweep for the openjpeg drivers.
+ *
+ * Walks the combinations of the option schema (common/opj_fuzz_options.h)
+ * over a chosen set of fields and, for each input file, decodes the payload
+ * once per combination through the same pipeline as the AFL drivers.  One
+ * CSV row is printed per (file, combination): the option values, whether
+ * the header was read and the decode succeeded, the output hash and the
+ * decode time.  Hash changes across thread counts or stream modes, and slow
+ * corners of the option space, stand out directly in the table.
+ *
+ * Build (no instrumentation needed):
+ *   g++ -O2 -I../src/lib/openjp2 -o opj_option_sweep opj_option_sweep.cpp -L../../build/bin -lopenjp2
+ *
+ * Usage:
+ *   ./opj_option_sweep -l                       list the schema
+ *   ./opj_option_sweep [-f fields] [-m max] -c  print the size of the space
+ *   ./opj_option_sweep [-f fields] [-m max] file...
+ *   ./opj_option_sweep [-f fields] [-m max] -w dir file...
+ *
+ * fields is a comma-separated list of schema field names (default
+ * nReduce,nLayer,nThreads,bChunked,bTiles); fields with more than max legal
+ * values (default 8) are sampled at max evenly spaced values.  With -w, one
+ * input per combination (option header + payload) is written to dir instead
+ * of decoding, for seeding an AFL driver with the whole sweep.
+ */
+
+#include <errno.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <string>
+#include <vector>
+
+#include "openjpeg.h"
+#include "common/opj_fuzz_decode.h"
+#include "common/opj_fuzz_options.h"
+
+static const char kDefaultFields[] = "nReduce,nLayer,nThreads,bChunked,bTiles";
+
+static void QuietCallback(const char*, void*) {
+}
+
+static void Usage(const char* argv0) {
+    fprintf(stderr,
+            "Usage: %s -l\n"
+            "       %s [-f fields] [-m max] -c\n"
+            "       %s [-f fields] [-m max] [-w dir] file...\n",
+            argv0, argv0, argv0);
+}
+
+static void ListSchema() {
+    printf("%-16s %6s %5s %5s %4s %6s %4s %7s\n",
+           "field", "offset", "width", "shift", "bits", "values", "base", "default");
+    for (int f = 0; f < OPJ_FUZZ_OPT_COUNT; f++) {
+        const OpjFuzzOptionDesc* d = &kOpjFuzzOptionSchema[f];
+        printf("%-16s %6u %5u %5u %4u %6u %4u %7u\n", d->pszName,
+               d->nOffset, d->nWidth, d->nShift, d->nBits,
+               d->nCount, d->nBase, d->nDefault);
+    }
+}
+
+// Parses a comma-separated field list into a mask of OPJ_FUZZ_OPT_xxx bits.
+static bool ParseFields(const char* list, uint32_t* mask) {
+    *mask = 0;
+    std::string s = list;
+    size_t pos = 0;
+    while (pos <= s.size()) {
+        size_t end = s.find(',', pos);
+        if (end == std::string::npos) {
+            end = s.size();
+        }
+        std::string name = s.substr(pos, end - pos);
+        int f = 0;
+        while (f < OPJ_FUZZ_OPT_COUNT && name != kOpjFuzzOptionSchema[f].pszName) {
+            f++;
+        }
+        if (f == OPJ_FUZZ_OPT_COUNT) {
+            fprintf(stderr, "unknown option field '%s' (see -l)\n", name.c_str());
+            return false;
+        }
+        *mask |= 1u << f;
+        pos = end + 1;
+    }
+    return true;
+}
+
+static bool ReadFile(const char* path, std::vector<uint8_t>* data) {
+    FILE* f = fopen(path, "rb");
+    if (!f) {
+        return false;
+    }
+    data->clear();
+    uint8_t chunk[65536];
+    size_t n;
+    while ((n = fread(chunk, 1, sizeof(chunk), f)) > 0) {
+        data->insert(data->end(), chunk, chunk + n);
+    }
+    fclose(f);
+    return true;
+}
+
+static bool WriteFile(const std::string& path, const uint8_t* header,
+                      const std::vector<uint8_t>& payload, size_t offset) {
+    FILE* f = fopen(path.c_str(), "wb");
+    if (!f) {
+        return false;
+    }
+    bool ok = fwrite(header, 1, OPJ_FUZZ_OPTIONS_SIZE, f) == OPJ_FUZZ_OPTIONS_SIZE &&
+              fwrite(payload.data() + offset, 1, payload.size() - offset, f) ==
+                  payload.size() - offset;
+    fclose(f);
+    return ok;
+}
+
+static OPJ_CODEC_FORMAT PayloadFormat(const uint8_t* buf, size_t len) {
+    static const uint8_t jp2_box_jp[] = {0x6a, 0x50, 0x20, 0x20};
+    if (len >= 8 && memcmp(buf + 4, jp2_box_jp, sizeof(jp2_box_jp)) == 0) {
+        return OPJ_CODEC_JP2;
+    }
+    return OPJ_CODEC_J2K;
+}
+
+int main(int argc, char** argv) {
+    const char* fields = kDefaultFields;
+    uint32_t nMax = 8;
+    const char* outdir = NULL;
+    bool bList = false, bCount = false;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "lcf:m:w:")) != -1) {
+        switch (opt) {
+        case 'l':
+            bList = true;
+            break;
+        case 'c':
+            bCount = true;
+            break;
+        case 'f':
+            fields = optarg;
+            break;
+        case 'm':
+            nMax = (uint32_t)strtoul(optarg, NULL, 10);
+            break;
+        case 'w':
+            outdir = optarg;
+            break;
+        default:
+            Usage(argv[0]);
+            return 1;
+        }
+    }
+    if (bList) {
+        ListSchema();
+        return 0;
+    }
+
+    uint32_t mask;
+    if (!ParseFields(fields, &mask)) {
+        return 1;
+    }
+    uint64_t nSpace = OpjFuzzSweepSize(mask, nMax);
+    if (bCount) {
+        printf("%llu\n", (unsigned long long)nSpace);
+        return 0;
+    }
+    if (optind >= argc) {
+        Usage(argv[0]);
+        return 1;
+    }
+    if (outdir && mkdir(outdir, 0755) != 0 && errno != EEXIST) {
+        perror(outdir);
+        return 1;
+    }
+
+    if (!outdir) {
+        printf("file,index");
+        for (int f = 0; f < OPJ_FUZZ_OPT_COUNT; f++) {
+            if (mask & (1u << f)) {
+                printf(",%s", kOpjFuzzOptionSchema[f].pszName);
+            }
+        }
+        printf(",header,decoded,hash,decode_us\n");
+    }
+
+    std::vector<uint8_t> data;
+    for (int a = optind; a < argc; a++) {
+        if (!ReadFile(argv[a], &data)) {
+            perror(argv[a]);
+            continue;
+        }
+        // Inputs from an AFL corpus carry a header; sweep the payload only.
+        size_t offset = OpjFuzzHasOptions(data.data(), data.size()) ? OPJ_FUZZ_OPTIONS_SIZE : 0;
+        const uint8_t* payload = data.data() + offset;
+        size_t payload_len = data.size() - offset;
+        const char* base = strrchr(argv[a], '/');
+        base = base ? base + 1 : argv[a];
+
+        OpjFuzzOptions options;
+        for (uint64_t i = 0; OpjFuzzSweepAt(i, mask, nMax, &options); i++) {
+            OpjFuzzNormalizeOptions(&options);
+            if (outdir) {
+                uint8_t header[OPJ_FUZZ_OPTIONS_SIZE];
+                OpjFuzzWriteOptions(&options, header);
+                char name[64];
+                snprintf(name, sizeof(name), ".%06llu", (unsigned long long)i);
+                std::string path = std::string(outdir) + "/" + base + name;
+                if (!WriteFile(path, header, data, offset)) {
+                    perror(path.c_str());
+                    return 1;
+                }
+                continue;
+            }
+
+            OpjFuzzDecodeOptions opts;
+            opts.eCodecFormat = PayloadFormat(payload, payload_len);
+            OpjFuzzApplyOptions(&options, &opts);
+            opts.pfnError = QuietCallback;
+            opts.pfnWarning = QuietCallback;
+            opts.pfnInfo = QuietCallback;
+
+            OpjFuzzDecodeResult result;
+            OpjFuzzDecode(payload, payload_len, &opts, true, &result);
+
+            printf("%s,%llu", base, (unsigned long long)i);
+            for (int f = 0; f < OPJ_FUZZ_OPT_COUNT; f++) {
+                if (mask & (1u << f)) {
+                    printf(",%u", OpjFuzzGetOption(&options, f));
+                }
+            }
+            printf(",%d,%d,%016llx,%llu\n", (int)result.bHeader, (int)result.bDecoded,
+                   (unsigned long long)result.nHash,
+                   (unsigned long long)(result.nDecodeNs / 1000));
+        }
+    }
+    fprintf(stderr, "%llu combinations per file\n", (unsigned long long)nSpace);
+    return 0;
+}
@@ -0,0 +1,472 @@
+/*
+ * Seed synthesiser for the openjpeg fuzz drivers.
+ *
+ * Every seed is produced by the libopenjp2 encoder from a small synthetic
+ * image, so it is a complete, structurally valid J2K codestream or JP2 file
+ * (SIZ/COD/QCD/SOT/SOD/EOC, jp2h/ihdr/colr/jp2c) with real packet data.
+ * Encoding parameters are drawn at random per seed and cover image and tile
+ * sizes, component counts and bit depths, sub-sampling, progression orders,
+ * code-block sizes and styles, precincts, SOP/EPH, quality layers, the
+ * number of resolutions, reversible/irreversible wavelets and MCT.
+ *
+ * Each seed is written into the input directory layout of one driver, with
+ * that driver's option bytes in front of the payload.
+ *
+ * Build (no instrumentation needed):
+ *   g++ -O2 -I../src/lib/openjp2 -o seeds_gen seeds_gen.cpp -L../../build/bin -lopenjp2
+ *
+ * Usage:
+ *   ./seeds_gen [-n count] [-s seed] [-d driver] <output_dir>
+ *
+ * driver is one of J2K, J2K_afl, JP2, JP2_afl or all (default); seeds go to
+ * <output_dir>/<driver>/.
+ */
+
+#include <errno.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <string>
+#include <vector>
+
+#include "openjpeg.h"
+#include "common/opj_fuzz_options.h"
+
+// ---------------------------------------------------------------------------
+// Random parameter selection
+
+struct Rng {
+    uint64_t s;
+
+    uint32_t Next() {
+        // xorshift64*
+        s ^= s >> 12;
+        s ^= s << 25;
+        s ^= s >> 27;
+        return (uint32_t)((s * 0x2545F4914F6CDD1DULL) >> 32);
+    }
+    uint32_t Range(uint32_t lo, uint32_t hi) {  // inclusive
+        return lo + Next() % (hi - lo + 1);
+    }
+    bool Chance(uint32_t percent) {
+        return Next() % 100 < percent;
+    }
+};
+
+static uint32_t FloorLog2(uint32_t v) {
+    uint32_t r = 0;
+    while (v >>= 1) {
+        r++;
+    }
+    return r;
+}
+
+struct SeedParams {
+    uint32_t width, height;
+    uint32_t numcomps;
+    uint32_t prec;
+    bool     sgnd;
+    uint32_t dx, dy;            // sub-sampling of components 1..n
+    bool     tiled;
+    uint32_t tdx, tdy;
+    uint32_t numres;
+    uint32_t cblkw, cblkh;
+    uint32_t mode;              // code-block style
+    OPJ_PROG_ORDER prog;
+    uint32_t layers;
+    bool     irreversible;
+    bool     mct;
+    bool     sop, eph;
+    uint32_t numprec;           // 0 = default precincts
+    uint32_t prcw[OPJ_J2K_MAXRLVLS], prch[OPJ_J2K_MAXRLVLS];
+};
+
+static void RandomParams(Rng& rng, SeedParams* p) {
+    memset(p, 0, sizeof(*p));
+
+    // Mostly tiny images (fast to encode and decode), some multi-tile ones.
+    if (rng.Chance(80)) {
+        p->width = rng.Range(1, 64);
+        p->height = rng.Range(1, 64);
+    } else {
+        p->width = rng.Range(64, 256);
+        p->height = rng.Range(64, 256);
+    }
+
+    static const uint32_t kComps[] = {1, 1, 1, 2, 3, 3, 3, 4};
+    p->numcomps = kComps[rng.Range(0, 7)];
+    static const uint32_t kPrec[] = {1, 2, 4, 7, 8, 8, 8, 10, 12, 12, 16};
+    p->prec = kPrec[rng.Range(0, 10)];
+    p->sgnd = rng.Chance(15);
+
+    p->dx = p->dy = 1;
+    if (p->numcomps >= 3 && rng.Chance(20)) {
+        p->dx = 2;
+        p->dy = rng.Chance(50) ? 2 : 1;
+    }
+
+    p->tiled = rng.Chance(60);
+    if (p->tiled) {
+        static const uint32_t kTile[] = {8, 16, 16, 32, 32, 64, 128};
+        p->tdx = kTile[rng.Range(0, 6)];
+        p->tdy = rng.Chance(70) ? p->tdx : kTile[rng.Range(0, 6)];
+    } else {
+        p->tdx = p->width;
+        p->tdy = p->height;
+    }
+
+    // 2^(numres-1) must not exceed the smallest tile / component dimension.
+    uint32_t minDim = p->tdx < p->tdy ? p->tdx : p->tdy;
+    uint32_t compW = (p->width + p->dx - 1) / p->dx;
+    uint32_t compH = (p->height + p->dy - 1) / p->dy;
+    if (compW < minDim) minDim = compW;
+    if (compH < minDim) minDim = compH;
+    uint32_t maxRes = FloorLog2(minDim) + 1;
+    if (maxRes > 7) maxRes = 7;
+    p->numres = rng.Range(1, maxRes);
+
+    // Code-blocks: 4..64 on each side, area at most 4096.
+    p->cblkw = 1u << rng.Range(2, 6);
+    p->cblkh = 1u << rng.Range(2, 6);
+    if (rng.Chance(70)) {
+        p->mode = 0;
+    } else {
+        p->mode = rng.Range(1, 63);  // BYPASS|RESET|RESTART|VSC|ERTERM|SEGMARK
+    }
+
+    p->prog = (OPJ_PROG_ORDER)rng.Range(OPJ_LRCP, OPJ_CPRL);
+    p->layers = rng.Chance(50) ? 1 : rng.Range(2, 5);
+    p->irreversible = rng.Chance(30);
+    p->mct = p->numcomps >= 3 && p->dx == 1 && p->dy == 1 && rng.Chance(60);
+    p->sop = rng.Chance(20);
+    p->eph = rng.Chance(20);
+
+    if (rng.Chance(35)) {
+        p->numprec = rng.Range(1, p->numres);
+        for (uint32_t i = 0; i < p->numprec; i++) {
+            p->prcw[i] = 1u << rng.Range(2, 8);
+            p->prch[i] = 1u << rng.Range(2, 8);
+        }
+    }
+}
+
+// ---------------------------------------------------------------------------
+// Encoding into memory
+
+struct MemWriter {
+    std::vector<uint8_t> data;
+    size_t pos;
+};
+
+static OPJ_SIZE_T WriteCallback(void* pBuffer, OPJ_SIZE_T nBytes, void* pUserData) {
+    MemWriter* w = (MemWriter*)pUserData;
+    if (w->pos + nBytes > w->data.size()) {
+        w->data.resize(w->pos + nBytes);
+    }
+    memcpy(w->data.data() + w->pos, pBuffer, nBytes);
+    w->pos += nBytes;
+    return nBytes;
+}
+
+static OPJ_OFF_T SkipCallback(OPJ_OFF_T nBytes, void* pUserData) {
+    MemWriter* w = (MemWriter*)pUserData;
+    if (nBytes < 0 && (size_t)(-nBytes) > w->pos) {
+        return -1;
+    }
+    w->pos += nBytes;
+    if (w->pos > w->data.size()) {
+        w->data.resize(w->pos);
+    }
+    return nBytes;
+}
+
+static OPJ_BOOL SeekCallback(OPJ_OFF_T nBytes, void* pUserData) {
+    MemWriter* w = (MemWriter*)pUserData;
+    if (nBytes < 0) {
+        return OPJ_FALSE;
+    }
+    w->pos = (size_t)nBytes;
+    if (w->pos > w->data.size()) {
+        w->data.resize(w->pos);
+    }
+    return OPJ_TRUE;
+}
+
+static void QuietCallback(const char*, void*) {
+}
+
+static opj_image_t* SyntheticImage(Rng& rng, const SeedParams* p, bool jp2) {
+    opj_image_cmptparm_t cmptparm[4];
+    memset(cmptparm, 0, sizeof(cmptparm));
+    for (uint32_t c = 0; c < p->numcomps; c++) {
+        uint32_t dx = c ? p->dx : 1;
+        uint32_t dy = c ? p->dy : 1;
+        cmptparm[c].dx = dx;
+        cmptparm[c].dy = dy;
+        cmptparm[c].w = (p->width + dx - 1) / dx;
+        cmptparm[c].h = (p->height + dy - 1) / dy;
+        cmptparm[c].prec = p->prec;
+        cmptparm[c].sgnd = p->sgnd;
+    }
+
+    OPJ_COLOR_SPACE cs = OPJ_CLRSPC_UNSPECIFIED;
+    if (jp2) {
+        cs = (p->numcomps >= 3) ? OPJ_CLRSPC_SRGB : OPJ_CLRSPC_GRAY;
+    }
+    opj_image_t* image = opj_image_create(p->numcomps, cmptparm, cs);
+    if (!image) {
+        return NULL;
+    }
+    image->x0 = 0;
+    image->y0 = 0;
+    image->x1 = p->width;
+    image->y1 = p->height;
+
+    // Gradients plus noise: compressible but not trivial, so every coding
+    // pass and most bit-planes carry data.
+    uint32_t pattern = rng.Range(0, 3);
+    int32_t lo = p->sgnd ? -(1 << (p->prec - 1)) : 0;
+    int32_t span = 1 << p->prec;
+    for (uint32_t c = 0; c < p->numcomps; c++) {
+        opj_image_comp_t* comp = &image->comps[c];
+        for (uint32_t y = 0; y < comp->h; y++) {
+            for (uint32_t x = 0; x < comp->w; x++) {
+                uint32_t v;
+                switch (pattern) {
+                case 0:
+                    v = x * 7 + y * 3 + c * 31;
+                    break;
+                case 1:
+                    v = ((x >> 2) ^ (y >> 2)) * 37;
+                    break;
+                case 2:
+                    v = rng.Next();
+                    break;
+                default:
+                    v = x * y + (rng.Next() & 3);
+                    break;
+                }
+                comp->data[y * comp->w + x] = lo + (int32_t)(v % (uint32_t)span);
+            }
+        }
+    }
+    return image;
+}
+
+static bool Encode(Rng& rng, const SeedParams* p, bool jp2, MemWriter* out) {
+    opj_cparameters_t parameters;
+    opj_set_default_encoder_parameters(&parameters);
+
+    parameters.tile_size_on = p->tiled ? OPJ_TRUE : OPJ_FALSE;
+    parameters.cp_tx0 = 0;
+    parameters.cp_ty0 = 0;
+    parameters.cp_tdx = p->tdx;
+    parameters.cp_tdy = p->tdy;
+    parameters.numresolution = p->numres;
+    parameters.cblockw_init = p->cblkw;
+    parameters.cblockh_init = p->cblkh;
+    parameters.mode = p->mode;
+    parameters.prog_order = p->prog;
+    parameters.irreversible = p->irreversible;
+    parameters.tcp_mct = p->mct ? 1 : 0;
+    if (p->sop) parameters.csty |= 0x02;
+    if (p->eph) parameters.csty |= 0x04;
+    if (p->numprec) {
+        parameters.csty |= 0x01;
+        parameters.res_spec = p->numprec;
+        for (uint32_t i = 0; i < p->numprec; i++) {
+            parameters.prcw_init[i] = p->prcw[i];
+            parameters.prch_init[i] = p->prch[i];
+        }
+    }
+
+    // Rate-allocated layers with decreasing compression ratios; the last
+    // layer is lossless.
+    parameters.tcp_numlayers = p->layers;
+    parameters.cp_disto_alloc = 1;
+    for (uint32_t l = 0; l < p->layers; l++) {
+        parameters.tcp_rates[l] = (l + 1 == p->layers) ? 0.0f
+                                  : (float)((p->layers - l) * 8);
+    }
+
+    opj_image_t* image = SyntheticImage(rng, p, jp2);
+    if (!image) {
+        return false;
+    }
+
+    opj_codec_t* codec = opj_create_compress(jp2 ? OPJ_CODEC_JP2 : OPJ_CODEC_J2K);
+    opj_set_info_handler(codec, QuietCallback, NULL);
+    opj_set_warning_handler(codec, QuietCallback, NULL);
+    opj_set_error_handler(codec, QuietCallback, NULL);
+
+    bool ok = false;
+    if (opj_setup_encoder(codec, &parameters, image)) {
+        opj_stream_t* stream = opj_stream_create(64 * 1024, OPJ_FALSE);
+        out->data.clear();
+        out->pos = 0;
+        opj_stream_set_write_function(stream, WriteCallback);
+        opj_stream_set_skip_function(stream, SkipCallback);
+        opj_stream_set_seek_function(stream, SeekCallback);
+        opj_stream_set_user_data(stream, out, NULL);
+
+        ok = opj_start_compress(codec, image, stream) &&
+             opj_encode(codec, stream) &&
+             opj_end_compress(codec, stream);
+        opj_stream_destroy(stream);
+    }
+
+    opj_destroy_codec(codec);
+    opj_image_destroy(image);
+    return ok;
+}
+
+// ---------------------------------------------------------------------------
+// Driver profiles
+
+struct DriverProfile {
+    const char* name;
+    bool        jp2;
+    // Appends the option bytes the driver reads in front of the payload.
+    // NULL when the driver takes the raw codestream / file.
+    void (*writeOptions)(Rng& rng, std::vector<uint8_t>* out);
+};
+
+// Option header of the AFL drivers, with mostly default values so the
+// seed decodes fully, and some spread over the legal option ranges.
+static void WriteOptionHeader(Rng& rng, std::vector<uint8_t>* out) {
+    OpjFuzzOptions opts;
+    OpjFuzzDefaultOptions(&opts);
+    if (rng.Chance(50)) {
+        opts.nReduce = rng.Range(0, 3);
+        opts.nLayer = rng.Range(0, 4);
+        opts.nThreads = rng.Range(1, 8);
+        opts.bThreadCheck = opts.nThreads > 1 && rng.Chance(25);
+        opts.nDecodeW = rng.Chance(50) ? 0 : rng.Range(1, 64);
+        opts.nDecodeH = rng.Chance(50) ? 0 : rng.Range(1, 64);
+        opts.bChunked = rng.Chance(50);
+        opts.nChunkSelector = (uint8_t)rng.Range(0, 10);
+        opts.bTiles = rng.Chance(50);
+        opts.nTileIndex = rng.Range(0, 4);
+        opts.nFlags = rng.Chance(25) ? 1 : 0;
+    }
+    uint8_t header[OPJ_FUZZ_OPTIONS_SIZE];
+    OpjFuzzWriteOptions(&opts, header);
+    out->insert(out->end(), header, header + sizeof(header));
+}
+
+static const DriverProfile kProfiles[] = {
+    // libFuzzer drivers take the raw input.
+    {"J2K", false, NULL},
+    {"JP2", true, NULL},
+    // The AFL drivers read the option header in front of the payload.
+    {"J2K_afl", false, WriteOptionHeader},
+    {"JP2_afl", true, WriteOptionHeader},
+};
+
+static bool MakeDir(const std::string& path) {
+    return mkdir(path.c_str(), 0755) == 0 || errno == EEXIST;
+}
+
+static bool WriteFile(const std::string& path, const std::vector<uint8_t>& data) {
+    FILE* f = fopen(path.c_str(), "wb");
+    if (!f) {
+        return false;
+    }
+    size_t n = fwrite(data.data(), 1, data.size(), f);
+    fclose(f);
+    return n == data.size();
+}
+
+static void Usage(const char* argv0) {
+    fprintf(stderr,
+            "Usage: %s [-n count] [-s seed] [-d J2K|J2K_afl|JP2|JP2_afl|all] <output_dir>\n",
+            argv0);
+}
+
+int main(int argc, char** argv) {
+    unsigned long count = 1000;
+    uint64_t seed = (uint64_t)time(NULL);
+    const char* driver = "all";
+
+    int opt;
+    while ((opt = getopt(argc, argv, "n:s:d:")) != -1) {
+        switch (opt) {
+        case 'n':
+            count = strtoul(optarg, NULL, 10);
+            break;
+        case 's':
+            seed = strtoull(optarg, NULL, 10);
+            break;
+        case 'd':
+            driver = optarg;
+            break;
+        default:
+            Usage(argv[0]);
+            return 1;
+        }
+    }
+    if (optind >= argc) {
+        Usage(argv[0]);
+        return 1;
+    }
+    std::string outdir = argv[optind];
+    if (!MakeDir(outdir)) {
+        perror(outdir.c_str());
+        return 1;
+    }
+
+    Rng rng = {seed ? seed : 1};
+    struct timespec t0, t1;
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+
+    unsigned long written = 0, failed = 0;
+    MemWriter payload;
+    std::vector<uint8_t> file;
+    for (size_t i = 0; i < sizeof(kProfiles) / sizeof(kProfiles[0]); i++) {
+        const DriverProfile* profile = &kProfiles[i];
+        if (strcmp(driver, "all") != 0 && strcmp(driver, profile->name) != 0) {
+            continue;
+        }
+        std::string dir = outdir + "/" + profile->name;
+        if (!MakeDir(dir)) {
+            perror(dir.c_str());
+            return 1;
+        }
+
+        for (unsigned long n = 0; n < count; n++) {
+            SeedParams params;
+            RandomParams(rng, &params);
+            if (!Encode(rng, &params, profile->jp2, &payload)) {
+                failed++;
+                continue;
+            }
+
+            file.clear();
+            if (profile->writeOptions) {
+                profile->writeOptions(rng, &file);
+            }
+            file.insert(file.end(), payload.data.begin(), payload.data.end());
+
+            char name[64];
+            snprintf(name, sizeof(name), "/seed_%06lu.%s", n,
+                     profile->jp2 ? "jp2" : "j2k");
+            if (!WriteFile(dir + name, file)) {
+                perror((dir + name).c_str());
+                return 1;
+            }
+            written++;
+        }
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+    double secs = (t1.tv_sec - t0.tv_sec) + (t1.tv_nsec - t0.tv_nsec) / 1e9;
+    fprintf(stderr, "wrote %lu seeds (%lu rejected by the encoder) in %.2f s, %.0f seeds/s\n",
+            written, failed, secs, secs > 0 ? written / secs : 0.0);
+    return 0;
+}
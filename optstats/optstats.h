@@ -0,0 +1,393 @@
+/*
+ * Option-tuple coverage table shared by the AFL drivers, their mutators and
+ * optstats_report.
+ *
+ * Every driver decodes an option header and runs the library with the
+ * resulting option tuple.  With OPTSTATS_FILE set, the driver also maps that
+ * file as a shared table and, per exec, looks up the tuple's slot and
+ * counts in it:
+ *
+ *   execs       execs started with the tuple
+ *   finished    execs that returned; the rest crashed or timed out
+ *   crashes     execs that ended in SIGSEGV, SIGBUS, SIGFPE, SIGILL or
+ *               SIGABRT (sanitizer reports abort under afl-fuzz)
+ *   new_edges   coverage map entries that no exec of any tuple had hit
+ *               before, read from the AFL map after the exec
+ *
+ * A tuple is keyed by its normalised option header: the header re-encoded
+ * from the decoded options, so headers that decode to the same options
+ * share a slot, and a key written back into an input selects the tuple
+ * again.  The driver adds a readable label when it creates the slot.
+ *
+ * Coverage map indices only mean something for one binary, so use one
+ * table file per driver binary; several afl-fuzz instances of the same
+ * binary (-M / -S) can share it.  Slots are claimed with compare-and-swap
+ * and all counters are updated atomically.
+ *
+ * optstats_sched_* is the read side for the option mutators: it picks a
+ * recorded tuple with probability proportional to a UCB1 score, new edges
+ * and crashes per exec plus an exploration bonus for tuples with few execs,
+ * so header mutations drift to under-explored and high-yield tuples.
+ *
+ * Without OPTSTATS_FILE every call is a NULL check.  Set OPTSTATS_EDGES=0
+ * to skip the coverage map scan (about 8K word loads for a 64 KiB map).
+ */
+
+#ifndef OPTSTATS_H
+#define OPTSTATS_H
+
+#include <fcntl.h>
+#include <math.h>
+#include <signal.h>
+#include <stdarg.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define OPTSTATS_MAGIC     "OPTSTAT1"
+#define OPTSTATS_VERSION   1
+#define OPTSTATS_SLOTS     4096
+#define OPTSTATS_KEY_MAX   16
+#define OPTSTATS_LABEL_MAX 96
+#define OPTSTATS_MAP_BITS  18       // coverage map entries tracked: 1 << 18
+
+typedef struct {
+    uint64_t hash;                      // key hash, 0 while the slot is free
+    uint32_t ready;                     // key written
+    uint32_t key_len;
+    uint8_t key[OPTSTATS_KEY_MAX];      // normalised option header
+    char label[OPTSTATS_LABEL_MAX];     // decoded tuple, for reports
+    uint64_t execs;
+    uint64_t finished;
+    uint64_t crashes;
+    uint64_t new_edges;
+    uint64_t last_new;                  // table execs when new_edges last grew
+} optstats_slot;
+
+typedef struct {
+    char magic[8];
+    uint32_t version;
+    uint32_t slots;
+    char driver[32];                    // driver that created the table
+    uint64_t execs;                     // execs of all tuples
+    uint64_t dropped;                   // execs whose tuple found no free slot
+    uint64_t edges;                     // distinct coverage map entries hit
+    uint8_t virgin[1 << (OPTSTATS_MAP_BITS - 3)];
+    optstats_slot slot[OPTSTATS_SLOTS];
+} optstats_table;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+// AFL++ coverage map, present only in instrumented binaries
+extern uint8_t *__afl_area_ptr __attribute__((weak));
+extern uint32_t __afl_map_size __attribute__((weak));
+#ifdef __cplusplus
+}
+#endif
+
+static inline uint64_t optstats_hash(const uint8_t *key, size_t len) {
+    uint64_t h = 1469598103934665603ULL;
+    for (size_t i = 0; i < len; i++) {
+        h = (h ^ key[i]) * 1099511628211ULL;
+    }
+    return h ? h : 1;
+}
+
+static inline bool optstats_valid(const optstats_table *t) {
+    return memcmp(t->magic, OPTSTATS_MAGIC, 8) == 0 && t->version == OPTSTATS_VERSION &&
+           t->slots == OPTSTATS_SLOTS;
+}
+
+// Maps the table at path.  The writer creates and initialises the file if
+// needed; readers get NULL until a writer has done so.
+static inline optstats_table *optstats_map(const char *path, bool writer, const char *driver) {
+    int fd = open(path, writer ? O_RDWR | O_CREAT : O_RDONLY, 0644);
+    if (fd < 0) {
+        return NULL;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0 ||
+        ((size_t)st.st_size < sizeof(optstats_table) &&
+         (!writer || ftruncate(fd, sizeof(optstats_table)) != 0))) {
+        close(fd);
+        return NULL;
+    }
+    void *p = mmap(NULL, sizeof(optstats_table), writer ? PROT_READ | PROT_WRITE : PROT_READ,
+                   MAP_SHARED, fd, 0);
+    close(fd);
+    if (p == MAP_FAILED) {
+        return NULL;
+    }
+    optstats_table *t = (optstats_table *)p;
+
+    if (writer) {
+        // The first writer to swap the version in fills the header
+        uint32_t unset = 0;
+        if (__atomic_compare_exchange_n(&t->version, &unset, (uint32_t)OPTSTATS_VERSION, false,
+                                        __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+            t->slots = OPTSTATS_SLOTS;
+            snprintf(t->driver, sizeof(t->driver), "%s", driver ? driver : "");
+            __atomic_thread_fence(__ATOMIC_RELEASE);
+            memcpy(t->magic, OPTSTATS_MAGIC, 8);
+        } else {
+            // Another writer is filling the header
+            for (int i = 0; i < 1000 && memcmp(t->magic, OPTSTATS_MAGIC, 8) != 0; i++) {
+                usleep(1000);
+            }
+        }
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    }
+    if (!optstats_valid(t)) {
+        munmap(p, sizeof(optstats_table));
+        return NULL;
+    }
+    return t;
+}
+
+// Finds the slot of key, claiming a free one if create is set.  *created
+// tells the caller to write the label.
+static inline optstats_slot *optstats_lookup(optstats_table *t, const uint8_t *key, size_t len,
+                                             bool create, bool *created) {
+    if (len > OPTSTATS_KEY_MAX) len = OPTSTATS_KEY_MAX;
+    uint64_t h = optstats_hash(key, len);
+    if (created) *created = false;
+    for (uint32_t probe = 0; probe < OPTSTATS_SLOTS; probe++) {
+        optstats_slot *s = &t->slot[(h + probe) % OPTSTATS_SLOTS];
+        uint64_t cur = __atomic_load_n(&s->hash, __ATOMIC_ACQUIRE);
+        if (cur == 0) {
+            if (!create) return NULL;
+            if (__atomic_compare_exchange_n(&s->hash, &cur, h, false, __ATOMIC_ACQ_REL,
+                                            __ATOMIC_ACQUIRE)) {
+                memcpy(s->key, key, len);
+                s->key_len = (uint32_t)len;
+                __atomic_store_n(&s->ready, 1, __ATOMIC_RELEASE);
+                if (created) *created = true;
+                return s;
+            }
+            // Lost the race; cur now holds the winner's hash
+        }
+        if (cur != h) continue;
+        // The claimer writes the key right after the swap
+        bool ready = false;
+        for (int spin = 0; spin < 1000000 && !ready; spin++) {
+            ready = __atomic_load_n(&s->ready, __ATOMIC_ACQUIRE) != 0;
+        }
+        if (ready && s->key_len == len && memcmp(s->key, key, len) == 0) {
+            return s;
+        }
+    }
+    return NULL;
+}
+
+// ---------------------------------------------------------------------------
+// Driver side.
+
+static optstats_table *optstats_tab = NULL;
+static optstats_slot *volatile optstats_cur = NULL;
+static bool optstats_edges_on = true;
+
+static const int optstats_signals[] = {SIGSEGV, SIGBUS, SIGFPE, SIGILL, SIGABRT};
+static struct sigaction optstats_prev[sizeof(optstats_signals) / sizeof(int)];
+
+static inline void optstats_on_signal(int sig, siginfo_t *info, void *uctx) {
+    (void)uctx;
+    optstats_slot *s = optstats_cur;
+    if (s) {
+        __atomic_fetch_add(&s->crashes, 1, __ATOMIC_RELAXED);
+        optstats_cur = NULL;
+    }
+    // Hand the signal on: a fault re-executes into the restored handler,
+    // anything sent with kill/raise is raised again
+    for (size_t i = 0; i < sizeof(optstats_signals) / sizeof(int); i++) {
+        if (optstats_signals[i] == sig) {
+            sigaction(sig, &optstats_prev[i], NULL);
+        }
+    }
+    if (!info || info->si_code <= 0) {
+        raise(sig);
+    }
+}
+
+// Maps OPTSTATS_FILE for driver and installs the crash hook.  Call once,
+// before __AFL_INIT(), after any other signal handlers the driver installs.
+static inline void optstats_init(const char *driver) {
+    const char *path = getenv("OPTSTATS_FILE");
+    if (!path || !*path) return;
+    optstats_tab = optstats_map(path, true, driver);
+    if (!optstats_tab) {
+        fprintf(stderr, "optstats: cannot map %s\n", path);
+        return;
+    }
+    const char *edges = getenv("OPTSTATS_EDGES");
+    optstats_edges_on = !(edges && !strcmp(edges, "0"));
+
+    struct sigaction sa;
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_sigaction = optstats_on_signal;
+    sa.sa_flags = SA_SIGINFO | SA_NODEFER;
+    sigemptyset(&sa.sa_mask);
+    for (size_t i = 0; i < sizeof(optstats_signals) / sizeof(int); i++) {
+        sigaction(optstats_signals[i], &sa, &optstats_prev[i]);
+    }
+}
+
+// Starts an exec with the tuple whose normalised header is key.  Returns
+// true if the tuple is new to the table; the caller then names it with
+// optstats_label().
+static inline bool optstats_begin(const void *key, size_t len) {
+    optstats_cur = NULL;
+    if (!optstats_tab) return false;
+    bool created = false;
+    optstats_slot *s = optstats_lookup(optstats_tab, (const uint8_t *)key, len, true, &created);
+    __atomic_fetch_add(&optstats_tab->execs, 1, __ATOMIC_RELAXED);
+    if (!s) {
+        __atomic_fetch_add(&optstats_tab->dropped, 1, __ATOMIC_RELAXED);
+        return false;
+    }
+    __atomic_fetch_add(&s->execs, 1, __ATOMIC_RELAXED);
+    optstats_cur = s;
+    return created;
+}
+
+#ifdef __GNUC__
+__attribute__((format(printf, 1, 2)))
+#endif
+static inline void optstats_label(const char *fmt, ...) {
+    optstats_slot *s = optstats_cur;
+    if (!s) return;
+    va_list ap;
+    va_start(ap, fmt);
+    vsnprintf(s->label, sizeof(s->label), fmt, ap);
+    va_end(ap);
+}
+
+// Counts the coverage map entries of this exec that no exec had hit yet.
+static inline uint64_t optstats_scan_edges(optstats_table *t) {
+    if (!&__afl_area_ptr || !__afl_area_ptr) return 0;
+    size_t size = &__afl_map_size ? __afl_map_size : 65536;
+    if (size > ((size_t)1 << OPTSTATS_MAP_BITS)) size = (size_t)1 << OPTSTATS_MAP_BITS;
+
+    const uint8_t *map = __afl_area_ptr;
+    uint64_t found = 0;
+    for (size_t i = 0; i + 8 <= size; i += 8) {
+        uint64_t word;
+        memcpy(&word, map + i, 8);
+        if (!word) continue;
+        for (size_t j = i; j < i + 8; j++) {
+            if (!map[j]) continue;
+            uint8_t bit = (uint8_t)(1u << (j & 7));
+            if (t->virgin[j >> 3] & bit) continue;
+            if (!(__atomic_fetch_or(&t->virgin[j >> 3], bit, __ATOMIC_RELAXED) & bit)) {
+                found++;
+            }
+        }
+    }
+    return found;
+}
+
+// Ends the exec started by optstats_begin().
+static inline void optstats_end(void) {
+    optstats_slot *s = optstats_cur;
+    if (!s) return;
+    optstats_cur = NULL;
+    __atomic_fetch_add(&s->finished, 1, __ATOMIC_RELAXED);
+    if (optstats_edges_on) {
+        uint64_t found = optstats_scan_edges(optstats_tab);
+        if (found) {
+            __atomic_fetch_add(&s->new_edges, found, __ATOMIC_RELAXED);
+            __atomic_fetch_add(&optstats_tab->edges, found, __ATOMIC_RELAXED);
+            __atomic_store_n(&s->last_new, __atomic_load_n(&optstats_tab->execs, __ATOMIC_RELAXED),
+                             __ATOMIC_RELAXED);
+        }
+    }
+}
+
+// ---------------------------------------------------------------------------
+// Mutator side.
+
+#define OPTSTATS_SCHED_REFRESH 1024
+
+typedef struct {
+    const optstats_table *table;
+    uint8_t prefix[8];                  // key prefix (header magic) to pick from
+    size_t prefix_len;
+    uint32_t count;                     // candidates
+    uint32_t picks;                     // picks since the last refresh
+    uint32_t index[OPTSTATS_SLOTS];     // candidate slots
+    double cum[OPTSTATS_SLOTS];         // cumulative scores
+} optstats_sched;
+
+// UCB1 score: yield (new edges and crashes per exec) plus exploration bonus
+static inline double optstats_score(const optstats_slot *s, uint64_t total) {
+    double n = (double)s->execs + 1.0;
+    double yield = ((double)s->new_edges + (double)s->crashes + 1.0) / n;
+    return yield + sqrt(2.0 * log((double)total + 2.0) / n);
+}
+
+static inline void optstats_sched_refresh(optstats_sched *s) {
+    s->picks = 0;
+    s->count = 0;
+    if (!s->table) {
+        const char *path = getenv("OPTSTATS_FILE");
+        if (path && *path) s->table = optstats_map(path, false, NULL);
+        if (!s->table) return;
+    }
+    const optstats_table *t = s->table;
+    uint64_t total = t->execs;
+    double sum = 0;
+    for (uint32_t i = 0; i < OPTSTATS_SLOTS; i++) {
+        const optstats_slot *slot = &t->slot[i];
+        if (!__atomic_load_n(&slot->ready, __ATOMIC_ACQUIRE) || slot->key_len < s->prefix_len ||
+            memcmp(slot->key, s->prefix, s->prefix_len) != 0) {
+            continue;
+        }
+        sum += optstats_score(slot, total);
+        s->index[s->count] = i;
+        s->cum[s->count] = sum;
+        s->count++;
+    }
+}
+
+// Prepares s to pick tuples whose key starts with prefix (up to 8 bytes);
+// OPTSTATS_FILE is mapped on first use, so the driver may create it later.
+static inline void optstats_sched_init(optstats_sched *s, const void *prefix, size_t prefix_len) {
+    memset(s, 0, sizeof(*s));
+    s->prefix_len = prefix_len < sizeof(s->prefix) ? prefix_len : sizeof(s->prefix);
+    memcpy(s->prefix, prefix, s->prefix_len);
+    s->picks = OPTSTATS_SCHED_REFRESH;
+}
+
+// Picks a recorded tuple with a random 64-bit value; copies its key to out
+// (OPTSTATS_KEY_MAX bytes) and returns the key length, or 0 if there is
+// nothing to pick from yet.
+static inline size_t optstats_sched_pick(optstats_sched *s, uint64_t rnd, uint8_t *out) {
+    if (s->picks++ >= OPTSTATS_SCHED_REFRESH) {
+        optstats_sched_refresh(s);
+    }
+    if (!s->count) return 0;
+    double x = (double)(rnd >> 11) / (double)(1ULL << 53) * s->cum[s->count - 1];
+    uint32_t lo = 0, hi = s->count - 1;
+    while (lo < hi) {
+        uint32_t mid = (lo + hi) / 2;
+        if (s->cum[mid] > x) hi = mid; else lo = mid + 1;
+    }
+    const optstats_slot *slot = &s->table->slot[s->index[lo]];
+    memcpy(out, slot->key, slot->key_len);
+    return slot->key_len;
+}
+
+static inline void optstats_sched_fini(optstats_sched *s) {
+    if (s->table) {
+        munmap((void *)s->table, sizeof(optstats_table));
+    }
+    s->table = NULL;
+}
+
+#endif // OPTSTATS_H
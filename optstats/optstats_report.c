@@ -0,0 +1,155 @@
+/*
+ * Report over optstats tables (optstats.h).
+ *
+ * Reads one or more table files, one per driver binary, and prints a line
+ * per option tuple: execs, new coverage map entries, crashes, execs lost to
+ * crashes or timeouts, new entries per million execs and how many execs ago
+ * the tuple last found something.  Each table is preceded by a summary with
+ * the total execs, the distinct tuples, the tuples that found coverage and
+ * the execs dropped because the table was full.
+ *
+ * Build:
+ *   gcc -O2 -o optstats_report optstats_report.c -lm
+ *
+ * Usage:
+ *   ./optstats_report [-s execs|edges|crashes|yield|recent] [-n top] [-c] table...
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "optstats.h"
+
+typedef enum { SORT_EXECS, SORT_EDGES, SORT_CRASHES, SORT_YIELD, SORT_RECENT } sort_key;
+
+static sort_key sort_by = SORT_EDGES;
+
+// Edges per million execs
+static double yield(const optstats_slot *s) {
+    return s->execs ? (double)s->new_edges * 1e6 / (double)s->execs : 0.0;
+}
+
+static uint64_t lost(const optstats_slot *s) {
+    uint64_t done = s->finished + s->crashes;
+    return s->execs > done ? s->execs - done : 0;
+}
+
+static int compare_slots(const void *a, const void *b) {
+    const optstats_slot *x = *(const optstats_slot *const *)a;
+    const optstats_slot *y = *(const optstats_slot *const *)b;
+    double kx, ky;
+    switch (sort_by) {
+    case SORT_EXECS:   kx = (double)x->execs;     ky = (double)y->execs;     break;
+    case SORT_CRASHES: kx = (double)x->crashes;   ky = (double)y->crashes;   break;
+    case SORT_YIELD:   kx = yield(x);             ky = yield(y);             break;
+    case SORT_RECENT:  kx = (double)x->last_new;  ky = (double)y->last_new;  break;
+    default:           kx = (double)x->new_edges; ky = (double)y->new_edges; break;
+    }
+    return kx < ky ? 1 : kx > ky ? -1 : 0;
+}
+
+static void print_key(const optstats_slot *s) {
+    for (uint32_t i = 0; i < s->key_len; i++) {
+        printf("%02x", s->key[i]);
+    }
+}
+
+static int report(const char *path, int top, bool csv) {
+    optstats_table *t = optstats_map(path, false, NULL);
+    if (!t) {
+        fprintf(stderr, "%s: not an optstats table\n", path);
+        return -1;
+    }
+
+    const optstats_slot *slots[OPTSTATS_SLOTS];
+    int count = 0, productive = 0;
+    for (int i = 0; i < OPTSTATS_SLOTS; i++) {
+        const optstats_slot *s = &t->slot[i];
+        if (!s->ready) continue;
+        slots[count++] = s;
+        if (s->new_edges) productive++;
+    }
+    int tuples = count;
+    qsort(slots, count, sizeof(slots[0]), compare_slots);
+    if (top > 0 && top < count) count = top;
+
+    if (!csv) {
+        printf("%s: driver %s, %llu execs, %d tuples (%d found coverage), %llu edges, %llu dropped\n",
+               path, t->driver, (unsigned long long)t->execs, tuples, productive,
+               (unsigned long long)t->edges, (unsigned long long)t->dropped);
+        printf("%12s %9s %8s %8s %10s %12s  %-32s %s\n", "execs", "new_edges", "crashes", "lost",
+               "edges/Mex", "since_new", "key", "tuple");
+    }
+    for (int i = 0; i < count; i++) {
+        const optstats_slot *s = slots[i];
+        uint64_t since = s->new_edges ? t->execs - s->last_new : t->execs;
+        if (csv) {
+            printf("%s,", t->driver);
+            print_key(s);
+            printf(",\"%s\",%llu,%llu,%llu,%llu,%.1f,%llu\n", s->label,
+                   (unsigned long long)s->execs, (unsigned long long)s->new_edges,
+                   (unsigned long long)s->crashes, (unsigned long long)lost(s), yield(s),
+                   (unsigned long long)since);
+        } else {
+            printf("%12llu %9llu %8llu %8llu %10.1f %12llu  ", (unsigned long long)s->execs,
+                   (unsigned long long)s->new_edges, (unsigned long long)s->crashes,
+                   (unsigned long long)lost(s), yield(s), (unsigned long long)since);
+            print_key(s);
+            printf("%*s  %s\n", (int)(32 - 2 * s->key_len), "", s->label);
+        }
+    }
+    if (!csv) printf("\n");
+    munmap(t, sizeof(optstats_table));
+    return 0;
+}
+
+static void usage(const char *argv0) {
+    fprintf(stderr, "Usage: %s [-s execs|edges|crashes|yield|recent] [-n top] [-c] table...\n", argv0);
+}
+
+int main(int argc, char **argv) {
+    int top = 0;
+    bool csv = false;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "s:n:c")) != -1) {
+        switch (opt) {
+        case 's':
+            if (!strcmp(optarg, "execs")) sort_by = SORT_EXECS;
+            else if (!strcmp(optarg, "edges")) sort_by = SORT_EDGES;
+            else if (!strcmp(optarg, "crashes")) sort_by = SORT_CRASHES;
+            else if (!strcmp(optarg, "yield")) sort_by = SORT_YIELD;
+            else if (!strcmp(optarg, "recent")) sort_by = SORT_RECENT;
+            else {
+                usage(argv[0]);
+                return EXIT_FAILURE;
+            }
+            break;
+        case 'n':
+            top = atoi(optarg);
+            break;
+        case 'c':
+            csv = true;
+            break;
+        default:
+            usage(argv[0]);
+            return EXIT_FAILURE;
+        }
+    }
+    if (optind >= argc) {
+        usage(argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    if (csv) {
+        printf("driver,key,tuple,execs,new_edges,crashes,lost,edges_per_mexec,since_new\n");
+    }
+    int failed = 0;
+    for (int i = optind; i < argc; i++) {
+        if (report(argv[i], top, csv) != 0) failed++;
+    }
+    return failed ? EXIT_FAILURE : EXIT_SUCCESS;
+}